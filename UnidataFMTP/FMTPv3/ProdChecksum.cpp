@@ -0,0 +1,249 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      ProdChecksum.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the ProdChecksum class.
+ *
+ * On x86-64 the CRC32C is computed with the SSE4.2 crc32 instruction, eight
+ * bytes at a time, if the CPU has it; on ARMv8 with the CRC32 extension if
+ * the compiler targets it. Otherwise a table is used a byte at a time.
+ */
+
+
+#include "ProdChecksum.h"
+#include "fmtpBase.h"
+
+#include <string.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+
+/* reflected CRC32C polynomial */
+static const uint32_t CRC32C_POLY = 0x82F63B78;
+
+
+/**
+ * The table of the software CRC32C.
+ */
+struct Crc32cTable
+{
+    uint32_t entry[256];
+
+    Crc32cTable()
+    {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+            entry[i] = crc;
+        }
+    }
+};
+
+
+/**
+ * Computes a CRC32C a byte at a time, without the inversions.
+ *
+ * @param[in] crc   Inverted CRC so far.
+ * @param[in] p     The data.
+ * @param[in] len   Length of the data.
+ * @return          Inverted CRC.
+ */
+static uint32_t crc32cSw(uint32_t crc, const unsigned char* p, size_t len)
+{
+    static const Crc32cTable table;
+    while (len--)
+        crc = table.entry[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+
+#if defined(__x86_64__)
+/**
+ * Computes a CRC32C with the SSE4.2 instructions, without the inversions.
+ *
+ * @param[in] crc   Inverted CRC so far.
+ * @param[in] p     The data.
+ * @param[in] len   Length of the data.
+ * @return          Inverted CRC.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHw(uint32_t crc, const unsigned char* p, size_t len)
+{
+    uint64_t crc64 = crc;
+    for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t)) {
+        uint64_t word;
+        (void)memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        p    += sizeof(word);
+    }
+    crc = (uint32_t)crc64;
+    while (len--)
+        crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+
+
+/**
+ * Returns whether the CPU has the SSE4.2 instructions.
+ */
+static bool haveHw()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+/**
+ * Computes a CRC32C with the ARMv8 CRC32 instructions, without the
+ * inversions.
+ *
+ * @param[in] crc   Inverted CRC so far.
+ * @param[in] p     The data.
+ * @param[in] len   Length of the data.
+ * @return          Inverted CRC.
+ */
+static uint32_t crc32cHw(uint32_t crc, const unsigned char* p, size_t len)
+{
+    for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t)) {
+        uint64_t word;
+        (void)memcpy(&word, p, sizeof(word));
+        crc = __crc32cd(crc, word);
+        p  += sizeof(word);
+    }
+    while (len--)
+        crc = __crc32cb(crc, *p++);
+    return crc;
+}
+
+
+/**
+ * Returns true, the compiler only targets CPUs with the instructions.
+ */
+static bool haveHw()
+{
+    return true;
+}
+#endif
+
+
+/**
+ * Constructs the zero checksums of a product.
+ *
+ * @param[in] prodsize  Size of the product in bytes.
+ */
+ProdChecksum::ProdChecksum(const uint32_t prodsize)
+    : blocks(segBlocks(prodsize)), sums(numSegs(prodsize))
+{
+}
+
+
+/**
+ * Destructs.
+ *
+ * @param[in] none
+ */
+ProdChecksum::~ProdChecksum()
+{
+}
+
+
+/**
+ * Adds a block to the checksum of its segment.
+ *
+ * @param[in] seqnum  Sequence number of the block.
+ * @param[in] data    The block.
+ * @param[in] len     Length of the block.
+ */
+void ProdChecksum::add(const uint32_t seqnum, const void* const data,
+                       const uint16_t len)
+{
+    sums[seqnum / FMTP_DATA_LEN / blocks] += blockSum(seqnum, data, len);
+}
+
+
+/**
+ * Returns the hash of a block. Seeding the CRC with the sequence number
+ * makes the hash depend on where the block is, so blocks that are swapped
+ * or stored at the wrong offset change the sum.
+ *
+ * @param[in] seqnum  Sequence number of the block.
+ * @param[in] data    The block.
+ * @param[in] len     Length of the block.
+ * @return            The hash.
+ */
+uint32_t ProdChecksum::blockSum(const uint32_t seqnum, const void* const data,
+                                const uint16_t len)
+{
+    return crc32c(seqnum, data, len);
+}
+
+
+/**
+ * Continues a CRC32C over more data.
+ *
+ * @param[in] crc   CRC of the preceding data, or the seed.
+ * @param[in] data  The data.
+ * @param[in] len   Length of the data.
+ * @return          CRC of the preceding data and `data`.
+ */
+uint32_t ProdChecksum::crc32c(uint32_t crc, const void* const data,
+                              size_t len)
+{
+    const unsigned char* p = (const unsigned char*)data;
+#if defined(__x86_64__) || \
+        (defined(__aarch64__) && defined(__ARM_FEATURE_CRC32))
+    static const bool hw = haveHw();
+    if (hw)
+        return ~crc32cHw(~crc, p, len);
+#endif
+    return ~crc32cSw(~crc, p, len);
+}
+
+
+/**
+ * Returns the number of segments of a product.
+ *
+ * @param[in] prodsize  Size of the product in bytes.
+ * @return              Number of segments, at most CKSUM_MAX_SEGS.
+ */
+uint32_t ProdChecksum::numSegs(const uint32_t prodsize)
+{
+    const uint32_t nblocks = (prodsize + (uint64_t)FMTP_DATA_LEN - 1) /
+                             FMTP_DATA_LEN;
+    const uint32_t blocks  = segBlocks(prodsize);
+    return (nblocks + blocks - 1) / blocks;
+}
+
+
+/**
+ * Returns the number of blocks in a segment of a product.
+ *
+ * @param[in] prodsize  Size of the product in bytes.
+ * @return              Number of blocks, at least 1.
+ */
+uint32_t ProdChecksum::segBlocks(const uint32_t prodsize)
+{
+    const uint32_t nblocks = (prodsize + (uint64_t)FMTP_DATA_LEN - 1) /
+                             FMTP_DATA_LEN;
+    const uint32_t blocks  = (nblocks + CKSUM_MAX_SEGS - 1) / CKSUM_MAX_SEGS;
+    return blocks ? blocks : 1;
+}
@@ -0,0 +1,112 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      ProdChecksum.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of ProdChecksum class.
+ *
+ * The end-to-end checksum of a product. The product is split into at most
+ * CKSUM_MAX_SEGS segments of whole blocks. Each block is hashed with a CRC32C
+ * that's seeded with its sequence number, and the checksum of a segment is
+ * the sum of the hashes of its blocks. The sum doesn't depend on the order
+ * in which blocks are added, so the receiver adds each block as it's stored,
+ * whichever way it arrives, without reading the product again. The sender
+ * sends the checksums of all segments in the EOP; a segment whose checksum
+ * doesn't match is requested again.
+ */
+
+
+#ifndef FMTP_FMTPV3_PRODCHECKSUM_H_
+#define FMTP_FMTPV3_PRODCHECKSUM_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+/* most segments of a product, so that the checksums fit in an EOP */
+const uint32_t CKSUM_MAX_SEGS = 256;
+
+
+class ProdChecksum
+{
+public:
+    /**
+     * Constructs the zero checksums of a product.
+     *
+     * @param[in] prodsize  Size of the product in bytes.
+     */
+    explicit ProdChecksum(const uint32_t prodsize);
+    ~ProdChecksum();
+
+    /**
+     * Adds a block to the checksum of its segment. Each block must be added
+     * once.
+     *
+     * @param[in] seqnum  Sequence number of the block.
+     * @param[in] data    The block.
+     * @param[in] len     Length of the block.
+     */
+    void     add(const uint32_t seqnum, const void* const data,
+                 const uint16_t len);
+    /**
+     * Returns the checksums of the segments.
+     */
+    const std::vector<uint32_t>& getSums() const { return sums; }
+
+    /**
+     * Returns the hash of a block.
+     *
+     * @param[in] seqnum  Sequence number of the block.
+     * @param[in] data    The block.
+     * @param[in] len     Length of the block.
+     */
+    static uint32_t blockSum(const uint32_t seqnum, const void* const data,
+                             const uint16_t len);
+    /**
+     * Continues a CRC32C (Castagnoli) over more data. Uses the CPU's CRC32
+     * instructions where there are any.
+     *
+     * @param[in] crc   CRC of the preceding data, or the seed.
+     * @param[in] data  The data.
+     * @param[in] len   Length of the data.
+     * @return          CRC of the preceding data and `data`.
+     */
+    static uint32_t crc32c(uint32_t crc, const void* const data, size_t len);
+    /**
+     * Returns the number of segments of a product, 0 for an empty one.
+     *
+     * @param[in] prodsize  Size of the product in bytes.
+     */
+    static uint32_t numSegs(const uint32_t prodsize);
+    /**
+     * Returns the number of blocks in a segment of a product. The last
+     * segment can have fewer.
+     *
+     * @param[in] prodsize  Size of the product in bytes.
+     */
+    static uint32_t segBlocks(const uint32_t prodsize);
+
+private:
+    const uint32_t        blocks;   /*!< blocks per segment */
+    std::vector<uint32_t> sums;
+};
+
+
+#endif /* FMTP_FMTPV3_PRODCHECKSUM_H_ */
@@ -37,6 +37,7 @@ RateShaper::RateShaper()
     sleeptime = 0;
     rate      = 0;
     txsize    = 0;
+    reserved_until = HRC::time_point();
 }
 
 
@@ -113,3 +114,32 @@ void RateShaper::Sleep()
         std::this_thread::sleep_for(p - txtime);
     }
 }
+
+
+/**
+ * Reserves the time to send a packet at the pre-set rate, after the time
+ * that's already reserved, and returns how long to wait before sending it.
+ * Unlike CalcPeriod() and Sleep(), this doesn't sleep, so several senders
+ * can share the rate, and a sender can do something else while it waits.
+ * The caller must serialize the calls.
+ *
+ * @param[in] size     Size of the packet to be sent.
+ * @return             Seconds to wait before sending the packet.
+ *
+ * @throw std::runtime_error  If input size is not positive.
+ */
+double RateShaper::Reserve(uint64_t size)
+{
+    if (size <= 0) {
+        throw std::runtime_error(
+                "RateShaper::Reserve() input size is not positive.");
+    }
+    const HRC::time_point now = HRC::now();
+    if (reserved_until < now)
+        reserved_until = now;
+    const std::chrono::duration<double> wait = reserved_until - now;
+    reserved_until += std::chrono::duration_cast<HRC::duration>(
+            std::chrono::duration<double>(
+            (static_cast<double>(size) * 8) / static_cast<double>(rate)));
+    return wait.count();
+}
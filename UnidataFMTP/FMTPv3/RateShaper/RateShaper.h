@@ -42,6 +42,8 @@ public:
     void CalcPeriod(uint64_t size);
     /* sleep for an amount of time based the calculated value */
     void Sleep();
+    /* reserves the time to send a packet, returns the seconds to wait first */
+    double Reserve(uint64_t size);
 
 private:
     double period;
@@ -54,6 +56,8 @@ private:
     HRC::time_point start_time;
     /* transmission end time */
     HRC::time_point end_time;
+    /* end of the time reserved by Reserve() */
+    HRC::time_point reserved_until;
 };
 
 
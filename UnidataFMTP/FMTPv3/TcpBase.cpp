@@ -128,7 +128,7 @@ void TcpBase::sendall(const int sock, const void* const buf, size_t nbytes)
     char*  ptr = (char*) buf;
 
     while (nbytes > 0) {
-        int nwritten = send(sock, ptr, nbytes, 0);
+        int nwritten = send(sock, ptr, nbytes, MSG_NOSIGNAL);
         if (nwritten <= 0) {
             throw std::system_error(errno, std::system_category(),
                     "TcpBase::sendall() Error sending to socket " +
@@ -156,7 +156,7 @@ void TcpBase::sendallstatic(const int sock, void* const buf, size_t nbytes)
     char*  ptr = (char*) buf;
 
     while (nbytes > 0) {
-        int nwritten = send(sock, ptr, nbytes, 0);
+        int nwritten = send(sock, ptr, nbytes, MSG_NOSIGNAL);
         if (nwritten <= 0) {
             throw std::system_error(errno, std::system_category(),
                     "TcpBase::sendall() Error sending to socket " +
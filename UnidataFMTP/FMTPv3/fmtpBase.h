@@ -102,28 +102,105 @@ const uint16_t FMTP_BOP_REQ   = 0x0080;
 const uint16_t FMTP_RETX_BOP  = 0x0100;
 const uint16_t FMTP_EOP_REQ   = 0x0200;
 const uint16_t FMTP_RETX_EOP  = 0x0400;
+const uint16_t FMTP_RCVR_REG  = 0x0800;
+const uint16_t FMTP_SESS_SELECT = 0x1000;
+const uint16_t FMTP_BOP_DELTA = 0x2000;
+const uint16_t FMTP_RETX_REQ_WIDE = 0x4000;
+const uint16_t FMTP_RETX_GIVEUP = 0x8000;
+
+
+/**
+ * structure of Receiver-Registration message. A receiver sends it over the
+ * retransmission TCP connection to announce the UDP port on which it accepts
+ * repair datagrams. The sender answers with the same message type carrying
+ * its own UDP repair port. Both fields are in network byte-order.
+ */
+typedef struct FmtpRcvrRegMessage {
+    uint16_t  udpport;      /*!< UDP repair port, 0 if UDP repair is unused */
+    uint16_t  options;      /*!< RCVR_OPT_* bits */
+} RcvrRegMsg;
+
+const int RCVR_REG_LEN = sizeof(RcvrRegMsg);
+/*
+ * The receiver can't receive the multicast and wants every product streamed
+ * over its TCP connection as FMTP_BOP, FMTP_MEM_DATA and FMTP_EOP. A sender
+ * that does so echoes the option in its answer.
+ */
+const uint16_t RCVR_OPT_UNICAST = 0x0001;
+/*
+ * The receiver reads the checksums of a product from the payload of a
+ * FMTP_RETX_EOP. Without the option, a FMTP_RETX_EOP has no payload.
+ */
+const uint16_t RCVR_OPT_CHECKSUMS = 0x0002;
+/*
+ * socket buffer size of the UDP repair channel. A lost product is requested
+ * block by block in one burst, which overflows the default buffer.
+ */
+const int UDP_RETX_BUFSIZE = 4194304;
+
+/*
+ * A FMTP_SESS_SELECT header carries a session id in its prodindex field. On a
+ * retransmission connection that is shared by several sessions, it tells the
+ * peer that the messages following it belong to that session. The sender
+ * confirms the first selection of each session with the same header. A seqnum
+ * of SESS_REFUSED means the receiver isn't allowed to join that session, and
+ * doesn't switch the session of the messages that follow.
+ */
+const uint32_t SESS_ACCEPTED = 0;
+const uint32_t SESS_REFUSED  = 1;
+
+
+/*
+ * A FMTP_BOP_DELTA begins a revision of an earlier product, its base. The BOP
+ * message is followed by the index of the base, the number of ranges and the
+ * byte ranges of the revision that differ from the base, all in network
+ * byte-order. Only the blocks in these ranges are multicast. A receiver that
+ * holds the base copies the other blocks from it; any other receiver requests
+ * them like lost blocks.
+ */
+typedef struct FmtpDeltaRange {
+    uint32_t seqnum;        /*!< start of the range, a multiple of FMTP_DATA_LEN */
+    uint32_t length;        /*!< length of the range in bytes */
+} DeltaRange;
+
+const int DELTA_HDR_LEN = sizeof(uint32_t) + sizeof(uint16_t);
+
+/*
+ * A FMTP_RETX_REQ asks for the blocks from seqnum through seqnum + payloadlen,
+ * so a range of up to 65535 bytes fits in one request. A longer range goes in
+ * a FMTP_RETX_REQ_WIDE, whose payload is the length of the range as a 32-bit
+ * integer in network byte-order.
+ */
+const int RETX_WIDE_LEN = sizeof(uint32_t);
+
+/*
+ * A FMTP_RETX_GIVEUP tells the sender that the receiver has given up on the
+ * products from prodindex through prodindex + seqnum - 1 and won't request or
+ * acknowledge them, e.g., because it resynchronized after a large gap. The
+ * sender treats it like a FMTP_RETX_END for each of these products.
+ */
+
+/*
+ * A FMTP_EOP or FMTP_RETX_EOP carries the checksums of the segments of the
+ * product as 32-bit integers in network byte-order, see ProdChecksum. An EOP
+ * without a payload, e.g., one the sender's timer sends, carries none.
+ */
 
 
 /** For communication between mcast thread and retx thread */
 const int MISSING_BOP  = 1;
 const int MISSING_DATA = 2;
 const int MISSING_EOP  = 3;
-const int SHUTDOWN     = 4;
+/* a data request that has to go over TCP even if UDP repair is in use */
+const int MISSING_DATA_TCP = 5;
 typedef struct recvInternalRetxReqMessage {
     int reqtype;
     uint32_t prodindex;
     uint32_t seqnum;
-    uint16_t payloadlen;
+    uint32_t payloadlen;    /*!< a range of MISSING_DATA can exceed 16 bits */
 } INLReqMsg;
 
 
-/** a structure defining parameters for each product, prodindex : sleeptime */
-typedef struct timerParameter {
-    uint32_t prodindex;
-    double   seconds;
-} timerParam;
-
-
 class fmtpBase {
 public:
     fmtpBase();
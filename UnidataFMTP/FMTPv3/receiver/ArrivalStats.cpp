@@ -0,0 +1,166 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      ArrivalStats.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the ArrivalStats class.
+ *
+ * The products of the multicast arrive one after the other, so a product's
+ * span is added when the first packet of the next product arrives. Gaps and
+ * spans use the network card's timestamps if there are any; the first-packet
+ * delay and the queue delay compare with the system clock and so use the
+ * kernel's.
+ */
+
+
+#include "ArrivalStats.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+
+
+/**
+ * Constructs an empty histogram.
+ *
+ * @param[in] none
+ */
+LogHist::LogHist()
+    : n(0), sumNs(0), maxNs(0)
+{
+    for (unsigned i = 0; i < HIST_BUCKETS; i++)
+        counts[i] = 0;
+}
+
+
+/**
+ * Adds a value. There's only one writer, so the counters are simply loaded
+ * and stored; the atomics only make them safe to read.
+ *
+ * @param[in] ns                Value in nanoseconds, ignored if negative.
+ */
+void LogHist::add(const int64_t ns)
+{
+    if (ns < 0)
+        return;
+
+    unsigned bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+    if (bucket >= HIST_BUCKETS)
+        bucket = HIST_BUCKETS - 1;
+
+    counts[bucket].store(counts[bucket].load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+    n.store(n.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sumNs.store(sumNs.load(std::memory_order_relaxed) + ns,
+                std::memory_order_relaxed);
+    if ((uint64_t)ns > maxNs.load(std::memory_order_relaxed))
+        maxNs.store(ns, std::memory_order_relaxed);
+}
+
+
+/**
+ * Copies the histogram. The copy can be off by the values that are being
+ * added at the same time.
+ *
+ * @param[out] hist             The copy.
+ */
+void LogHist::get(Histogram& hist) const
+{
+    for (unsigned i = 0; i < HIST_BUCKETS; i++)
+        hist.counts[i] = counts[i].load(std::memory_order_relaxed);
+    hist.n     = n.load(std::memory_order_relaxed);
+    hist.sumNs = sumNs.load(std::memory_order_relaxed);
+    hist.maxNs = maxNs.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * Constructs empty histograms.
+ *
+ * @param[in] none
+ */
+ArrivalStats::ArrivalStats()
+    : started(false), prodindex(0), firstNs(0), lastNs(0)
+{
+}
+
+
+/**
+ * Destructs.
+ *
+ * @param[in] none
+ */
+ArrivalStats::~ArrivalStats()
+{
+}
+
+
+/**
+ * Adds a multicast packet. Packets without a timestamp are ignored.
+ *
+ * @param[in] header            Header of the packet.
+ * @param[in] payload           Payload of the packet.
+ * @param[in] stamp             When the packet arrived.
+ * @param[in] nowNs             When the packet is handled, in nanoseconds
+ *                              since the Epoch.
+ */
+void ArrivalStats::add(const FmtpHeader& header, const char* const payload,
+                       const RecvStamp& stamp, const int64_t nowNs)
+{
+    const int64_t t = stamp.hardware ? stamp.hardware : stamp.kernel;
+    if (t == 0)
+        return;
+
+    if (stamp.kernel)
+        queueDelay.add(nowNs - stamp.kernel);
+
+    if (started && header.prodindex == prodindex) {
+        gap.add(t - lastNs);
+        lastNs = t;
+        return;
+    }
+
+    if (started)
+        span.add(lastNs - firstNs);
+    started   = true;
+    prodindex = header.prodindex;
+    firstNs   = lastNs = t;
+
+    const bool bop = header.flags == FMTP_BOP ||
+                     header.flags == FMTP_BOP_DELTA;
+    if (bop && stamp.kernel && header.payloadlen >= 3 * sizeof(uint32_t)) {
+        uint32_t start[3];
+        (void)memcpy(start, payload, sizeof(start));
+        const int64_t sec = ((int64_t)ntohl(start[0]) << 32) |
+                            ntohl(start[1]);
+        first.add(stamp.kernel - (sec * 1000000000 + ntohl(start[2])));
+    }
+}
+
+
+/**
+ * Returns copies of the histograms.
+ *
+ * @param[out] hists            The histograms.
+ */
+void ArrivalStats::get(ArrivalHistograms& hists) const
+{
+    first.get(hists.first);
+    span.get(hists.span);
+    gap.get(hists.gap);
+    queueDelay.get(hists.queueDelay);
+}
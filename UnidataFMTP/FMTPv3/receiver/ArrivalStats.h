@@ -0,0 +1,138 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      ArrivalStats.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of ArrivalStats class.
+ *
+ * Histograms of when multicast packets arrive, taken from the kernel's (or
+ * the network card's) receive timestamps rather than from when the packets
+ * are handled. The gaps between the packets of a product and the time a
+ * product takes to arrive show the network's jitter; the queue delay, from
+ * the kernel's timestamp to the handling of the packet, shows the receiver's
+ * own delay. Only the multicast handling thread adds to the histograms, any
+ * thread can read them.
+ */
+
+
+#ifndef FMTP_RECEIVER_ARRIVALSTATS_H_
+#define FMTP_RECEIVER_ARRIVALSTATS_H_
+
+
+#include <stdint.h>
+#include <atomic>
+
+#include "PacketQueue.h"
+#include "fmtpBase.h"
+
+
+/* number of buckets, the last one takes everything from 2^38 ns (~4.6 min) */
+const unsigned HIST_BUCKETS = 40;
+
+/* a copy of a histogram. Bucket 0 counts 0 ns, bucket i > 0 counts at least
+ * 2^(i-1) and less than 2^i ns */
+struct Histogram {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t n;
+    uint64_t sumNs;
+    uint64_t maxNs;
+};
+
+/* a copy of all histograms */
+struct ArrivalHistograms {
+    /* first packet of a product after the sender's start time, which needs
+     * synchronized clocks */
+    Histogram first;
+    /* first to last multicast packet of a product */
+    Histogram span;
+    /* between consecutive multicast packets of a product */
+    Histogram gap;
+    /* kernel's receive time to the handling of a packet */
+    Histogram queueDelay;
+};
+
+
+/* a log2 histogram with a single writer, any thread can take a copy */
+class LogHist
+{
+public:
+    LogHist();
+    /**
+     * Adds a value.
+     *
+     * @param[in] ns  Value in nanoseconds, ignored if negative.
+     */
+    void add(const int64_t ns);
+    /**
+     * Copies the histogram.
+     *
+     * @param[out] hist  The copy.
+     */
+    void get(Histogram& hist) const;
+
+private:
+    LogHist(const LogHist&);
+    LogHist& operator=(const LogHist&);
+
+    std::atomic<uint64_t> counts[HIST_BUCKETS];
+    std::atomic<uint64_t> n;
+    std::atomic<uint64_t> sumNs;
+    std::atomic<uint64_t> maxNs;
+};
+
+
+class ArrivalStats
+{
+public:
+    ArrivalStats();
+    ~ArrivalStats();
+    /**
+     * Adds a multicast packet. Called by the multicast handling thread only.
+     *
+     * @param[in] header   Header of the packet.
+     * @param[in] payload  Payload of the packet.
+     * @param[in] stamp    When the packet arrived.
+     * @param[in] nowNs    When the packet is handled, in nanoseconds since
+     *                     the Epoch.
+     */
+    void add(const FmtpHeader& header, const char* const payload,
+             const RecvStamp& stamp, const int64_t nowNs);
+    /**
+     * Returns copies of the histograms.
+     *
+     * @param[out] hists  The histograms.
+     */
+    void get(ArrivalHistograms& hists) const;
+
+private:
+    ArrivalStats(const ArrivalStats&);
+    ArrivalStats& operator=(const ArrivalStats&);
+
+    LogHist  first;
+    LogHist  span;
+    LogHist  gap;
+    LogHist  queueDelay;
+    /* the product whose packets are arriving */
+    bool     started;
+    uint32_t prodindex;
+    int64_t  firstNs;
+    int64_t  lastNs;
+};
+
+
+#endif /* FMTP_RECEIVER_ARRIVALSTATS_H_ */
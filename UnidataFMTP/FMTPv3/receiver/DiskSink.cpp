@@ -0,0 +1,323 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      DiskSink.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the DiskSink class.
+ *
+ * A file is named after its product index and carries a ".part" suffix
+ * until it has been completely received and synced, so whatever reads the
+ * directory never sees a partial product under its final name.
+ */
+
+
+#include "DiskSink.h"
+#ifdef LDM_LOGGING
+#include "log.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <system_error>
+
+
+/**
+ * Logs a failure of the sync thread, which has no caller to throw to.
+ *
+ * @param[in] msg  Message to be logged
+ */
+inline static void logError(const std::string& msg)
+{
+#ifdef LDM_LOGGING
+    log_add("%s: %s", msg.c_str(), strerror(errno));
+    log_flush_error();
+#else
+    (void)msg;
+#endif
+}
+
+
+/**
+ * Constructs and starts the sync thread.
+ *
+ * @param[in] dir               Directory of the product files.
+ * @throws std::system_error    if the thread can't be started.
+ */
+DiskSink::DiskSink(const std::string& dir)
+    : dir(dir), stopped(false), sync_t()
+{
+    int status = pthread_create(&sync_t, NULL, &DiskSink::StartSyncer, this);
+    if (status) {
+        throw std::system_error(status, std::system_category(),
+                "DiskSink::DiskSink() Couldn't start sync thread");
+    }
+}
+
+
+/**
+ * Syncs the completed files and stops the sync thread. The files of the
+ * products still being received are removed.
+ *
+ * @param[in] none
+ */
+DiskSink::~DiskSink()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopped = true;
+        queued.notify_one();
+    }
+    (void)pthread_join(sync_t, NULL);
+
+    for (std::map<uint32_t, ProdFile>::iterator it = files.begin();
+         it != files.end(); ++it) {
+        close(it->second);
+        (void)unlink(partPathOf(it->first).c_str());
+    }
+}
+
+
+/**
+ * Marks a product as completely received and hands its file to the sync
+ * thread. Does nothing if the product has no file, e.g., because the
+ * receiving application took it.
+ *
+ * @param[in] prodindex         Index of the product.
+ */
+void DiskSink::complete(const uint32_t prodindex)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    std::map<uint32_t, ProdFile>::iterator it = files.find(prodindex);
+    if (it == files.end())
+        return;
+
+    syncQ.push_back(*it);
+    syncing.insert(prodindex);
+    files.erase(it);
+    queued.notify_one();
+}
+
+
+/**
+ * Removes the file of a product that won't be completed. Does nothing if the
+ * product has no file.
+ *
+ * @pre                         Nothing writes to the product any longer.
+ * @param[in] prodindex         Index of the product.
+ */
+void DiskSink::discard(const uint32_t prodindex)
+{
+    ProdFile file;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::map<uint32_t, ProdFile>::iterator it = files.find(prodindex);
+        if (it == files.end())
+            return;
+        file = it->second;
+        files.erase(it);
+    }
+
+    close(file);
+    (void)unlink(partPathOf(prodindex).c_str());
+}
+
+
+/**
+ * Creates, preallocates and maps the file of a new product. Preallocation
+ * keeps the blocks of the file together and makes a full disk fail here
+ * rather than as a SIGBUS on a later write through the mapping. File systems
+ * that can't preallocate get a sparse file instead.
+ *
+ * @param[in] prodindex         Index of the product.
+ * @param[in] prodsize          Size of the product in bytes.
+ * @return                      Where to write the product, or NULL if the
+ *                              product is empty.
+ * @throws std::system_error    if the file can't be created or mapped.
+ */
+void* DiskSink::open(const uint32_t prodindex, const uint32_t prodsize)
+{
+    const std::string path = partPathOf(prodindex);
+    ProdFile          file = {-1, NULL, prodsize};
+
+    file.fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file.fd < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "DiskSink::open() Couldn't create " + path);
+    }
+
+    if (prodsize) {
+        if (fallocate(file.fd, 0, 0, prodsize) &&
+                (errno != EOPNOTSUPP || ftruncate(file.fd, prodsize))) {
+            const int err = errno;
+            close(file);
+            (void)unlink(path.c_str());
+            throw std::system_error(err, std::system_category(),
+                    "DiskSink::open() Couldn't allocate " +
+                    std::to_string(prodsize) + " bytes for " + path);
+        }
+        file.addr = mmap(NULL, prodsize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         file.fd, 0);
+        if (file.addr == MAP_FAILED) {
+            const int err = errno;
+            file.addr = NULL;
+            close(file);
+            (void)unlink(path.c_str());
+            throw std::system_error(err, std::system_category(),
+                    "DiskSink::open() Couldn't map " + path);
+        }
+    }
+
+    ProdFile old = {-1, NULL, 0};
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        /* a file left by an earlier product with the same index */
+        std::map<uint32_t, ProdFile>::iterator it = files.find(prodindex);
+        if (it != files.end())
+            old = it->second;
+        files[prodindex] = file;
+    }
+    close(old);
+
+    return file.addr;
+}
+
+
+/**
+ * Returns the final name of the file of a product.
+ *
+ * @param[in] prodindex         Index of the product.
+ * @return                      Path of the file.
+ */
+std::string DiskSink::pathOf(const uint32_t prodindex) const
+{
+    return dir + "/" + std::to_string(prodindex);
+}
+
+
+/**
+ * Copies a completely-received product from its file. The file can still be
+ * waiting to be synced under its partial name.
+ *
+ * @param[in]  prodindex        Index of the product.
+ * @param[out] data             Where to copy the product to.
+ * @param[in]  size             Maximum number of bytes to copy.
+ * @return                      false if there's no complete file of it.
+ */
+bool DiskSink::readBase(const uint32_t prodindex, void* const data,
+                        const size_t size)
+{
+    int fd = -1;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (syncing.count(prodindex))
+            fd = ::open(partPathOf(prodindex).c_str(), O_RDONLY);
+    }
+    /* also if it has just been renamed */
+    if (fd < 0)
+        fd = ::open(pathOf(prodindex).c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    size_t nread = 0;
+    while (nread < size) {
+        const ssize_t n = pread(fd, (char*)data + nread, size - nread, nread);
+        if (n <= 0)
+            break;
+        nread += n;
+    }
+    (void)::close(fd);
+    return nread > 0;
+}
+
+
+/**
+ * Unmaps and closes a file.
+ *
+ * @param[in] file              The file.
+ */
+void DiskSink::close(const ProdFile& file)
+{
+    if (file.addr)
+        (void)munmap(file.addr, file.size);
+    if (file.fd >= 0)
+        (void)::close(file.fd);
+}
+
+
+/**
+ * Returns the name of the file of a product while it's incomplete.
+ *
+ * @param[in] prodindex         Index of the product.
+ * @return                      Path of the file.
+ */
+std::string DiskSink::partPathOf(const uint32_t prodindex) const
+{
+    return pathOf(prodindex) + ".part";
+}
+
+
+/**
+ * Runs the sync thread. Called by `pthread_create()`.
+ *
+ * @param[in] ptr               The DiskSink.
+ */
+void* DiskSink::StartSyncer(void* ptr)
+{
+    static_cast<DiskSink*>(ptr)->syncer();
+    return NULL;
+}
+
+
+/**
+ * Syncs the completed files one at a time and gives each its final name once
+ * its data are on the disk. Returns once stopped and every completed file has
+ * been handled.
+ *
+ * @param[in] none
+ */
+void DiskSink::syncer()
+{
+    while (1) {
+        std::pair<uint32_t, ProdFile> prod;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (syncQ.empty() && !stopped)
+                queued.wait(lock);
+            if (syncQ.empty())
+                break;
+            prod = syncQ.front();
+            syncQ.pop_front();
+        }
+
+        const std::string path = partPathOf(prod.first);
+        /* the dirty pages stay in the page cache after the unmapping */
+        if (prod.second.addr)
+            (void)munmap(prod.second.addr, prod.second.size);
+        if (fdatasync(prod.second.fd))
+            logError("DiskSink::syncer() Couldn't sync " + path);
+        (void)::close(prod.second.fd);
+        if (rename(path.c_str(), pathOf(prod.first).c_str()))
+            logError("DiskSink::syncer() Couldn't rename " + path);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        syncing.erase(prod.first);
+    }
+}
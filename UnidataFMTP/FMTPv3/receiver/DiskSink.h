@@ -0,0 +1,128 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      DiskSink.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of DiskSink class.
+ *
+ * Writes the products that the receiving application doesn't take into
+ * files. Each product goes into its own file, which is preallocated and
+ * memory-mapped when the BOP arrives, so multicast and retransmitted blocks
+ * are copied straight to their place in the page cache. A completed file is
+ * synced and renamed by a thread of its own, so the receiving threads never
+ * wait for the disk.
+ */
+
+
+#ifndef FMTP_RECEIVER_DISKSINK_H_
+#define FMTP_RECEIVER_DISKSINK_H_
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+
+class DiskSink
+{
+public:
+    /**
+     * Constructs and starts the sync thread.
+     *
+     * @param[in] dir  Directory of the product files.
+     * @throws std::system_error  if the thread can't be started.
+     */
+    DiskSink(const std::string& dir);
+    /**
+     * Syncs the completed files, removes the incomplete ones and stops the
+     * sync thread.
+     */
+    ~DiskSink();
+    /**
+     * Marks a product as completely received. Its file is synced and renamed
+     * to its final name asynchronously.
+     *
+     * @param[in] prodindex  Index of the product.
+     */
+    void        complete(const uint32_t prodindex);
+    /**
+     * Removes the file of a product that won't be completed.
+     *
+     * @param[in] prodindex  Index of the product.
+     */
+    void        discard(const uint32_t prodindex);
+    /**
+     * Creates the file of a new product.
+     *
+     * @param[in] prodindex  Index of the product.
+     * @param[in] prodsize   Size of the product in bytes.
+     * @return               Where to write the product, or NULL if the file
+     *                       can't be created or the product is empty.
+     */
+    void*       open(const uint32_t prodindex, const uint32_t prodsize);
+    /**
+     * Returns the final name of the file of a product.
+     *
+     * @param[in] prodindex  Index of the product.
+     */
+    std::string pathOf(const uint32_t prodindex) const;
+    /**
+     * Copies a completely-received product, e.g., the base of a revision.
+     *
+     * @param[in]  prodindex  Index of the product.
+     * @param[out] data       Where to copy the product to.
+     * @param[in]  size       Maximum number of bytes to copy.
+     * @return                false if there's no complete file of it.
+     */
+    bool        readBase(const uint32_t prodindex, void* const data,
+                         const size_t size);
+
+private:
+    struct ProdFile {
+        int    fd;
+        void*  addr;
+        size_t size;
+    };
+
+    DiskSink(const DiskSink&);
+    DiskSink& operator=(const DiskSink&);
+    void        close(const ProdFile& file);
+    std::string partPathOf(const uint32_t prodindex) const;
+    static void* StartSyncer(void* ptr);
+    void        syncer();
+
+    const std::string                 dir;
+    /* files of the products being received */
+    std::map<uint32_t, ProdFile>      files;
+    /* completed files waiting to be synced */
+    std::deque<std::pair<uint32_t, ProdFile> > syncQ;
+    /* products in syncQ or being synced, still under their partial name */
+    std::set<uint32_t>                syncing;
+    bool                              stopped;
+    std::mutex                        mutex;
+    std::condition_variable           queued;
+    pthread_t                         sync_t;
+};
+
+
+#endif /* FMTP_RECEIVER_DISKSINK_H_ */
@@ -0,0 +1,243 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      EOPTimerWheel.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the EOPTimerWheel class.
+ *
+ * Deadlines are kept as absolute ticks, so a deadline that's more than one
+ * revolution away simply stays in its slot until the cursor passes it with
+ * its tick due.
+ */
+
+
+#include "EOPTimerWheel.h"
+
+
+/**
+ * Constructs an empty wheel.
+ *
+ * @param[in] none
+ */
+EOPTimerWheel::EOPTimerWheel()
+    : epoch(EOPClock::now()), slots(EOP_WHEEL_SLOTS), cursor(0),
+      stopped(false)
+{
+}
+
+
+/**
+ * Destructs the wheel.
+ *
+ * @param[in] none
+ */
+EOPTimerWheel::~EOPTimerWheel()
+{
+}
+
+
+/**
+ * Sets the EOP deadline of a product, replacing any earlier one.
+ *
+ * @param[in] prodindex        Product index.
+ * @param[in] timeout          Time from now until the deadline.
+ */
+void EOPTimerWheel::add(const uint32_t prodindex,
+                        const EOPClock::duration& timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t tick = tickOf(EOPClock::now() + timeout, true);
+    if (tick < cursor)
+        tick = cursor;
+
+    std::unordered_map<uint32_t, Slot::iterator>::iterator it =
+            index.find(prodindex);
+    if (it != index.end()) {
+        slots[it->second->tick % EOP_WHEEL_SLOTS].erase(it->second);
+        index.erase(it);
+    }
+    Slot& slot = slots[tick % EOP_WHEEL_SLOTS];
+    EOPDeadline deadline = {prodindex, tick};
+    index[prodindex] = slot.insert(slot.end(), deadline);
+    changed.notify_one();
+}
+
+
+/**
+ * Sets the EOP deadline of a product unless it already has an earlier one,
+ * so that calling this again doesn't postpone the deadline.
+ *
+ * @param[in] prodindex        Product index.
+ * @param[in] timeout          Time from now until the deadline.
+ */
+void EOPTimerWheel::advance(const uint32_t prodindex,
+                            const EOPClock::duration& timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t tick = tickOf(EOPClock::now() + timeout, true);
+    if (tick < cursor)
+        tick = cursor;
+
+    std::unordered_map<uint32_t, Slot::iterator>::iterator it =
+            index.find(prodindex);
+    if (it != index.end()) {
+        if (it->second->tick <= tick)
+            return;
+        slots[it->second->tick % EOP_WHEEL_SLOTS].erase(it->second);
+        index.erase(it);
+    }
+    Slot& slot = slots[tick % EOP_WHEEL_SLOTS];
+    EOPDeadline deadline = {prodindex, tick};
+    index[prodindex] = slot.insert(slot.end(), deadline);
+    changed.notify_one();
+}
+
+
+/**
+ * Removes the EOP deadline of a product, e.g., because the EOP has arrived.
+ * Does nothing if the product has no deadline.
+ *
+ * @param[in] prodindex        Product index.
+ */
+void EOPTimerWheel::cancel(const uint32_t prodindex)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    std::unordered_map<uint32_t, Slot::iterator>::iterator it =
+            index.find(prodindex);
+    if (it != index.end()) {
+        slots[it->second->tick % EOP_WHEEL_SLOTS].erase(it->second);
+        index.erase(it);
+    }
+}
+
+
+/**
+ * Makes wait() return false.
+ *
+ * @param[in] none
+ */
+void EOPTimerWheel::stop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    stopped = true;
+    changed.notify_all();
+}
+
+
+/**
+ * Waits until at least one deadline has passed and returns every product
+ * whose deadline has passed, in the order of their deadlines' ticks.
+ *
+ * @param[out] expired         Product indexes, cleared first.
+ * @return                     false if stop() was called.
+ */
+bool EOPTimerWheel::wait(std::vector<uint32_t>& expired)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    expired.clear();
+    while (!stopped) {
+        expire(tickOf(EOPClock::now(), false), expired);
+        if (!expired.empty())
+            return true;
+        if (index.empty())
+            changed.wait(lock);
+        else
+            changed.wait_until(lock, timeOf(nextTick()));
+    }
+    return false;
+}
+
+
+/**
+ * Visits the slots from the cursor up to the current tick and takes out the
+ * deadlines that have passed. Each slot is visited at most once.
+ *
+ * @param[in]  now             Current tick.
+ * @param[out] expired         Product indexes.
+ */
+void EOPTimerWheel::expire(const uint64_t now, std::vector<uint32_t>& expired)
+{
+    if (now < cursor)
+        return;
+
+    const uint64_t last = now - cursor < EOP_WHEEL_SLOTS ? now :
+                          cursor + EOP_WHEEL_SLOTS - 1;
+    for (uint64_t tick = cursor; tick <= last; tick++) {
+        Slot& slot = slots[tick % EOP_WHEEL_SLOTS];
+        for (Slot::iterator it = slot.begin(); it != slot.end(); ) {
+            if (it->tick <= now) {
+                expired.push_back(it->prodindex);
+                index.erase(it->prodindex);
+                it = slot.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    cursor = now + 1;
+}
+
+
+/**
+ * Returns the tick of the next occupied slot, or the tick one revolution
+ * from the cursor if no slot is occupied. The deadlines in that slot can be
+ * later revolutions', in which case the caller wakes up early and waits
+ * again.
+ *
+ * @return                     Tick.
+ */
+uint64_t EOPTimerWheel::nextTick() const
+{
+    for (uint64_t tick = cursor; tick < cursor + EOP_WHEEL_SLOTS; tick++) {
+        if (!slots[tick % EOP_WHEEL_SLOTS].empty())
+            return tick;
+    }
+    return cursor + EOP_WHEEL_SLOTS;
+}
+
+
+/**
+ * Converts a time to a tick. Deadlines are rounded up and the current time
+ * down, so that a deadline never passes early.
+ *
+ * @param[in] time             Time.
+ * @param[in] roundUp          Whether to round up.
+ * @return                     Tick.
+ */
+uint64_t EOPTimerWheel::tickOf(const EOPClock::time_point& time,
+                               const bool roundUp) const
+{
+    const int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+            time - epoch).count();
+    if (us <= 0)
+        return 0;
+    return (us + (roundUp ? EOP_WHEEL_TICK_US - 1 : 0)) / EOP_WHEEL_TICK_US;
+}
+
+
+/**
+ * Converts a tick to the time it starts.
+ *
+ * @param[in] tick             Tick.
+ * @return                     Time.
+ */
+EOPClock::time_point EOPTimerWheel::timeOf(const uint64_t tick) const
+{
+    return epoch + std::chrono::microseconds(tick * EOP_WHEEL_TICK_US);
+}
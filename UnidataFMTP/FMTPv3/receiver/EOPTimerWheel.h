@@ -0,0 +1,91 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      EOPTimerWheel.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of EOPTimerWheel class.
+ *
+ * A hashed timing wheel of the EOP deadlines of the products being received.
+ * Every product has its own deadline, which is put in the slot of its tick
+ * and taken out again when the EOP arrives, both in constant time. The timer
+ * thread waits for the next occupied slot and gets every product whose
+ * deadline has passed in one batch.
+ */
+
+
+#ifndef FMTP_RECEIVER_EOPTIMERWHEEL_H_
+#define FMTP_RECEIVER_EOPTIMERWHEEL_H_
+
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+typedef std::chrono::steady_clock EOPClock;
+
+/* number of slots, one revolution is EOP_WHEEL_SLOTS ticks */
+const unsigned EOP_WHEEL_SLOTS = 1024;
+/* length of a tick in microseconds, the resolution of the deadlines */
+const unsigned EOP_WHEEL_TICK_US = 1000;
+
+/* a deadline in a slot */
+struct EOPDeadline {
+    uint32_t prodindex;
+    uint64_t tick;       /*!< tick at which the deadline passes */
+};
+
+
+class EOPTimerWheel
+{
+public:
+    EOPTimerWheel();
+    ~EOPTimerWheel();
+    void     add(const uint32_t prodindex, const EOPClock::duration& timeout);
+    void     advance(const uint32_t prodindex,
+                     const EOPClock::duration& timeout);
+    void     cancel(const uint32_t prodindex);
+    void     stop();
+    bool     wait(std::vector<uint32_t>& expired);
+
+private:
+    typedef std::list<EOPDeadline> Slot;
+
+    uint64_t tickOf(const EOPClock::time_point& time,
+                    const bool roundUp) const;
+    EOPClock::time_point timeOf(const uint64_t tick) const;
+    void     expire(const uint64_t now, std::vector<uint32_t>& expired);
+    uint64_t nextTick() const;
+
+    const EOPClock::time_point epoch;
+    std::vector<Slot>          slots;
+    /* where every deadline is */
+    std::unordered_map<uint32_t, Slot::iterator> index;
+    /* first tick whose slot hasn't been visited */
+    uint64_t                   cursor;
+    bool                       stopped;
+    std::mutex                 mutex;
+    std::condition_variable    changed;
+};
+
+
+#endif /* FMTP_RECEIVER_EOPTIMERWHEEL_H_ */
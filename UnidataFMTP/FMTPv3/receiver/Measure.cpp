@@ -161,14 +161,17 @@ bool Measure::setEOPmiss(const uint32_t prodindex)
  * Set the multicast end clock.
  *
  * @param[in] prodindex        Product index of the product
+ * @param[in] time             When the packet arrived, e.g., the kernel's
+ *                             receive timestamp.
  * @return                     true for setting successfully
  *                             false for unsuccessfully.
  */
-bool Measure::setMcastClock(const uint32_t prodindex)
+bool Measure::setMcastClock(const uint32_t prodindex,
+                            const HRclock::time_point& time)
 {
     std::unique_lock<std::mutex> lock(mutex);
     if (measuremap.find(prodindex) != measuremap.end()) {
-        measuremap[prodindex]->mcastend_t = HRclock::now();
+        measuremap[prodindex]->mcastend_t = time;
         measuremap[prodindex]->end_t = measuremap[prodindex]->mcastend_t >
             measuremap[prodindex]->retxend_t ? measuremap[prodindex]->mcastend_t :
             measuremap[prodindex]->retxend_t;
@@ -32,6 +32,7 @@
 
 
 #include <stdint.h>
+#include <chrono>
 #include <mutex>
 #include <unordered_map>
 
@@ -64,7 +65,8 @@ public:
     bool getEOPmiss(const uint32_t prodindex);
     bool insert(const uint32_t prodindex, const uint32_t prodsize);
     bool setEOPmiss(const uint32_t prodindex);
-    bool setMcastClock(const uint32_t prodindex);
+    bool setMcastClock(const uint32_t prodindex,
+                       const HRclock::time_point& time = HRclock::now());
     bool setRetxClock(const uint32_t prodindex);
     bool remove(const uint32_t prodindex);
 
@@ -0,0 +1,288 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      NackScheduler.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the NackScheduler class.
+ *
+ * A product whose requests are dropped can't be completed, so the scheduler
+ * never drops a single request: it gives up on the whole product and drops
+ * every request of it, which the receiver then reports as missed.
+ */
+
+
+#include "NackScheduler.h"
+
+
+/**
+ * Constructs an empty scheduler.
+ *
+ * @param[in] limit     Number of requests that can wait to be sent.
+ */
+NackScheduler::NackScheduler(const uint32_t limit)
+    : pending(0), limit(limit ? limit : 1), stopped(false)
+{
+}
+
+
+/**
+ * Destructs the scheduler.
+ *
+ * @param[in] none
+ */
+NackScheduler::~NackScheduler()
+{
+}
+
+
+/**
+ * Returns the number of requests that can wait to be sent.
+ *
+ * @param[in] none
+ */
+uint32_t NackScheduler::getLimit()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return limit;
+}
+
+
+/**
+ * Sets the number of requests that can wait to be sent. Requests that are
+ * already waiting stay even if there are more of them.
+ *
+ * @param[in] limit     Number of requests, at least 1.
+ */
+void NackScheduler::setLimit(const uint32_t limit)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    this->limit = limit ? limit : 1;
+}
+
+
+/**
+ * Records that the receiver gives up on products it has never requested,
+ * e.g., the products skipped by a resynchronization, so that the sender is
+ * told about them.
+ *
+ * @param[in] prodindex First product.
+ * @param[in] count     Number of products.
+ */
+void NackScheduler::giveUp(const uint32_t prodindex, const uint32_t count)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    NackGiveUp giveup = {prodindex, count};
+    giveups.push_back(giveup);
+    filled.notify_one();
+}
+
+
+/**
+ * Adds a request.
+ *
+ * @param[in] req       The request.
+ */
+void NackScheduler::push(const INLReqMsg& req)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    (void)add(req);
+    filled.notify_one();
+}
+
+
+/**
+ * Adds requests and wakes the requester once.
+ *
+ * @param[in] reqs      The requests.
+ */
+void NackScheduler::push(const std::vector<INLReqMsg>& reqs)
+{
+    if (reqs.empty())
+        return;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (size_t i = 0; i < reqs.size(); i++)
+        (void)add(reqs[i]);
+    filled.notify_one();
+}
+
+
+/**
+ * Makes take() return false once the waiting requests are taken.
+ *
+ * @param[in] none
+ */
+void NackScheduler::stop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    stopped = true;
+    filled.notify_all();
+}
+
+
+/**
+ * Waits until there are requests or given-up products and takes them all.
+ * The requests are in priority order.
+ *
+ * @param[out] reqs     The requests, cleared first.
+ * @param[out] giveups  The given-up products, cleared first.
+ * @return              false if stop() was called.
+ */
+bool NackScheduler::take(std::vector<INLReqMsg>& reqs,
+                         std::vector<NackGiveUp>& giveups)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopped && pending == 0 && this->giveups.empty())
+        filled.wait(lock);
+
+    reqs.clear();
+    for (ProdSet::iterator it = bops.begin(); it != bops.end(); ++it) {
+        INLReqMsg req = {MISSING_BOP, *it, 0, 0};
+        reqs.push_back(req);
+    }
+    for (ProdSet::iterator it = eops.begin(); it != eops.end(); ++it) {
+        INLReqMsg req = {MISSING_EOP, *it, 0, 0};
+        reqs.push_back(req);
+    }
+    for (DataMap::iterator it = data.begin(); it != data.end(); ++it)
+        reqs.insert(reqs.end(), it->second.begin(), it->second.end());
+    bops.clear();
+    eops.clear();
+    data.clear();
+    pending = 0;
+
+    giveups.clear();
+    giveups.swap(this->giveups);
+
+    return !stopped;
+}
+
+
+/**
+ * Adds a request unless it's already waiting. If no more requests can wait,
+ * the product with the lowest-priority requests is given up on, which can be
+ * the product of this request.
+ *
+ * @pre                 The mutex is locked.
+ * @param[in] req       The request.
+ * @return              false if the request's product was given up on.
+ */
+bool NackScheduler::add(const INLReqMsg& req)
+{
+    const int rank = rankOf(req.reqtype);
+    if ((rank == 0 && bops.count(req.prodindex)) ||
+            (rank == 1 && eops.count(req.prodindex)))
+        return true;
+
+    for (size_t i = 0; i < giveups.size(); i++) {
+        if ((uint32_t)(req.prodindex - giveups[i].prodindex) <
+                giveups[i].count)
+            return false;
+    }
+
+    if (pending >= limit) {
+        uint32_t lowProd;
+        int      lowRank;
+        if (lowest(lowProd, lowRank) && lowProd != req.prodindex &&
+                (rank < lowRank ||
+                 (rank == lowRank && ProdLess()(req.prodindex, lowProd)))) {
+            evict(lowProd);
+        }
+        else {
+            evict(req.prodindex);
+            return false;
+        }
+    }
+
+    if (rank == 0)
+        bops.insert(req.prodindex);
+    else if (rank == 1)
+        eops.insert(req.prodindex);
+    else
+        data[req.prodindex].push_back(req);
+    pending++;
+    return true;
+}
+
+
+/**
+ * Finds the product of the lowest-priority request that's waiting.
+ *
+ * @pre                    The mutex is locked.
+ * @param[out] prodindex   Index of the product.
+ * @param[out] rank        Rank of the request, see rankOf().
+ * @return                 false if no request is waiting.
+ */
+bool NackScheduler::lowest(uint32_t& prodindex, int& rank) const
+{
+    if (!data.empty()) {
+        prodindex = data.rbegin()->first;
+        rank      = 2;
+    }
+    else if (!eops.empty()) {
+        prodindex = *eops.rbegin();
+        rank      = 1;
+    }
+    else if (!bops.empty()) {
+        prodindex = *bops.rbegin();
+        rank      = 0;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Drops every request of a product and gives up on it.
+ *
+ * @pre                 The mutex is locked.
+ * @param[in] prodindex Index of the product.
+ */
+void NackScheduler::evict(const uint32_t prodindex)
+{
+    pending -= bops.erase(prodindex);
+    pending -= eops.erase(prodindex);
+
+    DataMap::iterator it = data.find(prodindex);
+    if (it != data.end()) {
+        pending -= it->second.size();
+        data.erase(it);
+    }
+
+    NackGiveUp giveup = {prodindex, 1};
+    giveups.push_back(giveup);
+}
+
+
+/**
+ * Returns the rank of a request type: 0 for BOP, 1 for EOP and 2 for data
+ * requests. Lower ranks are sent first.
+ *
+ * @param[in] reqtype   Request type.
+ * @return              Rank.
+ */
+int NackScheduler::rankOf(const int reqtype)
+{
+    if (reqtype == MISSING_BOP)
+        return 0;
+    if (reqtype == MISSING_EOP)
+        return 1;
+    return 2;
+}
@@ -0,0 +1,99 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      NackScheduler.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of NackScheduler class.
+ *
+ * Holds the retransmission requests that wait to be sent and hands them to
+ * the requester thread in priority order: BOP requests first, then EOP
+ * requests, then data requests, each oldest product first. The number of
+ * waiting requests is bounded. When the bound is reached, the product with
+ * the lowest-priority requests is given up on instead of queueing more, and
+ * the requester tells the sender about it.
+ */
+
+
+#ifndef FMTP_RECEIVER_NACKSCHEDULER_H_
+#define FMTP_RECEIVER_NACKSCHEDULER_H_
+
+
+#include <stdint.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "fmtpBase.h"
+
+
+/* default number of retransmission requests that can wait to be sent */
+const uint32_t NACK_LIMIT = 65536;
+
+/* products that the receiver has given up on */
+struct NackGiveUp {
+    uint32_t prodindex;  /*!< first product */
+    uint32_t count;      /*!< number of products */
+};
+
+
+class NackScheduler
+{
+public:
+    NackScheduler(const uint32_t limit);
+    ~NackScheduler();
+    uint32_t getLimit();
+    void     setLimit(const uint32_t limit);
+    void     giveUp(const uint32_t prodindex, const uint32_t count);
+    void     push(const INLReqMsg& req);
+    void     push(const std::vector<INLReqMsg>& reqs);
+    void     stop();
+    bool     take(std::vector<INLReqMsg>& reqs,
+                  std::vector<NackGiveUp>& giveups);
+
+private:
+    /* orders product indexes by serial-number arithmetic, so across wrap */
+    struct ProdLess {
+        bool operator()(const uint32_t a, const uint32_t b) const
+        {
+            return (int32_t)(a - b) < 0;
+        }
+    };
+    typedef std::set<uint32_t, ProdLess>                         ProdSet;
+    typedef std::map<uint32_t, std::vector<INLReqMsg>, ProdLess> DataMap;
+
+    bool     add(const INLReqMsg& req);
+    bool     lowest(uint32_t& prodindex, int& rank) const;
+    void     evict(const uint32_t prodindex);
+    static int rankOf(const int reqtype);
+
+    ProdSet                 bops;
+    ProdSet                 eops;
+    DataMap                 data;
+    std::vector<NackGiveUp> giveups;
+    /* number of requests in bops, eops and data */
+    uint32_t                pending;
+    uint32_t                limit;
+    bool                    stopped;
+    std::mutex              mutex;
+    std::condition_variable filled;
+};
+
+
+#endif /* FMTP_RECEIVER_NACKSCHEDULER_H_ */
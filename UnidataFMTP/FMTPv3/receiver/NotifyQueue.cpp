@@ -0,0 +1,275 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      NotifyQueue.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the NotifyQueue class.
+ *
+ * The ring is a bounded multi-producer queue: a queueing thread claims a
+ * position by advancing the tail and then marks the cell at that position
+ * as filled, so the taking thread stops at the first cell that is still
+ * being filled. The overflow list is only used while it isn't empty and
+ * only taken from once the ring is, which keeps the events of each thread
+ * in order. Sleeping and waiting use a flag or counter that's checked after
+ * the ring changes, with sequentially consistent operations on both sides
+ * as in PacketQueue.
+ */
+
+
+#include "NotifyQueue.h"
+
+#include <chrono>
+
+
+/**
+ * Rounds up to a power of 2.
+ */
+static uint32_t roundPow2(const uint32_t n)
+{
+    uint32_t pow2 = 1;
+    while (pow2 < n)
+        pow2 <<= 1;
+    return pow2;
+}
+
+
+/**
+ * Returns the steady clock in nanoseconds.
+ */
+static int64_t steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/**
+ * Constructs an empty queue. The ring has at least 2 cells: in a ring of one,
+ * a filled cell would look free to the next position.
+ *
+ * @param[in] depth     Number of events the ring holds.
+ * @param[in] overflow  What an event does if the ring is full.
+ */
+NotifyQueue::NotifyQueue(const uint32_t depth, const NotifyOverflow overflow)
+    : mask(roundPow2(depth < 2 ? 2 : depth) - 1), overflow(overflow),
+      cells(new Cell[mask + 1]), tail(0), head(0), spillCount(0),
+      stopped(false), sleeping(false), waiters(0), queued(0), spilled(0),
+      waits(0), dropped(0), batches(0)
+{
+    for (uint32_t i = 0; i <= mask; i++)
+        cells[i].seq.store(i, std::memory_order_relaxed);
+}
+
+
+/**
+ * Destructs the queue.
+ *
+ * @param[in] none
+ */
+NotifyQueue::~NotifyQueue()
+{
+}
+
+
+/**
+ * Queues an event. Uses the ring while the overflow list is empty. If the
+ * ring is full, a progress event is dropped and any other event either waits
+ * for room or goes to the overflow list. Wakes the taking thread if it's
+ * sleeping.
+ *
+ * @param[in] event             The event.
+ * @return                      false if the queue has been stopped.
+ */
+bool NotifyQueue::push(const RecvEvent& event)
+{
+    const int64_t now = steadyNs();
+
+    for (;;) {
+        if (stopped.load())
+            return false;
+        if (spillCount.load() == 0 && tryPush(event, now))
+            break;
+
+        if (event.type == RECV_PROD_PROGRESS) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        if (overflow == NOTIFY_GROW) {
+            std::unique_lock<std::mutex> lock(spillMtx);
+            Spilled entry = {event, now};
+            spill.push_back(entry);
+            spillCount.store(spill.size());
+            spilled.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+
+        waits.fetch_add(1, std::memory_order_relaxed);
+        std::unique_lock<std::mutex> lock(mutex);
+        waiters.fetch_add(1);
+        while (!stopped.load() && isFull())
+            room.wait(lock);
+        waiters.fetch_sub(1);
+    }
+
+    queued.fetch_add(1, std::memory_order_relaxed);
+    if (sleeping.load()) {
+        std::unique_lock<std::mutex> lock(mutex);
+        filled.notify_one();
+    }
+    return true;
+}
+
+
+/**
+ * Takes the events that are ready, sleeping while there are none.
+ *
+ * @param[out] events           The events.
+ * @param[in]  maxEvents        Maximum number of events.
+ * @return                      Number of events, 0 once the queue is
+ *                              stopped and empty.
+ */
+size_t NotifyQueue::take(RecvEvent* const events, const size_t maxEvents)
+{
+    size_t n = takeReady(events, maxEvents);
+    if (n == 0) {
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping.store(true);
+        while ((n = takeReady(events, maxEvents)) == 0 && !stopped.load())
+            filled.wait(lock);
+        sleeping.store(false);
+    }
+
+    if (n) {
+        batches.fetch_add(1, std::memory_order_relaxed);
+        if (waiters.load()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            room.notify_all();
+        }
+    }
+    return n;
+}
+
+
+/**
+ * Stops the queue and wakes every thread that sleeps or waits on it.
+ *
+ * @param[in] none
+ */
+void NotifyQueue::stop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    stopped.store(true);
+    filled.notify_all();
+    room.notify_all();
+}
+
+
+/**
+ * Returns what the queue has done so far. The latency histogram can be off
+ * by the events that are being taken at the same time.
+ *
+ * @param[out] stats            Statistics.
+ */
+void NotifyQueue::getStats(NotifyStats& stats) const
+{
+    stats.queued  = queued.load(std::memory_order_relaxed);
+    stats.spilled = spilled.load(std::memory_order_relaxed);
+    stats.waits   = waits.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.batches = batches.load(std::memory_order_relaxed);
+    latency.get(stats.latency);
+}
+
+
+/**
+ * Returns whether the cell at the tail hasn't been taken yet.
+ *
+ * @return                      true if the ring is full.
+ */
+bool NotifyQueue::isFull() const
+{
+    const uint32_t pos = tail.load();
+    return (int32_t)(cells[pos & mask].seq.load() - pos) < 0;
+}
+
+
+/**
+ * Puts an event into the ring if there's room.
+ *
+ * @param[in] event             The event.
+ * @param[in] nowNs             Steady clock time of queueing in ns.
+ * @return                      false if the ring is full.
+ */
+bool NotifyQueue::tryPush(const RecvEvent& event, const int64_t nowNs)
+{
+    uint32_t pos = tail.load(std::memory_order_relaxed);
+    Cell*    cell;
+    for (;;) {
+        cell = &cells[pos & mask];
+        const int32_t diff = (int32_t)(cell->seq.load() - pos);
+        if (diff < 0)
+            return false;
+        if (diff == 0 && tail.compare_exchange_weak(pos, pos + 1,
+                std::memory_order_relaxed))
+            break;
+        if (diff > 0)
+            pos = tail.load(std::memory_order_relaxed);
+    }
+
+    cell->event    = event;
+    cell->queuedNs = nowNs;
+    cell->seq.store(pos + 1);
+    return true;
+}
+
+
+/**
+ * Takes the filled cells of the ring up to the first one that isn't, and
+ * then the overflow list if the ring is empty. Called by the taking thread
+ * only.
+ *
+ * @param[out] events           The events.
+ * @param[in]  maxEvents        Maximum number of events.
+ * @return                      Number of events.
+ */
+size_t NotifyQueue::takeReady(RecvEvent* const events, const size_t maxEvents)
+{
+    const int64_t now = steadyNs();
+    size_t        n   = 0;
+
+    for (; n < maxEvents; n++, head++) {
+        Cell& cell = cells[head & mask];
+        if (cell.seq.load() != head + 1)
+            break;
+        events[n] = cell.event;
+        latency.add(now - cell.queuedNs);
+        cell.seq.store(head + mask + 1);
+    }
+
+    /* an event that's still being put into the ring may precede the list's */
+    if (n < maxEvents && spillCount.load() && tail.load() == head) {
+        std::unique_lock<std::mutex> lock(spillMtx);
+        for (; n < maxEvents && !spill.empty(); n++) {
+            events[n] = spill.front().event;
+            latency.add(now - spill.front().queuedNs);
+            spill.pop_front();
+        }
+        spillCount.store(spill.size());
+    }
+    return n;
+}
@@ -0,0 +1,154 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      NotifyQueue.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of NotifyQueue class.
+ *
+ * A bounded queue of the events that the receiving application is told
+ * about, so the threads that receive products don't have to wait for the
+ * application. Any thread can queue an event without a lock while there's
+ * room; a single notification thread takes the events in batches. What a
+ * full queue does is configurable: the queueing thread either waits for
+ * room or puts the event on an unbounded overflow list. Progress events
+ * are dropped instead, they are only ever a hint.
+ */
+
+
+#ifndef FMTP_RECEIVER_NOTIFYQUEUE_H_
+#define FMTP_RECEIVER_NOTIFYQUEUE_H_
+
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "ArrivalStats.h"
+#include "RecvProxy.h"
+
+
+/* what an event that doesn't fit in a full queue does */
+enum NotifyOverflow {
+    NOTIFY_WAIT,    /*!< the queueing thread waits for room */
+    NOTIFY_GROW     /*!< the event goes to an unbounded overflow list */
+};
+
+/* what a notification queue has done so far */
+struct NotifyStats {
+    uint64_t  queued;     /*!< events queued */
+    uint64_t  spilled;    /*!< events put on the overflow list */
+    uint64_t  waits;      /*!< times a thread waited for room */
+    uint64_t  dropped;    /*!< progress events dropped for lack of room */
+    uint64_t  batches;    /*!< batches taken */
+    Histogram latency;    /*!< from queueing an event to taking it */
+};
+
+
+class NotifyQueue
+{
+public:
+    /**
+     * Constructs.
+     *
+     * @param[in] depth     Number of events the ring holds, rounded up to a
+     *                      power of 2 of at least 2.
+     * @param[in] overflow  What an event does if the ring is full.
+     */
+    NotifyQueue(const uint32_t depth, const NotifyOverflow overflow);
+    ~NotifyQueue();
+
+    /**
+     * Queues an event. Called by any thread.
+     *
+     * @param[in] event  The event.
+     * @return           false if the queue has been stopped.
+     */
+    bool   push(const RecvEvent& event);
+    /**
+     * Returns the oldest queued events. Blocks until at least one is
+     * available or the queue is stopped. Called by a single thread.
+     *
+     * @param[out] events     The events.
+     * @param[in]  maxEvents  Maximum number of events.
+     * @return                Number of events, 0 once the queue is stopped
+     *                        and empty.
+     */
+    size_t take(RecvEvent* const events, const size_t maxEvents);
+    /**
+     * Stops the queue. Events can no longer be queued, waiting threads
+     * return and the ones queued before can still be taken.
+     */
+    void   stop();
+    /**
+     * Returns what the queue has done so far.
+     *
+     * @param[out] stats  Statistics.
+     */
+    void   getStats(NotifyStats& stats) const;
+
+private:
+    NotifyQueue(const NotifyQueue&);
+    NotifyQueue& operator=(const NotifyQueue&);
+
+    struct Cell {
+        /* position the cell can be filled at, plus 1 once it's filled */
+        std::atomic<uint32_t> seq;
+        RecvEvent             event;
+        int64_t               queuedNs;
+    };
+    struct Spilled {
+        RecvEvent             event;
+        int64_t               queuedNs;
+    };
+
+    bool   isFull() const;
+    bool   tryPush(const RecvEvent& event, const int64_t nowNs);
+    size_t takeReady(RecvEvent* const events, const size_t maxEvents);
+
+    const uint32_t           mask;
+    const NotifyOverflow     overflow;
+    std::unique_ptr<Cell[]>  cells;
+    /* next position to fill, claimed by the queueing threads */
+    std::atomic<uint32_t>    tail;
+    /* next position to take, only used by the taking thread */
+    uint32_t                 head;
+    /* events that didn't fit in the ring, taken after the ring's */
+    std::mutex               spillMtx;
+    std::deque<Spilled>      spill;
+    std::atomic<size_t>      spillCount;
+    std::atomic<bool>        stopped;
+    /* set while the taking thread sleeps on `filled` */
+    std::atomic<bool>        sleeping;
+    /* number of threads waiting on `room` */
+    std::atomic<uint32_t>    waiters;
+    std::mutex               mutex;
+    std::condition_variable  filled;
+    std::condition_variable  room;
+    std::atomic<uint64_t>    queued;
+    std::atomic<uint64_t>    spilled;
+    std::atomic<uint64_t>    waits;
+    std::atomic<uint64_t>    dropped;
+    std::atomic<uint64_t>    batches;
+    LogHist                  latency;
+};
+
+
+#endif /* FMTP_RECEIVER_NOTIFYQUEUE_H_ */
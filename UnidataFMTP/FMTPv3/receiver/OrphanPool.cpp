@@ -0,0 +1,217 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      OrphanPool.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the OrphanPool class.
+ *
+ * The payloads live in one allocation of `capacity` blocks, which isn't
+ * touched until blocks are stored, so an idle pool costs no memory.
+ */
+
+
+#include "OrphanPool.h"
+
+#include <string.h>
+
+
+/**
+ * Constructs an empty pool.
+ *
+ * @param[in] capacity          Number of blocks.
+ * @param[in] blockSize         Largest payload of a block.
+ */
+OrphanPool::OrphanPool(const uint32_t capacity, const uint16_t blockSize)
+    : blockSize(blockSize), bufs(new char[(size_t)capacity * blockSize]),
+      stored(0), adopted(0), dropped(0)
+{
+    freeSlots.reserve(capacity);
+    for (uint32_t i = capacity; i-- > 0; )
+        freeSlots.push_back(i);
+}
+
+
+/**
+ * Destructs.
+ *
+ * @param[in] none
+ */
+OrphanPool::~OrphanPool()
+{
+}
+
+
+/**
+ * Keeps a copy of a block of a product without a BOP. A block that's
+ * already there isn't stored again. If the pool is full, the blocks of the
+ * product orphaned first are dropped to make room, unless that's the
+ * product of the block.
+ *
+ * @param[in] prodindex         Product index.
+ * @param[in] seqnum            Sequence number of the block.
+ * @param[in] data              Payload.
+ * @param[in] length            Length of the payload.
+ * @return                      false if the block wasn't kept.
+ */
+bool OrphanPool::add(const uint32_t prodindex, const uint32_t seqnum,
+                     const char* const data, const uint16_t length)
+{
+    if (length > blockSize)
+        return false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!order.empty() && prods.find(order.front()) == prods.end())
+        order.pop_front();
+
+    Blocks& blocks = prods[prodindex];
+    if (blocks.empty())
+        order.push_back(prodindex);
+    else if (blocks.count(seqnum))
+        return false;
+
+    while (freeSlots.empty()) {
+        if (!evictOldest(prodindex)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    OrphanBlock block = {seqnum, length, freeSlots.back()};
+    freeSlots.pop_back();
+    (void)memcpy(bufs.get() + (size_t)block.slot * blockSize, data, length);
+    blocks[seqnum] = block;
+    stored.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+
+/**
+ * Takes the blocks of a product out of the pool, in order of sequence
+ * number. Their payloads stay valid until they're released.
+ *
+ * @param[in]  prodindex        Product index.
+ * @param[out] blocks           The blocks, empty if there are none.
+ */
+void OrphanPool::take(const uint32_t prodindex,
+                      std::vector<OrphanBlock>& blocks)
+{
+    blocks.clear();
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = prods.find(prodindex);
+    if (it == prods.end())
+        return;
+
+    blocks.reserve(it->second.size());
+    for (auto b = it->second.begin(); b != it->second.end(); ++b)
+        blocks.push_back(b->second);
+    prods.erase(it);
+    adopted.fetch_add(blocks.size(), std::memory_order_relaxed);
+}
+
+
+/**
+ * Returns the payload of a block that was taken.
+ *
+ * @param[in] block             The block.
+ * @return                      The payload.
+ */
+const char* OrphanPool::data(const OrphanBlock& block) const
+{
+    return bufs.get() + (size_t)block.slot * blockSize;
+}
+
+
+/**
+ * Gives the space of blocks that were taken back to the pool.
+ *
+ * @param[in] blocks            The blocks.
+ */
+void OrphanPool::release(const std::vector<OrphanBlock>& blocks)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (size_t i = 0; i < blocks.size(); i++)
+        freeSlots.push_back(blocks[i].slot);
+}
+
+
+/**
+ * Drops the blocks of a product that won't be received.
+ *
+ * @param[in] prodindex         Product index.
+ */
+void OrphanPool::discard(const uint32_t prodindex)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = prods.find(prodindex);
+    if (it != prods.end()) {
+        drop(it->second);
+        prods.erase(it);
+    }
+}
+
+
+/**
+ * Returns what the pool has done so far.
+ *
+ * @param[out] stats            Statistics.
+ */
+void OrphanPool::getStats(OrphanStats& stats)
+{
+    stats.stored  = stored.load(std::memory_order_relaxed);
+    stats.adopted = adopted.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * Drops the blocks of the product orphaned first. The mutex must be held.
+ *
+ * @param[in] prodindex         Product that needs the room, which isn't
+ *                              dropped.
+ * @return                      false if there's nothing else to drop.
+ */
+bool OrphanPool::evictOldest(const uint32_t prodindex)
+{
+    while (!order.empty()) {
+        const uint32_t oldest = order.front();
+        auto it = prods.find(oldest);
+        if (oldest == prodindex)
+            return false;
+        order.pop_front();
+        if (it != prods.end()) {
+            drop(it->second);
+            prods.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Returns the space of blocks to the pool and counts them as dropped. The
+ * mutex must be held.
+ *
+ * @param[in,out] blocks        The blocks, cleared.
+ */
+void OrphanPool::drop(Blocks& blocks)
+{
+    for (auto b = blocks.begin(); b != blocks.end(); ++b)
+        freeSlots.push_back(b->second.slot);
+    dropped.fetch_add(blocks.size(), std::memory_order_relaxed);
+    blocks.clear();
+}
@@ -0,0 +1,135 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      OrphanPool.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of OrphanPool class.
+ *
+ * Multicast blocks of products whose BOP was lost. Without a BOP there's no
+ * buffer to put a block in, so the blocks are kept here, keyed by product
+ * index and sequence number, until the retransmitted BOP arrives and they
+ * can be copied into the product. The pool has a fixed number of blocks;
+ * when it's full, the blocks of the product that was orphaned first make
+ * room. Any thread can use it.
+ */
+
+
+#ifndef FMTP_RECEIVER_ORPHANPOOL_H_
+#define FMTP_RECEIVER_ORPHANPOOL_H_
+
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+/* default number of blocks in the pool, about 6 MB of payload */
+const uint32_t ORPHAN_POOL_BLOCKS = 4096;
+
+/* a block in the pool */
+struct OrphanBlock {
+    uint32_t seqnum;
+    uint16_t length;
+    uint32_t slot;           /*!< where the payload is */
+};
+
+/* what the pool has done so far */
+struct OrphanStats {
+    uint64_t stored;         /*!< blocks put in the pool */
+    uint64_t adopted;        /*!< blocks taken out for their product */
+    uint64_t dropped;        /*!< blocks evicted, discarded or not stored */
+};
+
+
+class OrphanPool
+{
+public:
+    /**
+     * Constructs an empty pool.
+     *
+     * @param[in] capacity   Number of blocks.
+     * @param[in] blockSize  Largest payload of a block.
+     */
+    OrphanPool(const uint32_t capacity, const uint16_t blockSize);
+    ~OrphanPool();
+    /**
+     * Keeps a copy of a block of a product without a BOP.
+     *
+     * @param[in] prodindex  Product index.
+     * @param[in] seqnum     Sequence number of the block.
+     * @param[in] data       Payload.
+     * @param[in] length     Length of the payload.
+     * @return               false if the block wasn't kept.
+     */
+    bool add(const uint32_t prodindex, const uint32_t seqnum,
+             const char* const data, const uint16_t length);
+    /**
+     * Takes the blocks of a product out of the pool, in order of sequence
+     * number. Their payloads stay valid until they're released.
+     *
+     * @param[in]  prodindex  Product index.
+     * @param[out] blocks     The blocks, empty if there are none.
+     */
+    void take(const uint32_t prodindex, std::vector<OrphanBlock>& blocks);
+    /**
+     * Returns the payload of a block that was taken.
+     *
+     * @param[in] block  The block.
+     */
+    const char* data(const OrphanBlock& block) const;
+    /**
+     * Gives the space of blocks that were taken back to the pool.
+     *
+     * @param[in] blocks  The blocks.
+     */
+    void release(const std::vector<OrphanBlock>& blocks);
+    /**
+     * Drops the blocks of a product that won't be received.
+     *
+     * @param[in] prodindex  Product index.
+     */
+    void discard(const uint32_t prodindex);
+    void getStats(OrphanStats& stats);
+
+private:
+    typedef std::map<uint32_t, OrphanBlock> Blocks;
+
+    OrphanPool(const OrphanPool&);
+    OrphanPool& operator=(const OrphanPool&);
+    bool evictOldest(const uint32_t prodindex);
+    void drop(Blocks& blocks);
+
+    const uint16_t                      blockSize;
+    std::unique_ptr<char[]>             bufs;
+    std::vector<uint32_t>               freeSlots;
+    std::unordered_map<uint32_t, Blocks> prods;
+    /* products in the order of their first block, may hold stale ones */
+    std::deque<uint32_t>                order;
+    std::mutex                          mutex;
+    std::atomic<uint64_t>               stored;
+    std::atomic<uint64_t>               adopted;
+    std::atomic<uint64_t>               dropped;
+};
+
+
+#endif /* FMTP_RECEIVER_ORPHANPOOL_H_ */
@@ -0,0 +1,154 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      PacketQueue.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the PacketQueue class.
+ *
+ * The consumer announces that it's going to sleep by setting a flag and then
+ * checks the ring once more under the mutex; the producer checks the flag
+ * after publishing and only then takes the mutex to wake it. Both use
+ * sequentially consistent operations, so one of them always sees the other.
+ */
+
+
+#include "PacketQueue.h"
+
+
+/**
+ * Rounds up to a power of 2.
+ */
+static uint32_t roundPow2(const uint32_t n)
+{
+    uint32_t pow2 = 1;
+    while (pow2 < n)
+        pow2 <<= 1;
+    return pow2;
+}
+
+
+/**
+ * Constructs the ring and allocates its packet buffers.
+ *
+ * @param[in] depth     Number of packets the ring holds.
+ * @param[in] slotLen   Size of a packet buffer in bytes.
+ */
+PacketQueue::PacketQueue(const uint32_t depth, const size_t slotLen)
+    : mask(roundPow2(depth ? depth : 1) - 1), slotLen(slotLen),
+      bufs((size_t)(mask + 1) * slotLen), lens(mask + 1),
+      stamps(mask + 1), head(0), tail(0),
+      taken(0), overruns(0), sleeping(false)
+{
+}
+
+
+/**
+ * Destructs the ring.
+ *
+ * @param[in] none
+ */
+PacketQueue::~PacketQueue()
+{
+}
+
+
+/**
+ * Publishes stored packets and wakes the consumer if it's sleeping.
+ *
+ * @param[in] lens      Length of each packet.
+ * @param[in] npkts     Number of packets.
+ * @param[in] stamps    Arrival time of each packet, or NULL.
+ */
+void PacketQueue::publish(const size_t* const lens, const int npkts,
+                          const RecvStamp* const stamps)
+{
+    if (npkts <= 0)
+        return;
+
+    const uint32_t t = tail.load(std::memory_order_relaxed);
+    for (int i = 0; i < npkts; i++)
+        this->lens[(t + i) & mask] = lens[i];
+    if (stamps) {
+        for (int i = 0; i < npkts; i++)
+            this->stamps[(t + i) & mask] = stamps[i];
+    }
+    tail.store(t + npkts);
+
+    if (sleeping.load()) {
+        std::unique_lock<std::mutex> lock(mutex);
+        filled.notify_one();
+    }
+}
+
+
+/**
+ * Returns the free buffers that follow the last published packet.
+ *
+ * @param[out] slots    Start and size of each buffer.
+ * @param[in]  maxslots Maximum number of buffers.
+ * @return              Number of buffers.
+ */
+int PacketQueue::reserve(struct iovec* slots, const int maxslots)
+{
+    const uint32_t t    = tail.load(std::memory_order_relaxed);
+    const uint32_t free = mask + 1 - (t - head.load(std::memory_order_acquire));
+    const int      n    = free < (uint32_t)maxslots ? free : maxslots;
+
+    for (int i = 0; i < n; i++) {
+        slots[i].iov_base = &bufs[(size_t)((t + i) & mask) * slotLen];
+        slots[i].iov_len  = slotLen;
+    }
+    return n;
+}
+
+
+/**
+ * Releases the packets of the previous call and returns the next ones,
+ * sleeping while there are none.
+ *
+ * @param[out] pkts     Start and length of each packet.
+ * @param[in]  maxpkts  Maximum number of packets.
+ * @param[out] stamps   Arrival time of each packet, or NULL.
+ * @return              Number of packets.
+ */
+int PacketQueue::take(struct iovec* pkts, const int maxpkts,
+                      RecvStamp* const stamps)
+{
+    const uint32_t h = head.load(std::memory_order_relaxed) + taken;
+    head.store(h, std::memory_order_release);
+    taken = 0;
+
+    uint32_t avail = tail.load(std::memory_order_acquire) - h;
+    if (avail == 0) {
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping.store(true);
+        while ((avail = tail.load() - h) == 0)
+            filled.wait(lock);
+        sleeping.store(false);
+    }
+
+    taken = avail < (uint32_t)maxpkts ? avail : maxpkts;
+    for (uint32_t i = 0; i < taken; i++) {
+        const uint32_t slot = (h + i) & mask;
+        pkts[i].iov_base = &bufs[(size_t)slot * slotLen];
+        pkts[i].iov_len  = lens[slot];
+        if (stamps)
+            stamps[i] = this->stamps[slot];
+    }
+    return taken;
+}
@@ -0,0 +1,127 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      PacketQueue.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of PacketQueue class.
+ *
+ * A single-producer single-consumer ring of packet buffers between the
+ * thread that receives the multicast and the thread that handles it. Neither
+ * side takes a lock unless the consumer has to sleep because the ring is
+ * empty. The producer never waits: when the ring is full, the packets it
+ * can't store are counted as overruns.
+ */
+
+
+#ifndef FMTP_RECEIVER_PACKETQUEUE_H_
+#define FMTP_RECEIVER_PACKETQUEUE_H_
+
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+
+/* when a packet arrived, in nanoseconds since the Epoch, 0 if unknown */
+struct RecvStamp {
+    int64_t kernel;      /*!< the kernel's receive time, CLOCK_REALTIME */
+    int64_t hardware;    /*!< the network card's receive time */
+};
+
+
+class PacketQueue
+{
+public:
+    /**
+     * Constructs.
+     *
+     * @param[in] depth    Number of packets the ring holds, rounded up to a
+     *                     power of 2.
+     * @param[in] slotLen  Size of a packet buffer in bytes.
+     */
+    PacketQueue(const uint32_t depth, const size_t slotLen);
+    ~PacketQueue();
+
+    /**
+     * Returns the number of packets that the producer couldn't store.
+     */
+    uint64_t getOverruns() const { return overruns; }
+    /**
+     * Counts packets that the producer had to drop.
+     *
+     * @param[in] npkts  Number of dropped packets.
+     */
+    void     overrun(const uint32_t npkts) { overruns += npkts; }
+    /**
+     * Makes stored packets visible to the consumer. Called by the producer.
+     *
+     * @param[in] lens    Length of each packet, in reserve() order.
+     * @param[in] npkts   Number of packets.
+     * @param[in] stamps  Arrival time of each packet, or NULL.
+     */
+    void     publish(const size_t* const lens, const int npkts,
+                     const RecvStamp* const stamps = NULL);
+    /**
+     * Returns free packet buffers. Called by the producer, which fills some
+     * of them and publishes those.
+     *
+     * @param[out] slots     Start and size of each buffer.
+     * @param[in]  maxslots  Maximum number of buffers.
+     * @return               Number of buffers, 0 if the ring is full.
+     */
+    int      reserve(struct iovec* slots, const int maxslots);
+    /**
+     * Returns stored packets. Blocks until at least one is available. The
+     * packets of the previous call are released first, so they stay valid
+     * until the next call. Called by the consumer.
+     *
+     * @param[out] pkts     Start and length of each packet.
+     * @param[in]  maxpkts  Maximum number of packets.
+     * @param[out] stamps   Arrival time of each packet, or NULL.
+     * @return              Number of packets.
+     */
+    int      take(struct iovec* pkts, const int maxpkts,
+                  RecvStamp* const stamps = NULL);
+
+private:
+    PacketQueue(const PacketQueue&);
+    PacketQueue& operator=(const PacketQueue&);
+
+    const uint32_t          mask;
+    const size_t            slotLen;
+    std::vector<char>       bufs;
+    std::vector<size_t>     lens;
+    std::vector<RecvStamp>  stamps;
+    /* next slot to take, written by the consumer */
+    std::atomic<uint32_t>   head;
+    /* next slot to publish, written by the producer */
+    std::atomic<uint32_t>   tail;
+    /* packets returned by the last take() */
+    uint32_t                taken;
+    std::atomic<uint64_t>   overruns;
+    /* set while the consumer sleeps on the condition variable */
+    std::atomic<bool>       sleeping;
+    std::mutex              mutex;
+    std::condition_variable filled;
+};
+
+
+#endif /* FMTP_RECEIVER_PACKETQUEUE_H_ */
@@ -0,0 +1,324 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      PacketRingRecv.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the memory-mapped multicast receiver.
+ *
+ * Encapsulation of an AF_PACKET socket with a TPACKET_V3 receive ring.
+ */
+
+
+#include "PacketRingRecv.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <ifaddrs.h>
+#include <linux/filter.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <system_error>
+
+
+/**
+ * Constructor, sets the local interface to receive on.
+ *
+ * @param[in] ifAddr    IPv4 address of the local interface.
+ */
+PacketRingRecv::PacketRingRecv(const std::string& ifAddr)
+    : sockfd(-1), ifAddr(ifAddr), ring(NULL), ringSize(0), blockIndex(0),
+      block(NULL), pkt(NULL), pktsLeft(0)
+{
+}
+
+
+/**
+ * Destructs the PacketRingRecv instance, unmaps the ring and closes the
+ * socket.
+ *
+ * @param[in] none
+ */
+PacketRingRecv::~PacketRingRecv()
+{
+    if (ring)
+        (void)munmap(ring, ringSize);
+    if (sockfd >= 0)
+        (void)close(sockfd);
+}
+
+
+/**
+ * Initializer. Creates the socket, attaches the filter, maps the ring and
+ * binds the socket to the interface. The socket is created for no protocol
+ * so that nothing is received before the filter is in place.
+ *
+ * @param[in] srcAddr          IPv4 address of the multicast source.
+ * @param[in] mcastAddr        IPv4 address of the multicast group.
+ * @param[in] mcastPort        Port number of the multicast group.
+ * @throws std::system_error   if the socket cannot be created.
+ * @throws std::system_error   if the ring cannot be set up.
+ * @throws std::system_error   if the interface isn't found.
+ * @throws std::system_error   if the socket cannot be bound.
+ */
+void PacketRingRecv::Init(const std::string& srcAddr,
+                          const std::string& mcastAddr,
+                          const unsigned short mcastPort)
+{
+    if ((sockfd = socket(AF_PACKET, SOCK_DGRAM, 0)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "PacketRingRecv::Init() Couldn't create packet socket");
+    }
+
+    attachFilter(inet_addr(srcAddr.c_str()), inet_addr(mcastAddr.c_str()),
+                 mcastPort);
+
+    int version = TPACKET_V3;
+    if (setsockopt(sockfd, SOL_PACKET, PACKET_VERSION, &version,
+                   sizeof(version)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "PacketRingRecv::Init() TPACKET_V3 isn't supported");
+    }
+
+    struct tpacket_req3 req;
+    (void)memset(&req, 0, sizeof(req));
+    req.tp_block_size     = PKT_RING_BLOCK_SIZE;
+    req.tp_block_nr       = PKT_RING_BLOCK_NR;
+    req.tp_frame_size     = TPACKET_ALIGNMENT << 7;
+    req.tp_frame_nr       = PKT_RING_BLOCK_SIZE / req.tp_frame_size *
+                            PKT_RING_BLOCK_NR;
+    req.tp_retire_blk_tov = PKT_RING_BLOCK_TOV;
+    if (setsockopt(sockfd, SOL_PACKET, PACKET_RX_RING, &req,
+                   sizeof(req)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "PacketRingRecv::Init() Couldn't set up the receive ring");
+    }
+
+    ringSize = (size_t)PKT_RING_BLOCK_SIZE * PKT_RING_BLOCK_NR;
+    void* const addr = mmap(NULL, ringSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, sockfd, 0);
+    if (addr == MAP_FAILED) {
+        throw std::system_error(errno, std::system_category(),
+                "PacketRingRecv::Init() Couldn't map the receive ring");
+    }
+    ring = (char*)addr;
+
+    struct sockaddr_ll sll;
+    (void)memset(&sll, 0, sizeof(sll));
+    sll.sll_family   = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_IP);
+    sll.sll_ifindex  = getIfIndex();
+    if (::bind(sockfd, (struct sockaddr*)&sll, sizeof(sll)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "PacketRingRecv::Init() Couldn't bind to " + ifAddr);
+    }
+}
+
+
+/**
+ * Attaches a classic BPF filter that accepts unfragmented UDP datagrams from
+ * the source to the group and port. Packets that this host sends itself are
+ * seen by a packet socket too and are dropped.
+ *
+ * @param[in] srcAddr          IPv4 address of the source in network order.
+ * @param[in] group            IPv4 address of the group in network order.
+ * @param[in] port             Port number in host order.
+ * @throws std::system_error   if the filter cannot be attached.
+ */
+void PacketRingRecv::attachFilter(const uint32_t srcAddr, const uint32_t group,
+                                  const unsigned short port)
+{
+    /* offsets are from the IP header, since the socket is SOCK_DGRAM */
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS,
+                 (uint32_t)(SKF_AD_OFF + SKF_AD_PKTTYPE)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   PACKET_OUTGOING, 12, 0),
+        BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 9),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   IPPROTO_UDP, 0, 10),
+        BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, 12),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   ntohl(srcAddr), 0, 8),
+        BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, 16),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   ntohl(group), 0, 6),
+        /* more-fragments flag or fragment offset */
+        BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 6),
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K,  0x3FFF, 4, 0),
+        BPF_STMT(BPF_LDX | BPF_B   | BPF_MSH, 0),
+        BPF_STMT(BPF_LD  | BPF_H   | BPF_IND, 2),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   port, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K,             0xFFFF),
+        BPF_STMT(BPF_RET | BPF_K,             0),
+    };
+    struct sock_fprog prog;
+    prog.len    = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &prog,
+                   sizeof(prog)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "PacketRingRecv::attachFilter() Couldn't attach filter");
+    }
+}
+
+
+/**
+ * Returns the index of the interface that has the local address.
+ *
+ * @return                     Index of the interface, 0 for all interfaces.
+ * @throws std::system_error   if the interfaces cannot be listed.
+ * @throws std::system_error   if no interface has the address.
+ */
+int PacketRingRecv::getIfIndex()
+{
+    const in_addr_t addr = inet_addr(ifAddr.c_str());
+    if (addr == htonl(INADDR_ANY))
+        return 0;
+
+    struct ifaddrs* ifas;
+    if (getifaddrs(&ifas) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "PacketRingRecv::getIfIndex() Couldn't list interfaces");
+    }
+    int index = 0;
+    for (struct ifaddrs* ifa = ifas; ifa && !index; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_INET &&
+                ((struct sockaddr_in*)ifa->ifa_addr)->sin_addr.s_addr == addr)
+            index = if_nametoindex(ifa->ifa_name);
+    }
+    freeifaddrs(ifas);
+    if (index == 0) {
+        throw std::system_error(ENODEV, std::system_category(),
+                "PacketRingRecv::getIfIndex() No interface has " + ifAddr);
+    }
+    return index;
+}
+
+
+/**
+ * Receives UDP payloads from the ring. Blocks until at least one is
+ * available. The block that the previous call returned payloads from is
+ * handed back to the kernel once all of them have been returned.
+ *
+ * @param[out] pkts            Start and length of each payload. The length
+ *                             is the one in the UDP header, which exceeds
+ *                             the captured data if the datagram didn't fit.
+ * @param[in]  maxpkts         Maximum number of payloads.
+ * @return                     Number of payloads.
+ * @throws std::system_error   if poll() fails.
+ */
+int PacketRingRecv::recv(struct iovec* pkts, const int maxpkts)
+{
+    int npkts = 0;
+    while (npkts == 0) {
+        if (block && pktsLeft == 0)
+            releaseBlock();
+        if (block == NULL)
+            waitBlock();
+
+        for (; pktsLeft > 0 && npkts < maxpkts; pktsLeft--) {
+            size_t len;
+            char*  payload = udpPayload(pkt, len);
+            if (payload) {
+                pkts[npkts].iov_base = payload;
+                pkts[npkts].iov_len  = len;
+                npkts++;
+            }
+            pkt = (struct tpacket3_hdr*)((char*)pkt + pkt->tp_next_offset);
+        }
+    }
+    return npkts;
+}
+
+
+/**
+ * Hands the current block back to the kernel.
+ *
+ * @param[in] none
+ */
+void PacketRingRecv::releaseBlock()
+{
+    __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL,
+                     __ATOMIC_RELEASE);
+    blockIndex = (blockIndex + 1) % PKT_RING_BLOCK_NR;
+    block      = NULL;
+}
+
+
+/**
+ * Locates the UDP payload of a packet in the ring.
+ *
+ * @param[in]  hdr             Header of the packet.
+ * @param[out] len             Length of the payload.
+ * @return                     Start of the payload, or NULL if the packet
+ *                             is malformed.
+ */
+char* PacketRingRecv::udpPayload(const struct tpacket3_hdr* const hdr,
+                                 size_t& len)
+{
+    const unsigned char* ip = (const unsigned char*)hdr + hdr->tp_net;
+    const uint32_t snaplen  = hdr->tp_snaplen - (hdr->tp_net - hdr->tp_mac);
+    if (snaplen < 20)
+        return NULL;
+
+    const uint32_t iphlen = (ip[0] & 0x0F) * 4;
+    if (iphlen < 20 || snaplen < iphlen + 8)
+        return NULL;
+
+    const uint16_t udplen = ntohs(*(const uint16_t*)(ip + iphlen + 4));
+    if (udplen < 8 || (iphlen + udplen > snaplen &&
+                       hdr->tp_snaplen == hdr->tp_len))
+        return NULL;
+
+    len = udplen - 8;
+    return (char*)ip + iphlen + 8;
+}
+
+
+/**
+ * Waits for the kernel to hand over the next block and starts walking it.
+ *
+ * @param[in] none
+ * @throws std::system_error   if poll() fails.
+ */
+void PacketRingRecv::waitBlock()
+{
+    struct tpacket_block_desc* const next = (struct tpacket_block_desc*)
+            (ring + (size_t)blockIndex * PKT_RING_BLOCK_SIZE);
+
+    while (!(__atomic_load_n(&next->hdr.bh1.block_status, __ATOMIC_ACQUIRE) &
+             TP_STATUS_USER)) {
+        struct pollfd pfd;
+        pfd.fd      = sockfd;
+        pfd.events  = POLLIN | POLLERR;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            throw std::system_error(errno, std::system_category(),
+                    "PacketRingRecv::waitBlock() error occurred when calling "
+                    "poll()");
+        }
+    }
+
+    block    = next;
+    pkt      = (struct tpacket3_hdr*)((char*)block +
+                                      block->hdr.bh1.offset_to_first_pkt);
+    pktsLeft = block->hdr.bh1.num_pkts;
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      PacketRingRecv.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of the memory-mapped multicast receiver.
+ *
+ * The PacketRingRecv class receives the multicast group through an AF_PACKET
+ * socket with a TPACKET_V3 receive ring. The kernel fills whole blocks of the
+ * ring with the datagrams that pass a BPF filter for the source, group and
+ * port, and the receiving thread walks the datagrams in place. A system call
+ * is only made to wait for a block. Needs CAP_NET_RAW.
+ */
+
+
+#ifndef FMTP_RECEIVER_PACKETRINGRECV_H_
+#define FMTP_RECEIVER_PACKETRINGRECV_H_
+
+
+#include <linux/if_packet.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <string>
+
+
+/* size of a block of the ring, a multiple of the page size */
+const unsigned PKT_RING_BLOCK_SIZE = 262144;
+/* number of blocks in the ring */
+const unsigned PKT_RING_BLOCK_NR = 64;
+/* milliseconds before the kernel hands over a block that isn't full */
+const unsigned PKT_RING_BLOCK_TOV = 1;
+
+
+class PacketRingRecv {
+public:
+    /**
+     * Constructs.
+     *
+     * @param[in] ifAddr  IPv4 address of the local interface to receive on,
+     *                    or "0.0.0.0" for all interfaces.
+     */
+    PacketRingRecv(const std::string& ifAddr);
+    ~PacketRingRecv();
+
+    /**
+     * Creates the socket and maps the ring. Only datagrams from the source to
+     * the group and port are received.
+     *
+     * @param[in] srcAddr    IPv4 address of the multicast source.
+     * @param[in] mcastAddr  IPv4 address of the multicast group.
+     * @param[in] mcastPort  Port number of the multicast group.
+     */
+    void Init(const std::string& srcAddr, const std::string& mcastAddr,
+              const unsigned short mcastPort);
+    /**
+     * Receives UDP payloads. Blocks until at least one is available. The
+     * payloads are in the ring and stay valid until the next call.
+     *
+     * @param[out] pkts     Start and length of each payload.
+     * @param[in]  maxpkts  Maximum number of payloads.
+     * @return              Number of payloads.
+     */
+    int recv(struct iovec* pkts, const int maxpkts);
+
+private:
+    void          attachFilter(const uint32_t srcAddr, const uint32_t group,
+                               const unsigned short port);
+    int           getIfIndex();
+    void          releaseBlock();
+    char*         udpPayload(const struct tpacket3_hdr* const hdr,
+                             size_t& len);
+    void          waitBlock();
+
+    int                        sockfd;
+    const std::string          ifAddr;
+    char*                      ring;
+    size_t                     ringSize;
+    unsigned                   blockIndex; /*!< next block to walk */
+    struct tpacket_block_desc* block;      /*!< block being walked or NULL */
+    struct tpacket3_hdr*       pkt;        /*!< next packet in the block */
+    uint32_t                   pktsLeft;   /*!< packets left in the block */
+};
+
+
+#endif /* FMTP_RECEIVER_PACKETRINGRECV_H_ */
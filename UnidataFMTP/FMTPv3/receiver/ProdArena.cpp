@@ -0,0 +1,250 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      ProdArena.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the ProdArena class.
+ *
+ * A class is mapped with MAP_HUGETLB if enough huge pages are reserved and
+ * otherwise aligned to a huge page and advised to use transparent huge
+ * pages. Every page is then written, which is what makes the kernel
+ * allocate it; merely reading it would map the shared zero page.
+ */
+
+
+#include "ProdArena.h"
+#ifdef LDM_LOGGING
+#include "log.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <system_error>
+
+
+/**
+ * Returns the number of page faults that the calling thread has taken.
+ *
+ * @return    Minor and major faults.
+ */
+static uint64_t threadFaults()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage))
+        return 0;
+    return usage.ru_minflt + usage.ru_majflt;
+}
+
+
+/**
+ * Maps and pre-faults the buffers of all slab classes. The classes are
+ * ARENA_MIN_CLASS, twice that and so on up to the first one that holds
+ * `maxProdSize` bytes.
+ *
+ * @param[in] maxProdSize       Size of the biggest product to be taken.
+ * @param[in] bytesPerClass     Memory of each class.
+ * @param[in] lock              Whether to lock the buffers in memory.
+ * @throws std::system_error    if a class can't be mapped.
+ */
+ProdArena::ProdArena(const size_t maxProdSize, const size_t bytesPerClass,
+                     const bool lock)
+    : bytes(0), prefaults(0), hugetlb(true), locked(lock), allocs(0),
+      misses(0), allocNs(0), maxAllocNs(0)
+{
+    const long     pagesize = sysconf(_SC_PAGESIZE);
+    const uint64_t faults   = threadFaults();
+
+    for (size_t size = ARENA_MIN_CLASS; ; size *= 2) {
+        size_t count = bytesPerClass / size;
+        if (count == 0)
+            count = 1;
+
+        std::unique_ptr<SlabClass> slab(new SlabClass());
+        slab->size   = size;
+        slab->length = (count * size + ARENA_HUGE_PAGE - 1) /
+                       ARENA_HUGE_PAGE * ARENA_HUGE_PAGE;
+        bool huge;
+        try {
+            slab->base = (char*)map(slab->length, huge);
+        }
+        catch (...) {
+            for (size_t i = 0; i < classes.size(); i++)
+                (void)munmap(classes[i]->base, classes[i]->length);
+            throw;
+        }
+        classes.push_back(std::move(slab));
+
+        SlabClass& cls = *classes.back();
+        hugetlb = hugetlb && huge;
+        bytes  += cls.length;
+        for (size_t off = 0; off < cls.length; off += pagesize)
+            ((volatile char*)cls.base)[off] = 0;
+        if (lock && mlock(cls.base, cls.length)) {
+#ifdef LDM_LOGGING
+            log_warning("ProdArena::ProdArena() Couldn't lock %lu bytes: %s",
+                    (unsigned long)cls.length, strerror(errno));
+#endif
+            locked = false;
+        }
+
+        cls.free.reserve(count);
+        for (size_t i = count; i-- > 0; )
+            cls.free.push_back(cls.base + i * size);
+
+        if (size >= maxProdSize)
+            break;
+    }
+
+    prefaults = threadFaults() - faults;
+}
+
+
+/**
+ * Unmaps the buffers, including the ones that haven't been returned.
+ *
+ * @param[in] none
+ */
+ProdArena::~ProdArena()
+{
+    for (size_t i = 0; i < classes.size(); i++)
+        (void)munmap(classes[i]->base, classes[i]->length);
+}
+
+
+/**
+ * Takes a free buffer of the smallest class that holds `size` bytes, or of a
+ * bigger class if that one has none left.
+ *
+ * @param[in] size              Size of the product in bytes.
+ * @return                      The buffer, or NULL if the product is too big
+ *                              or there's no free buffer.
+ */
+void* ProdArena::alloc(const size_t size)
+{
+    const std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+    void* buf = NULL;
+
+    for (size_t i = 0; i < classes.size() && buf == NULL; i++) {
+        SlabClass& cls = *classes[i];
+        if (cls.size < size)
+            continue;
+        std::unique_lock<std::mutex> lock(cls.mutex);
+        if (!cls.free.empty()) {
+            buf = cls.free.back();
+            cls.free.pop_back();
+        }
+    }
+
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    if (buf)
+        allocs.fetch_add(1, std::memory_order_relaxed);
+    else
+        misses.fetch_add(1, std::memory_order_relaxed);
+    allocNs.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = maxAllocNs.load(std::memory_order_relaxed);
+    while (ns > max && !maxAllocNs.compare_exchange_weak(max, ns,
+            std::memory_order_relaxed))
+        ;
+
+    return buf;
+}
+
+
+/**
+ * Returns a buffer to its class.
+ *
+ * @param[in] buf               The buffer.
+ * @return                      false if the buffer isn't the arena's.
+ */
+bool ProdArena::release(void* const buf)
+{
+    for (size_t i = 0; i < classes.size(); i++) {
+        SlabClass& cls = *classes[i];
+        if ((char*)buf >= cls.base && (char*)buf < cls.base + cls.length) {
+            std::unique_lock<std::mutex> lock(cls.mutex);
+            cls.free.push_back(buf);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Returns what the arena has done so far.
+ *
+ * @param[out] stats            Statistics.
+ */
+void ProdArena::getStats(ArenaStats& stats)
+{
+    stats.bytes      = bytes;
+    stats.prefaults  = prefaults;
+    stats.allocs     = allocs.load(std::memory_order_relaxed);
+    stats.misses     = misses.load(std::memory_order_relaxed);
+    stats.allocNs    = allocNs.load(std::memory_order_relaxed);
+    stats.maxAllocNs = maxAllocNs.load(std::memory_order_relaxed);
+    stats.hugetlb    = hugetlb;
+    stats.locked     = locked;
+}
+
+
+/**
+ * Maps anonymous memory aligned to a huge page, with reserved huge pages if
+ * possible and otherwise with transparent ones.
+ *
+ * @param[in]  length           Length, a multiple of ARENA_HUGE_PAGE.
+ * @param[out] hugetlb          Whether reserved huge pages are used.
+ * @return                      The mapping.
+ * @throws std::system_error    if the memory can't be mapped.
+ */
+void* ProdArena::map(const size_t length, bool& hugetlb)
+{
+    void* addr = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (addr != MAP_FAILED) {
+        hugetlb = true;
+        return addr;
+    }
+
+    hugetlb = false;
+    addr = mmap(NULL, length + ARENA_HUGE_PAGE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        throw std::system_error(errno, std::system_category(),
+                "ProdArena::map() Couldn't map " + std::to_string(length) +
+                " bytes");
+    }
+
+    /* trims the mapping to the huge page boundaries */
+    char* const    raw  = (char*)addr;
+    const size_t   head = (ARENA_HUGE_PAGE -
+                           (uintptr_t)raw % ARENA_HUGE_PAGE) % ARENA_HUGE_PAGE;
+    if (head)
+        (void)munmap(raw, head);
+    (void)munmap(raw + head + length, ARENA_HUGE_PAGE - head);
+    (void)madvise(raw + head, length, MADV_HUGEPAGE);
+
+    return raw + head;
+}
@@ -0,0 +1,122 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      ProdArena.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of ProdArena class.
+ *
+ * Product buffers that are allocated up front. The buffers are grouped in
+ * slab classes whose sizes are powers of 2, each class in one mapping that's
+ * backed by huge pages where the system has them. All pages are written once
+ * when the arena is created, and can be locked in memory, so filling a
+ * buffer on the multicast thread never takes a page fault.
+ */
+
+
+#ifndef FMTP_RECEIVER_PRODARENA_H_
+#define FMTP_RECEIVER_PRODARENA_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+/* size of the smallest slab class */
+const size_t ARENA_MIN_CLASS = 64 * 1024;
+/* alignment of the mappings, the size of a huge page on x86-64 */
+const size_t ARENA_HUGE_PAGE = 2 * 1024 * 1024;
+
+/* what the arena has done so far */
+struct ArenaStats {
+    uint64_t bytes;          /*!< size of all mappings */
+    uint64_t prefaults;      /*!< page faults taken when creating the arena */
+    uint64_t allocs;         /*!< buffers handed out */
+    uint64_t misses;         /*!< allocations that found no free buffer */
+    uint64_t allocNs;        /*!< total time spent in alloc() */
+    uint64_t maxAllocNs;     /*!< longest time spent in alloc() */
+    bool     hugetlb;        /*!< backed by reserved huge pages, not THP */
+    bool     locked;         /*!< locked in memory */
+};
+
+
+class ProdArena
+{
+public:
+    /**
+     * Maps and pre-faults the buffers of all slab classes.
+     *
+     * @param[in] maxProdSize    Size of the biggest product to be taken.
+     * @param[in] bytesPerClass  Memory of each class; every class has at
+     *                           least one buffer.
+     * @param[in] lock           Whether to lock the buffers in memory.
+     * @throws std::system_error  if a class can't be mapped.
+     */
+    ProdArena(const size_t maxProdSize, const size_t bytesPerClass,
+              const bool lock);
+    ~ProdArena();
+    /**
+     * Takes a buffer of at least the given size.
+     *
+     * @param[in] size  Size of the product in bytes.
+     * @return          The buffer, or NULL if there's no free one.
+     */
+    void* alloc(const size_t size);
+    /**
+     * Returns a buffer that alloc() handed out.
+     *
+     * @param[in] buf  The buffer.
+     * @return         false if the buffer isn't the arena's.
+     */
+    bool  release(void* const buf);
+    /**
+     * Returns what the arena has done so far.
+     *
+     * @param[out] stats  Statistics.
+     */
+    void  getStats(ArenaStats& stats);
+
+private:
+    struct SlabClass {
+        size_t              size;     /*!< size of each buffer */
+        char*               base;
+        size_t              length;   /*!< length of the mapping */
+        std::vector<void*>  free;
+        std::mutex          mutex;
+    };
+
+    ProdArena(const ProdArena&);
+    ProdArena& operator=(const ProdArena&);
+    void* map(const size_t length, bool& hugetlb);
+
+    std::vector<std::unique_ptr<SlabClass> > classes;
+    uint64_t                                  bytes;
+    uint64_t                                  prefaults;
+    bool                                      hugetlb;
+    bool                                      locked;
+    std::atomic<uint64_t>                     allocs;
+    std::atomic<uint64_t>                     misses;
+    std::atomic<uint64_t>                     allocNs;
+    std::atomic<uint64_t>                     maxAllocNs;
+};
+
+
+#endif /* FMTP_RECEIVER_PRODARENA_H_ */
@@ -0,0 +1,391 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      ProdBitmap.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the interfaces of ProdBitmap class.
+ *
+ * The block bitmap of a single product, one bit per FMTP_DATA_LEN block.
+ */
+
+
+#include "ProdBitmap.h"
+#include "fmtpBase.h"
+
+#include <algorithm>
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+
+/* the SSE2 scan reads the atomic words as plain memory */
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+              "std::atomic<uint64_t> isn't a plain 64-bit word");
+
+
+/**
+ * Constructor of the ProdBitmap class. The bitmap is empty until reset().
+ *
+ * @param[in] none
+ */
+ProdBitmap::ProdBitmap() : words(), capacity(0), prodsize(0), nblocks(0),
+    nrecv(0), sums(), sumCapacity(0), nsegs(0), segBlocks(1), unhashed(false)
+{
+}
+
+
+/**
+ * Destructor of the ProdBitmap class.
+ *
+ * @param[in] none
+ */
+ProdBitmap::~ProdBitmap()
+{
+}
+
+
+/**
+ * Adds a block that's just been set to the checksum of its segment. The
+ * block is read from where it's been stored.
+ *
+ * @param[in] block            Index of the block.
+ * @param[in] prodptr          Start of the product, or NULL if the block
+ *                             wasn't stored.
+ */
+inline void ProdBitmap::addSum(const uint32_t block, const void* const prodptr)
+{
+    if (prodptr == NULL) {
+        unhashed.store(true, std::memory_order_relaxed);
+        return;
+    }
+    const uint32_t seqnum = block * FMTP_DATA_LEN;
+    const uint16_t len    = std::min(prodsize - seqnum,
+                                     (uint32_t)FMTP_DATA_LEN);
+    sums[block / segBlocks].fetch_add(ProdChecksum::blockSum(seqnum,
+            (const char*)prodptr + seqnum, len), std::memory_order_relaxed);
+}
+
+
+/**
+ * Returns a word of the bitmap.
+ *
+ * @param[in] index            Index of the word.
+ * @return                     The word.
+ */
+inline uint64_t ProdBitmap::word(const uint32_t index) const
+{
+    return words[index].load(std::memory_order_relaxed);
+}
+
+
+/**
+ * Finds the first unreceived block at or after a given block. Whole words of
+ * received blocks are skipped, two at a time where SSE2 is available.
+ *
+ * @param[in] block            The block to start at.
+ * @param[in] end              The block to stop at.
+ * @return                     Index of the block or `end` if there's none.
+ */
+uint32_t ProdBitmap::findMissing(uint32_t block, const uint32_t end) const
+{
+    while (block < end) {
+        const uint64_t bits = ~word(block / 64) >> (block % 64);
+        if (bits)
+            return std::min(block + (uint32_t)__builtin_ctzll(bits), end);
+        block = (block / 64 + 1) * 64;
+#ifdef __SSE2__
+        const __m128i ones = _mm_set1_epi32(-1);
+        while (block + 128 <= end) {
+            const __m128i v = _mm_loadu_si128(
+                    (const __m128i*)&words[block / 64]);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, ones)) != 0xFFFF)
+                break;
+            block += 128;
+        }
+#endif
+    }
+    return end;
+}
+
+
+/**
+ * Finds the first received block at or after a given block. Whole words of
+ * missing blocks are skipped, two at a time where SSE2 is available.
+ *
+ * @param[in] block            The block to start at.
+ * @param[in] end              The block to stop at.
+ * @return                     Index of the block or `end` if there's none.
+ */
+uint32_t ProdBitmap::findReceived(uint32_t block, const uint32_t end) const
+{
+    while (block < end) {
+        const uint64_t bits = word(block / 64) >> (block % 64);
+        if (bits)
+            return std::min(block + (uint32_t)__builtin_ctzll(bits), end);
+        block = (block / 64 + 1) * 64;
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        while (block + 128 <= end) {
+            const __m128i v = _mm_loadu_si128(
+                    (const __m128i*)&words[block / 64]);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xFFFF)
+                break;
+            block += 128;
+        }
+#endif
+    }
+    return end;
+}
+
+
+/**
+ * Gets the status of the last block of the product.
+ *
+ * @param[in] none
+ * @return                     Arrival status of the last block.
+ */
+bool ProdBitmap::getLastBlock() const
+{
+    if (nblocks == 0)
+        return true;
+    const uint32_t last = nblocks - 1;
+    return (word(last / 64) >> (last % 64)) & 1;
+}
+
+
+/**
+ * Gets the end of the received blocks from a given block on, i.e. the start
+ * of the first missing block at or after it. The data of the blocks before
+ * that are visible to the caller, whichever thread stored them.
+ *
+ * @param[in] seqnum           Byte offset of the block to start at.
+ * @return                     Byte offset of the first missing block, or
+ *                             the size of the product if there is none.
+ */
+uint32_t ProdBitmap::getPrefix(const uint32_t seqnum) const
+{
+    const uint32_t block = findMissing(seqnum / FMTP_DATA_LEN, nblocks);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return std::min((uint64_t)block * FMTP_DATA_LEN, (uint64_t)prodsize);
+}
+
+
+/**
+ * Gets the unreceived ranges of the product between two byte offsets. A
+ * block counts if it starts before `end`.
+ *
+ * @param[in]  begin           Byte offset to start at.
+ * @param[in]  end             Byte offset to stop at.
+ * @param[out] ranges          The missing ranges, in order.
+ */
+void ProdBitmap::getMissing(const uint32_t begin, const uint32_t end,
+                            std::vector<MissingRange>& ranges) const
+{
+    ranges.clear();
+    const uint32_t last = std::min(
+            (uint32_t)(((uint64_t)end + FMTP_DATA_LEN - 1) / FMTP_DATA_LEN),
+            nblocks);
+    uint32_t block = begin / FMTP_DATA_LEN;
+    while ((block = findMissing(block, last)) < last) {
+        const uint32_t next = findReceived(block, last);
+        MissingRange range;
+        range.seqnum = block * FMTP_DATA_LEN;
+        range.length = std::min((uint64_t)next * FMTP_DATA_LEN,
+                                (uint64_t)prodsize) - range.seqnum;
+        ranges.push_back(range);
+        block = next;
+    }
+}
+
+
+/**
+ * Checks if the product has been completely received.
+ *
+ * @param[in] none
+ * @return                     true for complete and false for incomplete.
+ */
+bool ProdBitmap::isComplete() const
+{
+    return nrecv.load(std::memory_order_acquire) == nblocks;
+}
+
+
+/**
+ * Checks if the block starting at the given sequence number has been
+ * received.
+ *
+ * @param[in] seqnum           Sequence number of the block.
+ * @return                     true for received and false for unreceived.
+ */
+bool ProdBitmap::isReceived(const uint32_t seqnum) const
+{
+    const uint32_t block = seqnum / FMTP_DATA_LEN;
+    return block < nblocks && ((word(block / 64) >> (block % 64)) & 1);
+}
+
+
+/**
+ * Clears the bitmap for a new product, reusing the words already allocated.
+ * Must not run concurrently with any other member function.
+ *
+ * @param[in] prodsize         Size of the new product.
+ */
+void ProdBitmap::reset(const uint32_t prodsize)
+{
+    this->prodsize = prodsize;
+    nblocks = (prodsize + FMTP_DATA_LEN - 1) / FMTP_DATA_LEN;
+    const uint32_t nwords = (nblocks + 63) / 64;
+    if (nwords > capacity) {
+        words.reset(new std::atomic<uint64_t>[nwords]);
+        capacity = nwords;
+    }
+    for (uint32_t i = 0; i < nwords; i++)
+        words[i].store(0, std::memory_order_relaxed);
+    nsegs     = ProdChecksum::numSegs(prodsize);
+    segBlocks = ProdChecksum::segBlocks(prodsize);
+    if (nsegs > sumCapacity) {
+        sums.reset(new std::atomic<uint32_t>[nsegs]);
+        sumCapacity = nsegs;
+    }
+    for (uint32_t i = 0; i < nsegs; i++)
+        sums[i].store(0, std::memory_order_relaxed);
+    unhashed.store(false, std::memory_order_relaxed);
+    nrecv.store(0, std::memory_order_release);
+}
+
+
+/**
+ * Sets the received status of the given block and adds the block to the
+ * checksum of its segment.
+ *
+ * @param[in] seqnum           Sequence number of the received block.
+ * @param[in] payloadlen       Length of the received block.
+ * @param[in] prodptr          Start of the product the block has been stored
+ *                             in, or NULL if it wasn't stored.
+ *
+ * @return                     -1 if block misaligned
+ *                             0 if duplicate, no operation done
+ *                             1 if set block successful
+ */
+int ProdBitmap::set(const uint32_t seqnum, const uint16_t payloadlen,
+                    const void* const prodptr)
+{
+    const uint32_t block = seqnum / FMTP_DATA_LEN;
+    if (seqnum % FMTP_DATA_LEN || block >= nblocks ||
+            payloadlen != std::min(prodsize - seqnum, (uint32_t)FMTP_DATA_LEN))
+        return -1;
+
+    /* releases the block's data to the readers of the received prefix */
+    const uint64_t bit = (uint64_t)1 << (block % 64);
+    if (words[block / 64].fetch_or(bit, std::memory_order_acq_rel) & bit)
+        return 0;
+    addSum(block, prodptr);
+    nrecv.fetch_add(1, std::memory_order_release);
+    return 1;
+}
+
+
+/**
+ * Sets the received status of a range of whole blocks, a word of the bitmap
+ * at a time, and adds the newly-set blocks to the checksums.
+ *
+ * @param[in] seqnum           Sequence number of the first block.
+ * @param[in] length           Length of the range. It ends at a block
+ *                             boundary or at the end of the product.
+ * @param[in] prodptr          Start of the product the blocks have been
+ *                             stored in, or NULL if they weren't stored.
+ *
+ * @return                     -1 if range misaligned. Otherwise the number
+ *                             of newly-set blocks.
+ */
+int ProdBitmap::setRange(const uint32_t seqnum, const uint32_t length,
+                         const void* const prodptr)
+{
+    if (seqnum % FMTP_DATA_LEN || seqnum > prodsize ||
+            length > prodsize - seqnum ||
+            (length % FMTP_DATA_LEN && seqnum + length != prodsize))
+        return -1;
+
+    uint32_t       block = seqnum / FMTP_DATA_LEN;
+    const uint32_t end   = block +
+            (length + FMTP_DATA_LEN - 1) / FMTP_DATA_LEN;
+    int            nset  = 0;
+    while (block < end) {
+        const uint32_t nbits = std::min(64 - block % 64, end - block);
+        const uint64_t mask  = (nbits == 64 ? ~(uint64_t)0 :
+                (((uint64_t)1 << nbits) - 1)) << (block % 64);
+        const uint64_t old   = words[block / 64].fetch_or(mask,
+                std::memory_order_acq_rel);
+        for (uint64_t bits = mask & ~old; bits; bits &= bits - 1)
+            addSum(block / 64 * 64 + __builtin_ctzll(bits), prodptr);
+        nset  += __builtin_popcountll(mask & ~old);
+        block += nbits;
+    }
+    nrecv.fetch_add(nset, std::memory_order_release);
+    return nset;
+}
+
+
+/**
+ * Compares the checksums of the segments with the ones the sender computed.
+ * The blocks of every segment that doesn't match are cleared, as is its
+ * checksum, so that they can be received again. Must only be called when
+ * the product is complete; the blocks can then only be set again after
+ * they've been cleared. Does nothing if a block was set without its data.
+ *
+ * @param[in]  expected        Checksums computed by the sender.
+ * @param[out] corrupt         The cleared ranges, in order.
+ */
+void ProdBitmap::verify(const std::vector<uint32_t>& expected,
+                        std::vector<MissingRange>& corrupt)
+{
+    corrupt.clear();
+    if (expected.size() != nsegs ||
+            unhashed.load(std::memory_order_relaxed))
+        return;
+
+    for (uint32_t seg = 0; seg < nsegs; seg++) {
+        if (sums[seg].load(std::memory_order_relaxed) == expected[seg])
+            continue;
+
+        /* the checksum is cleared before any block can be set again */
+        sums[seg].store(0, std::memory_order_relaxed);
+        uint32_t       block    = seg * segBlocks;
+        const uint32_t end      = std::min(block + segBlocks, nblocks);
+        uint32_t       ncleared = 0;
+        while (block < end) {
+            const uint32_t nbits = std::min(64 - block % 64, end - block);
+            const uint64_t mask  = (nbits == 64 ? ~(uint64_t)0 :
+                    (((uint64_t)1 << nbits) - 1)) << (block % 64);
+            const uint64_t old   = words[block / 64].fetch_and(~mask,
+                    std::memory_order_release);
+            ncleared += __builtin_popcountll(mask & old);
+            block    += nbits;
+        }
+        nrecv.fetch_sub(ncleared, std::memory_order_relaxed);
+
+        const uint32_t seqnum = seg * segBlocks * FMTP_DATA_LEN;
+        const uint32_t length = std::min((uint64_t)end * FMTP_DATA_LEN,
+                                         (uint64_t)prodsize) - seqnum;
+        if (!corrupt.empty() && corrupt.back().seqnum +
+                corrupt.back().length == seqnum)
+            corrupt.back().length += length;
+        else
+            corrupt.push_back(MissingRange{seqnum, length});
+    }
+}
@@ -0,0 +1,95 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      ProdBitmap.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of ProdBitmap class.
+ *
+ * The block bitmap of a single product, one bit per FMTP_DATA_LEN block.
+ * Blocks are set with atomic operations, so the multicast and the
+ * retransmission threads can both set blocks without a lock. Bits are only
+ * ever set, a concurrent reader can at worst see a block as still missing,
+ * except that verify() clears the blocks of a segment whose checksum is
+ * wrong. Setting a block also adds it to the checksum of its segment, see
+ * ProdChecksum, before the block counts as received. A block that has been
+ * received mustn't be overwritten, so its duplicates aren't stored.
+ */
+
+
+#ifndef FMTP_RECEIVER_PRODBITMAP_H_
+#define FMTP_RECEIVER_PRODBITMAP_H_
+
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "ProdChecksum.h"
+
+
+/* a range of missing bytes in a product */
+struct MissingRange {
+    uint32_t seqnum;
+    uint32_t length;
+};
+
+
+class ProdBitmap
+{
+public:
+    ProdBitmap();
+    ~ProdBitmap();
+    bool     getLastBlock() const;
+    uint32_t getPrefix(const uint32_t seqnum) const;
+    void     getMissing(const uint32_t begin, const uint32_t end,
+                        std::vector<MissingRange>& ranges) const;
+    bool     isComplete() const;
+    bool     isReceived(const uint32_t seqnum) const;
+    void     reset(const uint32_t prodsize);
+    int      set(const uint32_t seqnum, const uint16_t payloadlen,
+                 const void* const prodptr);
+    int      setRange(const uint32_t seqnum, const uint32_t length,
+                      const void* const prodptr);
+    void     verify(const std::vector<uint32_t>& expected,
+                    std::vector<MissingRange>& corrupt);
+
+private:
+    ProdBitmap(const ProdBitmap&);
+    ProdBitmap& operator=(const ProdBitmap&);
+    uint32_t findMissing(uint32_t block, const uint32_t end) const;
+    uint32_t findReceived(uint32_t block, const uint32_t end) const;
+    void     addSum(const uint32_t block, const void* const prodptr);
+    uint64_t word(const uint32_t index) const;
+
+    std::unique_ptr<std::atomic<uint64_t>[]> words;
+    uint32_t                                 capacity; /*!< words allocated */
+    uint32_t                                 prodsize;
+    uint32_t                                 nblocks;
+    std::atomic<uint32_t>                    nrecv;    /*!< bits set */
+    /* checksum of each segment of the blocks received so far */
+    std::unique_ptr<std::atomic<uint32_t>[]> sums;
+    uint32_t                                 sumCapacity;
+    uint32_t                                 nsegs;
+    uint32_t                                 segBlocks;
+    /* a block was set without its data, so the checksums can't be used */
+    std::atomic<bool>                        unhashed;
+};
+
+
+#endif /* FMTP_RECEIVER_PRODBITMAP_H_ */
@@ -0,0 +1,557 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      ProdStateTable.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the interfaces of ProdStateTable class.
+ *
+ * The receiver's per-product state, a ring of slots indexed by prodindex.
+ */
+
+
+#include "ProdStateTable.h"
+
+#include <sched.h>
+#include <chrono>
+
+
+/**
+ * Constructor of the ProdStateTable class.
+ *
+ * @param[in] none
+ */
+ProdStateTable::ProdStateTable() : slots(new ProdState[PROD_TABLE_SIZE])
+{
+}
+
+
+/**
+ * Destructor of the ProdStateTable class.
+ *
+ * @param[in] none
+ */
+ProdStateTable::~ProdStateTable()
+{
+}
+
+
+/**
+ * Puts a new product under tracking. The product isn't visible to the data
+ * path until publish() is called, which gives the receiving application the
+ * time to allocate it. If the slot holds an older product that's still
+ * being received, that product is evicted.
+ *
+ * @param[in]  prodindex       Product index of the product to track.
+ * @param[in]  prodsize        Size of the product.
+ * @param[out] evicted         Whether a product was evicted.
+ * @param[out] evictedIndex    Product index of the evicted product.
+ * @return                     true for successful addition. false if the
+ *                             product is already tracked or its slot is
+ *                             held by a newer product.
+ */
+bool ProdStateTable::claim(const uint32_t prodindex, const uint32_t prodsize,
+                           bool& evicted, uint32_t& evictedIndex)
+{
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    if (!occupy(slot, prodindex, evicted, evictedIndex) ||
+            slot.status.load(std::memory_order_relaxed) != PROD_FREE)
+        return false;
+
+    /* a finished product's pins could still be in flight */
+    untrack(slot);
+    slot.prodsize = prodsize;
+    slot.prodptr  = NULL;
+    slot.delta    = false;
+    slot.last.store(0, std::memory_order_relaxed);
+    slot.numRetrans.store(0, std::memory_order_relaxed);
+    slot.prefix.store(0, std::memory_order_relaxed);
+    slot.reported.store(0, std::memory_order_relaxed);
+    slot.lastArrival.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count(),
+            std::memory_order_relaxed);
+    slot.bitmap.reset(prodsize);
+    slot.checksums.clear();
+    slot.eop = EOP_PENDING;
+    slot.status.store(PROD_STARTING, std::memory_order_release);
+    return true;
+}
+
+
+/**
+ * Clears the EOP arrival status.
+ *
+ * @param[in] prodindex        Product index which the EOP belongs to.
+ */
+void ProdStateTable::clearEOP(const uint32_t prodindex)
+{
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    if (slot.prodindex.load(std::memory_order_relaxed) == prodindex)
+        slot.eop = EOP_NONE;
+}
+
+
+/**
+ * If all blocks are received and match the checksums from the EOP, stops
+ * tracking the product and returns true. If all blocks are received but
+ * some segments don't match, clears their blocks so that they can be
+ * requested again and returns false. Otherwise, does nothing and returns
+ * false. A product that's complete before its EOP arrives isn't checked.
+ * Only one caller sees a product as finished.
+ *
+ * @param[in]  prodindex       Product index of the product to query.
+ * @param[out] numRetrans      Number of retransmitted blocks.
+ * @param[out] corrupt         The ranges that didn't match, in order.
+ * @return                     true for complete and finished.
+ *                             false for incomplete or product not found.
+ */
+bool ProdStateTable::finish(const uint32_t prodindex, uint32_t& numRetrans,
+                            std::vector<MissingRange>& corrupt)
+{
+    corrupt.clear();
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    if (slot.prodindex.load(std::memory_order_relaxed) != prodindex ||
+            slot.status.load(std::memory_order_relaxed) != PROD_TRACKED ||
+            !slot.bitmap.isComplete())
+        return false;
+    if (!slot.checksums.empty()) {
+        slot.bitmap.verify(slot.checksums, corrupt);
+        if (!corrupt.empty())
+            return false;
+    }
+
+    numRetrans = slot.numRetrans.load(std::memory_order_relaxed);
+    untrack(slot);
+    return true;
+}
+
+
+/**
+ * Gets the EOP arrival status.
+ *
+ * @param[in] prodindex        Product index which the EOP belongs to.
+ * @return                     true if the EOP has been received.
+ */
+bool ProdStateTable::getEOP(const uint32_t prodindex)
+{
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    return slot.prodindex.load(std::memory_order_relaxed) == prodindex &&
+           slot.eop == EOP_RECEIVED;
+}
+
+
+/**
+ * Gets the status of the last block of the given product.
+ *
+ * @param[in] prodindex        Product index of the product to get status from.
+ * @return                     Arrival status of the last block, false if the
+ *                             product isn't tracked.
+ */
+bool ProdStateTable::getLastBlock(const uint32_t prodindex)
+{
+    ProdStatePin pin(*this, prodindex);
+    return pin && pin->bitmap.getLastBlock();
+}
+
+
+/**
+ * Gets the products that are being received and the ones whose BOP has been
+ * requested. Slots are looked at one at a time, so products can come and go
+ * while the table is walked.
+ *
+ * @param[out] prods           The products, in slot order.
+ */
+void ProdStateTable::getOutstanding(std::vector<OutstandingProd>& prods)
+{
+    prods.clear();
+    for (uint32_t i = 0; i < PROD_TABLE_SIZE; i++) {
+        ProdState&                   slot = slots[i];
+        std::unique_lock<std::mutex> lock(slot.mutex);
+        const bool tracked = slot.status.load(std::memory_order_relaxed) ==
+                             PROD_TRACKED;
+        if (tracked || slot.bopRequested) {
+            OutstandingProd prod;
+            prod.prodindex = slot.prodindex.load(std::memory_order_relaxed);
+            prod.bop       = !tracked;
+            prod.eop       = slot.eop;
+            prods.push_back(prod);
+        }
+    }
+}
+
+
+/**
+ * Gets the unreceived ranges of a product between two byte offsets.
+ *
+ * @param[in]  prodindex       Product index of the product to query.
+ * @param[in]  begin           Byte offset to start at.
+ * @param[in]  end             Byte offset to stop at.
+ * @param[out] ranges          The missing ranges, in order. Empty if the
+ *                             product isn't tracked.
+ */
+void ProdStateTable::getMissing(const uint32_t prodindex, const uint32_t begin,
+                                const uint32_t end,
+                                std::vector<MissingRange>& ranges)
+{
+    ProdStatePin pin(*this, prodindex);
+    if (pin)
+        pin->bitmap.getMissing(begin, end, ranges);
+    else
+        ranges.clear();
+}
+
+
+/**
+ * Gets a copy of the tracker of a product.
+ *
+ * @param[in]  prodindex       Product index of the product.
+ * @param[out] tracker         The tracker.
+ * @return                     false if the product isn't tracked.
+ */
+bool ProdStateTable::getProd(const uint32_t prodindex, ProdTracker& tracker)
+{
+    ProdStatePin pin(*this, prodindex);
+    if (!pin)
+        return false;
+
+    const uint64_t last = pin->last.load(std::memory_order_relaxed);
+    tracker.prodsize    = pin->prodsize;
+    tracker.prodptr     = pin->prodptr;
+    tracker.seqnum      = last >> 32;
+    tracker.paylen      = last & 0xFFFF;
+    tracker.numRetrans  = pin->numRetrans.load(std::memory_order_relaxed);
+    tracker.delta       = pin->delta;
+    tracker.lastArrival = pin->lastArrival.load(std::memory_order_relaxed);
+    return true;
+}
+
+
+/**
+ * Checks whether the BOP of a product has been requested and hasn't been
+ * received yet.
+ *
+ * @param[in] prodindex        Product index of the product.
+ * @return                     true if the BOP is being waited for.
+ */
+bool ProdStateTable::isBopRequested(const uint32_t prodindex)
+{
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    return slot.prodindex.load(std::memory_order_relaxed) == prodindex &&
+           slot.bopRequested;
+}
+
+
+/**
+ * Checks whether every block of a tracked product has been received.
+ *
+ * @param[in] prodindex        Product index of the product.
+ * @return                     false if the product isn't tracked.
+ */
+bool ProdStateTable::isComplete(const uint32_t prodindex)
+{
+    ProdStatePin pin(*this, prodindex);
+    return pin && pin->bitmap.isComplete();
+}
+
+
+/**
+ * Checks whether a product is being tracked, i.e. its BOP has been received
+ * and it isn't finished.
+ *
+ * @param[in] prodindex        Product index of the product.
+ * @return                     true if the product is tracked.
+ */
+bool ProdStateTable::isTracked(const uint32_t prodindex)
+{
+    ProdStatePin pin(*this, prodindex);
+    return static_cast<bool>(pin);
+}
+
+
+/**
+ * Makes a claimed product visible to the data path.
+ *
+ * @param[in] prodindex        Product index of the product.
+ * @param[in] prodptr          Where the product is written to, or NULL.
+ * @param[in] delta            Whether unchanged blocks were copied from a
+ *                             base.
+ */
+void ProdStateTable::publish(const uint32_t prodindex, void* const prodptr,
+                             const bool delta)
+{
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    if (slot.prodindex.load(std::memory_order_relaxed) == prodindex &&
+            slot.status.load(std::memory_order_relaxed) == PROD_STARTING) {
+        slot.prodptr = prodptr;
+        slot.delta   = delta;
+        slot.status.store(PROD_TRACKED, std::memory_order_release);
+    }
+}
+
+
+/**
+ * Records that the BOP of a product is about to be requested. Each BOP is
+ * requested only once. If the slot holds an older product that's still
+ * being received, that product is evicted.
+ *
+ * @param[in]  prodindex       Product index of the missing BOP.
+ * @param[out] evicted         Whether a product was evicted.
+ * @param[out] evictedIndex    Product index of the evicted product.
+ * @return                     true if the BOP should be requested.
+ */
+bool ProdStateTable::reqBop(const uint32_t prodindex, bool& evicted,
+                            uint32_t& evictedIndex)
+{
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    if (!occupy(slot, prodindex, evicted, evictedIndex) || slot.bopRequested)
+        return false;
+    slot.bopRequested = true;
+    return true;
+}
+
+
+/**
+ * Clears the request for the BOP of a product.
+ *
+ * @param[in] prodindex        Product index of the BOP.
+ * @return                     true if the BOP had been requested.
+ */
+bool ProdStateTable::rmBop(const uint32_t prodindex)
+{
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    if (slot.prodindex.load(std::memory_order_relaxed) != prodindex ||
+            !slot.bopRequested)
+        return false;
+    slot.bopRequested = false;
+    return true;
+}
+
+
+/**
+ * Stops tracking a product, complete or not.
+ *
+ * @param[in] prodindex        Product index of the product to remove.
+ * @return                     true for successful removal and false
+ *                             for product not found.
+ */
+bool ProdStateTable::rmProd(const uint32_t prodindex)
+{
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    if (slot.prodindex.load(std::memory_order_relaxed) != prodindex ||
+            slot.status.load(std::memory_order_relaxed) == PROD_FREE)
+        return false;
+    untrack(slot);
+    return true;
+}
+
+
+/**
+ * Sets the received status of the given block of a product.
+ *
+ * @param[in] prodindex        Product index of the product to set.
+ * @param[in] seqnum           Sequence number of the received block.
+ * @param[in] payloadlen       Length of the received block.
+ *
+ * @return                     -1 if product not found or block misaligned
+ *                             0 if duplicate, no operation done
+ *                             1 if set block successful
+ */
+int ProdStateTable::set(const uint32_t prodindex, const uint32_t seqnum,
+                        const uint16_t payloadlen)
+{
+    ProdStatePin pin(*this, prodindex);
+    return pin ? pin->bitmap.set(seqnum, payloadlen, pin->prodptr) : -1;
+}
+
+
+/**
+ * Records the checksums of the segments of a product that the EOP carries.
+ *
+ * @param[in] prodindex        Product index which the EOP belongs to.
+ * @param[in] checksums        The checksums.
+ */
+void ProdStateTable::setChecksums(const uint32_t prodindex,
+                                  const std::vector<uint32_t>& checksums)
+{
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    if (slot.prodindex.load(std::memory_order_relaxed) == prodindex &&
+            slot.status.load(std::memory_order_relaxed) != PROD_FREE)
+        slot.checksums = checksums;
+}
+
+
+/**
+ * Sets the EOP arrival status to received.
+ *
+ * @param[in] prodindex        Product index which the EOP belongs to.
+ */
+void ProdStateTable::setEOP(const uint32_t prodindex)
+{
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    if (slot.prodindex.load(std::memory_order_relaxed) == prodindex)
+        slot.eop = EOP_RECEIVED;
+}
+
+
+/**
+ * Records the most recent block received over multicast.
+ *
+ * @param[in] prodindex        Product index of the product.
+ * @param[in] seqnum           Sequence number of the block.
+ * @param[in] paylen           Length of the block.
+ */
+void ProdStateTable::setLast(const uint32_t prodindex, const uint32_t seqnum,
+                             const uint16_t paylen)
+{
+    ProdStatePin pin(*this, prodindex);
+    if (pin)
+        pin->last.store((uint64_t)seqnum << 32 | paylen,
+                        std::memory_order_relaxed);
+}
+
+
+/**
+ * Sets the received status of a range of whole blocks of a product. Unlike
+ * set(), this works before the product is published.
+ *
+ * @param[in] prodindex        Product index of the product to set.
+ * @param[in] seqnum           Sequence number of the first block.
+ * @param[in] length           Length of the range.
+ * @param[in] prodptr          Where the product is written to, or NULL.
+ *
+ * @return                     -1 if product not found or range misaligned.
+ *                             Otherwise the number of newly-set blocks.
+ */
+int ProdStateTable::setRange(const uint32_t prodindex, const uint32_t seqnum,
+                             const uint32_t length, const void* const prodptr)
+{
+    ProdState&                   slot = slotOf(prodindex);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    if (slot.prodindex.load(std::memory_order_relaxed) != prodindex ||
+            slot.status.load(std::memory_order_relaxed) == PROD_FREE)
+        return -1;
+    return slot.bitmap.setRange(seqnum, length, prodptr);
+}
+
+
+/**
+ * Gives a slot to a product. The slot's mutex must be held. A slot that's
+ * in use by an older product is taken over, evicting the product if it's
+ * still tracked; one that's in use by a newer product is left alone.
+ *
+ * @param[in]  slot            The slot.
+ * @param[in]  prodindex       Product index of the product.
+ * @param[out] evicted         Whether a product was evicted.
+ * @param[out] evictedIndex    Product index of the evicted product.
+ * @return                     false if the slot is in use by a newer
+ *                             product.
+ */
+bool ProdStateTable::occupy(ProdState& slot, const uint32_t prodindex,
+                            bool& evicted, uint32_t& evictedIndex)
+{
+    evicted = false;
+    const uint32_t occupant = slot.prodindex.load(std::memory_order_relaxed);
+    if (occupant == prodindex)
+        return true;
+
+    const bool tracked =
+            slot.status.load(std::memory_order_relaxed) != PROD_FREE;
+    if ((tracked || slot.eop != EOP_NONE || slot.bopRequested) &&
+            static_cast<int32_t>(prodindex - occupant) < 0)
+        return false;
+
+    if (tracked) {
+        untrack(slot);
+        evicted      = true;
+        evictedIndex = occupant;
+    }
+    slot.eop          = EOP_NONE;
+    slot.bopRequested = false;
+    slot.prodindex.store(prodindex, std::memory_order_relaxed);
+    return true;
+}
+
+
+/**
+ * Returns the slot of a product.
+ *
+ * @param[in] prodindex        Product index of the product.
+ * @return                     The slot.
+ */
+inline ProdState& ProdStateTable::slotOf(const uint32_t prodindex)
+{
+    return slots[prodindex % PROD_TABLE_SIZE];
+}
+
+
+/**
+ * Hides the product in a slot from the data path and waits for the pins
+ * already taken to go away. The slot's mutex must be held.
+ *
+ * @param[in] slot             The slot.
+ */
+void ProdStateTable::untrack(ProdState& slot)
+{
+    slot.status.store(PROD_FREE);
+    while (slot.users.load())
+        (void)sched_yield();
+}
+
+
+/**
+ * Pins the slot of a product if the product is tracked.
+ *
+ * @param[in] table            The table.
+ * @param[in] prodindex        Product index of the product.
+ */
+ProdStatePin::ProdStatePin(ProdStateTable& table, const uint32_t prodindex)
+{
+    ProdState& state = table.slotOf(prodindex);
+    /* pairs with untrack(): either it sees the pin or the pin sees PROD_FREE */
+    state.users.fetch_add(1);
+    if (state.status.load() == PROD_TRACKED &&
+            state.prodindex.load(std::memory_order_relaxed) == prodindex) {
+        slot = &state;
+    }
+    else {
+        state.users.fetch_sub(1, std::memory_order_release);
+        slot = NULL;
+    }
+}
+
+
+/**
+ * Unpins the slot.
+ *
+ * @param[in] none
+ */
+ProdStatePin::~ProdStatePin()
+{
+    if (slot)
+        slot->users.fetch_sub(1, std::memory_order_release);
+}
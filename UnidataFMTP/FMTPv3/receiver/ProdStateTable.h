@@ -0,0 +1,183 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      ProdStateTable.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of ProdStateTable class.
+ *
+ * The receiver's per-product state: the tracker, the block bitmap, the EOP
+ * arrival status and whether the BOP has been requested. It's a ring of
+ * slots indexed by prodindex, so finding a product takes no lock. Data
+ * blocks are stored by pinning the slot with an atomic counter; everything
+ * else takes the slot's own mutex. A slot holds one product at a time, a
+ * product that's still there when its slot is needed by a product that's
+ * PROD_TABLE_SIZE newer is evicted.
+ */
+
+
+#ifndef FMTP_RECEIVER_PRODSTATETABLE_H_
+#define FMTP_RECEIVER_PRODSTATETABLE_H_
+
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ProdBitmap.h"
+
+
+/* number of slots, i.e. of products that can be received at the same time */
+const uint32_t PROD_TABLE_SIZE = 4096;
+
+/* a copy of the tracker of a product */
+struct ProdTracker
+{
+    uint32_t     prodsize;
+    void*        prodptr;
+    uint32_t     seqnum;
+    uint16_t     paylen;
+    uint32_t     numRetrans;
+    bool         delta;      /*!< unchanged blocks were copied from a base */
+    int64_t      lastArrival; /*!< steady clock ns, see ProdState */
+};
+
+/* what a product still needs from the sender, see getOutstanding() */
+struct OutstandingProd
+{
+    uint32_t     prodindex;
+    bool         bop;        /*!< the BOP was requested and hasn't arrived */
+    int          eop;        /*!< an EOPStatus */
+};
+
+/* life cycle of the product in a slot */
+enum ProdStatus {
+    PROD_FREE,       /*!< no product, or a finished one */
+    PROD_STARTING,   /*!< BOP being handed to the receiving application */
+    PROD_TRACKED     /*!< blocks can be stored */
+};
+
+/* EOP arrival status of the product in a slot */
+enum EOPStatus {
+    EOP_NONE,        /*!< the timer isn't waiting for the EOP */
+    EOP_PENDING,
+    EOP_RECEIVED
+};
+
+/* a slot of the table */
+struct ProdState
+{
+    std::mutex            mutex;      /*!< serializes all but the fast path */
+    std::atomic<uint32_t> users;      /*!< pins, see ProdStatePin */
+    std::atomic<int>      status;     /*!< a ProdStatus */
+    std::atomic<uint32_t> prodindex;  /*!< the product using the slot */
+    uint32_t              prodsize;
+    void*                 prodptr;
+    bool                  delta;
+    /* seqnum << 32 | paylen of the last in-order multicast block */
+    std::atomic<uint64_t> last;
+    std::atomic<uint32_t> numRetrans;
+    /* steady clock time in ns of the BOP or the last multicast block */
+    std::atomic<int64_t>  lastArrival;
+    /* bytes received from the start on, and the most reported of them */
+    std::atomic<uint32_t> prefix;
+    std::atomic<uint32_t> reported;
+    ProdBitmap            bitmap;
+    /* checksums of the segments from the EOP, empty until it arrives */
+    std::vector<uint32_t> checksums;
+    int                   eop;        /*!< an EOPStatus */
+    bool                  bopRequested;
+
+    ProdState() : users(0), status(PROD_FREE), prodindex(0), prodsize(0),
+        prodptr(NULL), delta(false), last(0), numRetrans(0), lastArrival(0),
+        prefix(0), reported(0), eop(EOP_NONE), bopRequested(false) {}
+};
+
+
+class ProdStateTable
+{
+public:
+    ProdStateTable();
+    ~ProdStateTable();
+    bool     claim(const uint32_t prodindex, const uint32_t prodsize,
+                   bool& evicted, uint32_t& evictedIndex);
+    void     clearEOP(const uint32_t prodindex);
+    bool     finish(const uint32_t prodindex, uint32_t& numRetrans,
+                    std::vector<MissingRange>& corrupt);
+    bool     getEOP(const uint32_t prodindex);
+    bool     getLastBlock(const uint32_t prodindex);
+    void     getOutstanding(std::vector<OutstandingProd>& prods);
+    void     getMissing(const uint32_t prodindex, const uint32_t begin,
+                        const uint32_t end, std::vector<MissingRange>& ranges);
+    bool     getProd(const uint32_t prodindex, ProdTracker& tracker);
+    bool     isBopRequested(const uint32_t prodindex);
+    bool     isComplete(const uint32_t prodindex);
+    bool     isTracked(const uint32_t prodindex);
+    void     publish(const uint32_t prodindex, void* const prodptr,
+                     const bool delta);
+    bool     reqBop(const uint32_t prodindex, bool& evicted,
+                    uint32_t& evictedIndex);
+    bool     rmBop(const uint32_t prodindex);
+    bool     rmProd(const uint32_t prodindex);
+    int      set(const uint32_t prodindex, const uint32_t seqnum,
+                 const uint16_t payloadlen);
+    void     setChecksums(const uint32_t prodindex,
+                          const std::vector<uint32_t>& checksums);
+    void     setEOP(const uint32_t prodindex);
+    void     setLast(const uint32_t prodindex, const uint32_t seqnum,
+                     const uint16_t paylen);
+    int      setRange(const uint32_t prodindex, const uint32_t seqnum,
+                      const uint32_t length, const void* const prodptr);
+
+private:
+    friend class ProdStatePin;
+    ProdStateTable(const ProdStateTable&);
+    ProdStateTable& operator=(const ProdStateTable&);
+    bool       occupy(ProdState& slot, const uint32_t prodindex,
+                      bool& evicted, uint32_t& evictedIndex);
+    ProdState& slotOf(const uint32_t prodindex);
+    static void untrack(ProdState& slot);
+
+    std::unique_ptr<ProdState[]> slots;
+};
+
+
+/**
+ * Pins the slot of a tracked product for as long as it's in scope, like a
+ * std::unique_lock but without a lock. The slot can't be given to another
+ * product while pinned, so its fields and bitmap can be used directly.
+ * Must not be held across a call that finishes or removes a product.
+ */
+class ProdStatePin
+{
+public:
+    ProdStatePin(ProdStateTable& table, const uint32_t prodindex);
+    ~ProdStatePin();
+    ProdState* operator->() const { return slot; }
+    explicit operator bool() const { return slot != NULL; }
+
+private:
+    ProdStatePin(const ProdStatePin&);
+    ProdStatePin& operator=(const ProdStatePin&);
+
+    ProdState* slot;
+};
+
+
+#endif /* FMTP_RECEIVER_PRODSTATETABLE_H_ */
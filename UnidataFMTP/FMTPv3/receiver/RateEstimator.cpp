@@ -0,0 +1,96 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      RateEstimator.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the RateEstimator class.
+ *
+ * Only the time between packets of the same product is counted, and the
+ * bytes of the packet that ends each interval. A sample is taken once
+ * RATE_WINDOW_NS have been counted and folded into an exponentially weighted
+ * moving average. Lost packets aren't counted, so the estimate errs on the
+ * low side under loss, which only makes deadlines longer.
+ */
+
+
+#include "RateEstimator.h"
+
+
+/**
+ * Constructs an estimator without an estimate.
+ *
+ * @param[in] none
+ */
+RateEstimator::RateEstimator()
+    : started(false), prodindex(0), lastNs(0), winBytes(0), winNs(0),
+      rate(0)
+{
+}
+
+
+/**
+ * Destructs.
+ *
+ * @param[in] none
+ */
+RateEstimator::~RateEstimator()
+{
+}
+
+
+/**
+ * Adds a multicast packet.
+ *
+ * @param[in] prodindex         Product the packet belongs to.
+ * @param[in] bytes             Length of the packet.
+ * @param[in] ns                When the packet arrived, in nanoseconds.
+ */
+void RateEstimator::add(const uint32_t prodindex, const size_t bytes,
+                        const int64_t ns)
+{
+    if (!started || prodindex != this->prodindex || ns < lastNs) {
+        started         = true;
+        this->prodindex = prodindex;
+        lastNs          = ns;
+        return;
+    }
+
+    winBytes += bytes;
+    winNs    += ns - lastNs;
+    lastNs    = ns;
+    if (winNs < RATE_WINDOW_NS)
+        return;
+
+    const double sample = winBytes * 1e9 / winNs;
+    const double old    = rate.load(std::memory_order_relaxed);
+    rate.store(old ? old + RATE_GAIN * (sample - old) : sample,
+               std::memory_order_relaxed);
+    winBytes = 0;
+    winNs    = 0;
+}
+
+
+/**
+ * Returns the estimated rate.
+ *
+ * @return                      Bytes per second, 0 until the first sample.
+ */
+double RateEstimator::getRate() const
+{
+    return rate.load(std::memory_order_relaxed);
+}
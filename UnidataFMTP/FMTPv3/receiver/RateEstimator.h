@@ -0,0 +1,82 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      RateEstimator.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of RateEstimator class.
+ *
+ * Estimates the rate at which multicast packets arrive while a product is
+ * being sent, so that the EOP deadline of the next product follows the
+ * sender's actual rate rather than a configured link speed. The idle time
+ * between products isn't counted. Only the multicast handling thread adds
+ * packets, any thread can read the estimate.
+ */
+
+
+#ifndef FMTP_RECEIVER_RATEESTIMATOR_H_
+#define FMTP_RECEIVER_RATEESTIMATOR_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+
+/* shortest time that a sample of the rate is taken over, in nanoseconds */
+const int64_t RATE_WINDOW_NS = 2000000;
+/* weight of a new sample in the moving average of the rate */
+const double  RATE_GAIN = 0.125;
+
+
+class RateEstimator
+{
+public:
+    RateEstimator();
+    ~RateEstimator();
+    /**
+     * Adds a multicast packet. Called by the multicast handling thread only.
+     *
+     * @param[in] prodindex  Product the packet belongs to.
+     * @param[in] bytes      Length of the packet.
+     * @param[in] ns         When the packet arrived, in nanoseconds.
+     */
+    void   add(const uint32_t prodindex, const size_t bytes,
+               const int64_t ns);
+    /**
+     * Returns the estimated rate.
+     *
+     * @return  Bytes per second, 0 until enough packets have arrived.
+     */
+    double getRate() const;
+
+private:
+    RateEstimator(const RateEstimator&);
+    RateEstimator& operator=(const RateEstimator&);
+
+    /* the product whose packets are arriving */
+    bool                started;
+    uint32_t            prodindex;
+    int64_t             lastNs;
+    /* the sample being taken */
+    uint64_t            winBytes;
+    int64_t             winNs;
+    std::atomic<double> rate;
+};
+
+
+#endif /* FMTP_RECEIVER_RATEESTIMATOR_H_ */
@@ -20,6 +20,23 @@
 #include <ctime>
 
 
+/* kinds of events that are told by RecvProxy::notifyBatch() */
+enum RecvEventType {
+    RECV_END_PROD,       /*!< RecvProxy::endProd() */
+    RECV_MISSED_PROD,    /*!< RecvProxy::missedProd() */
+    RECV_PROD_PROGRESS   /*!< RecvProxy::prodProgress() */
+};
+
+/* an event for the receiving application */
+struct RecvEvent {
+    int             type;        /*!< a RecvEventType */
+    uint32_t        iProd;       /*!< FMTP product-index */
+    struct timespec stop;        /*!< RECV_END_PROD: arrival of the EOP */
+    uint32_t        numRetrans;  /*!< RECV_END_PROD: retransmitted blocks */
+    size_t          size;        /*!< RECV_PROD_PROGRESS: bytes received */
+};
+
+
 /**
  * This base class notifies a receiving application about events.
  */
@@ -68,6 +85,78 @@ public:
      * @param[in] prodIndex  Index of the missed product.
      */
     virtual void missedProd(uint32_t prodIndex) = 0;
+
+    /**
+     * Asks the receiving application for an earlier product, the base of a
+     * revision that's sent as a delta. The blocks that the revision shares
+     * with the base are then taken from the copy instead of being requested
+     * from the sender. This method is thread-safe.
+     *
+     * @param[in]  iProd  FMTP product-index of the base.
+     * @param[out] data   Where to copy the base to.
+     * @param[in]  size   Maximum number of bytes to copy.
+     * @return            `true` if the base was copied; `false` if it's
+     *                    unknown or hasn't been completely received, in
+     *                    which case the whole revision is requested from
+     *                    the sender.
+     */
+    virtual bool readBase(
+            uint32_t               /* iProd */,
+            void*                  /* data */,
+            size_t                 /* size */) { return false; }
+
+    /**
+     * Notifies the receiving application that the start of a product has
+     * been received and can be read while the rest of it arrives. Only
+     * called if enabled by `fmtpRecvv3::SetProgress()`, and never for the
+     * whole product, which `endProd()` is called for. Calls for the same
+     * product can be made by different threads at the same time, so one
+     * can tell less than an earlier one; none is made after `endProd()`.
+     * The product can't be ended while this runs, so it should be quick.
+     * With asynchronous notification, the calls are made in order with
+     * `endProd()` by the notification thread, and one that would have to
+     * wait for room in the queue is skipped.
+     *
+     * @param[in] iProd  FMTP product-index.
+     * @param[in] size   Number of bytes received from the start of the
+     *                   product on.
+     */
+    virtual void prodProgress(
+            uint32_t               /* iProd */,
+            size_t                 /* size */) {}
+
+    /**
+     * Notifies the receiving application about events, in the order in
+     * which they happened. Every `endProd()`, `missedProd()` and
+     * `prodProgress()` is made through this method, which calls them one
+     * after the other unless it's overridden. If enabled by
+     * `fmtpRecvv3::SetAsyncNotify()`, it's only called by the receiver's
+     * notification thread, which passes all the events that have been
+     * queued since the last call; otherwise it's called with one event at a
+     * time by the thread the event happened on.
+     *
+     * @param[in] events  The events.
+     * @param[in] count   Number of events.
+     */
+    virtual void notifyBatch(
+            const RecvEvent*       events,
+            size_t                 count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            const RecvEvent& event = events[i];
+            switch (event.type) {
+            case RECV_END_PROD:
+                endProd(event.stop, event.iProd, event.numRetrans);
+                break;
+            case RECV_MISSED_PROD:
+                missedProd(event.iProd);
+                break;
+            case RECV_PROD_PROGRESS:
+                prodProgress(event.iProd, event.size);
+                break;
+            }
+        }
+    }
 };
 
 
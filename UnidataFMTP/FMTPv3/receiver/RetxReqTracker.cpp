@@ -0,0 +1,248 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      RetxReqTracker.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the interfaces of RetxReqTracker class.
+ *
+ * A burst of requests for a whole product can take the sender longer to
+ * answer than one round-trip, so timing each request on its own resends
+ * most of the burst for nothing. Instead, losses are detected like TCP's
+ * duplicate acknowledgements: a request is lost if REORDER_THRESH requests
+ * sent after it have been answered. The timer only fires when no reply at
+ * all has arrived for a timeout.
+ *
+ * The timeout follows the RFC 6298 estimator: srtt and rttvar are updated with
+ * gains of 1/8 and 1/4 and the timeout is srtt + 4 * rttvar, bounded below by
+ * MIN_RTO and above by MAX_RTO. Samples are only taken from requests that
+ * were never resent (Karn's algorithm).
+ */
+
+
+#include "RetxReqTracker.h"
+
+#include <algorithm>
+
+
+/* bounds of the retransmission timeout in seconds */
+static const double MIN_RTO  = 0.02;
+static const double MAX_RTO  = 2.0;
+/* timeout before any round-trip time is known */
+static const double INIT_RTO = 0.2;
+/* number of later answered requests that marks a request as lost */
+static const uint64_t REORDER_THRESH = 3;
+
+
+/**
+ * Constructor of RetxReqTracker.
+ *
+ * @param[in] maxRetries  Number of times a request is resent before it's
+ *                        given up on.
+ */
+RetxReqTracker::RetxReqTracker(const unsigned maxRetries)
+    : srtt(0), rttvar(0), rto(INIT_RTO), nextTxseq(0), ackedTxseq(0),
+      lastReply(), maxRetries(maxRetries)
+{
+}
+
+
+/**
+ * Destructor of RetxReqTracker.
+ */
+RetxReqTracker::~RetxReqTracker()
+{
+}
+
+
+/**
+ * Records a request that is about to be sent. A request for a block that's
+ * already outstanding isn't recorded again, since the reply to the first one
+ * will do.
+ *
+ * @param[in] prodindex   Product index of the requested block.
+ * @param[in] seqnum      Sequence number of the requested block.
+ * @param[in] payloadlen  Length of the requested block.
+ * @return                False if the block is already outstanding.
+ */
+bool RetxReqTracker::add(const uint32_t prodindex, const uint32_t seqnum,
+                         const uint16_t payloadlen)
+{
+    RetxClock::time_point now = RetxClock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+
+    std::pair<RetxReqMap::iterator, bool> ins =
+        reqMap.insert(std::make_pair(std::make_pair(prodindex, seqnum),
+                                     RetxReq()));
+    if (!ins.second)
+        return false;
+
+    RetxReq& req   = ins.first->second;
+    req.prodindex  = prodindex;
+    req.seqnum     = seqnum;
+    req.payloadlen = payloadlen;
+    req.retries    = 0;
+    req.txseq      = ++nextTxseq;
+    req.sent       = now;
+    req.deadline   = now + std::chrono::duration_cast<RetxClock::duration>(
+                     std::chrono::duration<double>(rto));
+    return true;
+}
+
+
+/**
+ * Collects the requests that are considered lost, either because later
+ * requests have been answered or because their timers expired while no reply
+ * arrived. Requests with retries left are re-armed with a doubled timeout and
+ * returned in `resend`. The others are removed and returned in `giveup`.
+ *
+ * @param[out] resend  Requests to be sent again.
+ * @param[out] giveup  Requests that ran out of retries.
+ */
+void RetxReqTracker::expire(std::vector<RetxReq>& resend,
+                            std::vector<RetxReq>& giveup)
+{
+    RetxClock::time_point now = RetxClock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+
+    /* the sender is still answering, so only ordering reveals a loss */
+    const bool stalled = now - lastReply >
+        std::chrono::duration_cast<RetxClock::duration>(
+                std::chrono::duration<double>(rto));
+
+    for (RetxReqMap::iterator it = reqMap.begin(); it != reqMap.end();) {
+        RetxReq& req = it->second;
+        if (req.txseq + REORDER_THRESH > ackedTxseq &&
+            (req.deadline > now || !stalled)) {
+            ++it;
+        }
+        else if (req.retries >= maxRetries) {
+            giveup.push_back(req);
+            it = reqMap.erase(it);
+        }
+        else {
+            ++req.retries;
+            req.txseq    = ++nextTxseq;
+            const double timeout = std::min(MAX_RTO,
+                                            rto * (1u << req.retries));
+            req.sent     = now;
+            req.deadline = now +
+                std::chrono::duration_cast<RetxClock::duration>(
+                        std::chrono::duration<double>(timeout));
+            resend.push_back(req);
+            ++it;
+        }
+    }
+}
+
+
+/**
+ * Returns the current retransmission timeout.
+ *
+ * @return  Retransmission timeout in seconds.
+ */
+double RetxReqTracker::getRTO()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return rto;
+}
+
+
+/**
+ * Removes all the outstanding requests of a product. Called when the product
+ * is completed or abandoned.
+ *
+ * @param[in] prodindex   Product index.
+ */
+void RetxReqTracker::rmProd(const uint32_t prodindex)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    RetxReqMap::iterator it = reqMap.lower_bound(std::make_pair(prodindex, 0u));
+    while (it != reqMap.end() && it->first.first == prodindex)
+        it = reqMap.erase(it);
+}
+
+
+/**
+ * Marks the request for a block as satisfied and takes a round-trip time
+ * sample if the request was never resent.
+ *
+ * @param[in] prodindex   Product index of the received block.
+ * @param[in] seqnum      Sequence number of the received block.
+ * @return                True if the block was outstanding.
+ */
+bool RetxReqTracker::satisfy(const uint32_t prodindex, const uint32_t seqnum)
+{
+    RetxClock::time_point now = RetxClock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+
+    RetxReqMap::iterator it = reqMap.find(std::make_pair(prodindex, seqnum));
+    if (it == reqMap.end())
+        return false;
+
+    lastReply = now;
+    /*
+     * a reply to a resent request might answer an earlier transmission, so
+     * neither ordering nor timing can be taken from it.
+     */
+    if (it->second.retries == 0) {
+        if (it->second.txseq > ackedTxseq)
+            ackedTxseq = it->second.txseq;
+        sampleRTT(std::chrono::duration_cast<std::chrono::duration<double>>(
+                  now - it->second.sent).count());
+    }
+    reqMap.erase(it);
+    return true;
+}
+
+
+/**
+ * Seeds the estimator with an externally measured round-trip time, e.g. the
+ * one of the TCP connection to the same sender.
+ *
+ * @param[in] rtt  Round-trip time in seconds. Ignored if not positive.
+ */
+void RetxReqTracker::setRTT(const double rtt)
+{
+    if (rtt <= 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    srtt   = rtt;
+    rttvar = rtt / 2;
+    rto    = std::max(MIN_RTO, std::min(MAX_RTO, srtt + 4 * rttvar));
+}
+
+
+/**
+ * Updates the estimator with a round-trip time sample. The caller must hold
+ * the mutex.
+ *
+ * @param[in] rtt  Round-trip time sample in seconds.
+ */
+void RetxReqTracker::sampleRTT(const double rtt)
+{
+    if (srtt == 0) {
+        srtt   = rtt;
+        rttvar = rtt / 2;
+    }
+    else {
+        rttvar = 0.75 * rttvar + 0.25 * (srtt > rtt ? srtt - rtt : rtt - srtt);
+        srtt   = 0.875 * srtt + 0.125 * rtt;
+    }
+    rto = std::max(MIN_RTO, std::min(MAX_RTO, srtt + 4 * rttvar));
+}
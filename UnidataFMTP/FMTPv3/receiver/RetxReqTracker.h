@@ -0,0 +1,101 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      RetxReqTracker.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of RetxReqTracker class.
+ *
+ * Tracks the outstanding datagram retransmission requests of a receiver.
+ * The sender serves requests in the order they arrive, so a request is
+ * considered lost as soon as the replies to several later requests have
+ * arrived. A timer derived from a smoothed round-trip time estimate catches
+ * the remaining losses once replies stop arriving. A lost request is sent
+ * again with a doubled timeout until its retries are used up.
+ */
+
+
+#ifndef FMTP_RECEIVER_RETXREQTRACKER_H_
+#define FMTP_RECEIVER_RETXREQTRACKER_H_
+
+
+#include <stdint.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+
+typedef std::chrono::steady_clock RetxClock;
+
+/* an outstanding request for a single data block */
+struct RetxReq {
+    uint32_t              prodindex;
+    uint32_t              seqnum;
+    uint16_t              payloadlen;
+    unsigned              retries;   /*!< times the request has been resent */
+    uint64_t              txseq;     /*!< order of the latest transmission */
+    RetxClock::time_point sent;      /*!< time of the latest transmission */
+    RetxClock::time_point deadline;  /*!< time the request is considered lost */
+};
+
+/* maps (prodindex, seqnum) to the outstanding request */
+typedef std::map<std::pair<uint32_t, uint32_t>, RetxReq> RetxReqMap;
+
+
+class RetxReqTracker
+{
+public:
+    /**
+     * Constructs.
+     *
+     * @param[in] maxRetries  Number of times a request is resent before it's
+     *                        given up on.
+     */
+    RetxReqTracker(const unsigned maxRetries = 3);
+    ~RetxReqTracker();
+    bool     add(const uint32_t prodindex, const uint32_t seqnum,
+                 const uint16_t payloadlen);
+    void     expire(std::vector<RetxReq>& resend,
+                    std::vector<RetxReq>& giveup);
+    double   getRTO();
+    void     rmProd(const uint32_t prodindex);
+    bool     satisfy(const uint32_t prodindex, const uint32_t seqnum);
+    void     setRTT(const double rtt);
+
+private:
+    void     sampleRTT(const double rtt);
+
+    RetxReqMap   reqMap;
+    /* smoothed round-trip time and its variation in seconds */
+    double       srtt;
+    double       rttvar;
+    /* retransmission timeout in seconds */
+    double       rto;
+    /* order of the next transmission */
+    uint64_t     nextTxseq;
+    /* latest transmission whose reply has arrived */
+    uint64_t     ackedTxseq;
+    /* time the latest reply arrived */
+    RetxClock::time_point lastReply;
+    unsigned     maxRetries;
+    std::mutex   mutex;
+};
+
+
+#endif /* FMTP_RECEIVER_RETXREQTRACKER_H_ */
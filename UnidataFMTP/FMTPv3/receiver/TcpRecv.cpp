@@ -32,12 +32,14 @@
 
 #include <errno.h>
 #include <netdb.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
 #include <unistd.h>
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <system_error>
 
 
 TcpRecv::TcpRecv(
@@ -139,13 +141,57 @@ size_t TcpRecv::recvData(void* header, size_t headLen, char* payload,
 ssize_t TcpRecv::sendData(void* header, size_t headLen, char* payload,
                           size_t payLen)
 {
-    sendall(header, headLen);
-    sendall(payload, payLen);
+    std::unique_lock<std::mutex> lock(sendMtx);
+    try {
+        sendall(header, headLen);
+        sendall(payload, payLen);
+    }
+    catch (const std::system_error& e) {
+        return -1;
+    }
 
     return (headLen + payLen);
 }
 
 
+/**
+ * Replaces a broken TCP connection with a new one. The old connection is shut
+ * down first so that a thread blocked sending on it returns, and it's closed
+ * while sending is locked out so that no packet goes to the wrong socket.
+ * Blocks until the new connection is established or a severe error occurs.
+ *
+ * @param[in] none
+ * @throws std::system_error  if the new connection can't be established.
+ */
+void TcpRecv::reconnect()
+{
+    (void)shutdown(sockfd, SHUT_RDWR);
+
+    std::unique_lock<std::mutex> lock(sendMtx);
+    (void)close(sockfd);
+    sockfd = -1;
+    initSocket();
+}
+
+
+/**
+ * Returns the smoothed round-trip time that the kernel maintains for the TCP
+ * connection. Used to seed the timers of datagram retransmission requests.
+ *
+ * @return  Round-trip time in seconds or 0 if it can't be obtained.
+ */
+double TcpRecv::getRTT()
+{
+    struct tcp_info info;
+    socklen_t       len = sizeof(info);
+
+    if (getsockopt(sockfd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0)
+        return 0;
+
+    return info.tcpi_rtt / 1e6;
+}
+
+
 /**
  * Initializes the TCP connection. Blocks until the connection is established
  * or a severe error occurs.
@@ -175,16 +221,20 @@ void TcpRecv::initSocket()
         addr.sin_port = 0;            // Don't care about port number
         if (bind(sockfd, reinterpret_cast<struct sockaddr*>(&addr),
                 sizeof(addr))) {
+            const int err = errno;
             close(sockfd);
-            throw std::system_error(errno, std::system_category(),
+            sockfd = -1;
+            throw std::system_error(err, std::system_category(),
                     "TcpRecv:initSocket() Couldn't bind socket to interface " +
                     addr);
         }
     }
 
     if (connect(sockfd, (struct sockaddr*)&servAddr, sizeof(servAddr))) {
+        const int err = errno;
         close(sockfd);
-        throw std::system_error(errno, std::system_category(),
+        sockfd = -1;
+        throw std::system_error(err, std::system_category(),
                 "TcpRecv::initSocket() Error connecting to " + servAddr);
     }
 #if 0
@@ -70,8 +70,9 @@ public:
      */
     TcpRecv(const std::string& tcpaddr,
             unsigned short     tcpport);
+    virtual ~TcpRecv() {}
 
-    void Init();  /*!< the start point which upper layer should call */
+    virtual void Init();  /*!< the start point which upper layer should call */
     /**
      * Receives a header and a payload on the TCP connection. Blocks until the
      * packet is received or a severe error occurs. Re-establishes the TCP
@@ -98,8 +99,27 @@ public:
      * @retval    -1       O/S failure.
      * @return             Number of bytes sent.
      */
-    ssize_t sendData(void* header, size_t headLen, char* payload,
-                     size_t payLen);
+    virtual ssize_t sendData(void* header, size_t headLen, char* payload,
+                             size_t payLen);
+    /**
+     * Replaces a broken TCP connection with a new one to the same server.
+     *
+     * @throws std::system_error  if the new connection can't be established.
+     */
+    virtual void reconnect();
+    /**
+     * Returns the address of the TCP server.
+     *
+     * @return  The server address. Valid after `Init()`.
+     */
+    virtual const struct sockaddr_in& getServAddr() const {return servAddr;}
+    /**
+     * Returns the smoothed round-trip time measured by the kernel on the TCP
+     * connection.
+     *
+     * @return  Round-trip time in seconds or 0 if unknown.
+     */
+    virtual double getRTT();
 
 private:
     /**
@@ -114,6 +134,8 @@ private:
     unsigned short          tcpPort;  ///< a copy of the passed-in tcpPort
     /// Local interface to use in network byte-order
     in_addr_t               iface;
+    /// Keeps packets sent by different threads from interleaving
+    std::mutex              sendMtx;
 };
 
 
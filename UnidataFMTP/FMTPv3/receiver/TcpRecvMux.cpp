@@ -0,0 +1,551 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      TcpRecvMux.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the retransmission connection shared by receiver
+ *            sessions.
+ *
+ * One TCP connection to a SenderRuntime, demultiplexed into a stream per
+ * receiver session.
+ */
+
+
+#include "TcpRecvMux.h"
+#include "fmtpBase.h"
+#ifdef LDM_LOGGING
+#include "log.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <system_error>
+
+
+#ifndef NULL
+    #define NULL 0
+#endif
+
+
+#ifdef LDM_LOGGING
+static void freeLogging(void* arg)
+{
+    log_free();
+}
+#endif
+
+
+/**
+ * Constructs the TcpRecv of a session that shares a connection. Nothing is
+ * connected until Init() is called.
+ *
+ * @param[in] mux        The shared connection.
+ * @param[in] sessionId  Id of the sender session to receive.
+ */
+SessionTcpRecv::SessionTcpRecv(TcpRecvMux& mux, uint32_t sessionId)
+    : TcpRecv(mux.getTcpAddr(), mux.getTcpPort()), mux(mux),
+      sessionId(sessionId), gen(0)
+{
+}
+
+
+/**
+ * Leaves the shared connection. The stream of the session is closed by the
+ * base class.
+ */
+SessionTcpRecv::~SessionTcpRecv()
+{
+    mux.detach(sessionId);
+}
+
+
+/**
+ * Joins the sender session over the shared connection, which is established
+ * if it isn't yet. Blocks until the sender has accepted the session.
+ *
+ * @throw std::invalid_argument  if the address of the sender is invalid.
+ * @throw std::system_error      if the connection can't be established or is
+ *                               lost while joining.
+ * @throw std::runtime_error     if the sender refuses the session.
+ */
+void SessionTcpRecv::Init()
+{
+    uint64_t newGen = gen;
+    const int fd = mux.attach(sessionId, newGen, false);
+    (void)close(sockfd);
+    sockfd = fd;
+    gen    = newGen;
+    awaitJoin();
+}
+
+
+/**
+ * Sends a header and a payload over the shared connection, preceded by the
+ * session's FMTP_SESS_SELECT if needed.
+ *
+ * @param[in] header   Header.
+ * @param[in] headLen  Length of the header in bytes.
+ * @param[in] payload  Payload.
+ * @param[in] payLen   Length of the payload in bytes.
+ * @retval    -1       O/S failure or the connection has been replaced since
+ *                     the session joined it.
+ * @return             Number of bytes sent.
+ */
+ssize_t SessionTcpRecv::sendData(void* header, size_t headLen, char* payload,
+                                 size_t payLen)
+{
+    return mux.send(sessionId, gen, header, headLen, payload, payLen);
+}
+
+
+/**
+ * Joins the sender session again after the stream has ended. The shared
+ * connection is replaced if no other session has done so yet.
+ *
+ * @throw std::system_error   if the new connection can't be established or
+ *                            is lost while joining.
+ * @throw std::runtime_error  if the sender refuses the session.
+ */
+void SessionTcpRecv::reconnect()
+{
+    uint64_t newGen = gen;
+    const int fd = mux.attach(sessionId, newGen, true);
+    (void)close(sockfd);
+    sockfd = fd;
+    gen    = newGen;
+    awaitJoin();
+}
+
+
+/**
+ * Returns the address of the TCP server.
+ *
+ * @return  The server address. Valid after `Init()`.
+ */
+const struct sockaddr_in& SessionTcpRecv::getServAddr() const
+{
+    return mux.link.getServAddr();
+}
+
+
+/**
+ * Returns the smoothed round-trip time of the shared connection.
+ *
+ * @return  Round-trip time in seconds or 0 if it can't be obtained.
+ */
+double SessionTcpRecv::getRTT()
+{
+    return mux.link.getRTT();
+}
+
+
+/**
+ * Waits for the sender to answer the FMTP_SESS_SELECT that joins the session.
+ * The answer is the first message of the session's stream. The primary session
+ * doesn't join.
+ *
+ * @throw std::system_error   if the connection is lost.
+ * @throw std::runtime_error  if the sender refuses the session.
+ */
+void SessionTcpRecv::awaitJoin()
+{
+    if (sessionId == mux.primary)
+        return;
+
+    FmtpHeader header;
+    if (recvData(&header, sizeof(header), NULL, 0) == 0) {
+        throw std::system_error(ECONNRESET, std::system_category(),
+                "SessionTcpRecv::awaitJoin() Connection lost while joining "
+                "session " + std::to_string(sessionId));
+    }
+    if (ntohl(header.seqnum) != SESS_ACCEPTED) {
+        throw std::runtime_error("SessionTcpRecv::awaitJoin() Sender refused "
+                "session " + std::to_string(sessionId));
+    }
+}
+
+
+/**
+ * Constructs the connection's end of a session's stream.
+ *
+ * @param[in] wrfd  The file descriptor.
+ */
+TcpRecvMux::Stream::Stream(int wrfd)
+    : wrfd(wrfd), joining(false)
+{
+}
+
+
+/**
+ * Closes the connection's end of a session's stream. Done when the demux
+ * thread no longer uses it, so that the descriptor can't be reused meanwhile.
+ */
+TcpRecvMux::Stream::~Stream()
+{
+    (void)close(wrfd);
+}
+
+
+TcpRecvMux::TcpRecvMux(
+        const std::string& tcpaddr,
+        unsigned short     tcpport,
+        uint32_t           sessionId,
+        const in_addr_t    iface)
+    : tcpAddr(tcpaddr), tcpPort(tcpport), primary(sessionId),
+      link(tcpaddr, tcpport, iface), inited(false), demuxRunning(false),
+      demux_t(), linkGen(0), broken(true), rxSess(sessionId),
+      txSess(sessionId), txValid(true)
+{
+}
+
+
+TcpRecvMux::TcpRecvMux(
+        const std::string& tcpaddr,
+        unsigned short     tcpport,
+        uint32_t           sessionId)
+    : TcpRecvMux(tcpaddr, tcpport, sessionId, htonl(INADDR_ANY))
+{
+}
+
+
+/**
+ * Stops the demux thread. The connection is closed by `link`.
+ */
+TcpRecvMux::~TcpRecvMux()
+{
+    std::unique_lock<std::mutex> lock(connMtx);
+    stopDemux();
+}
+
+
+/**
+ * Attaches a session to the connection and returns the session's end of a new
+ * stream for its messages. The connection is established first if it's broken
+ * or isn't yet, or replaced if the session saw it break and no other session
+ * has replaced it since. Every other session then has to attach again, which
+ * its stream tells it by ending. A session other than the primary one joins
+ * with a FMTP_SESS_SELECT, whose answer is the first message of the stream.
+ *
+ * @param[in]     sessionId  Session id.
+ * @param[in,out] gen        Generation of the connection the session used.
+ *                           Set to that of the connection it's attached to.
+ * @param[in]     renew      Whether the connection of generation `gen` is to
+ *                           be replaced.
+ * @return                   The session's end of the stream.
+ *
+ * @throw std::invalid_argument  if the address of the sender is invalid.
+ * @throw std::system_error      if the connection can't be established.
+ * @throw std::system_error      if the stream can't be created.
+ */
+int TcpRecvMux::attach(uint32_t sessionId, uint64_t& gen, bool renew)
+{
+    std::unique_lock<std::mutex> connLock(connMtx);
+    bool connect;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        connect = broken || (renew && gen == linkGen);
+    }
+
+    if (connect) {
+        stopDemux();
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            for (auto it = streams.begin(); it != streams.end(); ++it)
+                (void)shutdown(it->second->wrfd, SHUT_WR);
+            streams.clear();
+            broken = true;
+        }
+        if (inited) {
+            link.reconnect();
+        }
+        else {
+            link.Init();
+            inited = true;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            ++linkGen;
+            rxSess  = primary;
+            txSess  = primary;
+            txValid = true;
+            broken  = false;
+        }
+        try {
+            startDemux();
+        }
+        catch (const std::system_error& e) {
+            std::unique_lock<std::mutex> lock(mtx);
+            broken = true;
+            throw;
+        }
+    }
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "TcpRecvMux::attach() Couldn't create stream of session " +
+                std::to_string(sessionId));
+    }
+    StreamPtr stream(new Stream(fds[1]));
+    stream->joining = sessionId != primary;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        streams[sessionId] = stream;
+        gen = linkGen;
+        /* the connection has broken since it was checked */
+        if (broken)
+            (void)shutdown(fds[1], SHUT_WR);
+    }
+    if (stream->joining)
+        sendSelect(sessionId);
+    return fds[0];
+}
+
+
+/**
+ * The demux thread. Reads the messages of the connection and writes each one
+ * to the stream of the session it belongs to. A FMTP_SESS_SELECT from the
+ * sender switches the session of the following messages and, if it answers a
+ * join, goes to the joining session. The messages of a session without a
+ * stream are discarded. The streams end when the connection does. Writing to
+ * a stream blocks while the session is behind, which holds up the other
+ * sessions like it would on a connection of their own.
+ */
+void TcpRecvMux::demux()
+{
+    char msg[FMTP_HEADER_LEN + UINT16_MAX];
+    int  ignoredState;
+
+    /* canceled only while it waits */
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &ignoredState);
+    for (;;) {
+        FmtpHeader header;
+        uint16_t   paylen = 0;
+        size_t     nbytes;
+
+        (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ignoredState);
+        try {
+            nbytes = link.recvData(msg, FMTP_HEADER_LEN, NULL, 0);
+            if (nbytes) {
+                (void)memcpy(&header, msg, FMTP_HEADER_LEN);
+                paylen = ntohs(header.payloadlen);
+                if (paylen)
+                    nbytes = link.recvData(NULL, 0, msg + FMTP_HEADER_LEN,
+                                           paylen);
+            }
+        }
+        catch (const std::system_error& e) {
+            nbytes = 0;
+        }
+        (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &ignoredState);
+        if (nbytes == 0)
+            break;
+
+        StreamPtr stream;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if (ntohs(header.flags) == FMTP_SESS_SELECT) {
+                const uint32_t sessionId = ntohl(header.prodindex);
+                auto it = streams.find(sessionId);
+                if (it != streams.end() && it->second->joining) {
+                    it->second->joining = false;
+                    stream = it->second;
+                }
+                if (ntohl(header.seqnum) == SESS_ACCEPTED) {
+                    rxSess = sessionId;
+                }
+                else if (txValid && txSess == sessionId) {
+                    /* the sender ignores messages until the next selection */
+                    txValid = false;
+                }
+            }
+            else {
+                auto it = streams.find(rxSess);
+                if (it != streams.end() && !it->second->joining)
+                    stream = it->second;
+            }
+        }
+
+        if (stream) {
+            (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ignoredState);
+            forward(stream, msg, FMTP_HEADER_LEN + paylen);
+            (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,
+                                         &ignoredState);
+        }
+    }
+
+#ifdef LDM_LOGGING
+    log_notice("Shared retransmission connection to %s lost",
+            ("" + link.getServAddr()).c_str());
+#endif
+    std::unique_lock<std::mutex> lock(mtx);
+    broken = true;
+    for (auto it = streams.begin(); it != streams.end(); ++it)
+        (void)shutdown(it->second->wrfd, SHUT_WR);
+}
+
+
+/**
+ * Detaches a session. What's left of its stream is discarded.
+ *
+ * @param[in] sessionId  Session id.
+ */
+void TcpRecvMux::detach(uint32_t sessionId)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    streams.erase(sessionId);
+}
+
+
+/**
+ * Writes a message to the stream of a session. A session that has gone away
+ * doesn't get it.
+ *
+ * @param[in] stream  The stream.
+ * @param[in] msg     The message.
+ * @param[in] len     Length of the message in bytes.
+ */
+void TcpRecvMux::forward(const StreamPtr& stream, const char* msg, size_t len)
+{
+    while (len) {
+        const ssize_t nbytes = ::send(stream->wrfd, msg, len, MSG_NOSIGNAL);
+        if (nbytes < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        msg += nbytes;
+        len -= nbytes;
+    }
+}
+
+
+/**
+ * Sends a message of a session, preceded by a FMTP_SESS_SELECT of the session
+ * if the connection last carried a message of another one.
+ *
+ * @param[in] sessionId  Session id.
+ * @param[in] gen        Generation of the connection the session joined.
+ * @param[in] header     Header.
+ * @param[in] headLen    Length of the header in bytes.
+ * @param[in] payload    Payload.
+ * @param[in] payLen     Length of the payload in bytes.
+ * @retval    -1         O/S failure or the connection has been replaced.
+ * @return               Number of bytes of the message.
+ */
+ssize_t TcpRecvMux::send(uint32_t sessionId, uint64_t gen, void* header,
+                         size_t headLen, char* payload, size_t payLen)
+{
+    std::unique_lock<std::mutex> sendLock(sendMtx);
+    bool select;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (broken || gen != linkGen)
+            return -1;
+        select  = !txValid || txSess != sessionId;
+        txSess  = sessionId;
+        txValid = true;
+    }
+    if (select) {
+        FmtpHeader selheader;
+        selheader.prodindex  = htonl(sessionId);
+        selheader.seqnum     = htonl(SESS_ACCEPTED);
+        selheader.payloadlen = 0;
+        selheader.flags      = htons(FMTP_SESS_SELECT);
+        if (link.sendData(&selheader, sizeof(selheader), NULL, 0) < 0)
+            return -1;
+    }
+    return link.sendData(header, headLen, payload, payLen);
+}
+
+
+/**
+ * Sends the FMTP_SESS_SELECT that joins a session. A failure shows as the end
+ * of the session's stream, since the demux thread sees the connection break.
+ *
+ * @param[in] sessionId  Session id.
+ */
+void TcpRecvMux::sendSelect(uint32_t sessionId)
+{
+    std::unique_lock<std::mutex> sendLock(sendMtx);
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        txSess  = sessionId;
+        txValid = true;
+    }
+    FmtpHeader header;
+    header.prodindex  = htonl(sessionId);
+    header.seqnum     = htonl(SESS_ACCEPTED);
+    header.payloadlen = 0;
+    header.flags      = htons(FMTP_SESS_SELECT);
+    (void)link.sendData(&header, sizeof(header), NULL, 0);
+}
+
+
+/**
+ * Starts the demux thread. Must be called with `connMtx` locked.
+ *
+ * @throw std::system_error  if the thread can't be created.
+ */
+void TcpRecvMux::startDemux()
+{
+    int status = pthread_create(&demux_t, NULL, &TcpRecvMux::StartDemux, this);
+    if (status) {
+        throw std::system_error(status, std::system_category(),
+                "TcpRecvMux::startDemux() Couldn't start demux thread");
+    }
+    demuxRunning = true;
+}
+
+
+/**
+ * Stops the demux thread, if it's running, and waits for it. Must be called
+ * with `connMtx` locked.
+ */
+void TcpRecvMux::stopDemux()
+{
+    if (!demuxRunning)
+        return;
+    (void)pthread_cancel(demux_t);
+    (void)pthread_join(demux_t, NULL);
+    demuxRunning = false;
+}
+
+
+/**
+ * Executes the demux thread.
+ *
+ * Called by `::pthread_create()`.
+ *
+ * @param[in,out] ptr   Pointer to the `TcpRecvMux` instance
+ * @retval        NULL  Always
+ */
+void* TcpRecvMux::StartDemux(void* ptr)
+{
+#ifdef LDM_LOGGING
+    pthread_cleanup_push(freeLogging, nullptr);
+#endif
+    static_cast<TcpRecvMux*>(ptr)->demux();
+#ifdef LDM_LOGGING
+    pthread_cleanup_pop(true);
+#endif
+    return NULL;
+}
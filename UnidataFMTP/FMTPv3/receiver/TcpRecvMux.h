@@ -0,0 +1,177 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      TcpRecvMux.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of the retransmission connection shared by
+ *            receiver sessions.
+ *
+ * The sessions of a SenderRuntime can serve a receiver over one TCP
+ * connection. A TcpRecvMux is that connection on the receiving side: it
+ * connects to one session of the sender, its primary one, and the other
+ * sessions join with FMTP_SESS_SELECT. A thread reads the connection and hands
+ * each message to the stream of the session it belongs to; outgoing messages
+ * are preceded by the session's FMTP_SESS_SELECT when needed. Each fmtpRecvv3
+ * constructed with the TcpRecvMux uses a SessionTcpRecv, which reads its
+ * stream like a TCP connection of its own.
+ */
+
+
+#ifndef FMTP_RECEIVER_TCPRECVMUX_H_
+#define FMTP_RECEIVER_TCPRECVMUX_H_
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "TcpRecv.h"
+
+
+class TcpRecvMux;
+
+
+/**
+ * The TcpRecv of a receiver session that shares a TcpRecvMux. Its socket is
+ * the session's end of a stream that carries only the messages of the session.
+ */
+class SessionTcpRecv : public TcpRecv
+{
+public:
+    SessionTcpRecv(TcpRecvMux& mux, uint32_t sessionId);
+    ~SessionTcpRecv();
+
+    void Init();
+    ssize_t sendData(void* header, size_t headLen, char* payload,
+                     size_t payLen);
+    void reconnect();
+    const struct sockaddr_in& getServAddr() const;
+    double getRTT();
+
+private:
+    void awaitJoin();
+
+    TcpRecvMux&     mux;
+    const uint32_t  sessionId;
+    /** generation of the connection that the stream belongs to */
+    std::atomic<uint64_t> gen;
+};
+
+
+class TcpRecvMux
+{
+public:
+    /**
+     * Constructs. Nothing is connected until the first session is started.
+     *
+     * @param[in] tcpaddr    The address of the TCP server: either an IPv4
+     *                       address in dotted-decimal format or an Internet
+     *                       host name.
+     * @param[in] tcpport    The port number of the TCP server in host
+     *                       byte-order.
+     * @param[in] sessionId  Id of the sender session that listens on
+     *                       `tcpport`.
+     * @param[in] iface      IPv4 address of local interface to use in
+     *                       network byte-order.
+     */
+    TcpRecvMux(const std::string& tcpaddr,
+               unsigned short     tcpport,
+               uint32_t           sessionId,
+               const in_addr_t    iface);
+    /**
+     * Constructs. The IPv4 address of the local interface to use will be
+     * `htonl(INADDR_ANY)`.
+     *
+     * @param[in] tcpaddr    The address of the TCP server.
+     * @param[in] tcpport    The port number of the TCP server in host
+     *                       byte-order.
+     * @param[in] sessionId  Id of the sender session that listens on
+     *                       `tcpport`.
+     */
+    TcpRecvMux(const std::string& tcpaddr,
+               unsigned short     tcpport,
+               uint32_t           sessionId);
+    /** Closes the connection. The sessions must be destroyed first. */
+    ~TcpRecvMux();
+
+    /** Returns the address of the TCP server as given. */
+    const std::string& getTcpAddr() const {return tcpAddr;}
+    /** Returns the port number of the TCP server. */
+    unsigned short getTcpPort() const {return tcpPort;}
+
+private:
+    friend class SessionTcpRecv;
+
+    /** where the messages of a session go */
+    struct Stream {
+        /** the connection's end of the stream */
+        int   wrfd;
+        /** waits for the sender to accept the session */
+        bool  joining;
+
+        explicit Stream(int wrfd);
+        ~Stream();
+    };
+    typedef std::shared_ptr<Stream> StreamPtr;
+
+    int attach(uint32_t sessionId, uint64_t& gen, bool renew);
+    void demux();
+    void detach(uint32_t sessionId);
+    void forward(const StreamPtr& stream, const char* msg, size_t len);
+    ssize_t send(uint32_t sessionId, uint64_t gen, void* header,
+                 size_t headLen, char* payload, size_t payLen);
+    void sendSelect(uint32_t sessionId);
+    void startDemux();
+    void stopDemux();
+    static void* StartDemux(void* ptr);
+    /* Prevent copying because it's meaningless */
+    TcpRecvMux(TcpRecvMux&);
+    TcpRecvMux& operator=(const TcpRecvMux&);
+
+    const std::string                tcpAddr;
+    const unsigned short             tcpPort;
+    /** the session the connection belongs to without a selection */
+    const uint32_t                   primary;
+    /** the connection itself */
+    TcpRecv                          link;
+    /** serializes connecting and reconnecting */
+    std::mutex                       connMtx;
+    bool                             inited;
+    bool                             demuxRunning;
+    pthread_t                        demux_t;
+    /** keeps the messages of different sessions apart */
+    std::mutex                       sendMtx;
+    /** protects everything below */
+    std::mutex                       mtx;
+    /** incremented whenever the connection is replaced */
+    uint64_t                         linkGen;
+    bool                             broken;
+    std::map<uint32_t, StreamPtr>    streams;
+    /** session of incoming messages */
+    uint32_t                         rxSess;
+    /** session of outgoing messages, if `txValid` */
+    uint32_t                         txSess;
+    bool                             txValid;
+};
+
+
+#endif /* FMTP_RECEIVER_TCPRECVMUX_H_ */
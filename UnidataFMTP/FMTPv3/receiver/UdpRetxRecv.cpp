@@ -0,0 +1,184 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      UdpRetxRecv.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the interfaces of receiver side UDP repair channel.
+ *
+ * Encapsulation of the unicast UDP socket used for datagram retransmission.
+ */
+
+
+#include "UdpRetxRecv.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <system_error>
+
+
+/**
+ * Constructor, sets the local interface to bind to.
+ *
+ * @param[in] ifAddr    IPv4 address of the local interface.
+ */
+UdpRetxRecv::UdpRetxRecv(const std::string& ifAddr)
+    : sockfd(-1), ifAddr(ifAddr)
+{
+}
+
+
+/**
+ * Destructs the UdpRetxRecv instance and closes the socket.
+ *
+ * @param[in] none
+ */
+UdpRetxRecv::~UdpRetxRecv()
+{
+    if (sockfd >= 0)
+        (void)close(sockfd);
+}
+
+
+/**
+ * Initializer. Creates the UDP socket and binds it to an ephemeral port on the
+ * local interface.
+ *
+ * @throws std::system_error  if the socket cannot be created.
+ * @throws std::system_error  if the local address is invalid.
+ * @throws std::system_error  if the socket cannot be bound.
+ */
+void UdpRetxRecv::Init()
+{
+    if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxRecv::Init() Couldn't create UDP socket");
+    }
+
+    struct sockaddr_in addr;
+    (void) memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(ifAddr.c_str());
+    addr.sin_port        = 0;
+    if (addr.sin_addr.s_addr == (in_addr_t)(-1)) {
+        throw std::system_error(EINVAL, std::system_category(),
+                "UdpRetxRecv::Init() Invalid interface: " + ifAddr);
+    }
+
+    if (::bind(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxRecv::Init() Couldn't bind to " + ifAddr);
+    }
+
+    /* best effort, the kernel caps the size at net.core.rmem_max */
+    int bufsize = UDP_RETX_BUFSIZE;
+    (void)setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+}
+
+
+/**
+ * Returns the local port number.
+ *
+ * @return                   The local port number in host byte-order.
+ * @throw std::system_error  The port number cannot be obtained.
+ */
+unsigned short UdpRetxRecv::getPortNum()
+{
+    struct sockaddr_in tmpAddr;
+    socklen_t          tmpAddrLen = sizeof(tmpAddr);
+
+    if (getsockname(sockfd, (struct sockaddr*)&tmpAddr, &tmpAddrLen) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxRecv::getPortNum() error getting port number");
+    }
+
+    return ntohs(tmpAddr.sin_port);
+}
+
+
+/**
+ * Connects the socket to the sender's repair address. Afterwards, only
+ * datagrams from that address are received.
+ *
+ * @param[in] peer             Sender's UDP repair address.
+ * @throws std::system_error   if connect() fails.
+ */
+void UdpRetxRecv::setPeer(const struct sockaddr_in& peer)
+{
+    if (connect(sockfd, (const struct sockaddr*)&peer, sizeof(peer)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxRecv::setPeer() Couldn't connect to sender");
+    }
+}
+
+
+/**
+ * Sends a datagram to the sender.
+ *
+ * @param[in] buf              Datagram.
+ * @param[in] len              Size of the datagram in bytes.
+ * @throws std::system_error   if send() fails.
+ */
+void UdpRetxRecv::send(const void* buf, size_t len)
+{
+    if (::send(sockfd, buf, len, 0) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxRecv::send() error occurred when calling send()");
+    }
+}
+
+
+/**
+ * Receives a datagram from the sender. Blocks until one arrives or the
+ * timeout expires. An ICMP error reported on the connected socket is treated
+ * like a timeout, since the caller retries lost requests anyway.
+ *
+ * @param[out] buf             Buffer to hold the datagram.
+ * @param[in]  len             Size of the buffer in bytes.
+ * @param[in]  timeoutMs       Timeout in milliseconds.
+ * @retval     0               Timeout.
+ * @return                     Size of the datagram in bytes.
+ * @throws std::system_error   if poll() or recv() fails.
+ */
+ssize_t UdpRetxRecv::recv(void* buf, size_t len, int timeoutMs)
+{
+    struct pollfd pfd;
+    pfd.fd     = sockfd;
+    pfd.events = POLLIN;
+
+    int status = poll(&pfd, 1, timeoutMs);
+    if (status < 0) {
+        if (errno == EINTR)
+            return 0;
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxRecv::recv() error occurred when calling poll()");
+    }
+    if (status == 0)
+        return 0;
+
+    ssize_t nbytes = ::recv(sockfd, buf, len, 0);
+    if (nbytes < 0) {
+        if (errno == ECONNREFUSED || errno == EINTR)
+            return 0;
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxRecv::recv() error occurred when calling recv()");
+    }
+    return nbytes;
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      UdpRetxRecv.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of receiver side UDP repair channel.
+ *
+ * The UdpRetxRecv class owns the unicast UDP socket on which the receiver
+ * sends datagram retransmission requests and receives repair datagrams. Once
+ * the sender's repair address is known, the socket is connected to it so that
+ * datagrams from any other source are discarded by the kernel.
+ */
+
+
+#ifndef FMTP_RECEIVER_UDPRETXRECV_H_
+#define FMTP_RECEIVER_UDPRETXRECV_H_
+
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <string>
+
+#include "fmtpBase.h"
+
+
+class UdpRetxRecv {
+public:
+    /**
+     * Constructs.
+     *
+     * @param[in] ifAddr  IPv4 address of the local interface to bind to.
+     */
+    UdpRetxRecv(const std::string& ifAddr);
+    ~UdpRetxRecv();
+
+    void Init();  /*!< start point which caller should call */
+    unsigned short getPortNum();
+    /**
+     * Connects the socket to the sender's repair address.
+     *
+     * @param[in] peer  Sender's UDP repair address.
+     */
+    void setPeer(const struct sockaddr_in& peer);
+    /**
+     * Sends a datagram to the sender.
+     *
+     * @param[in] buf  Datagram.
+     * @param[in] len  Size of the datagram in bytes.
+     */
+    void send(const void* buf, size_t len);
+    /**
+     * Receives a datagram from the sender. Blocks until one arrives or the
+     * timeout expires.
+     *
+     * @param[out] buf        Buffer to hold the datagram.
+     * @param[in]  len        Size of the buffer in bytes.
+     * @param[in]  timeoutMs  Timeout in milliseconds.
+     * @retval     0          Timeout.
+     * @return                Size of the datagram in bytes.
+     */
+    ssize_t recv(void* buf, size_t len, int timeoutMs);
+
+private:
+    int                   sockfd;
+    const std::string     ifAddr;
+};
+
+
+#endif /* FMTP_RECEIVER_UDPRETXRECV_H_ */
@@ -0,0 +1,579 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      XdpRecv.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the AF_XDP multicast receiver.
+ *
+ * Encapsulation of the AF_XDP sockets, their UMEMs and the XDP program that
+ * feeds them.
+ */
+
+
+#include "XdpRecv.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <ifaddrs.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <system_error>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+
+/* Ethernet, IPv4 without options and UDP headers */
+static const int XDP_HDRS_LEN = ETH_HLEN + 20 + 8;
+
+
+/**
+ * Makes an eBPF instruction.
+ */
+static struct bpf_insn bpfInsn(const uint8_t code, const uint8_t dst,
+                               const uint8_t src, const int16_t off,
+                               const int32_t imm)
+{
+    struct bpf_insn insn;
+    insn.code    = code;
+    insn.dst_reg = dst;
+    insn.src_reg = src;
+    insn.off     = off;
+    insn.imm     = imm;
+    return insn;
+}
+
+
+/**
+ * Calls bpf(2).
+ */
+static int sysBpf(const int cmd, union bpf_attr* const attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+
+/**
+ * Constructor, sets the local interface to receive on.
+ *
+ * @param[in] ifAddr    IPv4 address of the local interface.
+ */
+XdpRecv::XdpRecv(const std::string& ifAddr)
+    : ifAddr(ifAddr), mapfd(-1), progfd(-1), linkfd(-1), native(false),
+      nextQueue(0)
+{
+}
+
+
+/**
+ * Destructs the XdpRecv instance. Detaches the program by closing its link
+ * and releases the sockets and their memory.
+ *
+ * @param[in] none
+ */
+XdpRecv::~XdpRecv()
+{
+    if (linkfd >= 0)
+        (void)close(linkfd);
+    if (progfd >= 0)
+        (void)close(progfd);
+    if (mapfd >= 0)
+        (void)close(mapfd);
+    for (size_t i = 0; i < queues.size(); i++) {
+        XdpQueue& queue = queues[i];
+        XdpRing* const rings[] = {&queue.fill, &queue.comp, &queue.rx};
+        for (int j = 0; j < 3; j++) {
+            if (rings[j]->map)
+                (void)munmap(rings[j]->map, rings[j]->mapSize);
+        }
+        if (queue.sockfd >= 0)
+            (void)close(queue.sockfd);
+        if (queue.umem)
+            (void)munmap(queue.umem, (size_t)XDP_NUM_FRAMES * XDP_FRAME_SIZE);
+    }
+}
+
+
+/**
+ * Initializer. Creates the socket map, loads the program and attaches it to
+ * the interface, then opens a socket for every receive queue and enters it
+ * in the map. Until a queue's socket is in the map, the program passes its
+ * packets to the stack.
+ *
+ * @param[in] srcAddr          IPv4 address of the multicast source.
+ * @param[in] mcastAddr        IPv4 address of the multicast group.
+ * @param[in] mcastPort        Port number of the multicast group.
+ * @throws std::system_error   if the interface isn't found.
+ * @throws std::system_error   if the map or the program cannot be created.
+ * @throws std::system_error   if the program cannot be attached.
+ * @throws std::system_error   if a socket cannot be set up.
+ */
+void XdpRecv::Init(const std::string& srcAddr, const std::string& mcastAddr,
+                   const unsigned short mcastPort)
+{
+    std::string    ifName;
+    const int      ifindex = getIfIndex(ifName);
+    const unsigned nqueues = getNumQueues(ifName);
+
+    union bpf_attr attr;
+    (void)memset(&attr, 0, sizeof(attr));
+    attr.map_type    = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size    = sizeof(uint32_t);
+    attr.value_size  = sizeof(int);
+    attr.max_entries = nqueues;
+    if ((mapfd = sysBpf(BPF_MAP_CREATE, &attr)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::Init() Couldn't create socket map");
+    }
+
+    loadProg(inet_addr(srcAddr.c_str()), inet_addr(mcastAddr.c_str()),
+             mcastPort);
+    attachProg(ifindex);
+
+    queues.resize(nqueues);
+    for (unsigned i = 0; i < nqueues; i++) {
+        openQueue(queues[i], ifindex, i);
+
+        (void)memset(&attr, 0, sizeof(attr));
+        uint32_t key   = i;
+        int      value = queues[i].sockfd;
+        attr.map_fd = mapfd;
+        attr.key    = (uint64_t)(uintptr_t)&key;
+        attr.value  = (uint64_t)(uintptr_t)&value;
+        if (sysBpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+            throw std::system_error(errno, std::system_category(),
+                    "XdpRecv::Init() Couldn't add socket of queue " +
+                    std::to_string(i) + " to map");
+        }
+    }
+}
+
+
+/**
+ * Receives UDP payloads from the sockets. Blocks until at least one is
+ * available. The frames that the previous call returned payloads from are
+ * handed back to the kernel first. The queues are read round-robin so that
+ * a busy queue can't starve the others.
+ *
+ * @param[out] pkts            Start and length of each payload. The length
+ *                             is the one in the UDP header.
+ * @param[in]  maxpkts         Maximum number of payloads.
+ * @return                     Number of payloads.
+ * @throws std::system_error   if poll() fails.
+ */
+int XdpRecv::recv(struct iovec* pkts, const int maxpkts)
+{
+    for (size_t i = 0; i < queues.size(); i++)
+        refill(queues[i]);
+
+    int npkts = 0;
+    while (npkts == 0) {
+        for (size_t i = 0; i < queues.size() && npkts < maxpkts; i++) {
+            XdpQueue& queue = queues[(nextQueue + i) % queues.size()];
+            npkts += recvQueue(queue, pkts + npkts, maxpkts - npkts);
+        }
+        nextQueue = (nextQueue + 1) % queues.size();
+        if (npkts == 0)
+            waitQueues();
+    }
+    return npkts;
+}
+
+
+/**
+ * Attaches the program to the interface through a BPF link, so it's
+ * detached when the link is closed. Native mode is tried first.
+ *
+ * @param[in] ifindex          Index of the interface.
+ * @throws std::system_error   if the program cannot be attached in either
+ *                             mode.
+ */
+void XdpRecv::attachProg(const int ifindex)
+{
+    const uint32_t modes[] = {XDP_FLAGS_DRV_MODE, XDP_FLAGS_SKB_MODE};
+
+    for (int i = 0; i < 2 && linkfd < 0; i++) {
+        union bpf_attr attr;
+        (void)memset(&attr, 0, sizeof(attr));
+        attr.link_create.prog_fd        = progfd;
+        attr.link_create.target_ifindex = ifindex;
+        attr.link_create.attach_type    = BPF_XDP;
+        attr.link_create.flags          = modes[i];
+        linkfd = sysBpf(BPF_LINK_CREATE, &attr);
+        native = modes[i] == XDP_FLAGS_DRV_MODE;
+    }
+    if (linkfd < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::attachProg() Couldn't attach XDP program to "
+                "interface of " + ifAddr);
+    }
+}
+
+
+/**
+ * Returns the index and name of the interface that has the local address.
+ *
+ * @param[out] ifName          Name of the interface.
+ * @return                     Index of the interface.
+ * @throws std::system_error   if the interfaces cannot be listed.
+ * @throws std::system_error   if no interface has the address.
+ */
+int XdpRecv::getIfIndex(std::string& ifName)
+{
+    const in_addr_t addr = inet_addr(ifAddr.c_str());
+
+    struct ifaddrs* ifas;
+    if (getifaddrs(&ifas) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::getIfIndex() Couldn't list interfaces");
+    }
+    int index = 0;
+    for (struct ifaddrs* ifa = ifas; ifa && !index; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_INET &&
+                ((struct sockaddr_in*)ifa->ifa_addr)->sin_addr.s_addr ==
+                addr) {
+            index  = if_nametoindex(ifa->ifa_name);
+            ifName = ifa->ifa_name;
+        }
+    }
+    freeifaddrs(ifas);
+    if (index == 0) {
+        throw std::system_error(ENODEV, std::system_category(),
+                "XdpRecv::getIfIndex() No interface has " + ifAddr);
+    }
+    return index;
+}
+
+
+/**
+ * Returns the number of receive queues of the interface.
+ *
+ * @param[in] ifName           Name of the interface.
+ * @return                     Number of receive queues, at least 1.
+ */
+unsigned XdpRecv::getNumQueues(const std::string& ifName)
+{
+    const std::string path = "/sys/class/net/" + ifName + "/queues";
+    unsigned          nqueues = 0;
+
+    DIR* const dir = opendir(path.c_str());
+    if (dir) {
+        for (struct dirent* ent; (ent = readdir(dir)) != NULL; ) {
+            if (strncmp(ent->d_name, "rx-", 3) == 0)
+                nqueues++;
+        }
+        (void)closedir(dir);
+    }
+    return nqueues ? nqueues : 1;
+}
+
+
+/**
+ * Loads the XDP program. It redirects unfragmented UDP datagrams without IP
+ * options from the source to the group and port to the socket of the queue
+ * they arrived on, and passes everything else, including the datagrams of a
+ * queue without a socket, to the stack. The packet fields are compared in
+ * network byte order, 32 bits wide.
+ *
+ * @param[in] srcAddr          IPv4 address of the source in network order.
+ * @param[in] group            IPv4 address of the group in network order.
+ * @param[in] port             Port number in host order.
+ * @throws std::system_error   if the kernel rejects the program.
+ */
+void XdpRecv::loadProg(const uint32_t srcAddr, const uint32_t group,
+                       const unsigned short port)
+{
+    const uint8_t ldxB  = BPF_LDX | BPF_MEM | BPF_B;
+    const uint8_t ldxH  = BPF_LDX | BPF_MEM | BPF_H;
+    const uint8_t ldxW  = BPF_LDX | BPF_MEM | BPF_W;
+    const uint8_t jne32 = BPF_JMP32 | BPF_JNE | BPF_K;
+
+    /* (offset of a field from the Ethernet header, its size, its value) */
+    struct { int16_t off; uint8_t ldx; uint32_t value; } const fields[] = {
+        {12,      ldxH, htons(ETH_P_IP)},
+        {14,      ldxB, 0x45},             /* IPv4, no options */
+        {23,      ldxB, IPPROTO_UDP},
+        {26,      ldxW, srcAddr},
+        {30,      ldxW, group},
+        {36,      ldxH, htons(port)},
+    };
+
+    std::vector<struct bpf_insn> prog;
+    std::vector<size_t>          toPass;   /* jumps to the XDP_PASS exit */
+
+    /* r6 = ctx, r2 = data, r3 = data_end */
+    prog.push_back(bpfInsn(BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0));
+    prog.push_back(bpfInsn(ldxW, 2, 1, offsetof(struct xdp_md, data), 0));
+    prog.push_back(bpfInsn(ldxW, 3, 1, offsetof(struct xdp_md, data_end), 0));
+    prog.push_back(bpfInsn(BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0));
+    prog.push_back(bpfInsn(BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0,
+                           XDP_HDRS_LEN));
+    toPass.push_back(prog.size());
+    prog.push_back(bpfInsn(BPF_JMP | BPF_JGT | BPF_X, 4, 3, 0, 0));
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        prog.push_back(bpfInsn(fields[i].ldx, 5, 2, fields[i].off, 0));
+        toPass.push_back(prog.size());
+        prog.push_back(bpfInsn(jne32, 5, 0, 0, fields[i].value));
+    }
+    /* more-fragments flag or fragment offset */
+    prog.push_back(bpfInsn(ldxH, 5, 2, 20, 0));
+    prog.push_back(bpfInsn(BPF_ALU | BPF_AND | BPF_K, 5, 0, 0,
+                           htons(0x3FFF)));
+    toPass.push_back(prog.size());
+    prog.push_back(bpfInsn(jne32, 5, 0, 0, 0));
+
+    /* return bpf_redirect_map(map, ctx->rx_queue_index, XDP_PASS) */
+    prog.push_back(bpfInsn(BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD,
+                           0, mapfd));
+    prog.push_back(bpfInsn(0, 0, 0, 0, 0));
+    prog.push_back(bpfInsn(ldxW, 2, 6, offsetof(struct xdp_md,
+                                                rx_queue_index), 0));
+    prog.push_back(bpfInsn(BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS));
+    prog.push_back(bpfInsn(BPF_JMP | BPF_CALL, 0, 0, 0,
+                           BPF_FUNC_redirect_map));
+    prog.push_back(bpfInsn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+
+    const size_t pass = prog.size();
+    prog.push_back(bpfInsn(BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS));
+    prog.push_back(bpfInsn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+    for (size_t i = 0; i < toPass.size(); i++)
+        prog[toPass[i]].off = pass - (toPass[i] + 1);
+
+    static const char license[] = "GPL";
+    union bpf_attr    attr;
+    (void)memset(&attr, 0, sizeof(attr));
+    attr.prog_type            = BPF_PROG_TYPE_XDP;
+    attr.expected_attach_type = BPF_XDP;
+    attr.insns                = (uint64_t)(uintptr_t)prog.data();
+    attr.insn_cnt             = prog.size();
+    attr.license              = (uint64_t)(uintptr_t)license;
+    if ((progfd = sysBpf(BPF_PROG_LOAD, &attr)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::loadProg() Couldn't load XDP program");
+    }
+}
+
+
+/**
+ * Maps one of a socket's rings.
+ *
+ * @param[in]  sockfd          The socket.
+ * @param[out] ring            The ring.
+ * @param[in]  pgoff           Page offset that selects the ring.
+ * @param[in]  size            Number of descriptors, a power of 2.
+ * @param[in]  descSize        Size of a descriptor.
+ * @param[in]  offsets         Offsets of the ring's fields in the mapping.
+ * @throws std::system_error   if the ring cannot be mapped.
+ */
+void XdpRecv::mapRing(const int sockfd, XdpRing& ring, const uint64_t pgoff,
+                      const uint32_t size, const size_t descSize,
+                      const struct xdp_ring_offset& offsets)
+{
+    ring.mapSize = offsets.desc + size * descSize;
+    void* const addr = mmap(NULL, ring.mapSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, sockfd, pgoff);
+    if (addr == MAP_FAILED) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::mapRing() Couldn't map ring");
+    }
+    ring.map      = addr;
+    ring.producer = (uint32_t*)((char*)addr + offsets.producer);
+    ring.consumer = (uint32_t*)((char*)addr + offsets.consumer);
+    ring.descs    = (char*)addr + offsets.desc;
+    ring.mask     = size - 1;
+}
+
+
+/**
+ * Opens the socket of a receive queue. Registers a UMEM of XDP_NUM_FRAMES
+ * frames, maps its fill and completion rings and the socket's receive ring,
+ * hands every frame to the kernel and binds the socket to the queue. In
+ * generic mode the socket is bound in copy mode.
+ *
+ * @param[out] queue           The queue.
+ * @param[in]  ifindex         Index of the interface.
+ * @param[in]  queueId         Index of the queue.
+ * @throws std::system_error   if any step fails.
+ */
+void XdpRecv::openQueue(XdpQueue& queue, const int ifindex,
+                        const unsigned queueId)
+{
+    const std::string which = "of queue " + std::to_string(queueId);
+
+    if ((queue.sockfd = socket(AF_XDP, SOCK_RAW, 0)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::openQueue() Couldn't create socket " + which);
+    }
+
+    const size_t umemSize = (size_t)XDP_NUM_FRAMES * XDP_FRAME_SIZE;
+    void* const  umem = mmap(NULL, umemSize, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (umem == MAP_FAILED) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::openQueue() Couldn't allocate UMEM " + which);
+    }
+    queue.umem = (char*)umem;
+
+    struct xdp_umem_reg reg;
+    (void)memset(&reg, 0, sizeof(reg));
+    reg.addr       = (uint64_t)(uintptr_t)umem;
+    reg.len        = umemSize;
+    reg.chunk_size = XDP_FRAME_SIZE;
+    if (setsockopt(queue.sockfd, SOL_XDP, XDP_UMEM_REG, &reg,
+                   sizeof(reg)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::openQueue() Couldn't register UMEM " + which);
+    }
+
+    const int size = XDP_NUM_FRAMES;
+    if (setsockopt(queue.sockfd, SOL_XDP, XDP_UMEM_FILL_RING, &size,
+                   sizeof(size)) < 0 ||
+            setsockopt(queue.sockfd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &size,
+                       sizeof(size)) < 0 ||
+            setsockopt(queue.sockfd, SOL_XDP, XDP_RX_RING, &size,
+                       sizeof(size)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::openQueue() Couldn't size rings " + which);
+    }
+
+    struct xdp_mmap_offsets off;
+    socklen_t               optlen = sizeof(off);
+    if (getsockopt(queue.sockfd, SOL_XDP, XDP_MMAP_OFFSETS, &off,
+                   &optlen) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::openQueue() Couldn't get ring offsets " + which);
+    }
+    mapRing(queue.sockfd, queue.fill, XDP_UMEM_PGOFF_FILL_RING, size,
+            sizeof(uint64_t), off.fr);
+    mapRing(queue.sockfd, queue.comp, XDP_UMEM_PGOFF_COMPLETION_RING, size,
+            sizeof(uint64_t), off.cr);
+    mapRing(queue.sockfd, queue.rx, XDP_PGOFF_RX_RING, size,
+            sizeof(struct xdp_desc), off.rx);
+
+    queue.held.reserve(XDP_NUM_FRAMES);
+    for (unsigned i = 0; i < XDP_NUM_FRAMES; i++)
+        queue.held.push_back((uint64_t)i * XDP_FRAME_SIZE);
+    refill(queue);
+
+    struct sockaddr_xdp sxdp;
+    (void)memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family   = AF_XDP;
+    sxdp.sxdp_ifindex  = ifindex;
+    sxdp.sxdp_queue_id = queueId;
+    sxdp.sxdp_flags    = native ? 0 : XDP_COPY;
+    if (::bind(queue.sockfd, (struct sockaddr*)&sxdp, sizeof(sxdp)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::openQueue() Couldn't bind socket " + which);
+    }
+}
+
+
+/**
+ * Takes the received frames of a queue off its receive ring.
+ *
+ * @param[in]  queue           The queue.
+ * @param[out] pkts            Start and length of each payload.
+ * @param[in]  maxpkts         Maximum number of payloads.
+ * @return                     Number of payloads.
+ */
+int XdpRecv::recvQueue(XdpQueue& queue, struct iovec* pkts,
+                       const int maxpkts)
+{
+    XdpRing&       rx    = queue.rx;
+    const uint32_t cons  = *rx.consumer;
+    uint32_t       avail = __atomic_load_n(rx.producer, __ATOMIC_ACQUIRE) -
+                           cons;
+    if (avail > (uint32_t)maxpkts)
+        avail = maxpkts;
+
+    int npkts = 0;
+    for (uint32_t i = 0; i < avail; i++) {
+        const struct xdp_desc& desc =
+                ((const struct xdp_desc*)rx.descs)[(cons + i) & rx.mask];
+        char* const    frame  = queue.umem + desc.addr;
+        const uint16_t udplen = ntohs(*(const uint16_t*)(frame + ETH_HLEN +
+                                                         20 + 4));
+
+        queue.held.push_back(desc.addr & ~(uint64_t)(XDP_FRAME_SIZE - 1));
+        if (udplen < 8 || (uint32_t)ETH_HLEN + 20 + udplen > desc.len)
+            continue;
+        pkts[npkts].iov_base = frame + XDP_HDRS_LEN;
+        pkts[npkts].iov_len  = udplen - 8;
+        npkts++;
+    }
+    __atomic_store_n(rx.consumer, cons + avail, __ATOMIC_RELEASE);
+    return npkts;
+}
+
+
+/**
+ * Hands the frames that are held back to the kernel through the fill ring.
+ * There's always room, since the ring can hold every frame.
+ *
+ * @param[in] queue            The queue.
+ */
+void XdpRecv::refill(XdpQueue& queue)
+{
+    if (queue.held.empty())
+        return;
+
+    XdpRing&       fill = queue.fill;
+    const uint32_t prod = *fill.producer;
+    for (size_t i = 0; i < queue.held.size(); i++)
+        ((uint64_t*)fill.descs)[(prod + i) & fill.mask] = queue.held[i];
+    __atomic_store_n(fill.producer, prod + (uint32_t)queue.held.size(),
+                     __ATOMIC_RELEASE);
+    queue.held.clear();
+}
+
+
+/**
+ * Waits until a queue has received a frame.
+ *
+ * @param[in] none
+ * @throws std::system_error   if poll() fails.
+ */
+void XdpRecv::waitQueues()
+{
+    std::vector<struct pollfd> pfds(queues.size());
+    for (size_t i = 0; i < queues.size(); i++) {
+        pfds[i].fd      = queues[i].sockfd;
+        pfds[i].events  = POLLIN;
+        pfds[i].revents = 0;
+    }
+    if (poll(pfds.data(), pfds.size(), -1) < 0 && errno != EINTR) {
+        throw std::system_error(errno, std::system_category(),
+                "XdpRecv::waitQueues() error occurred when calling poll()");
+    }
+}
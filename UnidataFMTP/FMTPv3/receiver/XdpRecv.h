@@ -0,0 +1,133 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      XdpRecv.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of the AF_XDP multicast receiver.
+ *
+ * The XdpRecv class receives the multicast group through AF_XDP sockets, one
+ * per receive queue of the interface. A small XDP program redirects the
+ * datagrams from the source to the group and port into the sockets' UMEMs
+ * and passes all other traffic to the stack. The program is attached in
+ * native mode where the driver supports it and in generic (SKB) mode
+ * otherwise, so any interface works. Needs CAP_NET_ADMIN, CAP_NET_RAW and
+ * CAP_BPF, and Linux 5.9 or later.
+ */
+
+
+#ifndef FMTP_RECEIVER_XDPRECV_H_
+#define FMTP_RECEIVER_XDPRECV_H_
+
+
+#include <linux/if_xdp.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <string>
+#include <vector>
+
+
+/* size of a UMEM frame, holds a whole Ethernet frame plus the headroom */
+const unsigned XDP_FRAME_SIZE = 2048;
+/* number of frames in the UMEM of each queue, also the size of its rings */
+const unsigned XDP_NUM_FRAMES = 4096;
+
+
+/* a single-producer single-consumer ring shared with the kernel */
+struct XdpRing
+{
+    uint32_t* producer;
+    uint32_t* consumer;
+    void*     descs;
+    uint32_t  mask;
+    void*     map;
+    size_t    mapSize;
+};
+
+/* the socket and UMEM of a receive queue */
+struct XdpQueue
+{
+    int                   sockfd;
+    char*                 umem;
+    XdpRing               fill;
+    XdpRing               comp;
+    XdpRing               rx;
+    /* frames returned by the last recv(), refilled by the next one */
+    std::vector<uint64_t> held;
+
+    XdpQueue() : sockfd(-1), umem(NULL), fill(), comp(), rx() {}
+};
+
+
+class XdpRecv {
+public:
+    /**
+     * Constructs.
+     *
+     * @param[in] ifAddr  IPv4 address of the local interface to receive on.
+     */
+    XdpRecv(const std::string& ifAddr);
+    ~XdpRecv();
+
+    /**
+     * Creates the sockets, loads the XDP program and attaches it. Only
+     * datagrams from the source to the group and port are received.
+     *
+     * @param[in] srcAddr    IPv4 address of the multicast source.
+     * @param[in] mcastAddr  IPv4 address of the multicast group.
+     * @param[in] mcastPort  Port number of the multicast group.
+     */
+    void Init(const std::string& srcAddr, const std::string& mcastAddr,
+              const unsigned short mcastPort);
+    /**
+     * Receives UDP payloads. Blocks until at least one is available. The
+     * payloads are in the UMEM and stay valid until the next call.
+     *
+     * @param[out] pkts     Start and length of each payload.
+     * @param[in]  maxpkts  Maximum number of payloads.
+     * @return              Number of payloads.
+     */
+    int recv(struct iovec* pkts, const int maxpkts);
+
+private:
+    void          attachProg(const int ifindex);
+    int           getIfIndex(std::string& ifName);
+    unsigned      getNumQueues(const std::string& ifName);
+    void          loadProg(const uint32_t srcAddr, const uint32_t group,
+                           const unsigned short port);
+    void          mapRing(const int sockfd, XdpRing& ring,
+                          const uint64_t pgoff, const uint32_t size,
+                          const size_t descSize,
+                          const struct xdp_ring_offset& offsets);
+    void          openQueue(XdpQueue& queue, const int ifindex,
+                            const unsigned queueId);
+    int           recvQueue(XdpQueue& queue, struct iovec* pkts,
+                            const int maxpkts);
+    void          refill(XdpQueue& queue);
+    void          waitQueues();
+
+    const std::string          ifAddr;
+    std::vector<XdpQueue>      queues;
+    int                        mapfd;
+    int                        progfd;
+    int                        linkfd;
+    bool                       native;     /*!< attached in driver mode */
+    unsigned                   nextQueue;  /*!< queue to read first */
+};
+
+
+#endif /* FMTP_RECEIVER_XDPRECV_H_ */
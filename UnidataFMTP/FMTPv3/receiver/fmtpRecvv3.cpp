@@ -37,21 +37,71 @@
 #include <errno.h>
 #include <exception>
 #include <fcntl.h>
+#include <ifaddrs.h>
+#include <linux/errqueue.h>
+#include <linux/filter.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <linux/sock_diag.h>
 #include <math.h>
 #include <memory.h>
+#include <net/if.h>
 #include <netinet/in.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
+#include <algorithm>
 #include <utility>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include <system_error>
 
 #define Frcv 20
 
+/* the sender closed the retransmission connection */
+class RetxConnLost : public std::runtime_error
+{
+public:
+    explicit RetxConnLost(const std::string& what)
+        : std::runtime_error(what) {}
+};
+
+/**
+ * Tells whether an error on the retransmission connection means that the
+ * connection is gone rather than that the receiver failed.
+ *
+ * @param[in] err  The error number.
+ */
+static bool isConnError(const int err)
+{
+    return err == ECONNRESET || err == ECONNABORTED || err == EPIPE ||
+           err == ETIMEDOUT || err == ENOTCONN || err == EHOSTUNREACH ||
+           err == ENETUNREACH || err == EBADF;
+}
+
+#ifdef MEASURE
+/**
+ * Returns when a multicast packet arrived: the kernel's timestamp if there's
+ * one, otherwise the current time. HRclock counts from the Epoch like the
+ * kernel's CLOCK_REALTIME.
+ *
+ * @param[in] stamp  Timestamps of the packet, or NULL.
+ */
+static HRclock::time_point arrivalTime(const RecvStamp* const stamp)
+{
+    if (stamp == NULL || stamp->kernel == 0)
+        return HRclock::now();
+    return HRclock::time_point(std::chrono::duration_cast<HRclock::duration>(
+            std::chrono::nanoseconds(stamp->kernel)));
+}
+#endif
+
 #ifdef LDM_LOGGING
 static void freeLogging(void* arg)
 {
@@ -78,37 +128,145 @@ fmtpRecvv3::fmtpRecvv3(
     const unsigned short mcastPort,
     RecvProxy*           notifier,
     const std::string    ifAddr)
+:
+    fmtpRecvv3(new TcpRecv(tcpAddr, tcpPort, inet_addr(ifAddr.c_str())),
+               tcpAddr, tcpPort, mcastAddr, mcastPort, notifier, ifAddr)
+{
+}
+
+
+/**
+ * Constructs a receiver of one session of a SenderRuntime whose retransmission
+ * connection is shared with other sessions. The connection is established by
+ * the first session that's started.
+ *
+ * @param[in] mux           The shared retransmission connection. Must outlive
+ *                          this instance.
+ * @param[in] sessionId     Id of the sender session.
+ * @param[in] mcastAddr     UDP multicast address for receiving data products.
+ * @param[in] mcastPort     UDP multicast port for receiving data products.
+ * @param[in] notifier      Callback function to notify receiving application
+ *                          of incoming Begin-Of-Product messages.
+ * @param[in] ifAddr        IPv4 address of local interface for receiving
+ *                          multicast packets and retransmitted data-blocks.
+ */
+fmtpRecvv3::fmtpRecvv3(
+    TcpRecvMux&          mux,
+    const uint32_t       sessionId,
+    const std::string    mcastAddr,
+    const unsigned short mcastPort,
+    RecvProxy*           notifier,
+    const std::string    ifAddr)
+:
+    fmtpRecvv3(new SessionTcpRecv(mux, sessionId), mux.getTcpAddr(),
+               mux.getTcpPort(), mcastAddr, mcastPort, notifier, ifAddr)
+{
+}
+
+
+/**
+ * Constructs with a given retransmission connection.
+ *
+ * @param[in] tcprecv       The retransmission connection. Deleted by the
+ *                          instance.
+ * @param[in] tcpAddr       Sender TCP unicast address for retransmission.
+ * @param[in] tcpPort       Sender TCP unicast port for retransmission.
+ * @param[in] mcastAddr     UDP multicast address for receiving data products.
+ * @param[in] mcastPort     UDP multicast port for receiving data products.
+ * @param[in] notifier      Callback function to notify receiving application
+ *                          of incoming Begin-Of-Product messages.
+ * @param[in] ifAddr        IPv4 address of local interface for receiving
+ *                          multicast packets and retransmitted data-blocks.
+ */
+fmtpRecvv3::fmtpRecvv3(
+    TcpRecv*             tcprecv,
+    const std::string    tcpAddr,
+    const unsigned short tcpPort,
+    const std::string    mcastAddr,
+    const unsigned short mcastPort,
+    RecvProxy*           notifier,
+    const std::string    ifAddr)
 :
     tcpAddr(tcpAddr),
     tcpPort(tcpPort),
     mcastAddr(mcastAddr),
     mcastPort(mcastPort),
-    mcastgroup(),
-    prodidx_mcast(0xFFFFFFFF),
     ifAddr(ifAddr),
-    tcprecv(new TcpRecv(tcpAddr, tcpPort, inet_addr(ifAddr.c_str()))),
-    notifier(notifier),
     mcastSock(0),
     retxSock(0),
-    pSegMNG(new ProdSegMNG()),
-    msgQfilled(),
-    msgQmutex(),
-    BOPSetMtx(),
-    exitMutex(),
-    exitCond(),
-    stopRequested(false),
-    except(),
+    mcastgroup(),
+    prodidx_mcast(0xFFFFFFFF),
+    notifier(notifier),
+    tcprecv(tcprecv),
+    prodTable(new ProdStateTable()),
+    nacks(new NackScheduler(NACK_LIMIT)),
     retx_rq(),
     retx_t(),
     mcast_t(),
     timer_t(),
+    eopTimers(new EOPTimerWheel()),
+    exitMutex(),
+    exitCond(),
+    stopRequested(false),
+    except(),
     //linkspeed(0),
-    /* Coverity Scan #1: Issue #2. Initialize notifyprodidx to 0 for product index */
-    notifyprodidx(0),
-    mcastHndlrStarted(false),
     linkspeed(20000000),
+    mcastRate(new RateEstimator()),
+    eopSafety(EOP_SAFETY),
+    mcastNow(0),
+    eopDetect(new LogHist()),
     retxHandlerCanceled(ATOMIC_FLAG_INIT),
     mcastHandlerCanceled(ATOMIC_FLAG_INIT),
+    udpRetx(false),
+    udpretx(new UdpRetxRecv(ifAddr)),
+    reqTracker(new RetxReqTracker()),
+    udpRetxReady(false),
+    retxReconnect(RETX_RECONNECT_TIMEOUT),
+    retxReconnects(0),
+    udpretx_t(),
+    udpRetxHandlerCanceled(ATOMIC_FLAG_INIT),
+    unicast(false),
+    pktRing(false),
+    pktring(new PacketRingRecv(ifAddr)),
+    xdp(false),
+    xdprecv(new XdpRecv(ifAddr)),
+    mcastQueueDepth(MCAST_QUEUE_DEPTH),
+    mcastQueue(NULL),
+    rcvBufInit(0),
+    rcvBufCap(0),
+    rcvBuf(0),
+    sockDrops(0),
+    lastDropCount(0),
+    fullBatches(0),
+    recvStamps(false),
+    hwStamps(false),
+    arrivals(NULL),
+    corruptProds(0),
+    diskSink(NULL),
+    orphanBlocks(ORPHAN_POOL_BLOCKS),
+    orphans(NULL),
+    reorderPkts(0),
+    reorderNs(0),
+    mcastPkts(0),
+    reorderPending(0),
+    gapsNacked(0),
+    gapsSuppressed(0),
+    eopChecksums(true),
+    progressStep(0),
+    notifyDepth(0),
+    notifyOverflow(NOTIFY_WAIT),
+    notifyQueue(NULL),
+    notify_t(),
+    arenaMaxProd(0),
+    arenaBytesPerClass(0),
+    arenaLock(false),
+    prodArena(NULL),
+    mcastTid(0),
+    mcastrecv_t(),
+    mcastReceiverCanceled(ATOMIC_FLAG_INIT),
+    /* Coverity Scan #1: Issue #2. Initialize notifyprodidx to 0 for product index */
+    notifyprodidx(0),
+    mcastHndlrStarted(false),
     measure(new Measure())
 {
 }
@@ -122,49 +280,546 @@ fmtpRecvv3::fmtpRecvv3(
 fmtpRecvv3::~fmtpRecvv3()
 {
     Stop();
-    close(mcastSock);
+    if (mcastSock > 0)
+        (void)close(mcastSock);
     (void)close(retxSock); // failure is irrelevant
-    {
-        std::unique_lock<std::mutex> lock(BOPSetMtx);
-        misBOPset.clear();
-    }
-    {
-        std::unique_lock<std::mutex> lock(trackermtx);
-        trackermap.clear();
-    }
     delete tcprecv;
-    delete pSegMNG;
+    delete udpretx;
+    delete reqTracker;
+    delete pktring;
+    delete xdprecv;
+    delete mcastQueue;
+    delete diskSink;
+    delete prodTable;
+    delete prodArena;
+    delete orphans;
+    delete notifyQueue;
+    delete arrivals;
+    delete eopTimers;
+    delete eopDetect;
+    delete mcastRate;
+    delete nacks;
     delete measure;
 }
 
 
+/**
+ * Gets the number of multicast packets that were dropped because the handling
+ * thread fell behind by more than the depth of the multicast queue.
+ *
+ * @return    Number of dropped packets.
+ */
+uint64_t fmtpRecvv3::getMcastOverruns()
+{
+    return mcastQueue ? mcastQueue->getOverruns() : 0;
+}
+
+
+/**
+ * Gets the number of multicast packets that the kernel dropped because the
+ * receive buffer of the multicast socket was full. The count comes with the
+ * packets themselves (SO_RXQ_OVFL), so it's only updated when packets are
+ * received and doesn't cover the packet ring or AF_XDP.
+ *
+ * @return    Number of dropped packets.
+ */
+uint64_t fmtpRecvv3::getMcastSockDrops()
+{
+    return sockDrops.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * Gets the size of the receive buffer of the multicast socket, which the
+ * kernel reports as twice the size that was set to allow for its overhead.
+ *
+ * @return    Size in bytes, 0 before `Start()`.
+ */
+int fmtpRecvv3::getMcastRcvBuf()
+{
+    return rcvBuf.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * Gets the number of times the retransmission connection was re-established.
+ *
+ * @return    Number of reconnections.
+ */
+uint32_t fmtpRecvv3::getRetxReconnects()
+{
+    return retxReconnects.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * Gets the arrival rate of multicast products, measured over the packets of
+ * each product without the idle time between products.
+ *
+ * @return    Bytes per second, 0 until enough packets have arrived.
+ */
+double fmtpRecvv3::getMcastRate()
+{
+    return mcastRate->getRate();
+}
+
+
+/**
+ * Gets the histogram of how long after the last multicast packet of a
+ * product its missing EOP was detected, i.e., its deadline passed without
+ * it. Products streamed over TCP have no deadline.
+ *
+ * @param[out] latency       The histogram.
+ */
+void fmtpRecvv3::getEOPDetection(Histogram& latency)
+{
+    eopDetect->get(latency);
+}
+
+
+/**
+ * Gets the histograms of the arrival times of multicast packets.
+ *
+ * @param[out] hists     The histograms.
+ * @param[out] hardware  Whether the network card's timestamps are used for
+ *                       the gaps and spans.
+ * @return               false if receive timestamps aren't enabled.
+ */
+bool fmtpRecvv3::getArrivalStats(ArrivalHistograms& hists, bool& hardware)
+{
+    if (arrivals == NULL)
+        return false;
+    arrivals->get(hists);
+    hardware = hwStamps;
+    return true;
+}
+
+
+/**
+ * Gets the number of times a complete product failed its checksums.
+ *
+ * @return    Number of failures.
+ */
+uint64_t fmtpRecvv3::getCorruptProds()
+{
+    return corruptProds.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * Gets the page faults of the thread that handles multicast packets, which
+ * is where faults on fresh product buffers turn into multicast drops. They're
+ * read from /proc, so the thread itself pays nothing for them.
+ *
+ * @param[out] minor  Minor faults.
+ * @param[out] major  Major faults.
+ * @return            false if the thread hasn't started or /proc can't be
+ *                    read.
+ */
+bool fmtpRecvv3::getMcastFaults(uint64_t& minor, uint64_t& major)
+{
+    const pid_t tid = mcastTid.load();
+    if (tid == 0)
+        return false;
+
+    std::ifstream stat("/proc/self/task/" + std::to_string(tid) + "/stat");
+    std::string   line;
+    if (!std::getline(stat, line))
+        return false;
+
+    /* the fields after the command, which can contain blanks, start with
+     * the state (field 3); minflt and majflt are fields 10 and 12 */
+    const size_t paren = line.rfind(')');
+    if (paren == std::string::npos)
+        return false;
+    std::istringstream fields(line.substr(paren + 1));
+    std::string        field;
+    for (int i = 3; i < 10; i++)
+        fields >> field;
+    fields >> minor >> field >> major;
+    return !fields.fail();
+}
+
+
 /**
  * Gets the notified product index.
  *
  * @return    The product index of the latest completed product.
  */
-uint32_t fmtpRecvv3::getNotify()
+uint32_t fmtpRecvv3::getNotify()
+{
+    std::unique_lock<std::mutex> lock(notifyprodmtx);
+    notify_cv.wait(lock);
+    return notifyprodidx;
+}
+
+
+/**
+ * A public setter of link speed. The setter is thread-safe, but a recommended
+ * way is to set the link speed before the receiver starts. Due to the feature
+ * of virtual circuits, the link speed won't change when it's set up. So the
+ * link speed remains for the whole life of the receiver. As the possible link
+ * speed nowadays could possibly be 10Gbps or even higher, a 64-bit unsigned
+ * integer is used to hold the value, which can be up to 18000 Pbps.
+ *
+ * @param[in] speed                 User-specified link speed
+ */
+void fmtpRecvv3::SetLinkSpeed(uint64_t speed)
+{
+    std::unique_lock<std::mutex> lock(linkmtx);
+    linkspeed = speed;
+}
+
+
+/**
+ * Sets the EOP deadline of a product to `factor` times the time the product
+ * takes at the measured arrival rate, plus EOP_SLACK milliseconds. Until the
+ * rate has been measured, the link speed is used instead. The default is
+ * EOP_SAFETY. Must be called before `Start()`.
+ *
+ * @param[in] factor                Multiple, at least 1.
+ */
+void fmtpRecvv3::SetEOPSafety(double factor)
+{
+    eopSafety = factor;
+}
+
+
+/**
+ * Enables or disables the UDP repair channel. If enabled, missing data-blocks
+ * are requested and received as unicast datagrams, so that a lost repair
+ * doesn't hold up the repairs behind it as on the TCP connection. The TCP
+ * connection still carries everything else and any request that goes
+ * unanswered after its retries. Must be called before `Start()`.
+ *
+ * @param[in] enable                Whether to use the UDP repair channel.
+ */
+void fmtpRecvv3::SetUdpRetx(bool enable)
+{
+    udpRetx = enable;
+}
+
+
+/**
+ * Enables or disables unicast mode. A unicast receiver doesn't join the
+ * multicast group. It asks the sender to stream every product over the TCP
+ * connection instead and hands them to the receiving application through the
+ * same callbacks. Since TCP delivers everything in order, the UDP repair
+ * channel isn't used in this mode. Must be called before `Start()`.
+ *
+ * @param[in] enable                Whether to receive products over unicast.
+ */
+void fmtpRecvv3::SetUnicast(bool enable)
+{
+    unicast = enable;
+}
+
+
+/**
+ * Enables or disables the packet ring. The multicast group is then received
+ * by an AF_PACKET socket with a TPACKET_V3 ring that the kernel fills with the
+ * group's datagrams, and the multicast thread handles them in place. The UDP
+ * socket still joins the group but receives nothing. Must be called before
+ * `Start()`.
+ *
+ * @param[in] enable                Whether to receive from the packet ring.
+ */
+void fmtpRecvv3::SetPacketRing(bool enable)
+{
+    pktRing = enable;
+}
+
+
+/**
+ * Enables or disables AF_XDP. An XDP program on the interface then redirects
+ * the group's datagrams into the UMEMs of AF_XDP sockets, one per receive
+ * queue, and the multicast thread handles them in place. The program runs in
+ * native mode if the driver supports it and in generic mode otherwise. The
+ * UDP socket still joins the group but receives nothing. Must be called
+ * before `Start()`.
+ *
+ * @param[in] enable                Whether to receive through AF_XDP.
+ */
+void fmtpRecvv3::SetXdp(bool enable)
+{
+    xdp = enable;
+}
+
+
+/**
+ * Sets the depth of the multicast queue, which absorbs the packets that
+ * arrive while the handling thread is busy, e.g., in the receiving
+ * application's `startProd()`. Must be called before `Start()`.
+ *
+ * @param[in] depth                 Number of packets.
+ */
+void fmtpRecvv3::SetMcastQueueDepth(uint32_t depth)
+{
+    mcastQueueDepth = depth;
+}
+
+
+/**
+ * Sets the receive buffer of the multicast socket. The buffer is doubled,
+ * up to `cap`, whenever the kernel reports dropped packets or the buffer is
+ * more than three quarters full after a run of full batches. Sizes above
+ * net.core.rmem_max need CAP_NET_ADMIN. Must be called before `Start()`.
+ *
+ * @param[in] initial               Size in bytes, 0 for the system default.
+ * @param[in] cap                   Largest size in bytes, 0 to not grow it.
+ */
+void fmtpRecvv3::SetMcastRcvBuf(int initial, int cap)
+{
+    rcvBufInit = initial;
+    rcvBufCap  = cap;
+}
+
+
+/**
+ * Sets how long a lost retransmission connection is reconnected, with a
+ * doubling wait between attempts, before the receiver gives up and stops.
+ * Multicast reception goes on meanwhile. The default is
+ * RETX_RECONNECT_TIMEOUT. Must be called before `Start()`.
+ *
+ * @param[in] seconds               Seconds, 0 to stop at once as soon as the
+ *                                  connection is lost.
+ */
+void fmtpRecvv3::SetRetxReconnect(unsigned seconds)
+{
+    retxReconnect = seconds;
+}
+
+
+/**
+ * Makes the kernel timestamp multicast packets when they arrive and keeps
+ * histograms of the first-packet delay, the arrival span of each product,
+ * the gaps between packets and the time from arrival to handling. Hardware
+ * timestamps are enabled on the interface of the receiver's address if the
+ * network card and the process's privileges allow it; this affects every
+ * socket on the interface. Doesn't apply to the packet ring or AF_XDP. Must
+ * be called before `Start()`.
+ *
+ * @param[in] hardware              Whether to try hardware timestamps.
+ */
+void fmtpRecvv3::SetRecvTimestamps(bool hardware)
+{
+    recvStamps = true;
+    hwStamps   = hardware;
+}
+
+
+/**
+ * Makes the receiver write the products that the receiving application
+ * doesn't take, i.e., for which `startProd()` leaves the data pointer NULL or
+ * that arrive without a receiving application, into files in a directory.
+ * Each product is written straight into a preallocated, memory-mapped file,
+ * which is synced and given its final name after the product is complete.
+ * Must be called before `Start()`.
+ *
+ * @param[in] dir                   Existing directory of the product files.
+ */
+void fmtpRecvv3::SetDiskSink(const std::string& dir)
+{
+    diskDir = dir;
+}
+
+
+/**
+ * Returns the file that a product is written to if the disk sink is used.
+ *
+ * @param[in] prodindex             Index of the product.
+ * @return                          Path of the file, which only exists
+ *                                  under this name once the product has been
+ *                                  completely received and synced.
+ */
+std::string fmtpRecvv3::getProdPath(const uint32_t prodindex)
+{
+    return diskSink ? diskSink->pathOf(prodindex) : std::string();
+}
+
+
+/**
+ * Makes the receiver allocate product buffers up front and offer one to the
+ * receiving application in every `startProd()`, as the data pointer, so that
+ * the application doesn't have to allocate on the multicast thread. The
+ * buffers come in slab classes whose sizes are powers of 2 and are backed by
+ * huge pages and pre-faulted when the receiver starts. The application can
+ * keep the buffer, set the pointer to NULL or replace it with its own; a
+ * buffer that it keeps must be returned by `ReleaseProdBuffer()` after
+ * `endProd()` or `missedProd()`, once it's done with the product. If no
+ * buffer is free the data pointer is NULL as before. Must be called before
+ * `Start()`.
+ *
+ * @param[in] maxProdSize           Size of the biggest product to be taken.
+ * @param[in] bytesPerClass         Memory of each slab class.
+ * @param[in] lock                  Whether to lock the arena in memory,
+ *                                  which can need a higher RLIMIT_MEMLOCK.
+ */
+void fmtpRecvv3::SetProdArena(const size_t maxProdSize,
+                              const size_t bytesPerClass, const bool lock)
+{
+    arenaMaxProd       = maxProdSize;
+    arenaBytesPerClass = bytesPerClass;
+    arenaLock          = lock;
+}
+
+
+/**
+ * Returns a product buffer to the arena.
+ *
+ * @param[in] data                  The buffer that `startProd()` was given.
+ * @throws std::invalid_argument    if the buffer isn't the arena's.
+ */
+void fmtpRecvv3::ReleaseProdBuffer(void* const data)
+{
+    if (prodArena == NULL || !prodArena->release(data))
+        throw std::invalid_argument("fmtpRecvv3::ReleaseProdBuffer() "
+                "Not a buffer of the arena");
+}
+
+
+/**
+ * Gets what the product-buffer arena has done so far: the page faults taken
+ * to pre-fault it and the time spent allocating from it.
+ *
+ * @param[out] stats                Statistics.
+ * @return                          false if there's no arena.
+ */
+bool fmtpRecvv3::getArenaStats(ArenaStats& stats)
+{
+    if (prodArena == NULL)
+        return false;
+    prodArena->getStats(stats);
+    return true;
+}
+
+
+/**
+ * Sets how many multicast blocks of products whose BOP was lost are kept,
+ * so that only the blocks that are really missing have to be retransmitted
+ * once the BOP is. The default is ORPHAN_POOL_BLOCKS. Must be called before
+ * `Start()`.
+ *
+ * @param[in] blocks                Number of blocks, 0 to keep none.
+ */
+void fmtpRecvv3::SetOrphanPool(const uint32_t blocks)
+{
+    orphanBlocks = blocks;
+}
+
+
+/**
+ * Gets what the pool of blocks without a BOP has done so far.
+ *
+ * @param[out] stats                Statistics.
+ * @return                          false if there's no pool.
+ */
+bool fmtpRecvv3::getOrphanStats(OrphanStats& stats)
+{
+    if (orphans == NULL)
+        return false;
+    orphans->getStats(stats);
+    return true;
+}
+
+
+/**
+ * Sets the reorder window: how long a gap in the multicast blocks of a
+ * product waits for blocks that were only reordered on the way before its
+ * missing blocks are requested. The window ends after `packets` more
+ * multicast packets or `usec` microseconds, whichever comes first, and at
+ * the EOP of the product. Both 0, the default, requests the blocks at once.
+ * Must be called before `Start()`.
+ *
+ * @param[in] packets               Packets to wait for, 0 for no limit.
+ * @param[in] usec                  Microseconds to wait for, 0 for no limit.
+ */
+void fmtpRecvv3::SetReorderWindow(const uint32_t packets, const unsigned usec)
+{
+    reorderPkts = packets;
+    reorderNs   = (int64_t)usec * 1000;
+}
+
+
+/**
+ * Gets how many blocks of gaps in the multicast were requested and how many
+ * weren't because they arrived late within the reorder window.
+ *
+ * @param[out] nacked               Blocks requested.
+ * @param[out] suppressed           Blocks that arrived within the window.
+ */
+void fmtpRecvv3::getReorderStats(uint64_t& nacked, uint64_t& suppressed)
+{
+    nacked     = gapsNacked.load(std::memory_order_relaxed);
+    suppressed = gapsSuppressed.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * Makes the receiver tell the receiving application, by
+ * RecvProxy::prodProgress(), how much of a product it has received from the
+ * start on, so the application can work on a product while the rest of it
+ * arrives. The application is told whenever that has grown by at least
+ * `bytes` since it was last told. Must be called before `Start()`.
+ *
+ * @param[in] bytes                 Growth to report, 0 for no reports.
+ */
+void fmtpRecvv3::SetProgress(const uint32_t bytes)
+{
+    progressStep = bytes;
+}
+
+
+/**
+ * Makes a thread of the receiver's own notify the receiving application, so
+ * a slow application doesn't hold up the threads that receive products and
+ * let the socket buffers overflow. Events are queued in a ring of `depth`
+ * entries and passed to RecvProxy::notifyBatch() in batches of up to
+ * NOTIFY_BATCH. If the ring is full, the queueing thread waits for room or
+ * the event goes to an unbounded overflow list, as set by `overflow`;
+ * progress events are dropped either way. `RecvProxy::startProd()` and
+ * `RecvProxy::readBase()` are still called synchronously, they return what
+ * the receiver needs. Must be called before `Start()`.
+ *
+ * @param[in] depth                 Number of events the ring holds, 0 to
+ *                                  notify synchronously.
+ * @param[in] overflow              What an event does if the ring is full.
+ */
+void fmtpRecvv3::SetAsyncNotify(const uint32_t depth,
+                                const NotifyOverflow overflow)
+{
+    notifyDepth    = depth;
+    notifyOverflow = overflow;
+}
+
+
+/**
+ * Returns what the queue of events for the receiving application has done
+ * so far, including how long the events waited in it.
+ *
+ * @param[out] stats                Statistics.
+ * @return                          false if there's no queue.
+ */
+bool fmtpRecvv3::getNotifyStats(NotifyStats& stats)
 {
-    std::unique_lock<std::mutex> lock(notifyprodmtx);
-    notify_cv.wait(lock);
-    return notifyprodidx;
+    if (notifyQueue == NULL)
+        return false;
+    notifyQueue->getStats(stats);
+    return true;
 }
 
 
 /**
- * A public setter of link speed. The setter is thread-safe, but a recommended
- * way is to set the link speed before the receiver starts. Due to the feature
- * of virtual circuits, the link speed won't change when it's set up. So the
- * link speed remains for the whole life of the receiver. As the possible link
- * speed nowadays could possibly be 10Gbps or even higher, a 64-bit unsigned
- * integer is used to hold the value, which can be up to 18000 Pbps.
+ * Sets how many retransmission requests can wait to be sent. A product whose
+ * requests don't fit is given up on, and a gap of more products than this
+ * between consecutive BOPs makes the receiver resynchronize instead of
+ * requesting the BOPs of the gap. Must be called before `Start()`.
  *
- * @param[in] speed                 User-specified link speed
+ * @param[in] limit                 Number of requests.
  */
-void fmtpRecvv3::SetLinkSpeed(uint64_t speed)
+void fmtpRecvv3::SetMaxNacks(uint32_t limit)
 {
-    std::unique_lock<std::mutex> lock(linkmtx);
-    linkspeed = speed;
+    nacks->setLimit(limit);
 }
 
 
@@ -208,19 +863,69 @@ void fmtpRecvv3::Start()
         }
     }
 
-    joinGroup(tcpAddr, mcastAddr, mcastPort);
+    if (unicast)
+        udpRetx = false;
+    /**
+     * registers the UDP repair port or unicast mode before anything else is
+     * sent, requests go over TCP until the sender has acknowledged it.
+     */
+    if (udpRetx) {
+        udpretx->Init();
+        reqTracker->setRTT(tcprecv->getRTT());
+    }
+    if (udpRetx || unicast)
+        sendRcvrReg();
+
+    if (!unicast)
+        joinGroup(tcpAddr, mcastAddr, mcastPort);
+
+    if (!diskDir.empty())
+        diskSink = new DiskSink(diskDir);
+    if (arenaMaxProd && prodArena == NULL)
+        prodArena = new ProdArena(arenaMaxProd, arenaBytesPerClass, arenaLock);
+    if (orphanBlocks && !unicast && orphans == NULL)
+        orphans = new OrphanPool(orphanBlocks, FMTP_DATA_LEN);
+
+    if (notifyDepth && notifier) {
+        delete notifyQueue;
+        notifyQueue = new NotifyQueue(notifyDepth, notifyOverflow);
+        startNotifyThread();
+    }
 
     StartRetxProcedure();
     startTimerThread();
 
-    int status = pthread_create(&mcast_t, NULL, &fmtpRecvv3::StartMcastHandler,
-                                this);
-    if (status) {
-        Stop();
-        throw std::system_error(errno, std::system_category(),
-                "fmtpRecvv3::Start(): Couldn't start "
-                "multicast-receiving thread, failed with status = "
-                + std::to_string(status));
+    if (udpRetx) {
+        int status = pthread_create(&udpretx_t, NULL,
+                                    &fmtpRecvv3::StartUdpRetxHandler, this);
+        if (status) {
+            Stop();
+            throw std::system_error(errno, std::system_category(),
+                    "fmtpRecvv3::Start(): Couldn't start UDP repair "
+                    "thread, failed with status = " + std::to_string(status));
+        }
+    }
+
+    if (!unicast) {
+        mcastQueue = new PacketQueue(mcastQueueDepth, MAX_FMTP_PACKET_LEN);
+        int status = pthread_create(&mcast_t, NULL,
+                                    &fmtpRecvv3::StartMcastHandler, this);
+        if (status) {
+            Stop();
+            throw std::system_error(errno, std::system_category(),
+                    "fmtpRecvv3::Start(): Couldn't start "
+                    "multicast-receiving thread, failed with status = "
+                    + std::to_string(status));
+        }
+        status = pthread_create(&mcastrecv_t, NULL,
+                                &fmtpRecvv3::StartMcastReceiver, this);
+        if (status) {
+            Stop();
+            throw std::system_error(errno, std::system_category(),
+                    "fmtpRecvv3::Start(): Couldn't start "
+                    "multicast socket-draining thread, failed with status = "
+                    + std::to_string(status));
+        }
     }
 
     {
@@ -230,8 +935,16 @@ void fmtpRecvv3::Start()
     }
     stopJoinRetxRequester();
     stopJoinRetxHandler();
+    if (udpRetx)
+        stopJoinUdpRetxHandler();
     stopJoinTimerThread();
-    stopJoinMcastHandler();
+    if (!unicast) {
+        stopJoinMcastReceiver();
+        stopJoinMcastHandler();
+    }
+    /* last, so the events of the other threads are all delivered */
+    if (notifyQueue)
+        stopJoinNotifyThread();
 
     {
         std::unique_lock<std::mutex> lock(exitMutex);
@@ -283,27 +996,24 @@ void fmtpRecvv3::Stop()
  */
 bool fmtpRecvv3::addUnrqBOPinSet(uint32_t prodindex)
 {
-    std::pair<std::unordered_set<uint32_t>::iterator, bool> retval;
-    int size = 0;
-    {
-        std::unique_lock<std::mutex> lock(BOPSetMtx);
-        retval = misBOPset.insert(prodindex);
-        size = misBOPset.size();
-    }
-    return retval.second;
+    bool     evicted;
+    uint32_t evictedIndex;
+    bool     added = prodTable->reqBop(prodindex, evicted, evictedIndex);
+    if (evicted)
+        missProd(evictedIndex);
+    return added;
 }
 
 
 /**
- * Handles a multicast BOP message given its peeked-at and decoded FMTP header.
+ * Handles a multicast BOP message given its decoded FMTP header.
  *
- * @pre                       The multicast socket contains a FMTP BOP packet.
- * @param[in] header          The associated, peeked-at and already-decoded
- *                            FMTP header.
- * @throw std::runtime_error  if an error occurs while reading the socket.
+ * @param[in] header          The associated, already-decoded FMTP header.
+ * @param[in] payload         The payload of the received packet.
  * @throw std::runtime_error  if the packet is invalid.
  */
-void fmtpRecvv3::mcastBOPHandler(const FmtpHeader& header)
+void fmtpRecvv3::mcastBOPHandler(const FmtpHeader& header,
+                                 const char* const payload)
 {
 #ifdef LDM_LOGGING
     log_debug("Entered");
@@ -322,18 +1032,7 @@ void fmtpRecvv3::mcastBOPHandler(const FmtpHeader& header)
         WriteToLog(debugmsg);
     #endif
 
-    const int     bufsize = FMTP_HEADER_LEN + header.payloadlen;
-    char          pktBuf[bufsize];
-    const ssize_t nbytes = recv(mcastSock, pktBuf, bufsize, 0);
-
-    if (nbytes < 0) {
-        throw std::system_error(errno, std::system_category(),
-                "fmtpRecvv3::mcastBOPHandler() recv() got less"
-                "than 0 bytes returned.");
-    }
-
-    checkPayloadLen(header, nbytes);
-    BOPHandler(header, pktBuf + FMTP_HEADER_LEN);
+    BOPHandler(header, payload);
 
     /**
      * detects completely missing products by checking the consistency
@@ -381,6 +1080,8 @@ void fmtpRecvv3::retxBOPHandler(const FmtpHeader& header,
 
 /**
  * Parse BOP message and call notifier to notify receiving application.
+ * A product that is already complete then, e.g., a revision whose blocks all
+ * come from its base, is ended at once.
  *
  * @param[in] header           Header associated with the packet.
  * @param[in] FmtpPacketData   Pointer to payload of FMTP packet.
@@ -392,6 +1093,7 @@ void fmtpRecvv3::BOPHandler(const FmtpHeader& header,
 {
     void*    prodptr = NULL;
     BOPMsg   BOPmsg;
+    bool     filled = false;
     /**
      * Every time a new BOP arrives, save the msg to check following data
      * packets
@@ -422,6 +1124,11 @@ void fmtpRecvv3::BOPHandler(const FmtpHeader& header,
     wire = (const char*)uint16p;
     (void)memcpy(BOPmsg.metadata, wire, BOPmsg.metasize);
 
+    uint32_t                baseIndex = 0;
+    std::vector<DeltaRange> ranges;
+    if (header.flags == FMTP_BOP_DELTA)
+        decodeDelta(header, BOPmsg, wire + BOPmsg.metasize, baseIndex, ranges);
+
 #ifdef LDM_LOGGING
     log_debug("Received BOP {header={index=%lu, payload=%u}, "
             "bop={prodsize=%lu, metasize=%u}}",
@@ -430,21 +1137,24 @@ void fmtpRecvv3::BOPHandler(const FmtpHeader& header,
 #endif
 
     /**
-     * Here a strict check is performed to make sure the information in
-     * trackermap and BlockMNG would not be overwritten by duplicate BOP.
-     * By design, a product should exist in both the trackermap and
-     * BlockMNG or neither, which is the condition of executing all the
-     * initialization. Also, startProd() will only be called for a
-     * fresh new BOP. All the duplicate calls will be suppressed.
+     * Here a strict check is performed to make sure the state of a product
+     * would not be overwritten by duplicate BOP. The product is claimed
+     * before startProd() and only published to the data path after it, so
+     * startProd() will only be called for a fresh new BOP. All the
+     * duplicate calls will be suppressed.
      */
-    bool insertion = pSegMNG->addProd(header.prodindex, BOPmsg.prodsize);
-    bool inTracker;
-    {
-        std::unique_lock<std::mutex> lock(trackermtx);
-        inTracker = trackermap.count(header.prodindex);
-    }
-    if (insertion && !inTracker) {
+    bool     evicted;
+    uint32_t evictedIndex;
+    bool     insertion = prodTable->claim(header.prodindex, BOPmsg.prodsize,
+                                          evicted, evictedIndex);
+    if (evicted)
+        missProd(evictedIndex);
+    if (insertion) {
         if(notifier) {
+            void* const arenaBuf = prodArena && BOPmsg.prodsize ?
+                    prodArena->alloc(BOPmsg.prodsize) : NULL;
+            prodptr = arenaBuf;
+
             struct timespec startTime;
             startTime.tv_sec =
                     (static_cast<uint64_t>(BOPmsg.startTime[0]) << 32) |
@@ -453,47 +1163,43 @@ void fmtpRecvv3::BOPHandler(const FmtpHeader& header,
             notifier->startProd(startTime, header.prodindex,
                     BOPmsg.prodsize, BOPmsg.metadata, BOPmsg.metasize,
                     &prodptr);
+            if (arenaBuf && prodptr != arenaBuf)
+                (void)prodArena->release(arenaBuf);
         }
-
-        /* Atomic insertion for BOP of new product */
-        {
-            ProdTracker tracker = {BOPmsg.prodsize, prodptr, 0, 0, 0};
-            std::unique_lock<std::mutex> lock(trackermtx);
-            trackermap[header.prodindex] = tracker;
+        if (prodptr == NULL && diskSink)
+            prodptr = diskSink->open(header.prodindex, BOPmsg.prodsize);
+
+        /* makes the new product visible to the data path */
+        bool delta = false;
+        if (header.flags == FMTP_BOP_DELTA) {
+            delta = copyBase(header.prodindex, BOPmsg.prodsize, prodptr,
+                             baseIndex, ranges);
         }
-
-        /* forcibly terminate the previous timer */
-        timerWake.notify_all();
-
-        initEOPStatus(header.prodindex);
+        prodTable->publish(header.prodindex, prodptr, delta);
+        const bool adopted = orphans && adoptOrphans(header.prodindex);
+        filled = delta || adopted || BOPmsg.prodsize == 0;
 
         /**
          * Since the receiver timer starts after BOP is received, the RTT is not
          * affecting the timer model. Sleeptime here means the estimated reception
          * time of this product. Thus, the only thing needs to be considered is
          * the transmission delay, which can be calculated as product size over
-         * link speed. Besides, a little more extra time would be favorable to
+         * the measured arrival rate, or over the link speed until there is
+         * one. Besides, a little more extra time would be favorable to
          * tolerate possible fluctuation.
          */
-        double sleeptime = 0.0;
-        {
-            std::unique_lock<std::mutex> lock(trackermtx);
-            if (trackermap.count(header.prodindex)) {
-                sleeptime =
-                    Frcv * ((double)trackermap[header.prodindex].prodsize /
-                    (double)linkspeed);
-            }
-            else {
-                throw std::runtime_error("fmtpRecvv3::BOPHandler(): "
-                        "Error accessing newly added BOP in trackermap.");
-            }
-        }
-        /* add the new product into timer queue */
-        {
-            std::unique_lock<std::mutex> lock(timerQmtx);
-            timerParam timerparam = {header.prodindex, sleeptime};
-            timerParamQ.push(timerparam);
-            timerQfilled.notify_all();
+        const double rate      = mcastRate->getRate();
+        const double sleeptime = rate > 0 ?
+                eopSafety * BOPmsg.prodsize / rate + EOP_SLACK / 1e3 :
+                Frcv * ((double)BOPmsg.prodsize / (double)linkspeed);
+        /**
+         * sets the EOP deadline of the new product. A product streamed over
+         * TCP can't lose its EOP, so there's nothing to time.
+         */
+        if (!unicast) {
+            eopTimers->add(header.prodindex,
+                    std::chrono::duration_cast<EOPClock::duration>(
+                    std::chrono::duration<double>(sleeptime)));
         }
     }
     else {
@@ -509,9 +1215,8 @@ void fmtpRecvv3::BOPHandler(const FmtpHeader& header,
 
     #ifdef MEASURE
         {
-            std::unique_lock<std::mutex> lock(trackermtx);
-            if (trackermap.count(header.prodindex)) {
-                ProdTracker tracker = trackermap[header.prodindex];
+            ProdTracker tracker;
+            if (prodTable->getProd(header.prodindex, tracker)) {
                 measure->insert(header.prodindex, tracker.prodsize);
             }
             else {
@@ -528,6 +1233,103 @@ void fmtpRecvv3::BOPHandler(const FmtpHeader& header,
         std::cout << measuremsg << std::endl;
         WriteToLog(measuremsg);
     #endif
+
+    /* the blocks copied from the base or adopted may be the whole product */
+    if (filled && prodTable->isComplete(header.prodindex))
+        endProdBeforeEOP(header.prodindex);
+    else if (filled && progressStep)
+        reportProgress(header.prodindex);
+}
+
+
+/**
+ * Decodes the part of a FMTP_BOP_DELTA that follows the BOP message: the
+ * index of the base and the changed ranges of the revision.
+ *
+ * @param[in]  header           Header associated with the packet.
+ * @param[in]  BOPmsg           The decoded BOP message.
+ * @param[in]  wire             Start of the delta in the packet.
+ * @param[out] baseIndex        Index of the base.
+ * @param[out] ranges           The changed ranges.
+ * @throw std::runtime_error    if the packet is too small.
+ * @throw std::runtime_error    if the ranges are invalid.
+ */
+void fmtpRecvv3::decodeDelta(const FmtpHeader& header, const BOPMsg& BOPmsg,
+                             const char* const wire, uint32_t& baseIndex,
+                             std::vector<DeltaRange>& ranges)
+{
+    const size_t BOPCONST = sizeof(BOPmsg.startTime) + sizeof(BOPmsg.prodsize)
+            + sizeof(BOPmsg.metasize) + BOPmsg.metasize;
+    if (header.payloadlen < BOPCONST + DELTA_HDR_LEN)
+        throw std::runtime_error("fmtpRecvv3::decodeDelta(): packet too small");
+
+    const uint32_t* uint32p = (const uint32_t*)wire;
+    baseIndex = ntohl(*uint32p++);
+    const uint16_t* uint16p = (const uint16_t*)uint32p;
+    const uint16_t  nranges = ntohs(*uint16p++);
+    if (header.payloadlen < BOPCONST + DELTA_HDR_LEN +
+            nranges * sizeof(DeltaRange))
+        throw std::runtime_error("fmtpRecvv3::decodeDelta(): too many ranges: "
+                + std::to_string(nranges));
+
+    uint32p = (const uint32_t*)uint16p;
+    uint32_t end = 0;
+    for (uint16_t i = 0; i < nranges; i++) {
+        DeltaRange range;
+        range.seqnum = ntohl(*uint32p++);
+        range.length = ntohl(*uint32p++);
+        /* ranges must be ordered, block-aligned and within the product */
+        if (range.seqnum < end || range.seqnum % FMTP_DATA_LEN ||
+                range.length == 0 || range.seqnum > BOPmsg.prodsize ||
+                range.length > BOPmsg.prodsize - range.seqnum ||
+                (range.length % FMTP_DATA_LEN &&
+                 range.seqnum + range.length != BOPmsg.prodsize))
+            throw std::runtime_error("fmtpRecvv3::decodeDelta(): invalid "
+                    "range: seqnum=" + std::to_string(range.seqnum) +
+                    ", length=" + std::to_string(range.length) +
+                    ", prodsize=" + std::to_string(BOPmsg.prodsize));
+        end = range.seqnum + range.length;
+        ranges.push_back(range);
+    }
+}
+
+
+/**
+ * Copies the base of a revision into the revision and marks the blocks
+ * outside the changed ranges as received.
+ *
+ * @param[in] prodindex        Product index of the revision.
+ * @param[in] prodsize         Size of the revision in bytes.
+ * @param[in] prodptr          Where the revision is written to, or NULL.
+ * @param[in] baseIndex        Index of the base.
+ * @param[in] ranges           The changed ranges of the revision.
+ * @return                     True if the base was copied; false if the
+ *                             receiving application doesn't have it, in
+ *                             which case the unchanged blocks get requested
+ *                             like lost ones.
+ */
+bool fmtpRecvv3::copyBase(const uint32_t prodindex, const uint32_t prodsize,
+                          void* const prodptr, const uint32_t baseIndex,
+                          const std::vector<DeltaRange>& ranges)
+{
+    if (prodptr == NULL)
+        return false;
+    if ((notifier == NULL ||
+            !notifier->readBase(baseIndex, prodptr, prodsize)) &&
+            (diskSink == NULL ||
+            !diskSink->readBase(baseIndex, prodptr, prodsize)))
+        return false;
+
+    uint32_t seqnum = 0;
+    for (size_t i = 0; i <= ranges.size(); i++) {
+        const uint32_t end = i < ranges.size() ? ranges[i].seqnum : prodsize;
+        if (end > seqnum)
+            (void)prodTable->setRange(prodindex, seqnum, end - seqnum,
+                                      prodptr);
+        if (i < ranges.size())
+            seqnum = end + ranges[i].length;
+    }
+    return true;
 }
 
 
@@ -555,8 +1357,7 @@ void fmtpRecvv3::checkPayloadLen(const FmtpHeader& header, const size_t nbytes)
  */
 void fmtpRecvv3::clearEOPStatus(const uint32_t prodindex)
 {
-    std::unique_lock<std::mutex> lock(EOPmapmtx);
-    EOPmap.erase(prodindex);
+    prodTable->clearEOP(prodindex);
 }
 
 
@@ -598,14 +1399,18 @@ void fmtpRecvv3::decodeHeader(char* const  packet, FmtpHeader& header)
 /**
  * Handles a received EOP from the unicast thread. Check the bitmap to see if
  * all the data blocks are received. If true, notify the RecvApp. If false,
- * request for retransmission if it has to be so.
+ * request for retransmission if it has to be so. The checksums the EOP
+ * carries are kept for when the product is complete; an EOP without them,
+ * e.g., one the sender's timer sent, leaves the product unchecked.
  *
  * @param[in] header           Reference to the received FMTP packet header.
+ * @param[in] payload          Payload of the EOP.
  * @throws std::out_of_range   The notifier doesn't know about
  *                             `header.prodindex`.
  * @throws std::runtime_error  Receiving application error.
  */
-void fmtpRecvv3::EOPHandler(const FmtpHeader& header)
+void fmtpRecvv3::EOPHandler(const FmtpHeader& header,
+                            const char* const payload)
 {
     /*
      * The time-of-arrival of the end-of-product packets is set as soon as
@@ -614,134 +1419,241 @@ void fmtpRecvv3::EOPHandler(const FmtpHeader& header)
     struct timespec now;
     clock_gettime(CLOCK_REALTIME, &now);
 
+    ProdTracker tracker;
+    const bool  tracked = prodTable->getProd(header.prodindex, tracker);
+    if (tracked && header.payloadlen && header.payloadlen ==
+            ProdChecksum::numSegs(tracker.prodsize) * sizeof(uint32_t)) {
+        std::vector<uint32_t> checksums(header.payloadlen / sizeof(uint32_t));
+        const uint32_t*       wire = (const uint32_t*)payload;
+        for (size_t i = 0; i < checksums.size(); i++)
+            checksums[i] = ntohl(wire[i]);
+        prodTable->setChecksums(header.prodindex, checksums);
+    }
+    if (tracked)
+        eopChecksums.store(header.payloadlen != 0, std::memory_order_relaxed);
+
+    /* the multicast of the product is over, so its blocks are late no more */
+    if (reorderPending.load(std::memory_order_relaxed))
+        flushGaps(header.prodindex);
+
+    if (!endProdIfComplete(header.prodindex, now)) {
+        /**
+         * check if the last data block has been received. If true, then
+         * all the other missing blocks have been requested. In this case,
+         * receiver just needs to wait until product being all completed.
+         * Otherwise, last block is missing as well, receiver needs to
+         * request retx for all the missing blocks including the last one.
+         */
+        /*
+         * The last block of a revision may have been copied from its base,
+         * so it says nothing about whether the changed blocks before it
+         * have all been requested.
+         */
+        if (tracked && (tracker.delta || !hasLastBlock(header.prodindex)))
+            requestAnyMissingData(header.prodindex, tracker.prodsize);
+    }
+}
+
+
+/**
+ * Checks whether a product has been completely received. If so, sends the
+ * RETX_END message back to the sender and notifies the receiving application.
+ * Only the first caller for a product sees it as complete, so the multicast,
+ * TCP and UDP repair threads may all call this concurrently. The segments
+ * that don't match the checksums from the EOP are requested again instead.
+ *
+ * @param[in] prodindex        Index of the product.
+ * @param[in] now              Time of arrival of the last packet.
+ * @return                     True if the product is complete.
+ * @throws std::out_of_range   The notifier doesn't know about `prodindex`.
+ * @throws std::runtime_error  Receiving application error.
+ */
+bool fmtpRecvv3::endProdIfComplete(const uint32_t         prodindex,
+                                   const struct timespec& now)
+{
     /**
      * if segmap check tells everything is completed, then sends the
      * RETX_END message back to sender. Meanwhile notify receiving
      * application.
      */
-    if (pSegMNG->delIfComplete(header.prodindex)) {
-        sendRetxEnd(header.prodindex);
-        bool     inTracker;
-        uint32_t numRetrans;
+    uint32_t                  numRetrans;
+    std::vector<MissingRange> corrupt;
+    if (!prodTable->finish(prodindex, numRetrans, corrupt)) {
+        if (!corrupt.empty())
+            requestCorruptData(prodindex, corrupt);
+        return false;
+    }
+    eopTimers->cancel(prodindex);
+    if (diskSink)
+        diskSink->complete(prodindex);
+
+    sendRetxEnd(prodindex);
+    if (notifier) {
+        RecvEvent event = {RECV_END_PROD, prodindex, now, numRetrans, 0};
+        notify(event);
+    }
+    else {
+        /**
+         * Updates the most recently acknowledged product and notifies
+         * a dummy notification handler (getNotify()).
+         */
         {
-            std::unique_lock<std::mutex> lock(trackermtx);
-            inTracker = trackermap.count(header.prodindex);
-            if (inTracker)
-                numRetrans = trackermap[header.prodindex].numRetrans;
-        }
-        if (notifier && inTracker) {
-            notifier->endProd(now, header.prodindex, numRetrans);
-        }
-        else if (inTracker) {
-            /**
-             * Updates the most recently acknowledged product and notifies
-             * a dummy notification handler (getNotify()).
-             */
-            {
-                std::unique_lock<std::mutex> lock(notifyprodmtx);
-                notifyprodidx = header.prodindex;
-            }
-            notify_cv.notify_one();
+            std::unique_lock<std::mutex> lock(notifyprodmtx);
+            notifyprodidx = prodindex;
         }
+        notify_cv.notify_one();
+    }
 
-        {
-            std::unique_lock<std::mutex> lock(trackermtx);
-            trackermap.erase(header.prodindex);
+    #ifdef MODBASE
+        uint32_t tmpidx = prodindex % MODBASE;
+    #else
+        uint32_t tmpidx = prodindex;
+    #endif
+
+    #ifdef DEBUG2
+        std::string debugmsg = "[MSG] Product #" +
+            std::to_string(tmpidx);
+        debugmsg += " has been completely received";
+        std::cout << debugmsg << std::endl;
+        WriteToLog(debugmsg);
+    #elif DEBUG1
+        std::string debugmsg = "[MSG] Product #" +
+            std::to_string(tmpidx);
+        debugmsg += " has been completely received";
+        std::cout << debugmsg << std::endl;
+    #endif
+
+    #ifdef MEASURE
+        uint32_t bytes = measure->getsize(prodindex);
+        std::string measuremsg = "[SUCCESS] Product #" +
+            std::to_string(tmpidx);
+        measuremsg += ": product received, size = ";
+        measuremsg += std::to_string(bytes);
+        measuremsg += " bytes, elapsed time = ";
+        measuremsg += measure->gettime(prodindex);
+        measuremsg += " seconds.";
+        if (measure->getEOPmiss(prodindex)) {
+            measuremsg += " EOP is retransmitted";
         }
+        std::cout << measuremsg << std::endl;
+        WriteToLog(measuremsg);
+        /* remove the measurement if completely received */
+        measure->remove(prodindex);
+    #endif
 
-        #ifdef MODBASE
-            uint32_t tmpidx = header.prodindex % MODBASE;
-        #else
-            uint32_t tmpidx = header.prodindex;
-        #endif
+    reqTracker->rmProd(prodindex);
+    return true;
+}
 
-        #ifdef DEBUG2
-            std::string debugmsg = "[MSG] Product #" +
-                std::to_string(tmpidx);
-            debugmsg += " has been completely received";
-            std::cout << debugmsg << std::endl;
-            WriteToLog(debugmsg);
-        #elif DEBUG1
-            std::string debugmsg = "[MSG] Product #" +
-                std::to_string(tmpidx);
-            debugmsg += " has been completely received";
-            std::cout << debugmsg << std::endl;
-        #endif
 
-        #ifdef MEASURE
-            uint32_t bytes = measure->getsize(header.prodindex);
-            std::string measuremsg = "[SUCCESS] Product #" +
-                std::to_string(tmpidx);
-            measuremsg += ": product received, size = ";
-            measuremsg += std::to_string(bytes);
-            measuremsg += " bytes, elapsed time = ";
-            measuremsg += measure->gettime(header.prodindex);
-            measuremsg += " seconds.";
-            if (measure->getEOPmiss(header.prodindex)) {
-                measuremsg += " EOP is retransmitted";
-            }
-            std::cout << measuremsg << std::endl;
-            WriteToLog(measuremsg);
-            /* remove the measurement if completely received */
-            measure->remove(header.prodindex);
-        #endif
-    }
-    else {
-        /**
-         * check if the last data block has been received. If true, then
-         * all the other missing blocks have been requested. In this case,
-         * receiver just needs to wait until product being all completed.
-         * Otherwise, last block is missing as well, receiver needs to
-         * request retx for all the missing blocks including the last one.
-         */
-        if (!hasLastBlock(header.prodindex)) {
-            uint32_t prodsize;
-            bool     haveProdsize;
-            {
-                std::unique_lock<std::mutex> lock(trackermtx);
-                haveProdsize = trackermap.count(header.prodindex) > 0;
-                if (haveProdsize)
-                    prodsize = trackermap[header.prodindex].prodsize;
-            }
-            if (haveProdsize)
-                requestAnyMissingData(header.prodindex, prodsize);
+/**
+ * Ends a product whose blocks have all arrived, without waiting for its EOP
+ * and so for the EOP timer and a retransmission if the EOP was lost. The
+ * EOP carries the checksums of the product, though, so while the sender
+ * sends them, the product's EOP deadline is cut to EOP_GRACE instead: the
+ * EOP follows the last block unless it was lost, and the product is ended
+ * unchecked when the deadline passes. The deadline is only ever brought
+ * forward, so duplicate blocks don't postpone it. An EOP that arrives after
+ * the product has ended does nothing.
+ *
+ * @param[in] prodindex        Index of the product.
+ * @throws std::out_of_range   The notifier doesn't know about `prodindex`.
+ * @throws std::runtime_error  Receiving application error.
+ */
+void fmtpRecvv3::endProdBeforeEOP(const uint32_t prodindex)
+{
+    if (eopChecksums.load(std::memory_order_relaxed) &&
+            !getEOPStatus(prodindex)) {
+        /* a product streamed over TCP can't lose its EOP */
+        if (!unicast) {
+            eopTimers->advance(prodindex,
+                    std::chrono::duration_cast<EOPClock::duration>(
+                    std::chrono::milliseconds(EOP_GRACE)));
         }
+        return;
     }
+
+    struct timespec now;
+    (void)clock_gettime(CLOCK_REALTIME, &now);
+    (void)endProdIfComplete(prodindex, now);
 }
 
 
 /**
- * Gets the EOP arrival status.
+ * Tells the receiving application how many bytes of a product have been
+ * received from its start on, once they have grown by `progressStep` since
+ * it was last told. Every thread that stores blocks advances the prefix. A
+ * thread that stores the block the prefix stops at and one that moves the
+ * prefix up to it are separated by the fence and the compare-and-swap, so
+ * one of them sees the other and the prefix can't get stuck. The
+ * application is called while the product is pinned, so before endProd().
  *
- * @param[in] prodindex    Product index which the EOP belongs to.
+ * @param[in] prodindex        Index of the product.
+ * @throws std::runtime_error  Receiving application error.
  */
-bool fmtpRecvv3::getEOPStatus(const uint32_t prodindex)
+void fmtpRecvv3::reportProgress(const uint32_t prodindex)
 {
-    std::unique_lock<std::mutex> lock(EOPmapmtx);
-    return EOPmap[prodindex];
+    ProdStatePin pin(*prodTable, prodindex);
+    if (!pin || pin->prodptr == NULL || notifier == NULL)
+        return;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t prefix = pin->prefix.load();
+    for (uint32_t end; (end = pin->bitmap.getPrefix(prefix)) > prefix; ) {
+        if (pin->prefix.compare_exchange_strong(prefix, end))
+            prefix = end;
+    }
+
+    /* the whole product is told by endProd() */
+    uint32_t reported = pin->reported.load(std::memory_order_relaxed);
+    do {
+        if (prefix >= pin->prodsize ||
+                prefix < (uint64_t)reported + progressStep)
+            return;
+    } while (!pin->reported.compare_exchange_weak(reported, prefix,
+                                                  std::memory_order_relaxed));
+
+    RecvEvent event = {RECV_PROD_PROGRESS, prodindex, {0, 0}, 0, prefix};
+    notify(event);
 }
 
 
 /**
- * Check if the last data block has been received.
+ * Notifies the receiving application about an event. If there's a
+ * notification thread, the event is queued for it; otherwise the
+ * application is called by this thread.
  *
- * @param[in] none
+ * @param[in] event            The event.
+ * @throws std::runtime_error  Receiving application error.
  */
-bool fmtpRecvv3::hasLastBlock(const uint32_t prodindex)
+void fmtpRecvv3::notify(const RecvEvent& event)
 {
-    return pSegMNG->getLastSegment(prodindex);
+    if (notifyQueue)
+        (void)notifyQueue->push(event);
+    else
+        notifier->notifyBatch(&event, 1);
 }
 
 
 /**
- * Initialize the EOP arrival status.
+ * Gets the EOP arrival status.
  *
  * @param[in] prodindex    Product index which the EOP belongs to.
  */
-void fmtpRecvv3::initEOPStatus(const uint32_t prodindex)
+bool fmtpRecvv3::getEOPStatus(const uint32_t prodindex)
+{
+    return prodTable->getEOP(prodindex);
+}
+
+
+/**
+ * Check if the last data block has been received.
+ *
+ * @param[in] none
+ */
+bool fmtpRecvv3::hasLastBlock(const uint32_t prodindex)
 {
-    std::unique_lock<std::mutex> lock(EOPmapmtx);
-    EOPmap[prodindex] = false;
+    return prodTable->getLastBlock(prodindex);
 }
 
 
@@ -798,105 +1710,418 @@ void fmtpRecvv3::joinGroup(
             "%s on interface %s", mcastAddr.c_str(), srcAddr.c_str(),
             ifAddr.c_str());
 #endif
+
+    /* has the kernel attach its drop count to every received packet */
+    const int on = 1;
+    (void)setsockopt(mcastSock, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+    if (rcvBufInit > 0)
+        setRcvBuf(rcvBufInit);
+    if (recvStamps && !xdp && !pktRing) {
+        enableTimestamps();
+        arrivals = new ArrivalStats();
+    }
+    int       size = 0;
+    socklen_t len  = sizeof(size);
+    if (getsockopt(mcastSock, SOL_SOCKET, SO_RCVBUF, &size, &len) == 0)
+        rcvBuf = size;
+
+    if (xdp || pktRing) {
+        /* the socket only keeps the membership, the ring gets the packets */
+        struct sock_filter dropAll = BPF_STMT(BPF_RET | BPF_K, 0);
+        struct sock_fprog  prog = {1, &dropAll};
+        if (::setsockopt(mcastSock, SOL_SOCKET, SO_ATTACH_FILTER, &prog,
+                         sizeof(prog)) < 0)
+            throw std::system_error(errno, std::system_category(),
+                    "fmtpRecvv3::joinGroup() Couldn't mute socket " +
+                    std::to_string(mcastSock));
+        if (xdp)
+            xdprecv->Init(srcAddr, mcastAddr, mcastPort);
+        else
+            pktring->Init(srcAddr, mcastAddr, mcastPort);
+    }
 }
 
 
 /**
- * Handles multicast packets. To avoid extra copying operations, here recv()
- * is called with a MSG_PEEK flag to only peek the header instead of reading
- * it out (which would cause the buffer to be wiped). And the recv() call
- * will block if there is no data coming to the mcastSock.
+ * Handles multicast packets. The packets are taken in batches from the
+ * multicast queue, which mcastReceiver() fills, and are handled in place, so
+ * a stall here, e.g., in the receiving application's `startProd()`, only
+ * makes the queue longer instead of leaving the socket undrained.
  *
- * @throw std::runtime_error   if an I/O error occurs.
  * @throw std::runtime_error  if a packet is invalid.
  * @throw std::runtime_error  Receiving application error.
  * @throw std::out_of_range   The notifier doesn't know about the product-index.
  */
 void fmtpRecvv3::mcastHandler()
 {
+    struct iovec pkts[MCAST_BATCH];
+    RecvStamp    stamps[MCAST_BATCH];
+    int64_t      nowNs = 0;
+
+    mcastTid = syscall(SYS_gettid);
+
     while(1)
     {
-        FmtpHeader   header;
-        /* 
-         * Coverity Scan #1: Issue 5: Medium risk, coverity interprets recv() as
-         * "tainting" header object. If my understanding is correct, Coverity
-         * sees the recv() changing the header object as an error, however this
-         * is simply the way that the recv() function works (a limitation of
-         * C++'s inability to return more than one return value).
-         */
-        
-	const ssize_t nbytes = recv(mcastSock, &header, sizeof(header),
-                                    MSG_PEEK);
+        const int npkts = mcastQueue->take(pkts, MCAST_BATCH, stamps);
+        mcastNow = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (arrivals) {
+            struct timespec now;
+            (void)clock_gettime(CLOCK_REALTIME, &now);
+            nowNs = now.tv_sec * (int64_t)1000000000 + now.tv_nsec;
+        }
         /*
          * Allow the current thread to be cancelled only when it is likely
-         * blocked attempting to read from the multicast socket because that
+         * blocked waiting for the multicast queue because that
          * prevents the receiver from being put into an inconsistent state yet
          * allows for fast termination.
          */
         int initState;
         (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &initState);
 
-        if (nbytes < 0) {
-            throw std::system_error(errno, std::system_category(),
-                    "fmtpRecvv3::mcastHandler() recv() less than zero bytes.");
+        for (int i = 0; i < npkts; i++) {
+            char* const  packet = (char*)pkts[i].iov_base;
+            const size_t nbytes = pkts[i].iov_len;
+            FmtpHeader   header;
+
+            if (nbytes < FMTP_HEADER_LEN || nbytes > MAX_FMTP_PACKET_LEN) {
+                throw std::runtime_error("fmtpRecvv3::mcastHandler() Invalid "
+                        "packet length.");
+            }
+
+            decodeHeader(packet, header);
+            checkPayloadLen(header, nbytes);
+
+            if (!mcastHndlrStarted) {
+                prodidx_mcast = header.prodindex;
+                mcastHndlrStarted = true;
+            }
+            if (arrivals) {
+                arrivals->add(header, packet + FMTP_HEADER_LEN, stamps[i],
+                              nowNs);
+            }
+            mcastRate->add(header.prodindex, nbytes, stamps[i].hardware ?
+                           stamps[i].hardware : stamps[i].kernel);
+
+            if (header.flags == FMTP_BOP || header.flags == FMTP_BOP_DELTA) {
+                mcastBOPHandler(header, packet + FMTP_HEADER_LEN);
+            }
+            else if (header.flags == FMTP_MEM_DATA) {
+                #ifdef MEASURE
+                    measure->setMcastClock(header.prodindex,
+                            arrivalTime(arrivals ? &stamps[i] : NULL));
+                #endif
+
+                recvMemData(header, packet + FMTP_HEADER_LEN);
+            }
+            else if (header.flags == FMTP_EOP) {
+                #ifdef MEASURE
+                    measure->setMcastClock(header.prodindex,
+                            arrivalTime(arrivals ? &stamps[i] : NULL));
+                #endif
+
+                mcastEOPHandler(header, packet + FMTP_HEADER_LEN);
+            }
+
+            mcastPkts++;
+            if (reorderPending.load(std::memory_order_relaxed))
+                releaseGaps();
+        }
+
+        int ignoredState;
+        (void)pthread_setcancelstate(initState, &ignoredState);
+    }
+}
+
+
+/**
+ * Drains the multicast socket into the multicast queue. Each recvmmsg() call
+ * waits for at least one packet and then takes whatever else is queued, up to
+ * MCAST_BATCH packets or the free buffers of the queue, straight into the
+ * queue. With the packet ring or AF_XDP, the payloads are copied from memory
+ * shared with the kernel so that it can be handed back at once. Nothing else
+ * is done here, so the socket is drained at the rate packets arrive. If the
+ * queue is full, the packets are read anyway and counted as overruns; they're
+ * recovered like any lost packet.
+ *
+ * @throw std::system_error   if an I/O error occurs.
+ */
+void fmtpRecvv3::mcastReceiver()
+{
+    std::vector<char> scratch(MCAST_BATCH * MAX_FMTP_PACKET_LEN);
+    struct iovec      slots[MCAST_BATCH];
+    struct mmsghdr    msgs[MCAST_BATCH];
+    struct iovec      pkts[MCAST_BATCH];
+    size_t            lens[MCAST_BATCH];
+    RecvStamp         stamps[MCAST_BATCH];
+    /* room for the drop count and the timestamps of each packet */
+    union {
+        struct cmsghdr align;
+        char           buf[CMSG_SPACE(sizeof(uint32_t)) +
+                           CMSG_SPACE(sizeof(struct scm_timestamping))];
+    }                 ctrls[MCAST_BATCH];
+
+    (void)memset(msgs, 0, sizeof(msgs));
+    while(1)
+    {
+        int nslots = mcastQueue->reserve(slots, MCAST_BATCH);
+        int npkts;
+
+        if (xdp || pktRing) {
+            npkts = xdp ? xdprecv->recv(pkts, MCAST_BATCH) :
+                          pktring->recv(pkts, MCAST_BATCH);
+            if (npkts > nslots) {
+                mcastQueue->overrun(npkts - nslots);
+                npkts = nslots;
+            }
+            for (int i = 0; i < npkts; i++) {
+                /* too-long packets keep their length and are rejected later */
+                (void)memcpy(slots[i].iov_base, pkts[i].iov_base,
+                             std::min(pkts[i].iov_len, slots[i].iov_len));
+                lens[i] = pkts[i].iov_len;
+            }
+        }
+        else {
+            const bool full = nslots == 0;
+            if (full) {
+                for (nslots = 0; nslots < MCAST_BATCH; nslots++) {
+                    slots[nslots].iov_base = scratch.data() +
+                                             nslots * MAX_FMTP_PACKET_LEN;
+                    slots[nslots].iov_len  = MAX_FMTP_PACKET_LEN;
+                }
+            }
+            for (int i = 0; i < nslots; i++) {
+                msgs[i].msg_hdr.msg_iov        = &slots[i];
+                msgs[i].msg_hdr.msg_iovlen     = 1;
+                msgs[i].msg_hdr.msg_control    = ctrls[i].buf;
+                msgs[i].msg_hdr.msg_controllen = sizeof(ctrls[i].buf);
+            }
+            /* with MSG_TRUNC, msg_len is the size of the whole datagram */
+            npkts = recvmmsg(mcastSock, msgs, nslots,
+                             MSG_WAITFORONE | MSG_TRUNC, NULL);
+            if (npkts < 0) {
+                throw std::system_error(errno, std::system_category(),
+                        "fmtpRecvv3::mcastReceiver() recvmmsg() failed.");
+            }
+            checkRcvBuf(msgs, npkts, npkts == nslots);
+            if (full) {
+                mcastQueue->overrun(npkts);
+                npkts = 0;
+            }
+            for (int i = 0; i < npkts; i++)
+                lens[i] = msgs[i].msg_len;
+            if (arrivals)
+                getStamps(msgs, npkts, stamps);
+        }
+        /* without the kernel's timestamps, a batch arrived when it was read */
+        if (!arrivals && npkts > 0) {
+            struct timespec now;
+            (void)clock_gettime(CLOCK_REALTIME, &now);
+            const RecvStamp stamp = {now.tv_sec * (int64_t)1000000000 +
+                                     now.tv_nsec, 0};
+            for (int i = 0; i < npkts; i++)
+                stamps[i] = stamp;
+        }
+
+        mcastQueue->publish(lens, npkts, stamps);
+    }
+}
+
+
+/**
+ * Counts the packets that the kernel dropped on the multicast socket and
+ * grows its receive buffer if packets were dropped or the buffer keeps
+ * filling up. The kernel puts its running drop count for the socket on
+ * every packet once a packet has been dropped, so only the last packet that
+ * has the count matters. Called by mcastReceiver() after each batch.
+ *
+ * @param[in] msgs              The messages of the batch.
+ * @param[in] npkts             Number of messages.
+ * @param[in] fullBatch         Whether the batch took all it could, i.e.,
+ *                              more packets could be waiting.
+ */
+void fmtpRecvv3::checkRcvBuf(const struct mmsghdr* const msgs,
+                             const int npkts, const bool fullBatch)
+{
+    bool dropped = false;
+
+    for (int i = npkts - 1; i >= 0; i--) {
+        const struct msghdr* const hdr  = &msgs[i].msg_hdr;
+        struct cmsghdr*            cmsg = CMSG_FIRSTHDR(hdr);
+        for (; cmsg; cmsg = CMSG_NXTHDR((struct msghdr*)hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET &&
+                    cmsg->cmsg_type == SO_RXQ_OVFL)
+                break;
         }
-        if (nbytes != sizeof(header)) {
-            throw std::runtime_error("fmtpRecvv3::mcastHandler() Invalid packet "
-                    "length.");
+        if (cmsg) {
+            uint32_t count;
+            (void)memcpy(&count, CMSG_DATA(cmsg), sizeof(count));
+            /* the count is 32 bits wide and wraps */
+            const uint32_t delta = count - lastDropCount;
+            if (delta) {
+                sockDrops.fetch_add(delta, std::memory_order_relaxed);
+                lastDropCount = count;
+                dropped       = true;
+            }
+            break;
+        }
+    }
+
+    /* the kernel reports twice the size that was set */
+    const int size = rcvBuf.load(std::memory_order_relaxed) / 2;
+    if (rcvBufCap <= 0 || size >= rcvBufCap)
+        return;
+
+    bool filling = false;
+#ifdef SO_MEMINFO
+    if (fullBatch && ++fullBatches % RCVBUF_CHECK_BATCHES == 0) {
+        uint32_t  meminfo[SK_MEMINFO_VARS];
+        socklen_t len = sizeof(meminfo);
+        if (getsockopt(mcastSock, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0)
+            filling = meminfo[SK_MEMINFO_RMEM_ALLOC] >
+                      meminfo[SK_MEMINFO_RCVBUF] / 4 * 3;
+    }
+#endif
+
+    if (dropped || filling) {
+        setRcvBuf((int)std::min<int64_t>(2 * (int64_t)size, rcvBufCap));
+
+        int       now = 0;
+        socklen_t len = sizeof(now);
+        if (getsockopt(mcastSock, SOL_SOCKET, SO_RCVBUF, &now, &len) == 0) {
+            if (now / 2 > size) {
+#ifdef LDM_LOGGING
+                log_notice("Receive buffer of multicast socket grown from %d "
+                        "to %d bytes", size, now / 2);
+#endif
+            }
+            else {
+                /* the system's limit, don't try again */
+                rcvBufCap = size;
+            }
+            rcvBuf = now;
         }
+    }
+}
 
-        decodeHeader(header);
 
-        if (!mcastHndlrStarted) {
-            prodidx_mcast = header.prodindex;
-            mcastHndlrStarted = true;
-        }
+/**
+ * Sets the receive buffer of the multicast socket, beyond net.core.rmem_max
+ * if the process is allowed to.
+ *
+ * @param[in] size              Size in bytes.
+ */
+void fmtpRecvv3::setRcvBuf(const int size)
+{
+    if (setsockopt(mcastSock, SOL_SOCKET, SO_RCVBUFFORCE, &size,
+                   sizeof(size)) < 0)
+        (void)setsockopt(mcastSock, SOL_SOCKET, SO_RCVBUF, &size,
+                         sizeof(size));
+}
 
-        if (header.flags == FMTP_BOP) {
-            mcastBOPHandler(header);
-        }
-        else if (header.flags == FMTP_MEM_DATA) {
-            #ifdef MEASURE
-                measure->setMcastClock(header.prodindex);
-            #endif
 
-            recvMemData(header);
+/**
+ * Enables receive timestamps on the multicast socket: software ones and, if
+ * asked for, the network card's raw ones, which need the card to timestamp
+ * received packets (SIOCSHWTSTAMP). Falls back to SO_TIMESTAMPNS on kernels
+ * without SO_TIMESTAMPING. Failures only mean fewer timestamps.
+ */
+void fmtpRecvv3::enableTimestamps()
+{
+    if (hwStamps) {
+        hwStamps = false;
+        struct ifaddrs* ifas;
+        if (getifaddrs(&ifas) == 0) {
+            const in_addr_t addr = inet_addr(ifAddr.c_str());
+            for (struct ifaddrs* ifa = ifas; ifa; ifa = ifa->ifa_next) {
+                if (ifa->ifa_addr == NULL ||
+                        ifa->ifa_addr->sa_family != AF_INET ||
+                        ((struct sockaddr_in*)ifa->ifa_addr)->sin_addr.s_addr
+                        != addr)
+                    continue;
+                struct hwtstamp_config config = {};
+                config.tx_type   = HWTSTAMP_TX_OFF;
+                config.rx_filter = HWTSTAMP_FILTER_ALL;
+                struct ifreq ifr = {};
+                (void)strncpy(ifr.ifr_name, ifa->ifa_name,
+                              sizeof(ifr.ifr_name) - 1);
+                ifr.ifr_data = (char*)&config;
+                hwStamps = ioctl(mcastSock, SIOCSHWTSTAMP, &ifr) == 0 &&
+                           config.rx_filter != HWTSTAMP_FILTER_NONE;
+                break;
+            }
+            freeifaddrs(ifas);
         }
-        else if (header.flags == FMTP_EOP) {
-            #ifdef MEASURE
-                measure->setMcastClock(header.prodindex);
-            #endif
+#ifdef LDM_LOGGING
+        if (!hwStamps)
+            log_notice("fmtpRecvv3::enableTimestamps() No hardware "
+                    "timestamps on interface of %s", ifAddr.c_str());
+#endif
+    }
 
-            mcastEOPHandler(header);
-        }
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (hwStamps)
+        flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    if (setsockopt(mcastSock, SOL_SOCKET, SO_TIMESTAMPING, &flags,
+                   sizeof(flags)) < 0) {
+        const int on = 1;
+        (void)setsockopt(mcastSock, SOL_SOCKET, SO_TIMESTAMPNS, &on,
+                         sizeof(on));
+        hwStamps = false;
+    }
+}
 
-        int ignoredState;
-        (void)pthread_setcancelstate(initState, &ignoredState);
+
+/**
+ * Gets the receive timestamps of a batch of packets from their control
+ * messages.
+ *
+ * @param[in]  msgs             The messages of the batch.
+ * @param[in]  npkts            Number of messages.
+ * @param[out] stamps           Arrival time of each packet, 0 where unknown.
+ */
+void fmtpRecvv3::getStamps(const struct mmsghdr* const msgs, const int npkts,
+                           RecvStamp* const stamps)
+{
+    for (int i = 0; i < npkts; i++) {
+        struct msghdr* const hdr = (struct msghdr*)&msgs[i].msg_hdr;
+        stamps[i].kernel   = 0;
+        stamps[i].hardware = 0;
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg;
+             cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET)
+                continue;
+            if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                struct scm_timestamping ts;
+                (void)memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                stamps[i].kernel   = ts.ts[0].tv_sec * (int64_t)1000000000 +
+                                     ts.ts[0].tv_nsec;
+                stamps[i].hardware = ts.ts[2].tv_sec * (int64_t)1000000000 +
+                                     ts.ts[2].tv_nsec;
+            }
+            else if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec ts;
+                (void)memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                stamps[i].kernel = ts.tv_sec * (int64_t)1000000000 +
+                                   ts.tv_nsec;
+            }
+        }
     }
 }
 
 
 /**
- * Handles a received EOP from the multicast thread. Since the data is only
- * fetched with a MSG_PEEK flag, it's necessary to remove the data by calling
- * recv() again without MSG_PEEK.
+ * Handles a received EOP from the multicast thread.
  *
  * @param[in] FmtpHeader      Reference to the received FMTP packet header
+ * @param[in] payload         Payload of the EOP.
  * @throws std::out_of_range   The notifier doesn't know about
  *                             `header.prodindex`.
  * @throws std::runtime_error  Receiving application error.
  */
-void fmtpRecvv3::mcastEOPHandler(const FmtpHeader& header)
+void fmtpRecvv3::mcastEOPHandler(const FmtpHeader& header,
+                                 const char* const payload)
 {
-    char          pktBuf[FMTP_HEADER_LEN];
-    /* read the EOP packet out in order to remove it from buffer */
-    const ssize_t nbytes = recv(mcastSock, pktBuf, FMTP_HEADER_LEN, 0);
-
-    if (nbytes < 0) {
-        throw std::system_error(errno, std::system_category(),
-                "fmtpRecvv3::mcastEOPHandler() recv() less than zero bytes.");
-    }
-
     #ifdef MODBASE
         uint32_t tmpidx = header.prodindex % MODBASE;
     #else
@@ -911,17 +2136,10 @@ void fmtpRecvv3::mcastEOPHandler(const FmtpHeader& header)
         WriteToLog(debugmsg);
     #endif
 
-    bool hasBOP = false;
-    {
-        std::unique_lock<std::mutex> lock(trackermtx);
-        if (trackermap.count(header.prodindex)) {
-            hasBOP = true;
-        }
-    }
-    if (hasBOP) {
+    if (prodTable->isTracked(header.prodindex)) {
         setEOPStatus(header.prodindex);
-        timerWake.notify_all();
-        EOPHandler(header);
+        eopTimers->cancel(header.prodindex);
+        EOPHandler(header, payload);
     }
     else {
         (void)requestMissingBopsInclusive(header.prodindex);
@@ -948,19 +2166,33 @@ void fmtpRecvv3::mcastEOPHandler(const FmtpHeader& header)
 
 
 /**
- * Pushes a request for a data-packet onto the retransmission-request queue.
+ * Gives up on a product and notifies the receiving application, or the dummy
+ * notification handler if there's none.
  *
- * @pre                  The retransmission-request queue is locked.
- * @param[in] prodindex  Index of the associated data-product.
- * @param[in] seqnum     Sequence number of the data-packet.
- * @param[in] datalen    Amount of data in bytes.
+ * @param[in] prodindex  Index of the product.
  */
-void fmtpRecvv3::pushMissingDataReq(const uint32_t prodindex,
-                                    const uint32_t seqnum,
-                                    const uint16_t datalen)
+void fmtpRecvv3::missProd(const uint32_t prodindex)
 {
-    INLReqMsg reqmsg = {MISSING_DATA, prodindex, seqnum, datalen};
-    msgqueue.push(reqmsg);
+    if (diskSink)
+        diskSink->discard(prodindex);
+    if (orphans)
+        orphans->discard(prodindex);
+
+    if (notifier) {
+        RecvEvent event = {RECV_MISSED_PROD, prodindex, {0, 0}, 0, 0};
+        notify(event);
+    }
+    else {
+        /**
+         * Updates the most recently acknowledged product and
+         * notifies a dummy notification handler (getNotify()).
+         */
+        {
+            std::unique_lock<std::mutex> lock(notifyprodmtx);
+            notifyprodidx = prodindex;
+        }
+        notify_cv.notify_one();
+    }
 }
 
 
@@ -971,10 +2203,8 @@ void fmtpRecvv3::pushMissingDataReq(const uint32_t prodindex,
  */
 void fmtpRecvv3::pushMissingBopReq(const uint32_t prodindex)
 {
-    std::unique_lock<std::mutex> lock(msgQmutex);
-    INLReqMsg                    reqmsg = {MISSING_BOP, prodindex, 0, 0};
-    msgqueue.push(reqmsg);
-    msgQfilled.notify_one();
+    INLReqMsg reqmsg = {MISSING_BOP, prodindex, 0, 0};
+    nacks->push(reqmsg);
 }
 
 
@@ -985,10 +2215,8 @@ void fmtpRecvv3::pushMissingBopReq(const uint32_t prodindex)
  */
 void fmtpRecvv3::pushMissingEopReq(const uint32_t prodindex)
 {
-    std::unique_lock<std::mutex> lock(msgQmutex);
-    INLReqMsg                    reqmsg = {MISSING_EOP, prodindex, 0, 0};
-    msgqueue.push(reqmsg);
-    msgQfilled.notify_one();
+    INLReqMsg reqmsg = {MISSING_EOP, prodindex, 0, 0};
+    nacks->push(reqmsg);
 }
 
 
@@ -1003,7 +2231,7 @@ void fmtpRecvv3::pushMissingEopReq(const uint32_t prodindex)
  * @throw std::out_of_range   The notifier doesn't know about the product-index.
  * @throw std::runtime_error  Receiving application error.
  */
-void fmtpRecvv3::retxHandler()
+void fmtpRecvv3::recvRetxPackets()
 {
     FmtpHeader header;
     char       pktHead[FMTP_HEADER_LEN];
@@ -1032,20 +2260,17 @@ void fmtpRecvv3::retxHandler()
         clock_gettime(CLOCK_REALTIME, &now);
 
         /*
-         * recvData returning 0 indicates an unexpected socket close, thus
-         * FMTP receiver should stop right away and throw an exception.
+         * recvData returning 0 indicates an unexpected socket close, which
+         * retxHandler() recovers from by reconnecting.
          * Since TcpRecv::recvData() either returns 0 or FMTP_HEADER_LEN here,
          * decodeHeader() should only be called if nbytes is not 0. Besides,
          * decodeHeader() itself does not do any header size check, because
          * nbytes should always equal FMTP_HEADER_LEN when successful.
          */
         if (nbytes == 0) {
-            Stop();
-#if 1
-            throw std::runtime_error("fmtpRecvv3::retxHandler() "
+            throw RetxConnLost("fmtpRecvv3::recvRetxPackets() "
                     "Error reading FMTP header: "
                     "EOF read from retransmission TCP socket.");
-#endif
         }
         else {
             /* TcpRecv::recvData() will return requested number of bytes */
@@ -1065,279 +2290,559 @@ void fmtpRecvv3::retxHandler()
             nbytes = tcprecv->recvData(NULL, 0, paytmp, header.payloadlen);
             (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &ignoredState);
 
-            if (nbytes == 0) {
-                //Stop();
-                throw std::runtime_error("fmtpRecvv3::retxHandler() "
-                        "Error reading FMTP_RETX_BOP: "
-                        "EOF read from the retransmission TCP socket.");
-            }
-            else {
-                retxBOPHandler(header, paytmp);
-            }
+            if (nbytes == 0) {
+                throw RetxConnLost("fmtpRecvv3::recvRetxPackets() "
+                        "Error reading FMTP_RETX_BOP: "
+                        "EOF read from the retransmission TCP socket.");
+            }
+            else {
+                retxBOPHandler(header, paytmp);
+            }
+
+            /** remove the BOP from missing list */
+            (void)rmMisBOPinSet(header.prodindex);
+
+            uint32_t prodsize    = 0;
+            uint32_t seqnum      = 0;
+            uint32_t lastprodidx = 0xFFFFFFFF;
+            {
+                std::unique_lock<std::mutex> lock(antiracemtx);
+                ProdTracker                  tracker;
+                if (prodTable->getProd(header.prodindex, tracker)) {
+                    prodsize    = tracker.prodsize;
+                    seqnum      = tracker.seqnum;
+                    lastprodidx = prodidx_mcast;
+                }
+                if (prodsize > 0) {
+                    /**
+                     * If seqnum != 0, the seqnum is updated right after the
+                     * retx BOP is handled, which means the multicast thread
+                     * is receiving blocks. In this case, nothing needs to be
+                     * done.
+                     */
+                    if (seqnum == 0) {
+                        /**
+                         * If two indices don't equal, the product is totally
+                         * missed. Thus, all blocks should be requested.
+                         * On the other hand, if they equal, there could be
+                         * concurrency or a gap before next product arrives.
+                         * Only requesting EOP is the most economic choice.
+                         */
+                        if (lastprodidx != header.prodindex) {
+                            requestAnyMissingData(header.prodindex, prodsize);
+                        }
+                        pushMissingEopReq(header.prodindex);
+                    }
+                }
+                /*
+                 * Otherwise the product is already complete: the blocks that
+                 * arrived before the BOP were adopted and the rest were
+                 * retransmitted in the meantime.
+                 */
+            }
+        }
+        else if (header.flags == FMTP_BOP) {
+            /* streamed to a unicast receiver, see SetUnicast() */
+            (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ignoredState);
+            nbytes = tcprecv->recvData(NULL, 0, paytmp, header.payloadlen);
+            (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &ignoredState);
+            if (nbytes == 0) {
+                throw RetxConnLost("fmtpRecvv3::recvRetxPackets() "
+                        "Error reading FMTP_BOP: "
+                        "EOF read from the retransmission TCP socket.");
+            }
+            BOPHandler(header, paytmp);
+        }
+        else if (header.flags == FMTP_RETX_DATA ||
+                 header.flags == FMTP_MEM_DATA) {
+            /* FMTP_MEM_DATA is streamed to a unicast receiver */
+            const bool isRetx = header.flags == FMTP_RETX_DATA;
+            #ifdef MEASURE
+                /* log the time first */
+                if (isRetx)
+                    measure->setRetxClock(header.prodindex);
+            #endif
+
+            #ifdef MODBASE
+                uint32_t tmpidx = header.prodindex % MODBASE;
+            #else
+                uint32_t tmpidx = header.prodindex;
+            #endif
+
+            #ifdef DEBUG2
+                std::string debugmsg = "[RETX DATA] Product #" +
+                    std::to_string(tmpidx);
+                debugmsg += ": Data block received on unicast, SeqNum = ";
+                debugmsg += std::to_string(header.seqnum);
+                debugmsg += ", Paylen = ";
+                debugmsg += std::to_string(header.payloadlen);
+                std::cout << debugmsg << std::endl;
+                WriteToLog(debugmsg);
+            #endif
+
+            /* read before pinning, the socket may block */
+            (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ignoredState);
+            nbytes = tcprecv->recvData(NULL, 0, paytmp, header.payloadlen);
+            (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &ignoredState);
+            if (nbytes == 0) {
+                throw RetxConnLost("fmtpRecvv3::recvRetxPackets() "
+                        "Error reading FMTP_RETX_DATA: "
+                        "EOF read from the retransmission TCP socket.");
+            }
+
+            {
+                /* copies while pinned so the product can't be finished */
+                ProdStatePin pin(*prodTable, header.prodindex);
+
+                /*
+                 * A product is only untracked when it has been completely
+                 * received or given up on. So if no valid
+                 * prodindex found, it indicates the product is received
+                 * and thus removed or there is out-of-order arrival on
+                 * TCP. The payload is dropped.
+                 */
+                if (!pin || pin->prodsize == 0)
+                    continue;
+
+                if (header.seqnum + header.payloadlen > pin->prodsize) {
+                    throw std::runtime_error("fmtpRecvv3::recvRetxPackets() "
+                            "retx block out of boundary: seqnum=" +
+                            std::to_string(header.seqnum) + ", payloadlen=" +
+                            std::to_string(header.payloadlen) + "prodsize=" +
+                            std::to_string(pin->prodsize));
+                }
+
+                if (isRetx)
+                    pin->numRetrans.fetch_add(1, std::memory_order_relaxed);
+                /*
+                 * without a product queue, the payload is dropped. A
+                 * duplicate mustn't overwrite a block that has been hashed.
+                 */
+                if (pin->prodptr && !pin->bitmap.isReceived(header.seqnum)) {
+                    (void)memcpy((char*)pin->prodptr + header.seqnum, paytmp,
+                                 header.payloadlen);
+                }
+
+                /**
+                 * set() returns -1/0/1, receiver can parse the info for
+                 * detailed operations. But currently it is ignored to keep
+                 * the process going
+                 */
+                (void)pin->bitmap.set(header.seqnum, header.payloadlen,
+                                      pin->prodptr);
+            }
+            if (progressStep)
+                reportProgress(header.prodindex);
+
+            (void)endProdIfComplete(header.prodindex, now);
+        }
+        else if (header.flags == FMTP_RETX_EOP ||
+                 header.flags == FMTP_EOP) {
+            /* the payload holds the checksums of the product */
+            if (header.payloadlen) {
+                (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE,
+                                             &ignoredState);
+                nbytes = tcprecv->recvData(NULL, 0, paytmp,
+                                           header.payloadlen);
+                (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,
+                                             &ignoredState);
+                if (nbytes == 0) {
+                    throw RetxConnLost("fmtpRecvv3::recvRetxPackets() "
+                            "Error reading EOP checksums: "
+                            "EOF read from the retransmission TCP socket.");
+                }
+            }
+
+            if (header.flags == FMTP_RETX_EOP) {
+                #ifdef MEASURE
+                    measure->setRetxClock(header.prodindex);
+                    measure->setEOPmiss(header.prodindex);
+                #endif
+                /*
+ 	         * Coverity Scan #1: Issue 3: Priority supposedly high, claims header is uninitialized.
+ 	         * Header should be initialized in the decodeHeader function called above. Ignore for now..
+ 	         * 8/3/2016 - Ryan Aubrey
+ 	         */
+                retxEOPHandler(header, paytmp);
+            }
+            else {
+                /* streamed to a unicast receiver, see SetUnicast() */
+                setEOPStatus(header.prodindex);
+                EOPHandler(header, paytmp);
+            }
+        }
+        else if (header.flags == FMTP_RETX_REJ) {
+            retxRejHandler(header);
+        }
+        else if (header.flags == FMTP_RCVR_REG) {
+            (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ignoredState);
+            nbytes = tcprecv->recvData(NULL, 0, paytmp, header.payloadlen);
+            (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &ignoredState);
+            if (nbytes == 0) {
+                throw RetxConnLost("fmtpRecvv3::recvRetxPackets() "
+                        "Error reading FMTP_RCVR_REG: "
+                        "EOF read from the retransmission TCP socket.");
+            }
+            rcvrRegHandler(header, paytmp);
+        }
+    }
+
+    (void)pthread_setcancelstate(initState, &ignoredState);
+}
+
+
+/**
+ * Receives the packets of the retransmission connection for as long as the
+ * receiver runs. A lost connection is re-established and whatever was being
+ * requested is requested again; multicast reception goes on meanwhile. The
+ * receiver stops if the connection can't be re-established within the time
+ * set by SetRetxReconnect().
+ *
+ * @param[in] none
+ * @throw std::system_error   The connection couldn't be re-established.
+ * @throw std::runtime_error  Receiving application error.
+ */
+void fmtpRecvv3::retxHandler()
+{
+    for (;;) {
+        try {
+            recvRetxPackets();
+        }
+        catch (const RetxConnLost& e) {
+            if (retxReconnect == 0)
+                throw;
+            reconnectRetx(e);
+        }
+        catch (const std::system_error& e) {
+            if (retxReconnect == 0 || !isConnError(e.code().value()))
+                throw;
+            reconnectRetx(e);
+        }
+    }
+}
+
+
+/**
+ * Re-establishes the retransmission connection, waiting twice as long after
+ * each failed attempt from RETX_BACKOFF_MIN up to RETX_BACKOFF_MAX
+ * milliseconds. The requests that were in flight went with the old
+ * connection, so the UDP repair port and unicast mode are registered again
+ * and everything that's still missing is requested again.
+ *
+ * @param[in] cause           Why the connection was lost.
+ * @throw std::system_error   The sender couldn't be reached in time.
+ */
+void fmtpRecvv3::reconnectRetx(const std::exception& cause)
+{
+#ifdef LDM_LOGGING
+    log_warning("Lost retransmission connection to %s, reconnecting: %s",
+            ("" + tcprecv->getServAddr()).c_str(), cause.what());
+#else
+    (void)cause;
+#endif
+    /* requests go over TCP again until the sender re-acknowledges the port */
+    udpRetxReady = false;
+
+    const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() +
+            std::chrono::seconds(retxReconnect);
+    unsigned backoff = RETX_BACKOFF_MIN;
+    int      prevState;
+    int      ignoredState;
+
+    /* Stop() cancels this thread, which may take long to connect */
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &prevState);
+    for (;;) {
+        try {
+            tcprecv->reconnect();
+            break;
+        }
+        catch (const std::system_error& e) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                (void)pthread_setcancelstate(prevState, &ignoredState);
+                throw;
+            }
+        }
+        struct timespec wait = {backoff / 1000,
+                                (long)(backoff % 1000) * 1000000};
+        (void)nanosleep(&wait, NULL);
+        backoff = std::min(2 * backoff, RETX_BACKOFF_MAX);
+    }
+    (void)pthread_setcancelstate(prevState, &ignoredState);
+
+    retxReconnects.fetch_add(1, std::memory_order_relaxed);
+    if (udpRetx)
+        reqTracker->setRTT(tcprecv->getRTT());
+    if (udpRetx || unicast)
+        (void)sendRcvrReg();
+#ifdef LDM_LOGGING
+    log_notice("Reconnected to FMTP server %s",
+            ("" + tcprecv->getServAddr()).c_str());
+#endif
+
+    resyncRetx();
+}
+
+
+/**
+ * Requests again what's still missing after the retransmission connection
+ * was re-established: the BOPs that were requested, the blocks missing up to
+ * the last in-order block of each product or all of them if its EOP has
+ * come, and the EOPs whose timers have already run out. An EOP whose timer
+ * is still running is left to the timer, and so are the blocks behind the
+ * last in-order one, which may still be on their way.
+ *
+ * @param[in] none
+ */
+void fmtpRecvv3::resyncRetx()
+{
+    std::vector<OutstandingProd> prods;
+    std::vector<MissingRange>    missing;
+    std::vector<INLReqMsg>       reqs;
+
+    prodTable->getOutstanding(prods);
+    for (size_t i = 0; i < prods.size(); i++) {
+        const uint32_t prodindex = prods[i].prodindex;
+        if (prods[i].bop) {
+            INLReqMsg reqmsg = {MISSING_BOP, prodindex, 0, 0};
+            reqs.push_back(reqmsg);
+            continue;
+        }
+
+        ProdTracker tracker;
+        if (!prodTable->getProd(prodindex, tracker))
+            continue;
+        const uint32_t end = prods[i].eop == EOP_RECEIVED ?
+                tracker.prodsize : tracker.seqnum + tracker.paylen;
+        prodTable->getMissing(prodindex, 0, end, missing);
+        for (size_t j = 0; j < missing.size(); j++) {
+            INLReqMsg reqmsg = {MISSING_DATA, prodindex, missing[j].seqnum,
+                                missing[j].length};
+            reqs.push_back(reqmsg);
+        }
+        if (prods[i].eop == EOP_NONE) {
+            INLReqMsg reqmsg = {MISSING_EOP, prodindex, 0, 0};
+            reqs.push_back(reqmsg);
+        }
+    }
+
+#ifdef LDM_LOGGING
+    log_info("Re-requesting %lu BOPs, ranges and EOPs of %lu products",
+            (unsigned long)reqs.size(), (unsigned long)prods.size());
+#endif
+    if (!reqs.empty())
+        nacks->push(reqs);
+}
+
+
+/**
+ * Handles a rejected retransmission request. The sender no longer has the
+ * product, so it's given up on. A unicast receiver is also sent one for a
+ * product that expired before it was streamed, which it hasn't heard of.
+ *
+ * @param[in] header  Header of the RETX_REJ packet.
+ */
+void fmtpRecvv3::retxRejHandler(const FmtpHeader& header)
+{
+    if (unicast)
+        (void)addUnrqBOPinSet(header.prodindex);
+    abandonProd(header.prodindex);
+}
+
+
+/**
+ * Gives up on a product that can't be completed and notifies the receiving
+ * application once, no matter how often the product is given up on.
+ *
+ * @param[in] prodindex  Index of the product.
+ */
+void fmtpRecvv3::abandonProd(const uint32_t prodindex)
+{
+    reqTracker->rmProd(prodindex);
+
+    const bool hadBop = rmMisBOPinSet(prodindex);
+    /*
+     * if the product is tracked, stop tracking it. Also avoid
+     * duplicated notification if the product has already been
+     * given up on.
+     */
+    if (prodTable->rmProd(prodindex) || hadBop) {
+        #ifdef MODBASE
+            uint32_t tmpidx = prodindex % MODBASE;
+        #else
+            uint32_t tmpidx = prodindex;
+        #endif
+
+        #ifdef DEBUG2
+            std::string debugmsg = "[FAILURE] Product #" +
+                std::to_string(tmpidx);
+            debugmsg += " is not completely received";
+            std::cout << debugmsg << std::endl;
+            WriteToLog(debugmsg);
+        #endif
+
+        missProd(prodindex);
+    }
+}
+
 
-            /** remove the BOP from missing list */
-            (void)rmMisBOPinSet(header.prodindex);
+/**
+ * Handles the sender's reply to the registration of the UDP repair port. The
+ * reply carries the sender's repair port, which together with the address of
+ * the TCP server forms the destination of datagram requests. From then on,
+ * data-blocks are requested over UDP. A unicast receiver checks that the
+ * sender is going to stream the products to it.
+ *
+ * @param[in] header           Header of the reply.
+ * @param[in] payload          Payload of the reply.
+ * @throws std::runtime_error  if the reply is malformed.
+ * @throws std::runtime_error  if the sender doesn't support unicast mode.
+ * @throws std::system_error   if the UDP socket can't be connected.
+ */
+void fmtpRecvv3::rcvrRegHandler(const FmtpHeader& header,
+                                const char* const payload)
+{
+    if (header.payloadlen != RCVR_REG_LEN) {
+        throw std::runtime_error("fmtpRecvv3::rcvrRegHandler() invalid "
+                "registration length: " + std::to_string(header.payloadlen));
+    }
 
-            uint32_t prodsize    = 0;
-            uint32_t seqnum      = 0;
-            uint32_t lastprodidx = 0xFFFFFFFF;
-            {
-                std::unique_lock<std::mutex> lock(antiracemtx);
-                {
-                    std::unique_lock<std::mutex> lock(trackermtx);
-                    if (trackermap.count(header.prodindex)) {
-                        ProdTracker tracker  = trackermap[header.prodindex];
-                        prodsize             = tracker.prodsize;
-                        seqnum               = tracker.seqnum;
+    RcvrRegMsg reg;
+    (void)memcpy(&reg, payload, sizeof(reg));
+    if (unicast && !(ntohs(reg.options) & RCVR_OPT_UNICAST)) {
+        throw std::runtime_error("fmtpRecvv3::rcvrRegHandler() sender "
+                "doesn't stream products to unicast receivers");
+    }
+    if (!udpRetx || reg.udpport == 0)
+        return;
 
-                        lastprodidx = prodidx_mcast;
-                    }
-                }
-                if (prodsize > 0) {
-                    /**
-                     * If seqnum != 0, the seqnum is updated right after the
-                     * retx BOP is handled, which means the multicast thread
-                     * is receiving blocks. In this case, nothing needs to be
-                     * done.
-                     */
-                    if (seqnum == 0) {
-                        /**
-                         * If two indices don't equal, the product is totally
-                         * missed. Thus, all blocks should be requested.
-                         * On the other hand, if they equal, there could be
-                         * concurrency or a gap before next product arrives.
-                         * Only requesting EOP is the most economic choice.
-                         */
-                        if (lastprodidx != header.prodindex) {
-                            requestAnyMissingData(header.prodindex, prodsize);
-                        }
-                        pushMissingEopReq(header.prodindex);
-                    }
-                }
-                else {
-                    throw std::runtime_error("fmtpRecvv3::retxHandler() "
-                            "Product not found in BOPMap after receiving retx BOP");
-                }
-            }
-        }
-        else if (header.flags == FMTP_RETX_DATA) {
-            #ifdef MEASURE
-                /* log the time first */
-                measure->setRetxClock(header.prodindex);
-            #endif
+    struct sockaddr_in peer = tcprecv->getServAddr();
+    peer.sin_port = reg.udpport;
+    udpretx->setPeer(peer);
+    udpRetxReady = true;
 
-            #ifdef MODBASE
-                uint32_t tmpidx = header.prodindex % MODBASE;
-            #else
-                uint32_t tmpidx = header.prodindex;
-            #endif
+    #ifdef DEBUG2
+        std::string debugmsg = "[MSG] UDP repair channel to port " +
+            std::to_string(ntohs(reg.udpport)) + " is ready";
+        std::cout << debugmsg << std::endl;
+        WriteToLog(debugmsg);
+    #endif
+}
 
-            #ifdef DEBUG2
-                std::string debugmsg = "[RETX DATA] Product #" +
-                    std::to_string(tmpidx);
-                debugmsg += ": Data block received on unicast, SeqNum = ";
-                debugmsg += std::to_string(header.seqnum);
-                debugmsg += ", Paylen = ";
-                debugmsg += std::to_string(header.payloadlen);
-                std::cout << debugmsg << std::endl;
-                WriteToLog(debugmsg);
-            #endif
 
-            uint32_t prodsize = 0;
-            void*    prodptr  = NULL;
-            {
-                std::unique_lock<std::mutex> lock(trackermtx);
-                if (trackermap.count(header.prodindex)) {
-                    ProdTracker& tracker = trackermap[header.prodindex];
-                    prodsize = tracker.prodsize;
-                    prodptr  = tracker.prodptr;
-                    ++tracker.numRetrans;
-                }
-            }
+/**
+ * The UDP repair handler. Stores the data-blocks that arrive as datagrams and
+ * drives the timers of the outstanding datagram requests. Since every block
+ * is an independent datagram, a lost one only delays itself: it's requested
+ * again when its timer expires while the blocks behind it are stored as they
+ * arrive. A request that has used up its retries is handed to the TCP
+ * connection. Datagrams that don't make sense are dropped rather than
+ * treated as errors.
+ *
+ * @throw std::system_error   if the UDP socket fails.
+ * @throw std::runtime_error  Receiving application error.
+ */
+void fmtpRecvv3::udpRetxHandler()
+{
+    char                 pktBuf[MAX_FMTP_PACKET_LEN];
+    FmtpHeader           header;
+    std::vector<RetxReq> resend;
+    std::vector<RetxReq> giveup;
+    int                  initState;
+    int                  ignoredState;
+
+    /* same cancellation policy as retxHandler() */
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &initState);
 
-            if ((prodsize > 0) &&
-                (header.seqnum + header.payloadlen > prodsize)) {
-                throw std::runtime_error("fmtpRecvv3::retxHandler() "
-                        "retx block out of boundary: seqnum=" +
-                        std::to_string(header.seqnum) + ", payloadlen=" +
-                        std::to_string(header.payloadlen) + "prodsize=" +
-                        std::to_string(prodsize));
-            }
-            else if (prodsize <= 0) {
-                (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE,
-                                             &ignoredState);
-                /**
-                 * drop the payload since there is no location allocated
-                 * in the product queue.
-                 */
-                nbytes = tcprecv->recvData(NULL, 0, paytmp, header.payloadlen);
-                (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,
-                                             &ignoredState);
-                if (nbytes == 0) {
-                    throw std::runtime_error("fmtpRecvv3::retxHandler() "
-                            "Error reading FMTP_RETX_DATA (prodsize <= 0): "
-                            "EOF read from the retransmission TCP socket.");
-                }
+    while (1) {
+        /* wakes up often enough to resend lost requests on time */
+        int timeoutMs = static_cast<int>(reqTracker->getRTO() * 1000 / 2);
+        timeoutMs = timeoutMs < 1 ? 1 : timeoutMs;
 
-                /*
-                 * The TrackerMap will only be erased when the associated
-                 * product has been completely received. So if no valid
-                 * prodindex found, it indicates the product is received
-                 * and thus removed or there is out-of-order arrival on
-                 * TCP.
-                 */
-                continue;
-            }
+        (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ignoredState);
+        ssize_t nbytes = udpretx->recv(pktBuf, sizeof(pktBuf), timeoutMs);
+        (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &ignoredState);
 
-            if (prodptr) {
-                (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE,
-                                             &ignoredState);
-                nbytes = tcprecv->recvData(NULL, 0, (char*)prodptr +
-                                           header.seqnum, header.payloadlen);
-                (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,
-                                             &ignoredState);
-                if (nbytes == 0) {
-                    throw std::runtime_error("fmtpRecvv3::retxHandler() "
-                            "Error reading FMTP_RETX_DATA (with prodptr): "
-                            "EOF read from the retransmission TCP socket.");
-                }
-            }
-            else {
-                /** dump the payload since there is no product queue */
-                (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE,
-                                             &ignoredState);
-                nbytes = tcprecv->recvData(NULL, 0, paytmp, header.payloadlen);
-                (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,
-                                             &ignoredState);
-                if (nbytes == 0) {
-                    throw std::runtime_error("fmtpRecvv3::retxHandler() "
-                            "Error reading FMTP_RETX_DATA (without prodptr): "
-                            "EOF read from the retransmission TCP socket.");
-                }
-            }
+        if (nbytes >= FMTP_HEADER_LEN) {
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            decodeHeader(pktBuf, header);
 
-            /**
-             * set() returns -1/0/1, receiver can parse the info for detailed
-             * operations. But currently it is ignored to keep the process going
-             */
-            pSegMNG->set(header.prodindex, header.seqnum, header.payloadlen);
+            if (header.flags == FMTP_RETX_DATA &&
+                nbytes == FMTP_HEADER_LEN + header.payloadlen) {
+                #ifdef MEASURE
+                    measure->setRetxClock(header.prodindex);
+                #endif
 
-            if (pSegMNG->delIfComplete(header.prodindex)) {
-                sendRetxEnd(header.prodindex);
-                bool     inTracker;
-                uint32_t numRetrans;
+                (void)reqTracker->satisfy(header.prodindex, header.seqnum);
+
+                bool stored = false;
                 {
-                    std::unique_lock<std::mutex> lock(trackermtx);
-                    inTracker = trackermap.count(header.prodindex);
-                    if (inTracker)
-                        numRetrans = trackermap[header.prodindex].numRetrans;
-                }
-                if (notifier && inTracker) {
-                    notifier->endProd(now, header.prodindex, numRetrans);
-                }
-                else if (inTracker) {
-                    /**
-                     * Updates the most recently acknowledged product and notifies
-                     * a dummy notification handler (getNotify()).
-                     */
-                    {
-                        std::unique_lock<std::mutex> lock(notifyprodmtx);
-                        notifyprodidx = header.prodindex;
+                    /* copies while pinned so the product can't be finished */
+                    ProdStatePin pin(*prodTable, header.prodindex);
+                    if (pin && pin->prodptr && header.seqnum +
+                            header.payloadlen <= pin->prodsize) {
+                        /* a duplicate leaves the hashed block alone */
+                        if (!pin->bitmap.isReceived(header.seqnum)) {
+                            (void)memcpy((char*)pin->prodptr + header.seqnum,
+                                         pktBuf + FMTP_HEADER_LEN,
+                                         header.payloadlen);
+                        }
+                        pin->numRetrans.fetch_add(1,
+                                std::memory_order_relaxed);
+                        (void)pin->bitmap.set(header.seqnum,
+                                              header.payloadlen,
+                                              pin->prodptr);
+                        stored = true;
                     }
-                    notify_cv.notify_one();
                 }
 
-                {
-                    std::unique_lock<std::mutex> lock(trackermtx);
-                    trackermap.erase(header.prodindex);
+                if (stored) {
+                    if (progressStep)
+                        reportProgress(header.prodindex);
+                    (void)endProdIfComplete(header.prodindex, now);
                 }
 
                 #ifdef DEBUG2
-                    std::string debugmsg = "[MSG] Product #" +
-                        std::to_string(tmpidx);
-                    debugmsg += " has been completely received";
+                    std::string debugmsg = "[RETX DATA] Product #" +
+                        std::to_string(header.prodindex);
+                    debugmsg += ": Data block received on UDP, SeqNum = ";
+                    debugmsg += std::to_string(header.seqnum);
+                    debugmsg += ", Paylen = ";
+                    debugmsg += std::to_string(header.payloadlen);
                     std::cout << debugmsg << std::endl;
                     WriteToLog(debugmsg);
-                #elif DEBUG1
-                    std::string debugmsg = "[MSG] Product #" +
-                        std::to_string(tmpidx);
-                    debugmsg += " has been completely received";
-                    std::cout << debugmsg << std::endl;
-                #endif
-
-                #ifdef MEASURE
-                    uint32_t bytes = measure->getsize(header.prodindex);
-                    std::string measuremsg = "[SUCCESS] Product #" +
-                        std::to_string(tmpidx);
-                    measuremsg += ": product received, size = ";
-                    measuremsg += std::to_string(bytes);
-                    measuremsg += " bytes, elapsed time = ";
-                    measuremsg += measure->gettime(header.prodindex);
-                    measuremsg += " seconds.";
-                    if (measure->getEOPmiss(header.prodindex)) {
-                        measuremsg += " EOP is retransmitted";
-                    }
-                    std::cout << measuremsg << std::endl;
-                    WriteToLog(measuremsg);
-                    /* remove the measurement if completely received */
-                    measure->remove(header.prodindex);
                 #endif
             }
+            else if (header.flags == FMTP_RETX_REJ) {
+                retxRejHandler(header);
+            }
         }
-        else if (header.flags == FMTP_RETX_EOP) {
-            #ifdef MEASURE
-                measure->setRetxClock(header.prodindex);
-                measure->setEOPmiss(header.prodindex);
-            #endif
-            /*
- 	     * Coverity Scan #1: Issue 3: Priority supposedly high, claims header is uninitialized.
- 	     * Header should be initialized in the decodeHeader function called above. Ignore for now..
- 	     * 8/3/2016 - Ryan Aubrey
- 	     */
-            retxEOPHandler(header);
-        }
-        else if (header.flags == FMTP_RETX_REJ) {
-            const bool hadBop = rmMisBOPinSet(header.prodindex);
-            /*
-             * if associated segmap exists, remove the segmap. Also avoid
-             * duplicated notification if the product's segmap has
-             * already been removed.
-             */
-            if (pSegMNG->rmProd(header.prodindex) || hadBop) {
-                #ifdef MODBASE
-                    uint32_t tmpidx = header.prodindex % MODBASE;
-                #else
-                    uint32_t tmpidx = header.prodindex;
-                #endif
-
-                #ifdef DEBUG2
-                    std::string debugmsg = "[FAILURE] Product #" +
-                        std::to_string(tmpidx);
-                    debugmsg += " is not completely received";
-                    std::cout << debugmsg << std::endl;
-                    WriteToLog(debugmsg);
-                #endif
-
-                if (notifier) {
-                    notifier->missedProd(header.prodindex);
-                }
-                else {
-                    /**
-                     * Updates the most recently acknowledged product and
-                     * notifies a dummy notification handler (getNotify()).
-                     */
-                    {
-                        std::unique_lock<std::mutex> lock(notifyprodmtx);
-                        notifyprodidx = header.prodindex;
-                    }
-                    notify_cv.notify_one();
-                }
 
-                {
-                    std::unique_lock<std::mutex> lock(trackermtx);
-                    trackermap.erase(header.prodindex);
-                }
+        resend.clear();
+        giveup.clear();
+        reqTracker->expire(resend, giveup);
+        for (size_t i = 0; i < resend.size(); i++) {
+            FmtpHeader reqheader;
+            reqheader.prodindex  = htonl(resend[i].prodindex);
+            reqheader.seqnum     = htonl(resend[i].seqnum);
+            reqheader.payloadlen = htons(resend[i].payloadlen);
+            reqheader.flags      = htons(FMTP_RETX_REQ);
+            try {
+                udpretx->send(&reqheader, sizeof(reqheader));
+            }
+            catch (const std::system_error& e) {
+                /* the timer stays armed, so it's retried or given up on */
+            }
+        }
+        if (!giveup.empty()) {
+            std::vector<INLReqMsg> reqs;
+            for (size_t i = 0; i < giveup.size(); i++) {
+                INLReqMsg reqmsg = {MISSING_DATA_TCP, giveup[i].prodindex,
+                                    giveup[i].seqnum, giveup[i].payloadlen};
+                reqs.push_back(reqmsg);
             }
+            nacks->push(reqs);
         }
     }
 
@@ -1346,42 +2851,60 @@ void fmtpRecvv3::retxHandler()
 
 
 /**
- * Fetch the requests from an internal message queue and call corresponding
- * handler to send requests respectively. The read operation on the internal
- * message queue will block if the queue is empty itself. The existing request
- * being handled will only be removed from the queue if the handler returns a
- * successful state. Doesn't return until a "shutdown" request is encountered or
- * an error occurs.
+ * Fetch the requests from the NACK scheduler and send them. Blocks while
+ * there are none. Every request that's waiting is taken at once, in priority
+ * order, and the ones that go over the TCP connection are written together,
+ * so that a burst of losses costs one write rather than one per request. The
+ * products that the scheduler has given up on are given up on here too, and
+ * the sender is told with FMTP_RETX_GIVEUP. Requests that couldn't be written
+ * are dropped and requested again when the connection is re-established.
+ * Doesn't return until the scheduler is stopped or an error occurs.
  *
  * @param[in] none
  */
 void fmtpRecvv3::retxRequester()
 {
-    while(1)
-    {
-        INLReqMsg reqmsg;
+    std::vector<INLReqMsg>  reqs;
+    std::vector<NackGiveUp> giveups;
+    std::vector<char>       batch;
+    bool                    run = true;
 
-        {
-            std::unique_lock<std::mutex> lock(msgQmutex);
-            while (msgqueue.empty())
-                msgQfilled.wait(lock);
-            reqmsg = msgqueue.front();
-        }
-
-        if (reqmsg.reqtype == SHUTDOWN)
-            break; // leave "shutdown" message in queue
-
-        if ( ((reqmsg.reqtype == MISSING_BOP) &&
-                sendBOPRetxReq(reqmsg.prodindex)) ||
-            ((reqmsg.reqtype == MISSING_DATA) &&
-                sendDataRetxReq(reqmsg.prodindex, reqmsg.seqnum,
-                                reqmsg.payloadlen)) ||
-            ((reqmsg.reqtype == MISSING_EOP) &&
-                sendEOPRetxReq(reqmsg.prodindex)) )
-        {
-            std::unique_lock<std::mutex> lock(msgQmutex);
-            msgqueue.pop();
+    while (run)
+    {
+        run = nacks->take(reqs, giveups);
+
+        batch.clear();
+        for (size_t i = 0; i < giveups.size(); i++) {
+            /* products skipped by a resync were never tracked */
+            if (giveups[i].count == 1)
+                abandonProd(giveups[i].prodindex);
+            addRetxReq(batch, FMTP_RETX_GIVEUP, giveups[i].prodindex,
+                       giveups[i].count, 0);
+        }
+        for (size_t i = 0; i < reqs.size(); i++) {
+            const INLReqMsg& reqmsg = reqs[i];
+            if (reqmsg.reqtype == MISSING_BOP) {
+                addRetxReq(batch, FMTP_BOP_REQ, reqmsg.prodindex, 0, 0);
+            }
+            else if (reqmsg.reqtype == MISSING_DATA) {
+                addDataRetxReq(batch, reqmsg.prodindex, reqmsg.seqnum,
+                               reqmsg.payloadlen);
+            }
+            else if (reqmsg.reqtype == MISSING_DATA_TCP) {
+                addDataRetxReq(batch, reqmsg.prodindex, reqmsg.seqnum,
+                               reqmsg.payloadlen, true);
+            }
+            else if (reqmsg.reqtype == MISSING_EOP) {
+                addRetxReq(batch, FMTP_EOP_REQ, reqmsg.prodindex, 0, 0);
+            }
         }
+
+        /*
+         * The connection is broken; the batch goes with it and
+         * resyncRetx() requests again what's missing once it's back.
+         */
+        if (!batch.empty())
+            (void)tcprecv->sendData(batch.data(), batch.size(), NULL, 0);
     }
 }
 
@@ -1395,9 +2918,7 @@ void fmtpRecvv3::retxRequester()
  */
 bool fmtpRecvv3::rmMisBOPinSet(uint32_t prodindex)
 {
-    std::unique_lock<std::mutex> lock(BOPSetMtx);
-    bool rmsuccess = misBOPset.erase(prodindex);
-    return rmsuccess;
+    return prodTable->rmBop(prodindex);
 }
 
 
@@ -1406,11 +2927,13 @@ bool fmtpRecvv3::rmMisBOPinSet(uint32_t prodindex)
  * just call the handling process directly.
  *
  * @param[in] FmtpHeader    Reference to the received FMTP packet header
+ * @param[in] payload       Payload of the EOP.
  * @throw std::out_of_range   The notifier doesn't know about
  *                            `header.prodindex`.
  * @throw std::runtime_error  Receiving application error.
  */
-void fmtpRecvv3::retxEOPHandler(const FmtpHeader& header)
+void fmtpRecvv3::retxEOPHandler(const FmtpHeader& header,
+                                const char* const payload)
 {
     #ifdef MODBASE
         uint32_t tmpidx = header.prodindex % MODBASE;
@@ -1426,15 +2949,8 @@ void fmtpRecvv3::retxEOPHandler(const FmtpHeader& header)
         WriteToLog(debugmsg);
     #endif
 
-    bool hasBOP = false;
-    {
-        std::unique_lock<std::mutex> lock(trackermtx);
-        if (trackermap.count(header.prodindex)) {
-            hasBOP = true;
-        }
-    }
-    if (hasBOP) {
-        EOPHandler(header);
+    if (prodTable->isTracked(header.prodindex)) {
+        EOPHandler(header, payload);
     }
     else {
         /**
@@ -1458,76 +2974,38 @@ void fmtpRecvv3::retxEOPHandler(const FmtpHeader& header)
 
 
 /**
- * Reads the data portion of a FMTP data-packet into the location specified
- * by the receiving application given the associated, peeked-at, and decoded
- * FMTP header.
+ * Copies the data portion of a FMTP data-packet into the location specified
+ * by the receiving application given the associated and decoded FMTP header.
  *
- * @pre                       The socket contains a FMTP data-packet.
- * @param[in] header          The associated, peeked-at, and decoded header.
- * @throw std::runtime_error  if an error occurs while reading the multicast
- *                            socket.
- * @throw std::runtime_error  if the packet is invalid.
+ * @param[in] header          The associated and decoded header.
+ * @param[in] payload         The payload of the received packet.
+ * @param[in] prodptr         Where the product is written to, or NULL if the
+ *                            receiving application ignores it.
  */
-void fmtpRecvv3::readMcastData(const FmtpHeader& header)
+void fmtpRecvv3::readMcastData(const FmtpHeader& header,
+                               const char* const payload, void* const prodptr)
 {
-    ssize_t nbytes = 0;
-    void*   prodptr = NULL;
-    {
-        std::unique_lock<std::mutex> lock(trackermtx);
-        if (trackermap.count(header.prodindex)) {
-            ProdTracker tracker = trackermap[header.prodindex];
-            prodptr = tracker.prodptr;
-        }
-    }
-
-    if (0 == prodptr) {
-        const int bufsize = FMTP_HEADER_LEN + header.payloadlen;
-        char pktbuf[bufsize];
-        nbytes = read(mcastSock, &pktbuf, bufsize);
-    }
-    else {
-        struct iovec iovec[2];
-        FmtpHeader  headBuf; // ignored because already have peeked-at header
-
-        iovec[0].iov_base = &headBuf;
-        iovec[0].iov_len  = sizeof(headBuf);
-        iovec[1].iov_base = (char*)prodptr + header.seqnum;
-        iovec[1].iov_len  = header.payloadlen;
-
-        nbytes = readv(mcastSock, iovec, 2);
-    }
-
-    if (nbytes == -1) {
-        throw std::system_error(errno, std::system_category(),
-                "fmtpRecvv3::readMcastData(): readv() EOF.");
+    if (prodptr) {
+        (void)memcpy((char*)prodptr + header.seqnum, payload,
+                     header.payloadlen);
     }
-    else {
-        checkPayloadLen(header, nbytes);
-
-        #ifdef MODBASE
-            uint32_t tmpidx = header.prodindex % MODBASE;
-        #else
-            uint32_t tmpidx = header.prodindex;
-        #endif
 
-        #ifdef DEBUG2
-            std::string debugmsg = "[MCAST DATA] Product #" +
-                std::to_string(tmpidx);
-            debugmsg += ": Data block received from multicast. SeqNum = ";
-            debugmsg += std::to_string(header.seqnum);
-            debugmsg += ", Paylen = ";
-            debugmsg += std::to_string(header.payloadlen);
-            std::cout << debugmsg << std::endl;
-            WriteToLog(debugmsg);
-        #endif
+    #ifdef MODBASE
+        uint32_t tmpidx = header.prodindex % MODBASE;
+    #else
+        uint32_t tmpidx = header.prodindex;
+    #endif
 
-        /**
-         * Since now receiver has no knowledge about the segment size, it
-         * trusts the packet from sender is legal. Also, ProdBlockMNG has
-         * control to make sure no malicious segments will be ACKed.
-         */
-        pSegMNG->set(header.prodindex, header.seqnum, header.payloadlen);
-    }
+    #ifdef DEBUG2
+        std::string debugmsg = "[MCAST DATA] Product #" +
+            std::to_string(tmpidx);
+        debugmsg += ": Data block received from multicast. SeqNum = ";
+        debugmsg += std::to_string(header.seqnum);
+        debugmsg += ", Paylen = ";
+        debugmsg += std::to_string(header.payloadlen);
+        std::cout << debugmsg << std::endl;
+        WriteToLog(debugmsg);
+    #endif
 }
 
 
@@ -1541,28 +3019,36 @@ void fmtpRecvv3::readMcastData(const FmtpHeader& header)
  * @param[in] prodindex  Product index.
  * @param[in] mostRecent The most recently-received data-packet of the current
  *                       data-product.
+ * @return               Number of blocks requested.
  */
-void fmtpRecvv3::requestAnyMissingData(const uint32_t prodindex,
-                                       const uint32_t mostRecent)
+uint32_t fmtpRecvv3::requestAnyMissingData(const uint32_t prodindex,
+                                           const uint32_t mostRecent)
 {
-    uint32_t seqnum = 0;
-    {
-        std::unique_lock<std::mutex> lock(trackermtx);
-        if (trackermap.count(prodindex)) {
-            ProdTracker tracker = trackermap[prodindex];
-            seqnum = tracker.seqnum + tracker.paylen;
-        }
-    }
+    uint32_t    blocks = 0;
+    uint32_t    seqnum = 0;
+    ProdTracker tracker;
+    if (prodTable->getProd(prodindex, tracker))
+        seqnum = tracker.seqnum + tracker.paylen;
 
     /**
      * requests for missing blocks counting from the last received
-     * block sequence number.
+     * block sequence number. The bitmap leaves out blocks that are already
+     * there, e.g., retransmitted ones or ones copied from the base of a
+     * revision.
      */
-    if (seqnum != mostRecent) {
-        std::unique_lock<std::mutex> lock(msgQmutex);
+    std::vector<MissingRange> missing;
+    if (seqnum < mostRecent)
+        prodTable->getMissing(prodindex, seqnum, mostRecent, missing);
+
+    if (!missing.empty()) {
+        std::vector<INLReqMsg> reqs;
 
-        for (; seqnum < mostRecent; seqnum += FMTP_DATA_LEN) {
-            pushMissingDataReq(prodindex, seqnum, FMTP_DATA_LEN);
+        /* merged requests, multiple missing blocks in one request */
+        for (size_t i = 0; i < missing.size(); i++) {
+            INLReqMsg reqmsg = {MISSING_DATA, prodindex, missing[i].seqnum,
+                                missing[i].length};
+            reqs.push_back(reqmsg);
+            blocks += (missing[i].length + FMTP_DATA_LEN - 1) / FMTP_DATA_LEN;
 
             #ifdef MODBASE
                 uint32_t tmpidx = prodindex % MODBASE;
@@ -1573,32 +3059,198 @@ void fmtpRecvv3::requestAnyMissingData(const uint32_t prodindex,
             #ifdef DEBUG2
                 std::string debugmsg = "[RETX REQ] Product #" +
                     std::to_string(tmpidx);
-                debugmsg += ": Data block is missing. SeqNum = ";
-                debugmsg += std::to_string(seqnum);
+                debugmsg += ": Data blocks are missing. SeqNum = ";
+                debugmsg += std::to_string(missing[i].seqnum);
                 debugmsg += ", PayLen = ";
-                debugmsg += std::to_string(mostRecent - seqnum);
+                debugmsg += std::to_string(missing[i].length);
                 debugmsg += ". Request retx.";
                 std::cout << debugmsg << std::endl;
                 WriteToLog(debugmsg);
             #endif
         }
 
-        // TODO: Merged RETX_REQ cannot be implemented so far, because
-        // current FMTP header has a limited payloadlen field of 16 bits.
-        // A merged RETX_REQ could have more than 65535 in payloadlen, the
-        // field thus needs to be upgraded to 32 bits. We will do this in
-        // the next version of FMTP.
-        //
-        /* merged requests, multiple missing blocks in one request */
-        // pushMissingDataReq(prodindex, seqnum, mostRecent - seqnum);
+        nacks->push(reqs);
+    }
+
+    return blocks;
+}
+
+
+/**
+ * Puts the gap between the last in-order block of a product and a block
+ * further on into the reorder window instead of requesting its blocks: a
+ * block that was merely reordered on the way fills its part of the gap
+ * before the window ends. The window ends after `reorderPkts` more multicast
+ * packets or `reorderNs`, whichever comes first. Gaps are put in the order
+ * their windows end in. Called by the multicast thread only.
+ *
+ * @param[in] prodindex  Product index.
+ * @param[in] mostRecent The most recently-received data-packet of the
+ *                       product.
+ */
+void fmtpRecvv3::deferMissingData(const uint32_t prodindex,
+                                  const uint32_t mostRecent)
+{
+    ProdTracker tracker;
+    if (!prodTable->getProd(prodindex, tracker))
+        return;
+    const uint32_t seqnum = tracker.seqnum + tracker.paylen;
+    if (seqnum >= mostRecent)
+        return;
+
+    /* blocks of a revision copied from its base aren't missing */
+    std::vector<MissingRange> missing;
+    prodTable->getMissing(prodindex, seqnum, mostRecent, missing);
+    uint32_t blocks = 0;
+    for (size_t i = 0; i < missing.size(); i++)
+        blocks += (missing[i].length + FMTP_DATA_LEN - 1) / FMTP_DATA_LEN;
+    if (blocks == 0)
+        return;
+
+    const PendingGap gap = {prodindex, seqnum, mostRecent - seqnum, blocks,
+            reorderPkts ? mcastPkts + reorderPkts : UINT64_MAX,
+            reorderNs ? mcastNow + reorderNs : INT64_MAX};
+    std::unique_lock<std::mutex> lock(reorderMtx);
+    reorderGaps.push_back(gap);
+    reorderPending.store(reorderGaps.size(), std::memory_order_relaxed);
+}
+
+
+/**
+ * Requests the blocks that are still missing of the gaps whose reorder
+ * window has ended. Called by the multicast thread only, at every packet.
+ *
+ * @param[in] none
+ */
+void fmtpRecvv3::releaseGaps()
+{
+    std::vector<PendingGap> due;
+    {
+        std::unique_lock<std::mutex> lock(reorderMtx);
+        while (!reorderGaps.empty() &&
+                (reorderGaps.front().pktDue <= mcastPkts ||
+                 reorderGaps.front().nsDue <= mcastNow)) {
+            due.push_back(reorderGaps.front());
+            reorderGaps.pop_front();
+        }
+        reorderPending.store(reorderGaps.size(), std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < due.size(); i++)
+        requestGap(due[i]);
+}
+
+
+/**
+ * Requests the blocks that are still missing of a product's gaps at once.
+ * Called once the EOP of the product has arrived, which ends the multicast
+ * of the product.
+ *
+ * @param[in] prodindex  Product index.
+ */
+void fmtpRecvv3::flushGaps(const uint32_t prodindex)
+{
+    std::vector<PendingGap> gaps;
+    {
+        std::unique_lock<std::mutex> lock(reorderMtx);
+        for (std::deque<PendingGap>::iterator it = reorderGaps.begin();
+                it != reorderGaps.end(); ) {
+            if (it->prodindex == prodindex) {
+                gaps.push_back(*it);
+                it = reorderGaps.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        reorderPending.store(reorderGaps.size(), std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < gaps.size(); i++)
+        requestGap(gaps[i]);
+}
+
+
+/**
+ * Requests the blocks of a gap that haven't arrived, late or retransmitted,
+ * while it waited in the reorder window. Nothing is requested for a product
+ * that is no longer tracked.
+ *
+ * @param[in] gap  The gap.
+ */
+void fmtpRecvv3::requestGap(const PendingGap& gap)
+{
+    if (!prodTable->isTracked(gap.prodindex))
+        return;
+
+    std::vector<MissingRange> missing;
+    prodTable->getMissing(gap.prodindex, gap.seqnum, gap.seqnum + gap.length,
+                          missing);
+
+    std::vector<INLReqMsg> reqs;
+    uint32_t               blocks = 0;
+    for (size_t i = 0; i < missing.size(); i++) {
+        INLReqMsg reqmsg = {MISSING_DATA, gap.prodindex, missing[i].seqnum,
+                            missing[i].length};
+        reqs.push_back(reqmsg);
+        blocks += (missing[i].length + FMTP_DATA_LEN - 1) / FMTP_DATA_LEN;
+    }
+    if (!reqs.empty())
+        nacks->push(reqs);
+
+    gapsNacked.fetch_add(blocks, std::memory_order_relaxed);
+    gapsSuppressed.fetch_add(gap.blocks > blocks ? gap.blocks - blocks : 0,
+                             std::memory_order_relaxed);
+
+    #ifdef DEBUG2
+        std::string debugmsg = "[REORDER] Product #" +
+            std::to_string(gap.prodindex);
+        debugmsg += ": " + std::to_string(blocks) + " of ";
+        debugmsg += std::to_string(gap.blocks);
+        debugmsg += " missing blocks of the gap at SeqNum = ";
+        debugmsg += std::to_string(gap.seqnum) + " are requested";
+        std::cout << debugmsg << std::endl;
+        WriteToLog(debugmsg);
+    #endif
+}
 
-        msgQfilled.notify_one();
+
+/**
+ * Requests the ranges of a product whose blocks were all received but didn't
+ * match the checksums from the sender. Their blocks have been cleared, so
+ * they're stored again when the retransmissions arrive and the product is
+ * checked again once it's complete.
+ *
+ * @param[in] prodindex  Product index.
+ * @param[in] corrupt    The ranges.
+ */
+void fmtpRecvv3::requestCorruptData(const uint32_t prodindex,
+                                    const std::vector<MissingRange>& corrupt)
+{
+    std::vector<INLReqMsg> reqs;
+    for (size_t i = 0; i < corrupt.size(); i++) {
+        INLReqMsg reqmsg = {MISSING_DATA, prodindex, corrupt[i].seqnum,
+                            corrupt[i].length};
+        reqs.push_back(reqmsg);
+
+        #ifdef LDM_LOGGING
+            log_warning("Product %lu failed its checksum: requesting bytes "
+                    "%lu through %lu again", (unsigned long)prodindex,
+                    (unsigned long)corrupt[i].seqnum,
+                    (unsigned long)corrupt[i].seqnum + corrupt[i].length - 1);
+        #endif
     }
+    corruptProds.fetch_add(1, std::memory_order_relaxed);
+    nacks->push(reqs);
 }
 
 
 /**
- * Requests BOP packets for a prodindex interval.
+ * Requests BOP packets for a prodindex interval. An interval of more products
+ * than the NACK scheduler can hold, e.g., after the sender restarted with
+ * other product indexes or after a long outage, isn't requested: the receiver
+ * resynchronizes to the new index and the sender is told that the products of
+ * the interval are given up on.
  *
  * @param[in] openleft   Open left end of the prodindex interval.
  * @param[in] openright  Open right end of the prodindex interval.
@@ -1606,13 +3258,32 @@ void fmtpRecvv3::requestAnyMissingData(const uint32_t prodindex,
 void fmtpRecvv3::requestMissingBops(const uint32_t openleft,
                                      const uint32_t openright)
 {
-    if (openright - openleft > 1) {
-        for (uint32_t i = (openleft + 1); i != openright; i++) {
-            if (addUnrqBOPinSet(i)) {
-                pushMissingBopReq(i);
-            }
+    /*
+     * Serial-number arithmetic: a late packet of an older product makes a
+     * backward interval, which has no products in it.
+     */
+    if ((int32_t)(openright - openleft) <= 1)
+        return;
+
+    const uint32_t count = openright - openleft - 1;
+    if (count > nacks->getLimit()) {
+        #ifdef LDM_LOGGING
+            log_notice("Resynchronizing: skipping %lu products after "
+                    "product %lu", (unsigned long)count,
+                    (unsigned long)openleft);
+        #endif
+        nacks->giveUp(openleft + 1, count);
+        return;
+    }
+
+    std::vector<INLReqMsg> reqs;
+    for (uint32_t i = (openleft + 1); i != openright; i++) {
+        if (addUnrqBOPinSet(i)) {
+            INLReqMsg reqmsg = {MISSING_BOP, i, 0, 0};
+            reqs.push_back(reqmsg);
         }
     }
+    nacks->push(reqs);
 }
 
 
@@ -1631,7 +3302,8 @@ int fmtpRecvv3::requestMissingBopsExclusive(const uint32_t prodindex)
     /* fetches the most recent product index */
     uint32_t lastprodidx = prodidx_mcast;
 
-    if (prodindex - lastprodidx > 0) {
+    /* a late packet of an older product doesn't move the index back */
+    if ((int32_t)(prodindex - lastprodidx) > 0) {
         prodidx_mcast = prodindex;
     }
 
@@ -1656,7 +3328,8 @@ int fmtpRecvv3::requestMissingBopsInclusive(const uint32_t prodindex)
     /* fetches the most recent product index */
     uint32_t lastprodidx = prodidx_mcast;
 
-    if (prodindex - lastprodidx > 0) {
+    /* a late packet of an older product doesn't move the index back */
+    if ((int32_t)(prodindex - lastprodidx) > 0) {
         prodidx_mcast = prodindex;
     }
 
@@ -1667,88 +3340,218 @@ int fmtpRecvv3::requestMissingBopsInclusive(const uint32_t prodindex)
 
 
 /**
- * Handles a multicast FMTP data-packet given the associated peeked-at and
- * decoded FMTP header. Directly store and check for missing blocks.
+ * Copies the multicast blocks that arrived before the BOP of a product into
+ * the product, as if they had just arrived. Called once the product is
+ * tracked. The missing blocks before the last of them are requested and
+ * that one becomes the product's last block, so the EOP, which takes all
+ * gaps to be requested once the last block is there, and the next multicast
+ * block carry on from it. A block that is stored while this runs stays in
+ * the pool until it's evicted and is retransmitted instead.
  *
- * @pre                       The socket contains a FMTP data-packet.
- * @param[in] header          The associated, peeked-at and decoded header.
- * @throw std::runtime_error  if `seqnum + payloadlen` is out of boundary.
- * @throw std::runtime_error  if the packet is invalid.
- * @throw std::runtime_error   if an error occurs while reading the socket.
+ * @param[in] prodindex       Index of the product.
+ * @return                    Whether any blocks were adopted.
  */
-void fmtpRecvv3::recvMemData(const FmtpHeader& header)
+bool fmtpRecvv3::adoptOrphans(const uint32_t prodindex)
 {
-    //int state = 0;
-    uint32_t prodsize = 0;
+    std::vector<OrphanBlock> blocks;
+    orphans->take(prodindex, blocks);
+    if (blocks.empty())
+        return false;
+
+    const OrphanBlock* top = NULL;
     {
-        std::unique_lock<std::mutex> lock(trackermtx);
-        if (trackermap.count(header.prodindex)) {
-            ProdTracker tracker = trackermap[header.prodindex];
-            prodsize = tracker.prodsize;
+        ProdStatePin pin(*prodTable, prodindex);
+        for (size_t i = 0; pin && i < blocks.size(); i++) {
+            const OrphanBlock& block = blocks[i];
+            if (block.seqnum + block.length > pin->prodsize)
+                continue;
+            if (pin->prodptr && !pin->bitmap.isReceived(block.seqnum)) {
+                (void)memcpy((char*)pin->prodptr + block.seqnum,
+                             orphans->data(block), block.length);
+            }
+            (void)pin->bitmap.set(block.seqnum, block.length, pin->prodptr);
+            if (top == NULL || block.seqnum > top->seqnum)
+                top = &block;
         }
     }
 
-    if ((prodsize > 0) && (header.seqnum + header.payloadlen > prodsize)) {
-        throw std::runtime_error(
-            std::string("fmtpRecvv3::recvMemData() block out of boundary: ") +
-            "seqnum=" + std::to_string(header.seqnum) + ", payloadlen=" +
-            std::to_string(header.payloadlen) + ", prodsize=" +
-            std::to_string(prodsize));
+    if (top) {
+        std::unique_lock<std::mutex> lock(antiracemtx);
+        ProdTracker                  tracker;
+        if (prodTable->getProd(prodindex, tracker) &&
+                top->seqnum >= tracker.seqnum + tracker.paylen) {
+            requestAnyMissingData(prodindex, top->seqnum);
+            prodTable->setLast(prodindex, top->seqnum, top->length);
+        }
     }
+    orphans->release(blocks);
 
-    /**
-     * If prodsize > 0, the BOP of the currently receiving product is
-     * received, otherwise, it is either removed or not even received.
-     * Since this function is called by multicast thread, it is likely
-     * to be the first time a product arrives. So BOP loss is the only
-     * possibility.
-     */
-    if (prodsize > 0) {
-        readMcastData(header);
-        {
-            std::unique_lock<std::mutex> lock(antiracemtx);
-            requestAnyMissingData(header.prodindex, header.seqnum);
-            /* update most recent seqnum and payloadlen */
-            {
-                std::unique_lock<std::mutex> lock(trackermtx);
-                if (trackermap.count(header.prodindex)) {
-                    trackermap[header.prodindex].seqnum = header.seqnum;
-                    trackermap[header.prodindex].paylen = header.payloadlen;
-                }
+    #ifdef DEBUG2
+        std::string debugmsg = "[ORPHANS] Product #" +
+            std::to_string(prodindex);
+        debugmsg += ": " + std::to_string(blocks.size());
+        debugmsg += " blocks received before the BOP are stored";
+        std::cout << debugmsg << std::endl;
+        WriteToLog(debugmsg);
+    #endif
+
+    return true;
+}
+
+
+/**
+ * Handles a multicast FMTP data-packet given the associated decoded FMTP
+ * header. Directly store and check for missing blocks. A block that follows
+ * the previous one takes no lock; only a gap is handled under the lock
+ * shared with the retransmission thread. The blocks of a gap are requested
+ * at once or, with a reorder window, once the window ends. A late block
+ * fills its part of a gap and leaves the last block as it is. The block
+ * that completes the product ends it without waiting for the EOP.
+ *
+ * @param[in] header          The associated and decoded header.
+ * @param[in] payload         The payload of the received packet.
+ * @throw std::runtime_error  if `seqnum + payloadlen` is out of boundary.
+ * @throw std::out_of_range   The notifier doesn't know about the product.
+ * @throw std::runtime_error  Receiving application error.
+ */
+void fmtpRecvv3::recvMemData(const FmtpHeader& header,
+                             const char* const payload)
+{
+    bool complete;
+    {
+        ProdStatePin pin(*prodTable, header.prodindex);
+
+        /**
+         * If the product is tracked, the BOP of the currently receiving
+         * product is received, otherwise, it is either removed or not even
+         * received. Since this function is called by multicast thread, it is
+         * likely to be the first time a product arrives. So BOP loss is the
+         * only possibility.
+         */
+        if (!pin || pin->prodsize == 0) {
+            (void)requestMissingBopsInclusive(header.prodindex);
+            /* kept until the BOP is retransmitted, see adoptOrphans() */
+            if (!pin && orphans &&
+                    prodTable->isBopRequested(header.prodindex)) {
+                (void)orphans->add(header.prodindex, header.seqnum, payload,
+                                   header.payloadlen);
             }
+            return;
+        }
+
+        if (header.seqnum + header.payloadlen > pin->prodsize) {
+            throw std::runtime_error(
+                std::string("fmtpRecvv3::recvMemData() block out of "
+                "boundary: ") + "seqnum=" + std::to_string(header.seqnum) +
+                ", payloadlen=" + std::to_string(header.payloadlen) +
+                ", prodsize=" + std::to_string(pin->prodsize));
+        }
+
+        /* a duplicate mustn't overwrite a block that has been hashed */
+        readMcastData(header, payload,
+                      pin->bitmap.isReceived(header.seqnum) ? NULL :
+                      pin->prodptr);
+        /**
+         * Since now receiver has no knowledge about the segment size, it
+         * trusts the packet from sender is legal. Also, ProdBitmap has
+         * control to make sure no malicious segments will be ACKed.
+         */
+        (void)pin->bitmap.set(header.seqnum, header.payloadlen,
+                              pin->prodptr);
+        pin->lastArrival.store(mcastNow, std::memory_order_relaxed);
+        complete = pin->bitmap.isComplete();
+        if (progressStep && !complete)
+            reportProgress(header.prodindex);
+
+        /* only this thread updates the most recent block */
+        const uint64_t last = pin->last.load(std::memory_order_relaxed);
+        if (header.seqnum == (last >> 32) + (last & 0xFFFF)) {
+            pin->last.store((uint64_t)header.seqnum << 32 | header.payloadlen,
+                            std::memory_order_relaxed);
+            if (!complete)
+                return;
         }
     }
-    else {
-        char buf[1];
-        (void)recv(mcastSock, buf, 1, 0); // skip unusable datagram
-        (void)requestMissingBopsInclusive(header.prodindex);
+
+    if (complete) {
+        endProdBeforeEOP(header.prodindex);
+        return;
     }
 
-#if 0
-    /* records the most recent product index */
-    if (state == 1) {
-        prodidx_mcast = header.prodindex;
+    std::unique_lock<std::mutex> lock(antiracemtx);
+    if (reorderPkts || reorderNs) {
+        deferMissingData(header.prodindex, header.seqnum);
+    }
+    else {
+        gapsNacked.fetch_add(requestAnyMissingData(header.prodindex,
+                header.seqnum), std::memory_order_relaxed);
+    }
+    /* update most recent seqnum and payloadlen, unless the block is late */
+    ProdTracker tracker;
+    if (prodTable->getProd(header.prodindex, tracker) &&
+            header.seqnum > tracker.seqnum) {
+        prodTable->setLast(header.prodindex, header.seqnum,
+                           header.payloadlen);
     }
-#endif
 }
 
 
 /**
- * Request for EOP retransmission if the EOP is not received. This function is
- * an integration of isEOPReceived() and pushMissingEopReq() but being made
- * atomic. If the EOP is requested by this function, it returns a boolean true.
- * Otherwise, if not requested, it returns a boolean false.
+ * Requests the EOPs that haven't been received of the products whose EOP
+ * deadlines have passed. The requests are pushed onto the retransmission-
+ * request queue together, so the requester is woken once per batch. The EOP
+ * status of every product is cleared afterwards; only the timer clears it.
+ * How long after its last multicast packet each missing EOP was detected is
+ * added to the detection histogram. A product whose blocks have all arrived
+ * is ended instead of having its EOP requested.
  *
- * @param[in] prodindex        Product index which the EOP is using.
+ * @param[in] prodindexes      Product indexes.
+ * @throws std::out_of_range   The notifier doesn't know about a product.
+ * @throws std::runtime_error  Receiving application error.
  */
-bool fmtpRecvv3::reqEOPifMiss(const uint32_t prodindex)
+void fmtpRecvv3::reqEOPsifMiss(const std::vector<uint32_t>& prodindexes)
 {
-    bool hasReq = false;
-    if (!getEOPStatus(prodindex)) {
-        pushMissingEopReq(prodindex);
-        hasReq = true;
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    struct timespec realNow;
+    (void)clock_gettime(CLOCK_REALTIME, &realNow);
+    std::vector<uint32_t> missing;
+    for (size_t i = 0; i < prodindexes.size(); i++) {
+        if (!getEOPStatus(prodindexes[i])) {
+            /* only waited for its checksums, see endProdBeforeEOP() */
+            if (endProdIfComplete(prodindexes[i], realNow))
+                continue;
+            missing.push_back(prodindexes[i]);
+            ProdTracker tracker;
+            if (prodTable->getProd(prodindexes[i], tracker))
+                eopDetect->add(now - tracker.lastArrival);
+        }
+        clearEOPStatus(prodindexes[i]);
+    }
+    if (missing.empty())
+        return;
+
+    std::vector<INLReqMsg> reqs;
+    for (size_t i = 0; i < missing.size(); i++) {
+        INLReqMsg reqmsg = {MISSING_EOP, missing[i], 0, 0};
+        reqs.push_back(reqmsg);
+    }
+    nacks->push(reqs);
+
+    #ifdef DEBUG2
+    for (size_t i = 0; i < missing.size(); i++) {
+        #ifdef MODBASE
+            uint32_t tmpidx = missing[i] % MODBASE;
+        #else
+            uint32_t tmpidx = missing[i];
+        #endif
+        std::string debugmsg = "[TIMER] Timer has waken up. Product #" +
+                std::to_string(tmpidx);
+        debugmsg += " is still missing EOP. Request retx.";
+        std::cout << debugmsg << std::endl;
+        WriteToLog(debugmsg);
     }
-    return hasReq;
+    #endif
 }
 
 
@@ -1777,60 +3580,130 @@ void* fmtpRecvv3::runTimerThread(void* ptr)
 
 
 /**
- * Sends a request for retransmission of the missing BOP identified by the
- * given product index.
+ * Start the notification thread.
  *
- * @param[in] prodindex        The product index of the requested BOP.
+ * @param[in] *ptr    A pointer to an fmtpRecvv3 instance.
  */
-bool fmtpRecvv3::sendBOPRetxReq(uint32_t prodindex)
+void* fmtpRecvv3::runNotifyThread(void* ptr)
 {
-    FmtpHeader header;
-    header.prodindex  = htonl(prodindex);
-    header.seqnum     = 0;
-    header.payloadlen = 0;
-    header.flags      = htons(FMTP_BOP_REQ);
-
-    return (-1 != tcprecv->sendData(&header, sizeof(FmtpHeader), NULL, 0));
+#ifdef LDM_LOGGING
+    pthread_cleanup_push(freeLogging, nullptr);
+#endif
+    fmtpRecvv3* const recvr = static_cast<fmtpRecvv3*>(ptr);
+    try {
+        recvr->notifyThread();
+    }
+    catch (std::runtime_error& e) {
+        /* nothing takes the events anymore, so nothing may wait for room */
+        recvr->notifyQueue->stop();
+        recvr->taskExit(std::current_exception());
+    }
+#ifdef LDM_LOGGING
+    pthread_cleanup_pop(true);
+#endif
+    return NULL;
 }
 
 
 /**
- * Sends a request for retransmission of the missing EOP identified by the
- * given product index.
+ * Appends a request to a batch of requests for the TCP connection. A data
+ * request whose range doesn't fit in the 16-bit payloadlen becomes a
+ * FMTP_RETX_REQ_WIDE, which carries the length as its payload.
  *
- * @param[in] prodindex        The product index of the requested EOP.
+ * @param[in,out] batch        The batch.
+ * @param[in]     flags        FMTP_BOP_REQ, FMTP_EOP_REQ, FMTP_RETX_REQ or
+ *                             FMTP_RETX_GIVEUP.
+ * @param[in]     prodindex    The product index of the request.
+ * @param[in]     seqnum       The sequence number of the first block.
+ * @param[in]     length       Amount of data in bytes.
  */
-bool fmtpRecvv3::sendEOPRetxReq(uint32_t prodindex)
+void fmtpRecvv3::addRetxReq(std::vector<char>& batch, uint16_t flags,
+                            uint32_t prodindex, uint32_t seqnum,
+                            uint32_t length)
 {
+    const bool wide   = length > UINT16_MAX;
+    const size_t size = batch.size();
+
     FmtpHeader header;
     header.prodindex  = htonl(prodindex);
-    header.seqnum     = 0;
-    header.payloadlen = 0;
-    header.flags      = htons(FMTP_EOP_REQ);
-
-    return (-1 != tcprecv->sendData(&header, sizeof(FmtpHeader), NULL, 0));
+    header.seqnum     = htonl(seqnum);
+    header.payloadlen = htons(wide ? RETX_WIDE_LEN : length);
+    header.flags      = htons(wide ? FMTP_RETX_REQ_WIDE : flags);
+
+    batch.resize(size + sizeof(FmtpHeader) + (wide ? RETX_WIDE_LEN : 0));
+    (void)memcpy(&batch[size], &header, sizeof(FmtpHeader));
+    if (wide) {
+        const uint32_t netlen = htonl(length);
+        (void)memcpy(&batch[size + sizeof(FmtpHeader)], &netlen,
+                     RETX_WIDE_LEN);
+    }
 }
 
 
 /**
- * Sends a request for retransmission of the missing block. The sequence
- * number and payload length are guaranteed to be aligned to the boundary of
- * a legal block.
+ * Requests retransmission of a range of missing blocks. The sequence number is
+ * guaranteed to be aligned to the boundary of a legal block. If the UDP repair
+ * channel is ready, every block is requested over it in a datagram of its own
+ * and tracked until it arrives, since the tracker and the sender's datagram
+ * replies are per block. Otherwise, or from the first block whose datagram
+ * can't be sent, the rest of the range is appended to the batch for the TCP
+ * connection as one request.
  *
- * @param[in] prodindex        The product index of the requested block.
- * @param[in] seqnum           The sequence number of the requested block.
- * @param[in] payloadlen       The block size of the requested block.
+ * @param[in,out] batch        Batch of requests for the TCP connection.
+ * @param[in]     prodindex    The product index of the requested blocks.
+ * @param[in]     seqnum       The sequence number of the first block.
+ * @param[in]     length       Amount of data in bytes.
+ * @param[in]     tcpOnly      Whether to use the TCP connection regardless.
  */
-bool fmtpRecvv3::sendDataRetxReq(uint32_t prodindex, uint32_t seqnum,
-                                  uint16_t payloadlen)
+void fmtpRecvv3::addDataRetxReq(std::vector<char>& batch, uint32_t prodindex,
+                                uint32_t seqnum, uint32_t length, bool tcpOnly)
 {
+    const uint32_t end = seqnum + length;
+
+    if (!tcpOnly && udpRetxReady) {
+        for (; seqnum < end; seqnum += FMTP_DATA_LEN) {
+            FmtpHeader header;
+            header.prodindex  = htonl(prodindex);
+            header.seqnum     = htonl(seqnum);
+            header.payloadlen = htons(FMTP_DATA_LEN);
+            header.flags      = htons(FMTP_RETX_REQ);
+            try {
+                /* tracks first so that a fast reply always finds the entry */
+                if (reqTracker->add(prodindex, seqnum, FMTP_DATA_LEN))
+                    udpretx->send(&header, sizeof(FmtpHeader));
+            }
+            catch (const std::system_error& e) {
+                /* falls back to TCP, which is always able to carry the rest */
+                (void)reqTracker->satisfy(prodindex, seqnum);
+                break;
+            }
+        }
+        if (seqnum >= end)
+            return;
+    }
+
+    addRetxReq(batch, FMTP_RETX_REQ, prodindex, seqnum, end - seqnum);
+}
+
+
+/**
+ * Registers the UDP repair port or unicast mode with the sender. The sender
+ * answers with a message of the same type, handled by rcvrRegHandler().
+ */
+bool fmtpRecvv3::sendRcvrReg()
+{
+    RcvrRegMsg reg;
+    reg.udpport = udpRetx ? htons(udpretx->getPortNum()) : 0;
+    reg.options = htons((unicast ? RCVR_OPT_UNICAST : 0) | RCVR_OPT_CHECKSUMS);
+
     FmtpHeader header;
-    header.prodindex  = htonl(prodindex);
-    header.seqnum     = htonl(seqnum);
-    header.payloadlen = htons(payloadlen);
-    header.flags      = htons(FMTP_RETX_REQ);
+    header.prodindex  = 0;
+    header.seqnum     = 0;
+    header.payloadlen = htons(RCVR_REG_LEN);
+    header.flags      = htons(FMTP_RCVR_REG);
 
-    return (-1 != tcprecv->sendData(&header, sizeof(FmtpHeader), NULL, 0));
+    return (-1 != tcprecv->sendData(&header, sizeof(FmtpHeader), (char*)&reg,
+                                    sizeof(reg)));
 }
 
 
@@ -1888,12 +3761,7 @@ void* fmtpRecvv3::StartRetxRequester(void* ptr)
  */
 void fmtpRecvv3::stopJoinRetxRequester()
 {
-    {
-        std::unique_lock<std::mutex> lock(msgQmutex);
-        INLReqMsg reqmsg = {SHUTDOWN};
-        msgqueue.push(reqmsg);
-        msgQfilled.notify_one();
-    }
+    nacks->stop();
 
     int status = pthread_join(retx_rq, NULL);
     if (status) {
@@ -1985,6 +3853,58 @@ void* fmtpRecvv3::StartMcastHandler(
 }
 
 
+/**
+ * Starts the multicast socket-draining task of a FMTP receiver. Called by
+ * `::pthread_create()`.
+ *
+ * @param[in] arg   Pointer to the FMTP receiver.
+ * @retval    NULL  Always.
+ */
+void* fmtpRecvv3::StartMcastReceiver(void* const arg)
+{
+#ifdef LDM_LOGGING
+    pthread_cleanup_push(freeLogging, nullptr);
+#endif
+    fmtpRecvv3* const recvr = static_cast<fmtpRecvv3*>(arg);
+    try {
+        recvr->mcastReceiver();
+    }
+    catch (const std::exception& e) {
+        recvr->taskExit(std::current_exception());
+    }
+#ifdef LDM_LOGGING
+    pthread_cleanup_pop(true);
+#endif
+    return NULL;
+}
+
+
+/**
+ * Stops the multicast socket-draining task by canceling its thread and
+ * joining it.
+ *
+ * @throws std::runtime_error if the socket-draining thread can't be canceled.
+ * @throws std::runtime_error if the socket-draining thread can't be joined.
+ */
+void fmtpRecvv3::stopJoinMcastReceiver()
+{
+    if (!mcastReceiverCanceled.test_and_set()) {
+        int status = pthread_cancel(mcastrecv_t);
+        if (status && status != ESRCH) {
+            throw std::system_error(errno, std::system_category(),
+                    "fmtpRecvv3::stopJoinMcastReceiver() "
+                    "Couldn't cancel multicast socket-draining thread");
+        }
+        status = pthread_join(mcastrecv_t, NULL);
+        if (status && status != ESRCH) {
+            throw std::system_error(errno, std::system_category(),
+                    "fmtpRecvv3::stopJoinMcastReceiver() "
+                    "Couldn't join multicast socket-draining thread");
+        }
+    }
+}
+
+
 /**
  * Stops the muticast task by canceling its thread and joining it.
  *
@@ -2010,6 +3930,56 @@ void fmtpRecvv3::stopJoinMcastHandler()
 }
 
 
+/**
+ * Starts the UDP repair task. Called by `::pthread_create()`.
+ *
+ * @param[in] arg   Pointer to the FMTP receiver.
+ * @retval    NULL  Always.
+ */
+void* fmtpRecvv3::StartUdpRetxHandler(void* const arg)
+{
+#ifdef LDM_LOGGING
+    pthread_cleanup_push(freeLogging, nullptr);
+#endif
+    fmtpRecvv3* const recvr = static_cast<fmtpRecvv3*>(arg);
+    try {
+        recvr->udpRetxHandler();
+    }
+    catch (const std::exception& e) {
+        recvr->taskExit(std::current_exception());
+    }
+#ifdef LDM_LOGGING
+    pthread_cleanup_pop(true);
+#endif
+    return NULL;
+}
+
+
+/**
+ * Stops the UDP repair task by canceling its thread and joining it.
+ *
+ * @throws std::runtime_error if the UDP repair thread can't be canceled.
+ * @throws std::runtime_error if the UDP repair thread can't be joined.
+ */
+void fmtpRecvv3::stopJoinUdpRetxHandler()
+{
+    if (!udpRetxHandlerCanceled.test_and_set()) {
+        int status = pthread_cancel(udpretx_t);
+        if (status && status != ESRCH) {
+            throw std::system_error(errno, std::system_category(),
+                    "fmtpRecvv3::stopJoinUdpRetxHandler() "
+                    "Couldn't cancel UDP repair thread");
+        }
+        status = pthread_join(udpretx_t, NULL);
+        if (status && status != ESRCH) {
+            throw std::system_error(errno, std::system_category(),
+                    "fmtpRecvv3::stopJoinUdpRetxHandler() "
+                    "Couldn't join UDP repair thread");
+        }
+    }
+}
+
+
 /**
  * Start a Retx procedure, including the retxHandler thread and retxRequester
  * thread. These two threads will be started independently and after the
@@ -2063,20 +4033,14 @@ void fmtpRecvv3::startTimerThread()
 
 
 /**
- * Stops the timer task by adding a "shutdown" entry to the associated queue and
- * joins with its thread.
+ * Stops the timer task by stopping the EOP timer wheel and joins with its
+ * thread.
  *
  * @throws std::runtime_error if the timer thread can't be joined.
  */
 void fmtpRecvv3::stopJoinTimerThread()
 {
-    timerParam timerparam;
-    {
-        std::unique_lock<std::mutex> lock(timerQmtx);
-        timerParam timerparam = {0, -1.0};
-        timerParamQ.push(timerparam);
-        timerQfilled.notify_one();
-    }
+    eopTimers->stop();
 
     int status = pthread_join(timer_t, NULL);
     if (status) {
@@ -2087,6 +4051,45 @@ void fmtpRecvv3::stopJoinTimerThread()
 }
 
 
+/**
+ * Starts the thread that notifies the receiving application about the
+ * queued events.
+ *
+ * @return  none
+ */
+void fmtpRecvv3::startNotifyThread()
+{
+    int retval = pthread_create(&notify_t, NULL, &fmtpRecvv3::runNotifyThread,
+            this);
+
+    if(retval != 0) {
+        throw std::system_error(errno, std::system_category(),
+                "fmtpRecvv3::startNotifyThread() "
+                "pthread_create() failed with retval = " + std::to_string(retval));
+    }
+}
+
+
+/**
+ * Stops the notification queue and joins with the notification thread,
+ * which notifies the receiving application about the events that are still
+ * queued first.
+ *
+ * @throws std::runtime_error if the notification thread can't be joined.
+ */
+void fmtpRecvv3::stopJoinNotifyThread()
+{
+    notifyQueue->stop();
+
+    int status = pthread_join(notify_t, NULL);
+    if (status) {
+        throw std::system_error(errno, std::system_category(),
+                "fmtpRecvv3::stopJoinNotifyThread() "
+                "Couldn't join notification thread");
+    }
+}
+
+
 /**
  * Sets the EOP arrival status to true, which indicates the successful
  * reception of EOP.
@@ -2095,69 +4098,37 @@ void fmtpRecvv3::stopJoinTimerThread()
  */
 void fmtpRecvv3::setEOPStatus(const uint32_t prodindex)
 {
-    std::unique_lock<std::mutex> lock(EOPmapmtx);
-    EOPmap[prodindex] = true;
+    prodTable->setEOP(prodindex);
 }
 
 
 /**
- * Runs a timer thread to watch for the case of missing EOP. If an expected
- * EOP is not received, the timer should trigger after sleeping. If it is
- * received from the mcast socket, do not trigger to request for retransmission
- * of the EOP. mcastEOPHandler will notify the condition variable to interrupt
- * the timed wait function. Doesn't return unless a "shutdown" entry is
- * encountered or an exception is thrown.
+ * Runs a timer thread to watch for the case of missing EOP. Every product
+ * being multicast has its own EOP deadline in the timer wheel, which is
+ * cancelled when the EOP arrives. The thread waits for deadlines to pass and
+ * requests the missing EOPs of all the products whose deadlines passed
+ * together. Doesn't return unless the wheel is stopped or an exception is
+ * thrown.
  */
 void fmtpRecvv3::timerThread()
 {
-    while (1) {
-        timerParam timerparam;
-        {
-            std::unique_lock<std::mutex> lock(timerQmtx);
-            while (timerParamQ.empty())
-                timerQfilled.wait(lock);
-            timerparam = timerParamQ.front();
-        }
-
-        if (timerparam.seconds < 0)
-            break; // leave "shutdown" entry in queue
-
-        unsigned long period = timerparam.seconds * 1000000000lu;
-        {
-            std::unique_lock<std::mutex> lk(timerWakemtx);
-            /** sleep for a given amount of time in precision of nanoseconds */
-            timerWake.wait_for(lk, std::chrono::nanoseconds(period));
-        }
-
-        /** pop the current entry in timer queue when timer wakes up */
-        {
-            std::unique_lock<std::mutex> lock(timerQmtx);
-            timerParamQ.pop();
-        }
+    std::vector<uint32_t> expired;
+    while (eopTimers->wait(expired))
+        reqEOPsifMiss(expired);
+}
 
-        /** if EOP has not been received yet, issue a request for retx */
-        if (reqEOPifMiss(timerparam.prodindex)) {
-            #ifdef MODBASE
-                uint32_t tmpidx = timerparam.prodindex % MODBASE;
-            #else
-                uint32_t tmpidx = timerparam.prodindex;
-            #endif
 
-            #ifdef DEBUG2
-            std::string debugmsg = "[TIMER] Timer has waken up. Product #" +
-                    std::to_string(tmpidx);
-                debugmsg += " is still missing EOP. Request retx.";
-                std::cout << debugmsg << std::endl;
-                WriteToLog(debugmsg);
-            #endif
-        }
-        /**
-         * After waking up, the timer checks the EOP arrival status of
-         * a product and decides whether to request for re-transmission.
-         * Only the timer can clear the EOPmap.
-         */
-        clearEOPStatus(timerparam.prodindex);
-    }
+/**
+ * Runs the notification thread, which passes the queued events to the
+ * receiving application in batches. Doesn't return until the queue is
+ * stopped and empty or an exception is thrown.
+ */
+void fmtpRecvv3::notifyThread()
+{
+    RecvEvent events[NOTIFY_BATCH];
+    size_t    count;
+    while ((count = notifyQueue->take(events, NOTIFY_BATCH)) > 0)
+        notifier->notifyBatch(events, count);
 }
 
 
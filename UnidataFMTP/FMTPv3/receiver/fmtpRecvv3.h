@@ -38,18 +38,32 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <exception>
 #include <list>
 #include <mutex>
-#include <queue>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
 #include "Measure.h"
-#include "ProdSegMNG.h"
+#include "ArrivalStats.h"
+#include "DiskSink.h"
+#include "EOPTimerWheel.h"
+#include "NackScheduler.h"
+#include "NotifyQueue.h"
+#include "OrphanPool.h"
+#include "PacketQueue.h"
+#include "PacketRingRecv.h"
+#include "XdpRecv.h"
+#include "ProdArena.h"
+#include "ProdChecksum.h"
+#include "ProdStateTable.h"
+#include "RateEstimator.h"
 #include "RecvProxy.h"
+#include "RetxReqTracker.h"
 #include "TcpRecv.h"
+#include "TcpRecvMux.h"
+#include "UdpRetxRecv.h"
 #include "fmtpBase.h"
 
 
@@ -62,17 +76,36 @@ struct StartTimerInfo
     fmtpRecvv3* receiver;   /*!< a pointer to the fmtpRecvv3 instance */
 };
 
-struct ProdTracker
+/* a gap in the multicast blocks of a product that isn't requested yet */
+struct PendingGap
 {
-    uint32_t     prodsize;
-    void*        prodptr;
-    uint32_t     seqnum;
-    uint16_t     paylen;
-    uint32_t     numRetrans;
+    uint32_t prodindex;
+    uint32_t seqnum;     /*!< first byte of the gap */
+    uint32_t length;     /*!< bytes of the gap */
+    uint32_t blocks;     /*!< blocks missing when the gap was found */
+    uint64_t pktDue;     /*!< multicast packet count that ends the wait */
+    int64_t  nsDue;      /*!< steady clock time in ns that ends the wait */
 };
 
-typedef std::unordered_map<uint32_t, ProdTracker> TrackerMap;
-typedef std::unordered_map<uint32_t, bool> EOPStatusMap;
+/* number of multicast packets that one recvmmsg() call can receive */
+const int MCAST_BATCH = 64;
+/* default number of multicast packets queued for the handling thread */
+const uint32_t MCAST_QUEUE_DEPTH = 8192;
+/* full recvmmsg() batches between looks at the occupancy of the socket */
+const uint32_t RCVBUF_CHECK_BATCHES = 64;
+/* default EOP deadline as a multiple of a product's expected arrival time */
+const double EOP_SAFETY = 2.0;
+/* time added to every EOP deadline for jitter, in milliseconds */
+const unsigned EOP_SLACK = 10;
+/* time a complete product waits for the checksums in its EOP, in ms */
+const unsigned EOP_GRACE = 10;
+/* default seconds to keep reconnecting a lost retransmission connection */
+const unsigned RETX_RECONNECT_TIMEOUT = 120;
+/* first and longest wait between reconnection attempts, in milliseconds */
+const unsigned RETX_BACKOFF_MIN = 100;
+const unsigned RETX_BACKOFF_MAX = 5000;
+/* maximum number of events in one RecvProxy::notifyBatch() call */
+const size_t NOTIFY_BATCH = 64;
 
 
 class fmtpRecvv3 {
@@ -95,15 +128,287 @@ public:
                const unsigned short mcastPort,
                RecvProxy*           notifier = NULL,
                const std::string    ifAddr = "0.0.0.0");
+    /**
+     * Constructs a receiver of one session of a SenderRuntime whose
+     * retransmission connection is shared with other sessions.
+     *
+     * @param[in] mux           The shared retransmission connection.
+     * @param[in] sessionId     Id of the sender session.
+     * @param[in] mcastAddr     UDP multicast address for receiving data products.
+     * @param[in] mcastPort     UDP multicast port for receiving data products.
+     * @param[in] notifier      Callback function to notify receiving application
+     *                          of incoming Begin-Of-Product messages.
+     * @param[in] ifAddr        IPv4 address of local interface receiving
+     *                          multicast packets and retransmitted data-blocks.
+     */
+    fmtpRecvv3(TcpRecvMux&          mux,
+               const uint32_t       sessionId,
+               const std::string    mcastAddr,
+               const unsigned short mcastPort,
+               RecvProxy*           notifier = NULL,
+               const std::string    ifAddr = "0.0.0.0");
     ~fmtpRecvv3();
 
+    /**
+     * Returns the number of multicast packets that were dropped because the
+     * queue between the receiving and the handling thread was full.
+     */
+    uint64_t getMcastOverruns();
+    /**
+     * Returns the number of multicast packets that the kernel dropped because
+     * the receive buffer of the multicast socket was full.
+     */
+    uint64_t getMcastSockDrops();
+    /**
+     * Returns the size of the receive buffer of the multicast socket in
+     * bytes, as the kernel reports it.
+     */
+    int      getMcastRcvBuf();
+    /**
+     * Returns the number of times the retransmission connection was lost and
+     * re-established.
+     */
+    uint32_t getRetxReconnects();
+    /**
+     * Returns the measured arrival rate of multicast products.
+     *
+     * @return  Bytes per second, 0 until enough packets have arrived.
+     */
+    double   getMcastRate();
+    /**
+     * Returns the histogram of the time from the last multicast packet of a
+     * product to the detection of its missing EOP.
+     *
+     * @param[out] latency  The histogram.
+     */
+    void     getEOPDetection(Histogram& latency);
+    /**
+     * Returns the histograms of the arrival times of multicast packets.
+     *
+     * @param[out] hists     The histograms.
+     * @param[out] hardware  Whether the network card's timestamps are used.
+     * @return               false if receive timestamps aren't enabled.
+     */
+    bool     getArrivalStats(ArrivalHistograms& hists, bool& hardware);
+    /**
+     * Returns the number of times a complete product didn't match the
+     * checksums from the sender and parts of it were requested again.
+     */
+    uint64_t getCorruptProds();
+    /**
+     * Returns the page faults that the thread that handles multicast packets
+     * has taken.
+     *
+     * @param[out] minor  Minor faults.
+     * @param[out] major  Major faults.
+     * @return            false if the thread hasn't started.
+     */
+    bool getMcastFaults(uint64_t& minor, uint64_t& major);
     uint32_t getNotify();
     void SetLinkSpeed(uint64_t speed);
+    /**
+     * Sets how long the EOP of a product is waited for, as a multiple of the
+     * time the product is expected to take at the measured arrival rate.
+     *
+     * @param[in] factor  Multiple, at least 1.
+     */
+    void SetEOPSafety(double factor);
+    /**
+     * Requests data-blocks over the UDP repair channel instead of the TCP
+     * connection. Must be called before `Start()`.
+     *
+     * @param[in] enable  Whether to use the UDP repair channel.
+     */
+    void SetUdpRetx(bool enable);
+    /**
+     * Receives every product over the TCP connection instead of the
+     * multicast, for hosts that the multicast doesn't reach. Must be called
+     * before `Start()`.
+     *
+     * @param[in] enable  Whether to receive products over unicast.
+     */
+    void SetUnicast(bool enable);
+    /**
+     * Receives the multicast group from a memory-mapped packet ring instead
+     * of the UDP socket. Needs CAP_NET_RAW. Must be called before `Start()`.
+     *
+     * @param[in] enable  Whether to receive from the packet ring.
+     */
+    void SetPacketRing(bool enable);
+    /**
+     * Receives the multicast group through AF_XDP sockets instead of the UDP
+     * socket. Takes precedence over the packet ring. Needs CAP_NET_ADMIN,
+     * CAP_NET_RAW and CAP_BPF. Must be called before `Start()`.
+     *
+     * @param[in] enable  Whether to receive through AF_XDP.
+     */
+    void SetXdp(bool enable);
+    /**
+     * Sets how many multicast packets can wait for the handling thread. Must
+     * be called before `Start()`.
+     *
+     * @param[in] depth  Number of packets, rounded up to a power of 2.
+     */
+    void SetMcastQueueDepth(uint32_t depth);
+    /**
+     * Sets the receive buffer of the multicast socket and lets it grow when
+     * the kernel drops packets or the buffer fills up. Must be called before
+     * `Start()`.
+     *
+     * @param[in] initial  Size in bytes, 0 for the system default.
+     * @param[in] cap      Largest size in bytes it can grow to, 0 to not
+     *                     grow it.
+     */
+    void SetMcastRcvBuf(int initial, int cap);
+    /**
+     * Sets how long a lost retransmission connection is reconnected before
+     * the receiver gives up. Must be called before `Start()`.
+     *
+     * @param[in] seconds  Seconds, 0 to give up at once.
+     */
+    void SetRetxReconnect(unsigned seconds);
+    /**
+     * Makes the kernel timestamp multicast packets as they arrive and keeps
+     * histograms of the timestamps. Must be called before `Start()`.
+     *
+     * @param[in] hardware  Whether to use the network card's timestamps
+     *                      where it has them.
+     */
+    void SetRecvTimestamps(bool hardware);
+    /**
+     * Sets how many retransmission requests can wait to be sent. Must be
+     * called before `Start()`.
+     *
+     * @param[in] limit  Number of requests.
+     */
+    void SetMaxNacks(uint32_t limit);
+    /**
+     * Writes the products that the receiving application doesn't take into
+     * files in a directory. Must be called before `Start()`.
+     *
+     * @param[in] dir  Directory of the product files.
+     */
+    void SetDiskSink(const std::string& dir);
+    /**
+     * Returns the file that a product is written to by the disk sink.
+     *
+     * @param[in] prodindex  Index of the product.
+     * @return               Path of the file, or an empty string if the disk
+     *                       sink isn't used.
+     */
+    std::string getProdPath(const uint32_t prodindex);
+    /**
+     * Offers the receiving application product buffers from an arena of
+     * pre-faulted memory in `startProd()`. Must be called before `Start()`.
+     *
+     * @param[in] maxProdSize    Size of the biggest product to be taken.
+     * @param[in] bytesPerClass  Memory of each slab class.
+     * @param[in] lock           Whether to lock the arena in memory.
+     */
+    void SetProdArena(const size_t maxProdSize, const size_t bytesPerClass,
+                      const bool lock);
+    /**
+     * Returns a buffer from the arena after the product is done with.
+     *
+     * @param[in] data  The buffer that `startProd()` was given.
+     */
+    void ReleaseProdBuffer(void* const data);
+    /**
+     * Returns what the product-buffer arena has done so far.
+     *
+     * @param[out] stats  Statistics.
+     * @return            false if there's no arena.
+     */
+    bool getArenaStats(ArenaStats& stats);
+    /**
+     * Sets how many multicast blocks of products whose BOP was lost are kept
+     * until the BOP is retransmitted. Must be called before `Start()`.
+     *
+     * @param[in] blocks  Number of blocks, 0 to keep none.
+     */
+    void SetOrphanPool(const uint32_t blocks);
+    /**
+     * Returns what the pool of blocks without a BOP has done so far.
+     *
+     * @param[out] stats  Statistics.
+     * @return            false if there's no pool.
+     */
+    bool getOrphanStats(OrphanStats& stats);
+    /**
+     * Sets how long a gap in the multicast blocks of a product waits for
+     * late blocks before its missing blocks are requested. Both 0 requests
+     * them at once. Must be called before `Start()`.
+     *
+     * @param[in] packets  Multicast packets to wait for, 0 for no limit.
+     * @param[in] usec     Microseconds to wait for, 0 for no limit.
+     */
+    void SetReorderWindow(const uint32_t packets, const unsigned usec);
+    /**
+     * Returns how many blocks of gaps were requested and how many arrived
+     * late within the reorder window, so weren't.
+     *
+     * @param[out] nacked      Blocks requested.
+     * @param[out] suppressed  Blocks that arrived within the window.
+     */
+    void getReorderStats(uint64_t& nacked, uint64_t& suppressed);
+    /**
+     * Makes the receiving application be told how much of a product has
+     * been received from its start on. Must be called before `Start()`.
+     *
+     * @param[in] bytes  Growth to report, 0 for no reports.
+     */
+    void SetProgress(const uint32_t bytes);
+    /**
+     * Makes the receiving application be notified by a thread of its own,
+     * so the threads that receive products don't wait for it. Must be called
+     * before `Start()`.
+     *
+     * @param[in] depth     Number of events that can be queued for the
+     *                      application, 0 to notify it synchronously.
+     * @param[in] overflow  What an event does if the queue is full.
+     */
+    void SetAsyncNotify(const uint32_t depth,
+                        const NotifyOverflow overflow = NOTIFY_WAIT);
+    /**
+     * Returns what the queue of events for the receiving application has
+     * done so far.
+     *
+     * @param[out] stats  Statistics.
+     * @return            false if the application is notified synchronously.
+     */
+    bool getNotifyStats(NotifyStats& stats);
     void Start();
     void Stop();
 
 private:
+    /**
+     * Constructs with a given retransmission connection, see the public
+     * constructors.
+     *
+     * @param[in] tcprecv       The retransmission connection. Deleted by the
+     *                          instance.
+     */
+    fmtpRecvv3(TcpRecv*             tcprecv,
+               const std::string    tcpAddr,
+               const unsigned short tcpPort,
+               const std::string    mcastAddr,
+               const unsigned short mcastPort,
+               RecvProxy*           notifier,
+               const std::string    ifAddr);
+    /**
+     * Gives up on a product that can't be completed.
+     *
+     * @param[in] prodindex  Index of the product.
+     */
+    void abandonProd(const uint32_t prodindex);
     bool addUnrqBOPinSet(uint32_t prodindex);
+    /**
+     * Copies the blocks that arrived before the BOP into a product.
+     *
+     * @param[in] prodindex  Index of the product.
+     * @return               Whether any blocks were adopted.
+     */
+    bool adoptOrphans(const uint32_t prodindex);
     /**
      * Parse BOP message and call notifier to notify receiving application.
      *
@@ -115,6 +420,12 @@ private:
                     const char* const  FmtpPacketData);
     void checkPayloadLen(const FmtpHeader& header, const size_t nbytes);
     void clearEOPStatus(const uint32_t prodindex);
+    bool copyBase(const uint32_t prodindex, const uint32_t prodsize,
+                  void* const prodptr, const uint32_t baseIndex,
+                  const std::vector<DeltaRange>& ranges);
+    void decodeDelta(const FmtpHeader& header, const BOPMsg& BOPmsg,
+                     const char* const wire, uint32_t& baseIndex,
+                     std::vector<DeltaRange>& ranges);
     /**
      * Decodes the header of a FMTP packet in-place.
      *
@@ -132,35 +443,87 @@ private:
      * @throw std::runtime_error  if the packet has in invalid payload length.
      */
     void decodeHeader(char* const packet, FmtpHeader& header);
-    void EOPHandler(const FmtpHeader& header);
+    void EOPHandler(const FmtpHeader& header, const char* const payload);
+    /**
+     * Notifies the receiving application and the sender if a product has been
+     * completely received.
+     *
+     * @param[in] prodindex  Index of the product.
+     * @param[in] now        Time of arrival of the last packet.
+     * @return               True if the product is complete.
+     */
+    bool endProdIfComplete(const uint32_t prodindex,
+                           const struct timespec& now);
+    /**
+     * Ends a product whose blocks have all arrived before its EOP, or
+     * shortens its EOP deadline to wait for the checksums in the EOP.
+     *
+     * @param[in] prodindex  Index of the product.
+     */
+    void endProdBeforeEOP(const uint32_t prodindex);
+    /**
+     * Tells the receiving application how much of a product has been
+     * received from its start on if that has grown enough.
+     *
+     * @param[in] prodindex  Index of the product.
+     */
+    void reportProgress(const uint32_t prodindex);
     bool getEOPStatus(const uint32_t prodindex);
     bool hasLastBlock(const uint32_t prodindex);
-    void initEOPStatus(const uint32_t prodindex);
     void joinGroup(
             std::string          srcAddr,
             std::string          mcastAddr,
             const unsigned short mcastPort);
     /**
-     * Handles a multicast BOP message given a peeked-at FMTP header.
+     * Handles a multicast BOP message.
      *
-     * @pre                           The multicast socket contains a FMTP BOP
-     *                                packet.
      * @param[in] header              The associated, already-decoded FMTP header.
-     * @throw     std::system_error   if an error occurs while reading the socket.
+     * @param[in] payload             The payload of the received packet.
      * @throw     std::runtime_error  if the packet is invalid.
      */
-    void mcastBOPHandler(const FmtpHeader& header);
+    void mcastBOPHandler(const FmtpHeader& header, const char* const payload);
     void mcastHandler();
-    void mcastEOPHandler(const FmtpHeader& header);
     /**
-     * Pushes a request for a data-packet onto the retransmission-request queue.
+     * Receives multicast packets into the multicast queue.
+     */
+    void mcastReceiver();
+    /**
+     * Counts the kernel's drops that the last packets of a batch report and
+     * grows the receive buffer if need be.
      *
-     * @param[in] prodindex  Index of the associated data-product.
-     * @param[in] seqnum     Sequence number of the data-packet.
-     * @param[in] datalen    Amount of data in bytes.
+     * @param[in] msgs       The messages of the batch.
+     * @param[in] npkts      Number of messages.
+     * @param[in] fullBatch  Whether the batch took all it could.
      */
-    void pushMissingDataReq(const uint32_t prodindex, const uint32_t seqnum,
-                            const uint16_t datalen);
+    void checkRcvBuf(const struct mmsghdr* msgs, const int npkts,
+                     const bool fullBatch);
+    /**
+     * Sets the receive buffer of the multicast socket.
+     *
+     * @param[in] size  Size in bytes.
+     */
+    void setRcvBuf(const int size);
+    /**
+     * Enables receive timestamps on the multicast socket.
+     */
+    void enableTimestamps();
+    /**
+     * Gets the receive timestamps of a batch of packets.
+     *
+     * @param[in]  msgs    The messages of the batch.
+     * @param[in]  npkts   Number of messages.
+     * @param[out] stamps  Arrival time of each packet.
+     */
+    static void getStamps(const struct mmsghdr* msgs, const int npkts,
+                          RecvStamp* stamps);
+    void mcastEOPHandler(const FmtpHeader& header,
+                         const char* const payload);
+    /**
+     * Gives up on a product and notifies the receiving application.
+     *
+     * @param[in] prodindex  Index of the product.
+     */
+    void missProd(const uint32_t prodindex);
     /**
      * Pushes a request for a BOP-packet onto the retransmission-request queue.
      *
@@ -173,7 +536,35 @@ private:
      * @param[in] prodindex  Index of the associated data-product.
      */
     void pushMissingEopReq(const uint32_t prodindex);
+    void recvRetxPackets();
+    /**
+     * Re-establishes the retransmission connection after it was lost and
+     * requests again whatever is still missing.
+     *
+     * @param[in] cause  Why the connection was lost.
+     * @throws  std::system_error  if the sender can't be reached in time.
+     */
+    void reconnectRetx(const std::exception& cause);
+    /**
+     * Requests every BOP, block and EOP that's still missing, after the
+     * requests in flight were lost with the connection.
+     */
+    void resyncRetx();
     void retxHandler();
+    /**
+     * Handles the sender's reply to the registration of the UDP repair port
+     * and the options.
+     *
+     * @param[in] header   Header of the reply.
+     * @param[in] payload  Payload of the reply.
+     */
+    void rcvrRegHandler(const FmtpHeader& header, const char* const payload);
+    /**
+     * Handles a rejected retransmission request.
+     *
+     * @param[in] header  Header of the RETX_REJ packet.
+     */
+    void retxRejHandler(const FmtpHeader& header);
     void retxRequester();
     bool rmMisBOPinSet(uint32_t prodindex);
     /**
@@ -184,18 +575,17 @@ private:
      */
     void retxBOPHandler(const FmtpHeader& header,
                         const char* const  FmtpPacketData);
-    void retxEOPHandler(const FmtpHeader& header);
+    void retxEOPHandler(const FmtpHeader& header, const char* const payload);
     /**
-     * Reads the data portion of a FMTP data-packet into the location specified
-     * by the receiving application.
+     * Copies the data portion of a FMTP data-packet into the location
+     * specified by the receiving application.
      *
-     * @pre                       The socket contains a FMTP data-packet.
-     * @param[in] header          The associated, peeked-at and decoded header.
-     * @throw std::system_error   if an error occurs while reading the multicast
-     *                            socket.
-     * @throw std::runtime_error  if the packet is invalid.
+     * @param[in] header          The associated and decoded header.
+     * @param[in] payload         The payload of the received packet.
+     * @param[in] prodptr         Where the product is written to, or NULL.
      */
-    void readMcastData(const FmtpHeader& header);
+    void readMcastData(const FmtpHeader& header, const char* const payload,
+                       void* const prodptr);
     /**
      * Requests data-packets that lie between the last previously-received
      * data-packet of the current data-product and its most recently-received
@@ -204,9 +594,44 @@ private:
      * @param[in] prodindex Product index.
      * @param[in] seqnum  The most recently-received data-packet of the current
      *                    data-product.
+     * @return            Number of blocks requested.
+     */
+    uint32_t requestAnyMissingData(const uint32_t prodindex,
+                                   const uint32_t mostRecent);
+    /**
+     * Puts the gap in front of a multicast block into the reorder window.
+     *
+     * @param[in] prodindex   Product index.
+     * @param[in] mostRecent  Sequence number of the block after the gap.
+     */
+    void deferMissingData(const uint32_t prodindex,
+                          const uint32_t mostRecent);
+    /**
+     * Requests the blocks of the gaps whose reorder window has ended that
+     * are still missing.
+     */
+    void releaseGaps();
+    /**
+     * Requests the blocks of a product's gaps that are still missing without
+     * waiting for their reorder window to end.
+     *
+     * @param[in] prodindex  Product index.
+     */
+    void flushGaps(const uint32_t prodindex);
+    /**
+     * Requests the blocks of a gap that are still missing.
+     *
+     * @param[in] gap  The gap.
+     */
+    void requestGap(const PendingGap& gap);
+    /**
+     * Requests the ranges of a product that didn't match their checksums.
+     *
+     * @param[in] prodindex  Product index.
+     * @param[in] corrupt    The ranges.
      */
-    void requestAnyMissingData(const uint32_t prodindex,
-                               const uint32_t mostRecent);
+    void requestCorruptData(const uint32_t prodindex,
+                            const std::vector<MissingRange>& corrupt);
     /**
      * Requests BOP packets for a prodindex interval.
      *
@@ -235,31 +660,47 @@ private:
      */
     int requestMissingBopsInclusive(const uint32_t prodindex);
     /**
-     * Handles a multicast FMTP data-packet given the associated peeked-at and
-     * decoded FMTP header. Directly store and check for missing blocks.
+     * Handles a multicast FMTP data-packet given the associated decoded FMTP
+     * header. Directly store and check for missing blocks.
      *
-     * @pre                       The socket contains a FMTP data-packet.
-     * @param[in] header          The associated, peeked-at and decoded header.
-     * @throw std::system_error   if an error occurs while reading the socket.
+     * @param[in] header          The associated, decoded header.
+     * @param[in] payload         The payload of the received packet.
      * @throw std::runtime_error  if the packet is invalid.
      */
-    void recvMemData(const FmtpHeader& header);
+    void recvMemData(const FmtpHeader& header, const char* const payload);
     /**
-     * request EOP retx if EOP is not received yet and return true if
-     * the request is sent out. Otherwise, return false.
-     * */
-    bool reqEOPifMiss(const uint32_t prodindex);
+     * Requests the EOPs of the products whose EOP deadlines have passed, if
+     * they haven't been received.
+     *
+     * @param[in] prodindexes  Indexes of the products.
+     */
+    void reqEOPsifMiss(const std::vector<uint32_t>& prodindexes);
     static void* runTimerThread(void* ptr);
-    bool sendBOPRetxReq(uint32_t prodindex);
-    bool sendEOPRetxReq(uint32_t prodindex);
-    bool sendDataRetxReq(uint32_t prodindex, uint32_t seqnum,
-                         uint16_t payloadlen);
+    static void* runNotifyThread(void* ptr);
+    /**
+     * Notifies the receiving application about an event, either directly or
+     * by queueing it for the notification thread.
+     *
+     * @param[in] event            The event.
+     * @throws std::runtime_error  Receiving application error.
+     */
+    void notify(const RecvEvent& event);
+    void notifyThread();
+    void addRetxReq(std::vector<char>& batch, uint16_t flags,
+                    uint32_t prodindex, uint32_t seqnum, uint32_t length);
+    void addDataRetxReq(std::vector<char>& batch, uint32_t prodindex,
+                        uint32_t seqnum, uint32_t length,
+                        bool tcpOnly = false);
+    bool sendRcvrReg();
     bool sendRetxEnd(uint32_t prodindex);
     static void*  StartRetxRequester(void* ptr);
     static void*  StartRetxHandler(void* ptr);
     static void*  StartMcastHandler(void* ptr);
+    static void*  StartMcastReceiver(void* ptr);
+    static void*  StartUdpRetxHandler(void* ptr);
     void StartRetxProcedure();
     void startTimerThread();
+    void startNotifyThread();
     void setEOPStatus(const uint32_t prodindex);
     void timerThread();
     void taskExit(const std::exception_ptr& e);
@@ -267,7 +708,11 @@ private:
     void stopJoinRetxRequester();
     void stopJoinRetxHandler();
     void stopJoinTimerThread();
+    void stopJoinNotifyThread();
     void stopJoinMcastHandler();
+    void stopJoinMcastReceiver();
+    void stopJoinUdpRetxHandler();
+    void udpRetxHandler();
     /* Sender VLAN Unique IP address */
     std::string             tcpAddr;
     /* Sender FMTP TCP Connection port number */
@@ -283,21 +728,12 @@ private:
     /* callback function of the receiving application */
     RecvProxy*              notifier;
     TcpRecv*                tcprecv;
-    /* a map from prodindex to struct ProdTracker */
-    TrackerMap              trackermap;
-    std::mutex              trackermtx;
     /* eliminate race conditions between mcast and retx */
     std::mutex              antiracemtx;
-    /* a map from prodindex to EOP arrival status */
-    EOPStatusMap            EOPmap;
-    std::mutex              EOPmapmtx;
-    ProdSegMNG*             pSegMNG;
-    std::queue<INLReqMsg>   msgqueue;
-    std::condition_variable msgQfilled;
-    std::mutex              msgQmutex;
-    /* track all the missing BOP until received */
-    std::unordered_set<uint32_t> misBOPset;
-    std::mutex              BOPSetMtx;
+    /* tracker, bitmap, EOP status and BOP request of every product */
+    ProdStateTable*         prodTable;
+    /* retransmission requests waiting for the requester thread */
+    NackScheduler*          nacks;
     /* Retransmission request thread */
     pthread_t               retx_rq;
     /* Retransmission receive thread */
@@ -306,12 +742,8 @@ private:
     pthread_t               mcast_t;
     /* BOP timer thread */
     pthread_t               timer_t;
-    /* a queue containing timerParam structure for each product */
-    std::queue<timerParam>  timerParamQ;
-    std::condition_variable timerQfilled;
-    std::mutex              timerQmtx;
-    std::condition_variable timerWake;
-    std::mutex              timerWakemtx;
+    /* EOP deadline of every product being multicast */
+    EOPTimerWheel*          eopTimers;
     std::mutex              exitMutex;
     std::condition_variable exitCond;
     bool                    stopRequested;
@@ -319,8 +751,87 @@ private:
     std::mutex              linkmtx;
     /* max link speed up to 18000 Pbps */
     uint64_t                linkspeed;
+    /* arrival rate of multicast products, which sets the EOP deadlines */
+    RateEstimator*          mcastRate;
+    double                  eopSafety;
+    /* steady clock time in ns of the multicast batch being handled */
+    int64_t                 mcastNow;
+    /* last multicast packet to detection of a missing EOP */
+    LogHist*                eopDetect;
     std::atomic_flag        retxHandlerCanceled;
     std::atomic_flag        mcastHandlerCanceled;
+    /* UDP repair channel, only used if enabled by SetUdpRetx() */
+    bool                    udpRetx;
+    UdpRetxRecv*            udpretx;
+    /* outstanding requests sent over the UDP repair channel */
+    RetxReqTracker*         reqTracker;
+    /* set once the sender has acknowledged the UDP repair port */
+    std::atomic<bool>       udpRetxReady;
+    /* seconds to reconnect a lost retransmission connection */
+    unsigned                retxReconnect;
+    std::atomic<uint32_t>   retxReconnects;
+    /* UDP repair receive thread */
+    pthread_t               udpretx_t;
+    std::atomic_flag        udpRetxHandlerCanceled;
+    /* products arrive over TCP only, set by SetUnicast() */
+    bool                    unicast;
+    /* multicast packet ring, only used if enabled by SetPacketRing() */
+    bool                    pktRing;
+    PacketRingRecv*         pktring;
+    /* AF_XDP sockets, only used if enabled by SetXdp() */
+    bool                    xdp;
+    XdpRecv*                xdprecv;
+    /* packets received by mcastrecv_t and not yet handled by mcast_t */
+    uint32_t                mcastQueueDepth;
+    PacketQueue*            mcastQueue;
+    /* receive buffer of the multicast socket, set by SetMcastRcvBuf() */
+    int                     rcvBufInit;
+    int                     rcvBufCap;
+    std::atomic<int>        rcvBuf;
+    /* datagrams dropped by the kernel, from SO_RXQ_OVFL */
+    std::atomic<uint64_t>   sockDrops;
+    uint32_t                lastDropCount;
+    uint32_t                fullBatches;
+    /* receive timestamps, only used if enabled by SetRecvTimestamps() */
+    bool                    recvStamps;
+    bool                    hwStamps;
+    ArrivalStats*           arrivals;
+    /* checksum failures of complete products */
+    std::atomic<uint64_t>   corruptProds;
+    /* product files, only used if enabled by SetDiskSink() */
+    std::string             diskDir;
+    DiskSink*               diskSink;
+    /* blocks of products without a BOP, see SetOrphanPool() */
+    uint32_t                orphanBlocks;
+    OrphanPool*             orphans;
+    /* gaps waiting for late blocks, see SetReorderWindow() */
+    uint32_t                reorderPkts;
+    int64_t                 reorderNs;
+    uint64_t                mcastPkts;
+    std::mutex              reorderMtx;
+    std::deque<PendingGap>  reorderGaps;
+    std::atomic<uint32_t>   reorderPending;
+    std::atomic<uint64_t>   gapsNacked;
+    std::atomic<uint64_t>   gapsSuppressed;
+    /* whether the sender's EOPs carry checksums, see endProdBeforeEOP() */
+    std::atomic<bool>       eopChecksums;
+    /* bytes between progress reports, see SetProgress() */
+    uint32_t                progressStep;
+    /* events for the receiving application, see SetAsyncNotify() */
+    uint32_t                notifyDepth;
+    NotifyOverflow          notifyOverflow;
+    NotifyQueue*            notifyQueue;
+    pthread_t               notify_t;
+    /* product buffers, only used if enabled by SetProdArena() */
+    size_t                  arenaMaxProd;
+    size_t                  arenaBytesPerClass;
+    bool                    arenaLock;
+    ProdArena*              prodArena;
+    /* kernel thread ID of mcast_t, 0 until it has started */
+    std::atomic<pid_t>      mcastTid;
+    /* Multicast socket-draining thread */
+    pthread_t               mcastrecv_t;
+    std::atomic_flag        mcastReceiverCanceled;
     std::mutex              notifyprodmtx;
     uint32_t                notifyprodidx;
     std::condition_variable notify_cv;
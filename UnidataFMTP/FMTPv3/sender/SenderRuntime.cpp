@@ -0,0 +1,1399 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      SenderRuntime.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the runtime shared by sender sessions.
+ *
+ * One event loop, one timer and a pool of workers serving any number of
+ * fmtpSendv3 sessions.
+ */
+
+
+#include "SenderRuntime.h"
+#include "fmtpSendv3.h"
+#ifdef LDM_LOGGING
+#include "log.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <system_error>
+
+
+#ifndef NULL
+    #define NULL 0
+#endif
+
+/** maximum number of events fetched by one epoll_wait() */
+#define MAX_EVENTS  64
+/** token of the wake-up file descriptor, never that of a source */
+#define WAKEUP_TOKEN 0
+/** maximum number of bytes read from a receiver by one job */
+#define CONN_READ_LEN 65536
+/**
+ * maximum number of bytes queued for a receiver. A receiver that falls this
+ * far behind is disconnected, like one whose socket buffer stays full.
+ */
+#define CONN_TX_MAX (64 * 1024 * 1024)
+/** a connection has drained, see whenWritable(), with this many bytes left */
+#define CONN_TX_LOW (256 * 1024)
+
+
+#ifdef LDM_LOGGING
+static void freeLogging(void* arg)
+{
+    log_free();
+}
+#endif
+
+/**
+ * Logs a potentially nested exception. Messages are logged starting with the
+ * innermost exception and ending with the outermost.
+ *
+ * @param[in] ex  Possible nested exception to be logged
+ */
+static void logMsg(const std::exception& ex)
+{
+    try {
+        std::rethrow_if_nested(ex);
+    }
+    catch (const std::exception& nested) {
+        logMsg(nested);
+    }
+#ifdef LDM_LOGGING
+    log_add(ex.what());
+    log_flush_error();
+#endif
+}
+
+
+/**
+ * Constructs the TcpSend of a session attached to a runtime.
+ *
+ * @param[in] runtime    The runtime.
+ * @param[in] sessionId  Id of the session.
+ * @param[in] tcpaddr    Address of the interface to listen on.
+ * @param[in] tcpport    Port to listen on or 0 for an ephemeral one.
+ */
+SessionTcpSend::SessionTcpSend(SenderRuntime&  runtime,
+                               uint32_t        sessionId,
+                               std::string     tcpaddr,
+                               unsigned short  tcpport)
+    : TcpSend(tcpaddr, tcpport), runtime(runtime), sessionId(sessionId)
+{
+}
+
+
+/**
+ * Sends a FMTP packet to a receiver through the runtime.
+ *
+ * @param[in] retxsockfd    retransmission socket file descriptor.
+ * @param[in] *sendheader   header in network byte-order.
+ * @param[in] *payload      payload or `NULL`.
+ * @param[in] paylen        size of the payload in bytes.
+ * @return    retval        return the total bytes sent.
+ */
+int SessionTcpSend::sendData(int retxsockfd, FmtpHeader* sendheader,
+                             char* payload, size_t paylen)
+{
+    return runtime.send(sessionId, retxsockfd, sendheader, payload, paylen);
+}
+
+
+/**
+ * Constructs a connection that belongs to the session that accepted it.
+ *
+ * @param[in] sock       Socket of the connection.
+ * @param[in] sessionId  Id of the accepting session.
+ */
+SenderRuntime::Conn::Conn(int sock, uint32_t sessionId)
+    : sock(sock), token(WAKEUP_TOKEN), rxSess(sessionId), rxValid(true),
+      txSess(sessionId), sessions{sessionId}, rxoff(0), rxEof(false),
+      txoff(0), rxArmed(true), txArmed(false), closed(false)
+{
+}
+
+
+/**
+ * Closes the socket when the last user of the connection is gone, so that the
+ * descriptor can't be reused while a job still refers to it.
+ */
+SenderRuntime::Conn::~Conn()
+{
+    (void)close(sock);
+}
+
+
+/**
+ * Constructs a runtime. Nothing runs until Start() is called.
+ *
+ * @param[in] nworkers       Number of worker threads.
+ * @param[in] maxPerSession  Maximum number of workers one session may
+ *                           occupy at once or 0, in which case half of the
+ *                           workers (at least one) are allowed.
+ */
+SenderRuntime::SenderRuntime(unsigned nworkers, unsigned maxPerSession)
+:
+    nworkers(nworkers ? nworkers : 1),
+    maxPerSession(maxPerSession ? maxPerSession :
+                  (this->nworkers + 1) / 2),
+    epfd(-1),
+    wakefd(-1),
+    started(false),
+    stopping(false),
+    nextToken(WAKEUP_TOKEN + 1),
+    loop_t(),
+    timer_t()
+{
+}
+
+
+/**
+ * Destructs the runtime. Stops it if it's still running.
+ */
+SenderRuntime::~SenderRuntime()
+{
+    Stop();
+}
+
+
+/**
+ * Starts the event loop, the timer and the workers. Returns immediately.
+ *
+ * @throw std::system_error  if the epoll instance can't be created.
+ * @throw std::system_error  if a thread can't be created.
+ */
+void SenderRuntime::Start()
+{
+    if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "SenderRuntime::Start() Couldn't create epoll instance");
+    }
+    if ((wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "SenderRuntime::Start() Couldn't create eventfd");
+    }
+    struct epoll_event ev;
+    ev.events   = EPOLLIN;
+    ev.data.u64 = WAKEUP_TOKEN;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &ev) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "SenderRuntime::Start() Couldn't add eventfd");
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        started = true;
+    }
+
+    int retval = pthread_create(&timer_t, NULL, &SenderRuntime::StartTimerLoop,
+                                this);
+    if (retval != 0) {
+        started = false;
+        throw std::system_error(retval, std::system_category(),
+                "SenderRuntime::Start() pthread_create() StartTimerLoop error");
+    }
+    for (unsigned i = 0; i < nworkers; i++) {
+        pthread_t t;
+        retval = pthread_create(&t, NULL, &SenderRuntime::StartWorker, this);
+        if (retval != 0) {
+            stopThreads();
+            started = false;
+            throw std::system_error(retval, std::system_category(),
+                    "SenderRuntime::Start() pthread_create() StartWorker "
+                    "error");
+        }
+        worker_t.push_back(t);
+    }
+    retval = pthread_create(&loop_t, NULL, &SenderRuntime::StartEventLoop,
+                            this);
+    if (retval != 0) {
+        stopThreads();
+        started = false;
+        throw std::system_error(retval, std::system_category(),
+                "SenderRuntime::Start() pthread_create() StartEventLoop error");
+    }
+}
+
+
+/**
+ * Stops the runtime. The receiver connections are shut down and their queued
+ * output is discarded. Doesn't return until all threads have stopped.
+ */
+void SenderRuntime::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!started)
+            return;
+    }
+    stopThreads();
+    uint64_t one = 1;
+    (void)write(wakefd, &one, sizeof(one));
+    (void)pthread_join(loop_t, NULL);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!conns.empty())
+        closeConnLocked(conns.begin()->second);
+    (void)close(epfd);
+    (void)close(wakefd);
+    epfd = wakefd = -1;
+    started = false;
+}
+
+
+/**
+ * Stops the timer and the workers and waits for them.
+ */
+void SenderRuntime::stopThreads()
+{
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        stopping = true;
+        for (auto it = conns.begin(); it != conns.end(); ++it)
+            (void)shutdown(it->first, SHUT_RDWR);
+    }
+    workCv.notify_all();
+    timerCv.notify_all();
+    idleCv.notify_all();
+
+    (void)pthread_join(timer_t, NULL);
+    for (size_t i = 0; i < worker_t.size(); i++)
+        (void)pthread_join(worker_t[i], NULL);
+    worker_t.clear();
+}
+
+
+/**
+ * Returns the accounting of a session.
+ *
+ * @param[in]  sessionId  Session id.
+ * @param[out] stats      Accounting of the session.
+ * @return                `false` if no such session is attached.
+ */
+bool SenderRuntime::getStats(uint32_t sessionId, SessionStats& stats)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    auto it = sessions.find(sessionId);
+    if (it == sessions.end())
+        return false;
+    stats = it->second.stats;
+    return true;
+}
+
+
+/**
+ * Attaches a started session. Its listening socket is made non-blocking so
+ * that a connection which goes away before it's accepted can't block a
+ * worker.
+ *
+ * @param[in] sender     The session.
+ * @param[in] sessionId  Session id, unique within the runtime.
+ *
+ * @throw std::runtime_error  if the runtime isn't started.
+ * @throw std::runtime_error  if the session id is already in use.
+ * @throw std::system_error   if a socket can't be added to the event loop.
+ */
+void SenderRuntime::attach(fmtpSendv3* sender, uint32_t sessionId)
+{
+    int listenfd = sender->tcpsend->getSockfd();
+    int flags = fcntl(listenfd, F_GETFL, 0);
+    if (flags < 0 || fcntl(listenfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "SenderRuntime::attach() Couldn't make listening socket "
+                "non-blocking");
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
+    if (!started || stopping) {
+        throw std::runtime_error("SenderRuntime::attach() runtime isn't "
+                                 "running");
+    }
+    if (sessions.count(sessionId)) {
+        throw std::runtime_error("SenderRuntime::attach() session id " +
+                std::to_string(sessionId) + " is already in use");
+    }
+    Session& sess = sessions[sessionId];
+    sess.sender    = sender;
+    sess.running   = 0;
+    sess.ready     = false;
+    sess.detaching = false;
+    sess.listenTok = WAKEUP_TOKEN;
+    sess.udpTok    = WAKEUP_TOKEN;
+    try {
+        sess.listenTok = addSource(SRC_LISTEN, listenfd, sessionId, nullptr);
+        sess.udpTok    = addSource(SRC_UDP, sender->udpretx->getSockfd(),
+                                   sessionId, nullptr);
+    }
+    catch (const std::system_error& e) {
+        /* only the sockets that were added */
+        if (sess.listenTok != WAKEUP_TOKEN)
+            rmSource(sess.listenTok);
+        sessions.erase(sessionId);
+        throw;
+    }
+}
+
+
+/**
+ * Detaches a session. Its sockets leave the event loop, its queued jobs and
+ * timers are dropped and connections that only it used are closed. Returns
+ * after the session's running jobs have finished.
+ *
+ * @param[in] sessionId  Session id.
+ */
+void SenderRuntime::detach(uint32_t sessionId)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    auto it = sessions.find(sessionId);
+    if (it == sessions.end())
+        return;
+    Session& sess = it->second;
+    sess.detaching = true;
+    rmSource(sess.listenTok);
+    rmSource(sess.udpTok);
+
+    std::deque<Job> dropped;
+    dropped.swap(sess.jobs);
+    for (auto tit = timers.begin(); tit != timers.end(); ) {
+        if (tit->second.sessionId == sessionId)
+            timers.erase(tit++);
+        else
+            ++tit;
+    }
+
+    idleCv.wait(lock, [&sess]{return sess.running == 0;});
+
+    std::vector<ConnPtr> orphans;
+    for (auto cit = conns.begin(); cit != conns.end(); ++cit) {
+        if (cit->second->sessions.erase(sessionId) &&
+                cit->second->sessions.empty())
+            orphans.push_back(cit->second);
+    }
+    sessions.erase(it);
+
+    for (size_t i = 0; i < orphans.size(); i++)
+        closeConnLocked(orphans[i]);
+    /* connections shared with other sessions continue there */
+    for (size_t i = 0; i < dropped.size(); i++)
+        dropJob(dropped[i]);
+}
+
+
+/**
+ * Runs a function on behalf of a session after a delay. The function runs on
+ * a worker like any other job of the session.
+ *
+ * @param[in] sessionId  Session id.
+ * @param[in] delay      Delay in seconds.
+ * @param[in] func       The function.
+ */
+void SenderRuntime::schedule(uint32_t sessionId, double delay,
+                             const std::function<void()>& func)
+{
+    Clock::time_point when = Clock::now() +
+        std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(delay));
+    Timer timer;
+    timer.sessionId = sessionId;
+    timer.func      = func;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    auto it = sessions.find(sessionId);
+    if (it == sessions.end() || it->second.detaching)
+        return;
+    timers.insert(std::make_pair(when, timer));
+    timerCv.notify_one();
+}
+
+
+/**
+ * Sends a message of a session to a receiver. If the connection last carried
+ * a message of another session, a FMTP_SESS_SELECT of this session is sent
+ * first. A connection that was never shared never sees one. The message is
+ * queued behind any earlier output and as much of it is written as the socket
+ * takes; the event loop writes the rest when the receiver reads. Never blocks
+ * on the receiver.
+ *
+ * @param[in] sessionId   Session id.
+ * @param[in] sock        The receiver's socket.
+ * @param[in] sendheader  Header in network byte-order.
+ * @param[in] payload     Payload or `NULL`.
+ * @param[in] paylen      Size of the payload in bytes.
+ * @return                Number of bytes of the message.
+ *
+ * @throw std::system_error  if the connection is closed.
+ * @throw std::system_error  if the receiver is too far behind, in which case
+ *                           the connection is closed.
+ * @throw std::system_error  if sending fails.
+ */
+int SenderRuntime::send(uint32_t sessionId, int sock, FmtpHeader* sendheader,
+                        char* payload, size_t paylen)
+{
+    ConnPtr conn;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        auto it = conns.find(sock);
+        if (it != conns.end())
+            conn = it->second;
+    }
+    if (!conn) {
+        throw std::system_error(ENOTCONN, std::system_category(),
+                "SenderRuntime::send() No connection on socket " +
+                std::to_string(sock));
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(conn->wrMtx);
+        if (conn->txbuf.size() - conn->txoff < CONN_TX_MAX) {
+            if (conn->txSess != sessionId)
+                sendSelect(*conn, sessionId, SESS_ACCEPTED);
+            queueMsg(*conn, sendheader, payload, paylen);
+            flushLocked(*conn);
+            return sizeof(FmtpHeader) + paylen;
+        }
+    }
+    closeConn(conn);
+    throw std::system_error(ENOBUFS, std::system_category(),
+            "SenderRuntime::send() Receiver on socket " +
+            std::to_string(sock) + " is too far behind");
+}
+
+
+/**
+ * Runs a function on behalf of a session once no more than CONN_TX_LOW bytes
+ * of output are queued for a receiver, right away if that's already so. The
+ * function runs on a worker like any other job of the session. It doesn't run
+ * if the connection is closed before.
+ *
+ * @param[in] sessionId  Session id.
+ * @param[in] sock       The receiver's socket.
+ * @param[in] func       The function.
+ */
+void SenderRuntime::whenWritable(uint32_t sessionId, int sock,
+                                 const std::function<void()>& func)
+{
+    ConnPtr conn;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        auto it = conns.find(sock);
+        if (it == conns.end())
+            return;
+        conn = it->second;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(conn->wrMtx);
+        if (conn->txbuf.size() - conn->txoff > CONN_TX_LOW) {
+            /* flushLocked() runs it */
+            Timer waiter;
+            waiter.sessionId = sessionId;
+            waiter.func      = func;
+            conn->drainJobs.push_back(waiter);
+            return;
+        }
+    }
+
+    Job job;
+    job.func = func;
+    std::unique_lock<std::mutex> lock(mtx);
+    enqueue(sessionId, job);
+}
+
+
+/**
+ * Accepts a connection on the listening socket of a session. The connection
+ * belongs to that session until the receiver selects another one.
+ *
+ * @param[in] sessionId  Session id.
+ *
+ * @throw std::system_error  if accept() fails for another reason than the
+ *                           connection going away.
+ */
+void SenderRuntime::acceptRcvr(uint32_t sessionId)
+{
+    fmtpSendv3* sender;
+    uint64_t    listenTok;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        Session& sess = sessions.at(sessionId);
+        sender    = sess.sender;
+        listenTok = sess.listenTok;
+    }
+
+    int sock;
+    try {
+        sock = sender->tcpsend->acceptConn();
+    }
+    catch (const std::system_error& e) {
+        const int err = e.code().value();
+        if (err != EAGAIN && err != EWOULDBLOCK && err != ECONNABORTED &&
+                err != EINTR)
+            throw;
+        rearm(listenTok);
+        return;
+    }
+    /* other receivers can connect while this one is vetted */
+    rearm(listenTok);
+
+    if (!sender->admitRcvr(sock))
+        return;
+
+    /* the connection is only read and written when it's ready */
+    const int flags = fcntl(sock, F_GETFL, 0);
+    if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+        logMsg(std::system_error(errno, std::system_category(),
+                "SenderRuntime::acceptRcvr() Couldn't make socket " +
+                std::to_string(sock) + " non-blocking"));
+        sender->tcpsend->dismantleConn(sock);
+        return;
+    }
+
+    ConnPtr conn(new Conn(sock, sessionId));
+    std::unique_lock<std::mutex> lock(mtx);
+    Session& sess = sessions.at(sessionId);
+    conns[sock] = conn;
+    ++sess.stats.receivers;
+    try {
+        conn->token = addSource(SRC_CONN, sock, sessionId, conn);
+    }
+    catch (const std::system_error& e) {
+        logMsg(e);
+        closeConnLocked(conn);
+    }
+}
+
+
+/**
+ * Adds a file descriptor to the event loop. It's reported once and has to be
+ * re-armed with rearm() after it has been served, so that only one worker
+ * reads from it at a time. Must be called with `mtx` locked.
+ *
+ * @param[in] type       Kind of file descriptor.
+ * @param[in] fd         The file descriptor.
+ * @param[in] sessionId  Session that owns it.
+ * @param[in] conn       The connection, if `type` is SRC_CONN.
+ * @return               Token of the file descriptor.
+ *
+ * @throw std::system_error  if epoll_ctl() fails.
+ */
+uint64_t SenderRuntime::addSource(SourceType type, int fd, uint32_t sessionId,
+                                  const ConnPtr& conn)
+{
+    const uint64_t token = nextToken++;
+    Source& src = sources[token];
+    src.type      = type;
+    src.fd        = fd;
+    src.sessionId = sessionId;
+    src.conn      = conn;
+
+    struct epoll_event ev;
+    ev.events   = EPOLLIN | EPOLLONESHOT;
+    ev.data.u64 = token;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        const int err = errno;
+        sources.erase(token);
+        throw std::system_error(err, std::system_category(),
+                "SenderRuntime::addSource() Couldn't add socket " +
+                std::to_string(fd));
+    }
+    return token;
+}
+
+
+/**
+ * Closes a receiver connection and removes it from all its sessions.
+ *
+ * @param[in] conn  The connection.
+ */
+void SenderRuntime::closeConn(const ConnPtr& conn)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    closeConnLocked(conn);
+}
+
+
+/**
+ * Closes a receiver connection. The socket is shut down right away, but only
+ * closed when the last job using the connection is done. Must be called with
+ * `mtx` locked.
+ *
+ * @param[in] conn  The connection.
+ */
+void SenderRuntime::closeConnLocked(const ConnPtr& conn)
+{
+    if (conn->closed)
+        return;
+    conn->closed = true;
+    rmSource(conn->token);
+    conns.erase(conn->sock);
+    for (auto it = conn->sessions.begin(); it != conn->sessions.end(); ++it) {
+        auto sit = sessions.find(*it);
+        if (sit != sessions.end()) {
+            sit->second.sender->rmUcastRcvr(conn->sock);
+            sit->second.sender->rmUdpPeer(conn->sock);
+            sit->second.sender->tcpsend->rmSockInList(conn->sock);
+            --sit->second.stats.receivers;
+        }
+    }
+    conn->sessions.clear();
+    (void)shutdown(conn->sock, SHUT_RDWR);
+}
+
+
+/**
+ * Queues the next message of a connection to the session it's for. If that
+ * session is going away, another session of the connection reads it, and if
+ * there's none, the connection is closed. Must be called with `mtx` locked.
+ *
+ * @param[in] conn  The connection.
+ */
+void SenderRuntime::dispatchConn(const ConnPtr& conn)
+{
+    if (conn->closed)
+        return;
+
+    bool     found = false;
+    uint32_t sessionId;
+    if (conn->rxValid && conn->sessions.count(conn->rxSess) &&
+            !sessions.at(conn->rxSess).detaching) {
+        sessionId = conn->rxSess;
+        found     = true;
+    }
+    for (auto it = conn->sessions.begin(); !found &&
+            it != conn->sessions.end(); ++it) {
+        if (!sessions.at(*it).detaching) {
+            sessionId = *it;
+            found     = true;
+        }
+    }
+    if (!found) {
+        closeConnLocked(conn);
+        return;
+    }
+
+    Job job;
+    job.func = [this, sessionId, conn]{serveConn(sessionId, conn);};
+    job.conn = conn;
+    enqueue(sessionId, job);
+}
+
+
+/**
+ * Disposes of a job that won't run. The connection of a dropped connection
+ * job is handed to another session. Must be called with `mtx` locked.
+ *
+ * @param[in] job  The job.
+ */
+void SenderRuntime::dropJob(Job& job)
+{
+    if (job.conn)
+        dispatchConn(job.conn);
+}
+
+
+/**
+ * Queues a job of a session. Must be called with `mtx` locked.
+ *
+ * @param[in] sessionId  Session id.
+ * @param[in] job        The job.
+ */
+void SenderRuntime::enqueue(uint32_t sessionId, const Job& job)
+{
+    auto it = sessions.find(sessionId);
+    if (it == sessions.end() || it->second.detaching) {
+        Job dropped = job;
+        dropJob(dropped);
+        return;
+    }
+    Session& sess = it->second;
+    sess.jobs.push_back(job);
+    sess.stats.queued = sess.jobs.size();
+    if (sess.stats.queued > sess.stats.maxQueued)
+        sess.stats.maxQueued = sess.stats.queued;
+    makeReady(sess, sessionId);
+}
+
+
+/**
+ * The event loop. Waits for the sockets of all sessions and queues a job for
+ * each one that's ready to be read. Queued output of the receiver connections
+ * is written by the loop itself, since that never blocks.
+ *
+ * @throw std::system_error  if epoll_wait() fails.
+ */
+void SenderRuntime::eventLoop()
+{
+    struct epoll_event   events[MAX_EVENTS];
+    std::vector<ConnPtr> writable;
+
+    while (1) {
+        int nevents = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (nevents < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::system_category(),
+                    "SenderRuntime::eventLoop() epoll_wait() failed");
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if (stopping)
+                return;
+            for (int i = 0; i < nevents; i++) {
+                auto it = sources.find(events[i].data.u64);
+                if (it == sources.end())
+                    continue;
+                const uint32_t sessionId = it->second.sessionId;
+                const uint32_t revents   = events[i].events;
+                /* serving the connection may remove its source */
+                const ConnPtr  conn      = it->second.conn;
+                Job job;
+                switch (it->second.type) {
+                    case SRC_LISTEN:
+                        job.func = [this, sessionId]{acceptRcvr(sessionId);};
+                        enqueue(sessionId, job);
+                        break;
+                    case SRC_UDP:
+                        job.func = [this, sessionId]{serveUdp(sessionId);};
+                        enqueue(sessionId, job);
+                        break;
+                    case SRC_CONN:
+                        if (conn->txArmed && (revents & ~EPOLLIN)) {
+                            conn->txArmed = false;
+                            writable.push_back(conn);
+                        }
+                        if (conn->rxArmed && (revents & ~EPOLLOUT)) {
+                            conn->rxArmed = false;
+                            dispatchConn(conn);
+                        }
+                        /* what wasn't reported stays armed */
+                        updateEvents(*conn);
+                        break;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < writable.size(); i++)
+            flushConn(writable[i]);
+        writable.clear();
+    }
+}
+
+
+/**
+ * Writes the queued output of a receiver connection. The connection is closed
+ * if it's broken.
+ *
+ * @param[in] conn  The connection.
+ */
+void SenderRuntime::flushConn(const ConnPtr& conn)
+{
+    try {
+        std::unique_lock<std::mutex> lock(conn->wrMtx);
+        flushLocked(*conn);
+    }
+    catch (const std::system_error& e) {
+        logMsg(e);
+        closeConn(conn);
+    }
+}
+
+
+/**
+ * Writes as much of the queued output of a receiver connection as its socket
+ * takes. If some is left, the event loop is told to report when the socket
+ * has room. The jobs that wait for the output to drain are queued once it
+ * has. Must be called with the write lock of the connection held.
+ *
+ * @param[in] conn  The connection.
+ *
+ * @throw std::system_error  if writing fails.
+ */
+void SenderRuntime::flushLocked(Conn& conn)
+{
+    while (conn.txoff < conn.txbuf.size()) {
+        const ssize_t nbytes = ::send(conn.sock, conn.txbuf.data() + conn.txoff,
+                                      conn.txbuf.size() - conn.txoff,
+                                      MSG_NOSIGNAL);
+        if (nbytes < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            throw std::system_error(errno, std::system_category(),
+                    "SenderRuntime::flushLocked() Couldn't write to socket " +
+                    std::to_string(conn.sock));
+        }
+        conn.txoff += nbytes;
+    }
+
+    const bool pending = conn.txoff < conn.txbuf.size();
+    if (!pending) {
+        conn.txbuf.clear();
+        conn.txoff = 0;
+    }
+    /* the written part is dropped once it's the larger one */
+    else if (conn.txoff >= conn.txbuf.size() / 2) {
+        conn.txbuf.erase(0, conn.txoff);
+        conn.txoff = 0;
+    }
+    std::vector<Timer> drained;
+    if (conn.txbuf.size() - conn.txoff <= CONN_TX_LOW)
+        drained.swap(conn.drainJobs);
+    if (!pending && drained.empty())
+        return;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    if (pending && !conn.txArmed && !conn.closed) {
+        conn.txArmed = true;
+        updateEvents(conn);
+    }
+    for (size_t i = 0; i < drained.size(); i++) {
+        Job job;
+        job.func = drained[i].func;
+        enqueue(drained[i].sessionId, job);
+    }
+}
+
+
+/**
+ * Joins a receiver connection to a session it selected. The session vets the
+ * receiver just like a new connection, and the receiver is told whether it
+ * was accepted. Serving the connection then goes on with this session.
+ *
+ * @param[in] sessionId  Id of the selected session.
+ * @param[in] conn       The connection.
+ */
+void SenderRuntime::joinSession(uint32_t sessionId, const ConnPtr& conn)
+{
+    fmtpSendv3* sender;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        sender = sessions.at(sessionId).sender;
+    }
+
+    try {
+        const bool accepted = !sender->notifier ||
+                              sender->notifier->vetNewRcvr(conn->sock);
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if (conn->closed)
+                return;
+            if (accepted) {
+                conn->sessions.insert(sessionId);
+                conn->rxSess = sessionId;
+                ++sessions.at(sessionId).stats.receivers;
+                sender->tcpsend->addSockInList(conn->sock);
+            }
+            conn->rxValid = accepted;
+        }
+        if (accepted)
+            sender->tcpsend->updatePathMTU(conn->sock);
+
+        std::unique_lock<std::mutex> lock(conn->wrMtx);
+        sendSelect(*conn, sessionId, accepted ? SESS_ACCEPTED : SESS_REFUSED);
+    }
+    catch (const std::exception& e) {
+        logMsg(e);
+        closeConn(conn);
+        return;
+    }
+    /* the messages that followed the selection */
+    serveBuffered(sessionId, conn);
+}
+
+
+/**
+ * Puts a session into the ready queue if it has jobs and may use another
+ * worker. Must be called with `mtx` locked.
+ *
+ * @param[in] sess       The session.
+ * @param[in] sessionId  Session id.
+ */
+void SenderRuntime::makeReady(Session& sess, uint32_t sessionId)
+{
+    if (!sess.ready && !sess.jobs.empty() && !sess.detaching &&
+            sess.running < maxPerSession) {
+        sess.ready = true;
+        readyQ.push_back(sessionId);
+        workCv.notify_one();
+    }
+}
+
+
+/**
+ * Queues a message for a receiver. Must be called with the write lock of the
+ * connection held.
+ *
+ * @param[in] conn     The connection.
+ * @param[in] header   Header in network byte-order.
+ * @param[in] payload  Payload or `NULL`.
+ * @param[in] paylen   Size of the payload in bytes.
+ */
+void SenderRuntime::queueMsg(Conn& conn, const FmtpHeader* header,
+                             const char* payload, size_t paylen)
+{
+    conn.txbuf.append(reinterpret_cast<const char*>(header), sizeof(*header));
+    if (payload)
+        conn.txbuf.append(payload, paylen);
+}
+
+
+/**
+ * Reads what a receiver has sent, up to CONN_READ_LEN bytes, and appends it to
+ * the unserved input of the connection. Doesn't block.
+ *
+ * @param[in] conn  The connection.
+ *
+ * @throw std::system_error  if reading fails.
+ */
+void SenderRuntime::readConn(Conn& conn)
+{
+    if (conn.rxEof)
+        return;
+
+    const size_t len = conn.rxbuf.size();
+    conn.rxbuf.resize(len + CONN_READ_LEN);
+    ssize_t nbytes;
+    do {
+        nbytes = recv(conn.sock, &conn.rxbuf[len], CONN_READ_LEN, 0);
+    } while (nbytes < 0 && errno == EINTR);
+
+    if (nbytes < 0) {
+        const int err = errno;
+        conn.rxbuf.resize(len);
+        if (err == EAGAIN || err == EWOULDBLOCK)
+            return;
+        throw std::system_error(err, std::system_category(),
+                "SenderRuntime::readConn() Couldn't read from socket " +
+                std::to_string(conn.sock));
+    }
+    conn.rxbuf.resize(len + nbytes);
+    if (nbytes == 0)
+        conn.rxEof = true;
+}
+
+
+/**
+ * Re-arms a file descriptor in the event loop after it has been served.
+ *
+ * @param[in] token  Token of the file descriptor.
+ */
+void SenderRuntime::rearm(uint64_t token)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    auto it = sources.find(token);
+    if (it == sources.end())
+        return;
+    if (it->second.conn) {
+        /* its output may be armed, too */
+        it->second.conn->rxArmed = true;
+        updateEvents(*it->second.conn);
+        return;
+    }
+    struct epoll_event ev;
+    ev.events   = EPOLLIN | EPOLLONESHOT;
+    ev.data.u64 = token;
+    (void)epoll_ctl(epfd, EPOLL_CTL_MOD, it->second.fd, &ev);
+}
+
+
+/**
+ * Removes a file descriptor from the event loop. Must be called with `mtx`
+ * locked.
+ *
+ * @param[in] token  Token of the file descriptor.
+ */
+void SenderRuntime::rmSource(uint64_t token)
+{
+    auto it = sources.find(token);
+    if (it == sources.end())
+        return;
+    (void)epoll_ctl(epfd, EPOLL_CTL_DEL, it->second.fd, NULL);
+    sources.erase(it);
+}
+
+
+/**
+ * Runs a job. An exception that escapes a job breaks only the job's session,
+ * like it would break the thread of a standalone session.
+ *
+ * @param[in] sender  The session of the job.
+ * @param[in] job     The job.
+ */
+void SenderRuntime::runJob(fmtpSendv3* sender, Job& job)
+{
+    try {
+        job.func();
+    }
+    catch (const std::exception& e) {
+        logMsg(e);
+        sender->taskBroke(std::current_exception());
+    }
+}
+
+
+/**
+ * Handles a FMTP_SESS_SELECT from a receiver. Selecting a joined session only
+ * redirects the following messages. Selecting a new session joins it, which
+ * is done by that session's job.
+ *
+ * @param[in] conn       The connection.
+ * @param[in] sessionId  Id of the selected session.
+ * @retval    `true`     The following messages can be served.
+ * @retval    `false`    The job of the joined session serves them.
+ *
+ * @throw std::system_error  if a refusal can't be sent.
+ */
+bool SenderRuntime::selectSession(const ConnPtr& conn, uint32_t sessionId)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    auto it = sessions.find(sessionId);
+    if (it != sessions.end() && !it->second.detaching) {
+        if (conn->sessions.count(sessionId)) {
+            conn->rxSess  = sessionId;
+            conn->rxValid = true;
+            return true;
+        }
+        Job job;
+        job.func = [this, sessionId, conn]{joinSession(sessionId, conn);};
+        job.conn = conn;
+        enqueue(sessionId, job);
+        return false;
+    }
+
+    conn->rxValid = false;
+    lock.unlock();
+    std::unique_lock<std::mutex> wrlock(conn->wrMtx);
+    sendSelect(*conn, sessionId, SESS_REFUSED);
+    return true;
+}
+
+
+/**
+ * Sends a FMTP_SESS_SELECT to a receiver like send() does. Must be called with
+ * the write lock of the connection held.
+ *
+ * @param[in] conn       The connection.
+ * @param[in] sessionId  Session id.
+ * @param[in] status     SESS_ACCEPTED or SESS_REFUSED.
+ *
+ * @throw std::system_error  if sending fails.
+ */
+void SenderRuntime::sendSelect(Conn& conn, uint32_t sessionId,
+                               uint32_t status)
+{
+    FmtpHeader header;
+    header.prodindex  = htonl(sessionId);
+    header.seqnum     = htonl(status);
+    header.payloadlen = 0;
+    header.flags      = htons(FMTP_SESS_SELECT);
+    queueMsg(conn, &header, NULL, 0);
+    flushLocked(conn);
+    /* a refusal doesn't switch the session of the following messages */
+    if (status == SESS_ACCEPTED)
+        conn.txSess = sessionId;
+}
+
+
+/**
+ * Serves the complete messages that were read from a receiver connection. A
+ * message of another joined session is left to a job of that session, and a
+ * message for a session the receiver isn't allowed in is discarded. The
+ * connection is re-armed when all has been served. It's closed if it's
+ * broken, like a standalone retransmission thread would exit.
+ *
+ * @param[in] sessionId  Session the messages are served for.
+ * @param[in] conn       The connection.
+ */
+void SenderRuntime::serveBuffered(uint32_t sessionId, const ConnPtr& conn)
+{
+    try {
+        while (conn->rxbuf.size() - conn->rxoff >= FMTP_HEADER_LEN) {
+            const char* const msg = conn->rxbuf.data() + conn->rxoff;
+            FmtpHeader header;
+            (void)memcpy(&header, msg, FMTP_HEADER_LEN);
+            header.prodindex  = ntohl(header.prodindex);
+            header.seqnum     = ntohl(header.seqnum);
+            header.payloadlen = ntohs(header.payloadlen);
+            header.flags      = ntohs(header.flags);
+            const size_t len = FMTP_HEADER_LEN +
+                               fmtpSendv3::rcvrPayloadLen(&header);
+            if (conn->rxbuf.size() - conn->rxoff < len)
+                break;
+
+            if (header.flags == FMTP_SESS_SELECT) {
+                conn->rxoff += len;
+                if (!selectSession(conn, header.prodindex))
+                    return;
+                continue;
+            }
+
+            fmtpSendv3* sender = NULL;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                if (conn->rxValid && conn->rxSess == sessionId) {
+                    Session& sess = sessions.at(sessionId);
+                    sender = sess.sender;
+                    ++sess.stats.messages;
+                }
+                else if (conn->rxValid &&
+                         conn->sessions.count(conn->rxSess) &&
+                         !sessions.at(conn->rxSess).detaching) {
+                    dispatchConn(conn);
+                    return;
+                }
+            }
+            if (sender)
+                sender->serveRetxMsg(&header, conn->sock, msg +
+                                     FMTP_HEADER_LEN);
+            conn->rxoff += len;
+        }
+    }
+    catch (const std::exception& e) {
+        logMsg(e);
+        closeConn(conn);
+        return;
+    }
+
+    conn->rxbuf.erase(0, conn->rxoff);
+    conn->rxoff = 0;
+    if (conn->rxEof) {
+        logMsg(std::runtime_error("SenderRuntime::serveBuffered() receiver "
+                "closed socket " + std::to_string(conn->sock)));
+        closeConn(conn);
+        return;
+    }
+    rearm(conn->token);
+}
+
+
+/**
+ * Reads from a receiver connection that's ready and serves what was read.
+ *
+ * @param[in] sessionId  Session the messages are served for.
+ * @param[in] conn       The connection.
+ */
+void SenderRuntime::serveConn(uint32_t sessionId, const ConnPtr& conn)
+{
+    try {
+        readConn(*conn);
+    }
+    catch (const std::exception& e) {
+        logMsg(e);
+        closeConn(conn);
+        return;
+    }
+    serveBuffered(sessionId, conn);
+}
+
+
+/**
+ * Serves one datagram on the UDP repair socket of a session.
+ *
+ * @param[in] sessionId  Session id.
+ */
+void SenderRuntime::serveUdp(uint32_t sessionId)
+{
+    fmtpSendv3* sender;
+    uint64_t    udpTok;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        Session& sess = sessions.at(sessionId);
+        sender = sess.sender;
+        udpTok = sess.udpTok;
+    }
+    sender->serveUdpRetxReq();
+    rearm(udpTok);
+}
+
+
+/**
+ * The timer. Queues the function of every timer that's due as a job of its
+ * session.
+ */
+void SenderRuntime::timerLoop()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stopping) {
+        if (timers.empty()) {
+            timerCv.wait(lock);
+            continue;
+        }
+        auto it = timers.begin();
+        if (it->first > Clock::now()) {
+            timerCv.wait_until(lock, it->first);
+            continue;
+        }
+        Job job;
+        job.func = it->second.func;
+        auto sit = sessions.find(it->second.sessionId);
+        if (sit != sessions.end())
+            ++sit->second.stats.timeouts;
+        enqueue(it->second.sessionId, job);
+        timers.erase(it);
+    }
+}
+
+
+/**
+ * Tells the event loop what to report on a receiver connection: input, unless
+ * a job is serving it, and room for output, if some is queued. Must be called
+ * with `mtx` locked.
+ *
+ * @param[in] conn  The connection.
+ */
+void SenderRuntime::updateEvents(const Conn& conn)
+{
+    if (conn.closed || conn.token == WAKEUP_TOKEN)
+        return;
+    struct epoll_event ev;
+    ev.events   = EPOLLONESHOT | (conn.rxArmed ? (uint32_t)EPOLLIN : 0u) |
+                  (conn.txArmed ? (uint32_t)EPOLLOUT : 0u);
+    ev.data.u64 = conn.token;
+    (void)epoll_ctl(epfd, EPOLL_CTL_MOD, conn.sock, &ev);
+}
+
+
+/**
+ * A worker. Takes the session at the head of the ready queue, runs its oldest
+ * job and puts the session back at the tail, so that every session with work
+ * gets its turn.
+ */
+void SenderRuntime::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stopping) {
+        if (readyQ.empty()) {
+            workCv.wait(lock);
+            continue;
+        }
+        const uint32_t sessionId = readyQ.front();
+        readyQ.pop_front();
+        auto it = sessions.find(sessionId);
+        if (it == sessions.end())
+            continue;
+        Session& sess = it->second;
+        sess.ready = false;
+        if (sess.jobs.empty() || sess.detaching ||
+                sess.running >= maxPerSession)
+            continue;
+
+        Job job = sess.jobs.front();
+        sess.jobs.pop_front();
+        sess.stats.queued = sess.jobs.size();
+        ++sess.running;
+        makeReady(sess, sessionId);
+        lock.unlock();
+
+        Clock::time_point start = Clock::now();
+        runJob(sess.sender, job);
+        std::chrono::duration<double> busy = Clock::now() - start;
+        job = Job();
+
+        lock.lock();
+        --sess.running;
+        ++sess.stats.jobs;
+        sess.stats.busyTime += busy.count();
+        makeReady(sess, sessionId);
+        if (sess.detaching && !sess.running)
+            idleCv.notify_all();
+    }
+}
+
+
+/**
+ * Executes the event loop.
+ *
+ * Called by `::pthread_create()`.
+ *
+ * @param[in,out] ptr   Pointer to the `SenderRuntime` instance
+ * @retval        NULL  Always
+ */
+void* SenderRuntime::StartEventLoop(void* ptr)
+{
+#ifdef LDM_LOGGING
+    pthread_cleanup_push(freeLogging, nullptr);
+#endif
+    SenderRuntime* runtime = static_cast<SenderRuntime*>(ptr);
+    try {
+        runtime->eventLoop();
+    }
+    catch (const std::exception& e) {
+        /* without the event loop no session can serve its receivers */
+        logMsg(e);
+        std::unique_lock<std::mutex> lock(runtime->mtx);
+        for (auto it = runtime->sessions.begin();
+                it != runtime->sessions.end(); ++it)
+            it->second.sender->taskBroke(std::current_exception());
+    }
+#ifdef LDM_LOGGING
+    pthread_cleanup_pop(true);
+#endif
+    return NULL;
+}
+
+
+/**
+ * Executes the timer.
+ *
+ * Called by `::pthread_create()`.
+ *
+ * @param[in,out] ptr   Pointer to the `SenderRuntime` instance
+ * @retval        NULL  Always
+ */
+void* SenderRuntime::StartTimerLoop(void* ptr)
+{
+#ifdef LDM_LOGGING
+    pthread_cleanup_push(freeLogging, nullptr);
+#endif
+    static_cast<SenderRuntime*>(ptr)->timerLoop();
+#ifdef LDM_LOGGING
+    pthread_cleanup_pop(true);
+#endif
+    return NULL;
+}
+
+
+/**
+ * Executes a worker.
+ *
+ * Called by `::pthread_create()`.
+ *
+ * @param[in,out] ptr   Pointer to the `SenderRuntime` instance
+ * @retval        NULL  Always
+ */
+void* SenderRuntime::StartWorker(void* ptr)
+{
+#ifdef LDM_LOGGING
+    pthread_cleanup_push(freeLogging, nullptr);
+#endif
+    static_cast<SenderRuntime*>(ptr)->workerLoop();
+#ifdef LDM_LOGGING
+    pthread_cleanup_pop(true);
+#endif
+    return NULL;
+}
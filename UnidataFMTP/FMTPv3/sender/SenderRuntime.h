@@ -0,0 +1,308 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      SenderRuntime.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of the runtime shared by sender sessions.
+ *
+ * A standalone fmtpSendv3 runs a coordinator thread, a timer thread, a UDP
+ * repair thread and one retransmission thread per receiver. A SenderRuntime
+ * replaces all of them for any number of fmtpSendv3 sessions in a process with
+ * one epoll(7) event loop, one timer thread and a fixed pool of workers. Work
+ * is queued per session and the sessions are served round-robin, with a cap
+ * on the workers one session may occupy, so that a busy session can't starve
+ * the others. A receiver connection can be shared by several sessions, see
+ * FMTP_SESS_SELECT. The receiver connections are non-blocking: the event loop
+ * reports them when there's something to read or when queued output can be
+ * written, so that a slow receiver never holds up a worker.
+ */
+
+
+#ifndef FMTP_SENDER_SENDERRUNTIME_H_
+#define FMTP_SENDER_SENDERRUNTIME_H_
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "TcpSend.h"
+#include "fmtpBase.h"
+
+
+class fmtpSendv3;
+class SenderRuntime;
+
+
+/**
+ * Per-session accounting of a SenderRuntime.
+ */
+struct SessionStats
+{
+    uint32_t  receivers;  /*!< receiver connections joined to the session */
+    uint64_t  messages;   /*!< messages served from receivers */
+    uint64_t  timeouts;   /*!< product timers that went off */
+    uint64_t  jobs;       /*!< jobs run by the worker pool */
+    size_t    queued;     /*!< jobs waiting for a worker */
+    size_t    maxQueued;  /*!< high-water mark of `queued` */
+    double    busyTime;   /*!< worker time spent on the session in seconds */
+
+    SessionStats(): receivers(0), messages(0), timeouts(0), jobs(0),
+                    queued(0), maxQueued(0), busyTime(0) {}
+};
+
+
+/**
+ * The TcpSend of a session attached to a SenderRuntime. It listens like a
+ * TcpSend, but sends through the runtime so that a message on a shared
+ * connection is preceded by the session's FMTP_SESS_SELECT when needed.
+ */
+class SessionTcpSend : public TcpSend
+{
+public:
+    SessionTcpSend(SenderRuntime& runtime, uint32_t sessionId,
+                   std::string tcpaddr, unsigned short tcpport = 0);
+    int sendData(int retxsockfd, FmtpHeader* sendheader, char* payload,
+                 size_t paylen);
+
+private:
+    SenderRuntime&  runtime;
+    const uint32_t  sessionId;
+};
+
+
+class SenderRuntime
+{
+public:
+    /**
+     * Constructs.
+     *
+     * @param[in] nworkers       Number of worker threads.
+     * @param[in] maxPerSession  Maximum number of workers one session may
+     *                           occupy at once or 0, in which case half of
+     *                           the workers (at least one) are allowed.
+     */
+    explicit SenderRuntime(unsigned nworkers = 4, unsigned maxPerSession = 0);
+    ~SenderRuntime();
+
+    /** Starts the event loop, the timer and the workers. */
+    void Start();
+    /**
+     * Stops the runtime. Sessions should be stopped first. Doesn't return
+     * until all threads have stopped.
+     */
+    void Stop();
+    /**
+     * Returns the accounting of a session.
+     *
+     * @param[in]  sessionId  Session id.
+     * @param[out] stats      Accounting of the session.
+     * @return                `false` if no such session is attached.
+     */
+    bool getStats(uint32_t sessionId, SessionStats& stats);
+
+    /* ----------- called by fmtpSendv3 only ----------- */
+    /**
+     * Attaches a started session. Its listening and UDP repair sockets are
+     * served by the event loop from now on.
+     *
+     * @param[in] sender     The session.
+     * @param[in] sessionId  Session id, unique within the runtime.
+     */
+    void attach(fmtpSendv3* sender, uint32_t sessionId);
+    /**
+     * Detaches a session. Queued work and timers of the session are dropped.
+     * Returns after the session's running jobs have finished.
+     *
+     * @param[in] sessionId  Session id.
+     */
+    void detach(uint32_t sessionId);
+    /**
+     * Runs a function on behalf of a session after a delay.
+     *
+     * @param[in] sessionId  Session id.
+     * @param[in] delay      Delay in seconds.
+     * @param[in] func       The function.
+     */
+    void schedule(uint32_t sessionId, double delay,
+                  const std::function<void()>& func);
+    /**
+     * Sends a message of a session to a receiver. Doesn't block: what can't
+     * be written right away is queued and written when the receiver reads.
+     *
+     * @param[in] sessionId   Session id.
+     * @param[in] sock        The receiver's socket.
+     * @param[in] sendheader  Header in network byte-order.
+     * @param[in] payload     Payload or `NULL`.
+     * @param[in] paylen      Size of the payload in bytes.
+     * @return                Number of bytes of the message.
+     */
+    int send(uint32_t sessionId, int sock, FmtpHeader* sendheader,
+             char* payload, size_t paylen);
+    /**
+     * Runs a function on behalf of a session once the receiver has read most
+     * of the output queued for it, which may be right away.
+     *
+     * @param[in] sessionId  Session id.
+     * @param[in] sock       The receiver's socket.
+     * @param[in] func       The function.
+     */
+    void whenWritable(uint32_t sessionId, int sock,
+                      const std::function<void()>& func);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    /** a function run on behalf of a session */
+    struct Timer {
+        uint32_t               sessionId;
+        std::function<void()>  func;
+    };
+
+    /** a receiver connection */
+    struct Conn {
+        int                 sock;
+        uint64_t            token;
+        /** session of incoming messages, if `rxValid` */
+        uint32_t            rxSess;
+        bool                rxValid;
+        /** session of outgoing messages */
+        uint32_t            txSess;
+        /** sessions the receiver has joined */
+        std::set<uint32_t>  sessions;
+        /** input read but not yet served, used by one job at a time */
+        std::string         rxbuf;
+        /** start of the unserved input in `rxbuf` */
+        size_t              rxoff;
+        /** the receiver has closed its end */
+        bool                rxEof;
+        /** protects `txbuf`, `txoff` and `txSess` */
+        std::mutex          wrMtx;
+        /** output not yet written */
+        std::string         txbuf;
+        /** start of the unwritten output in `txbuf` */
+        size_t              txoff;
+        /** run once the unwritten output has drained, see whenWritable() */
+        std::vector<Timer>  drainJobs;
+        /** the event loop reports input or writable space, under `mtx` */
+        bool                rxArmed;
+        bool                txArmed;
+        bool                closed;
+
+        Conn(int sock, uint32_t sessionId);
+        ~Conn();
+    };
+    typedef std::shared_ptr<Conn> ConnPtr;
+
+    struct Job {
+        std::function<void()>  func;
+        /** connection to resume if the job is dropped */
+        ConnPtr                 conn;
+    };
+
+    struct Session {
+        fmtpSendv3*        sender;
+        std::deque<Job>    jobs;
+        unsigned           running;
+        bool               ready;     /*!< in the ready queue */
+        bool               detaching;
+        uint64_t           listenTok;
+        uint64_t           udpTok;
+        SessionStats       stats;
+    };
+
+    enum SourceType {SRC_LISTEN, SRC_UDP, SRC_CONN};
+    /** a file descriptor in the event loop */
+    struct Source {
+        SourceType  type;
+        int         fd;
+        uint32_t    sessionId;
+        ConnPtr     conn;
+    };
+
+    void acceptRcvr(uint32_t sessionId);
+    uint64_t addSource(SourceType type, int fd, uint32_t sessionId,
+                       const ConnPtr& conn);
+    void closeConn(const ConnPtr& conn);
+    void closeConnLocked(const ConnPtr& conn);
+    void dispatchConn(const ConnPtr& conn);
+    void dropJob(Job& job);
+    void enqueue(uint32_t sessionId, const Job& job);
+    void eventLoop();
+    void flushConn(const ConnPtr& conn);
+    void flushLocked(Conn& conn);
+    void joinSession(uint32_t sessionId, const ConnPtr& conn);
+    void makeReady(Session& sess, uint32_t sessionId);
+    void queueMsg(Conn& conn, const FmtpHeader* header, const char* payload,
+                  size_t paylen);
+    void readConn(Conn& conn);
+    void rearm(uint64_t token);
+    void rmSource(uint64_t token);
+    void runJob(fmtpSendv3* sender, Job& job);
+    bool selectSession(const ConnPtr& conn, uint32_t sessionId);
+    void sendSelect(Conn& conn, uint32_t sessionId, uint32_t status);
+    void serveBuffered(uint32_t sessionId, const ConnPtr& conn);
+    void serveConn(uint32_t sessionId, const ConnPtr& conn);
+    void serveUdp(uint32_t sessionId);
+    void stopThreads();
+    void timerLoop();
+    void updateEvents(const Conn& conn);
+    void workerLoop();
+    static void* StartEventLoop(void* ptr);
+    static void* StartTimerLoop(void* ptr);
+    static void* StartWorker(void* ptr);
+    /* Prevent copying because it's meaningless */
+    SenderRuntime(SenderRuntime&);
+    SenderRuntime& operator=(const SenderRuntime&);
+
+    const unsigned                     nworkers;
+    const unsigned                     maxPerSession;
+    int                                epfd;
+    /** wakes up the event loop on Stop() */
+    int                                wakefd;
+    /** protects everything below */
+    std::mutex                         mtx;
+    bool                               started;
+    bool                               stopping;
+    std::map<uint32_t, Session>        sessions;
+    /** sessions with runnable jobs, served round-robin */
+    std::deque<uint32_t>               readyQ;
+    std::map<int, ConnPtr>             conns;
+    std::map<uint64_t, Source>         sources;
+    uint64_t                           nextToken;
+    std::multimap<Clock::time_point, Timer> timers;
+    std::condition_variable            workCv;
+    std::condition_variable            timerCv;
+    std::condition_variable            idleCv;
+    pthread_t                          loop_t;
+    pthread_t                          timer_t;
+    std::vector<pthread_t>             worker_t;
+};
+
+
+#endif /* FMTP_SENDER_SENDERRUNTIME_H_ */
@@ -37,6 +37,7 @@
 #endif
 
 #include <errno.h>
+#include <algorithm>
 #include <exception>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -190,12 +191,30 @@ int TcpSend::acceptConn()
     {
         std::unique_lock<std::mutex> lock(sockListMutex);
         connSockList.push_back(newsockfd);
+        sendMtxs[newsockfd].reset(new std::mutex());
     }
 
     return newsockfd;
 }
 
 
+/**
+ * Adds a connection that wasn't accepted by this instance to the socket list,
+ * e.g. a receiver connection shared by several sessions.
+ *
+ * @param[in] sockfd    retransmission socket file descriptor.
+ */
+void TcpSend::addSockInList(int sockfd)
+{
+    std::unique_lock<std::mutex> lock(sockListMutex);
+    if (std::find(connSockList.begin(), connSockList.end(), sockfd) ==
+            connSockList.end()) {
+        connSockList.push_back(sockfd);
+        sendMtxs[sockfd].reset(new std::mutex());
+    }
+}
+
+
 /**
  * Closes tcp connections and removes them from the current connection list.
  *
@@ -370,6 +389,22 @@ int TcpSend::readSock(int retxsockfd, char* pktBuf, int bufSize)
 }
 
 
+/**
+ * Reads the payload that follows a header parsed by parseHeader(). Blocks
+ * until the given amount of bytes is read or the end-of-file is encountered.
+ *
+ * @param[in] retxsockfd         retransmission socket file descriptor.
+ * @param[in] *buf               pointer to the buffer to store the payload.
+ * @param[in] len                size of the payload in bytes.
+ * @return    Number of bytes read. Less than `len` means EOF.
+ * @throws    std::system_error  error reading from the socket.
+ */
+size_t TcpSend::recvPayload(int retxsockfd, void* buf, size_t len)
+{
+    return recvall(retxsockfd, buf, len);
+}
+
+
 /**
  * Removes the given socket from the list.
  *
@@ -379,13 +414,16 @@ void TcpSend::rmSockInList(int sockfd)
 {
     std::unique_lock<std::mutex> lock(sockListMutex);
     connSockList.remove(sockfd);
+    sendMtxs.erase(sockfd);
 }
 
 
 /**
  * Sends a FMTP packet through the given retransmission connection identified
  * by retxsockfd. It blocks until all sending is finished. Or it can terminate
- * with error occurred.
+ * with error occurred. The header and the payload are gathered into one
+ * sendmsg() call straight from the caller's buffers. Packets sent by different
+ * threads to the same receiver don't interleave.
  *
  * @param[in] retxsockfd    retransmission socket file descriptor.
  * @param[in] *sendheader   pointer of a FmtpHeader structure, whose fields
@@ -394,17 +432,76 @@ void TcpSend::rmSockInList(int sockfd)
  *                          holds the packet payload.
  * @param[in] paylen        size to be sent (size of the payload)
  * @return    retval        return the total bytes sent.
+ * @throw  std::system_error  if sendmsg() fails.
  */
 int TcpSend::sendData(int retxsockfd, FmtpHeader* sendheader, char* payload,
                       size_t paylen)
 {
-    sendall(retxsockfd, sendheader, sizeof(FmtpHeader));
-    sendall(retxsockfd, payload, paylen);
+    std::shared_ptr<std::mutex> sendMtx;
+    {
+        std::unique_lock<std::mutex> lock(sockListMutex);
+        std::map<int, std::shared_ptr<std::mutex>>::iterator it =
+                sendMtxs.find(retxsockfd);
+        if (it != sendMtxs.end())
+            sendMtx = it->second;
+    }
+
+    struct iovec iov[2];
+    iov[0].iov_base = sendheader;
+    iov[0].iov_len  = sizeof(FmtpHeader);
+    iov[1].iov_base = payload;
+    iov[1].iov_len  = payload ? paylen : 0;
+
+    std::unique_lock<std::mutex> lock;
+    if (sendMtx)
+        lock = std::unique_lock<std::mutex>(*sendMtx);
+    sendallv(retxsockfd, iov, 2);
 
     return (sizeof(FmtpHeader) + paylen);
 }
 
 
+/**
+ * Writes a gather vector to a streaming socket. Returns when all of it is
+ * written or an error occurs. The vector is consumed in the process.
+ *
+ * @param[in] sock    The streaming socket.
+ * @param[in] iov     The gather vector.
+ * @param[in] iovcnt  Number of elements in `iov`.
+ * @throws std::system_error  if an error is encountered writing to the
+ *                            socket.
+ */
+void TcpSend::sendallv(const int sock, struct iovec* iov, int iovcnt)
+{
+    struct msghdr msg = {};
+
+    while (iovcnt > 0) {
+        if (iov->iov_len == 0) {
+            ++iov;
+            --iovcnt;
+            continue;
+        }
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t nwritten = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (nwritten <= 0) {
+            throw std::system_error(errno, std::system_category(),
+                    "TcpSend::sendallv() Error sending to socket " +
+                    std::to_string(sock));
+        }
+        while (iovcnt > 0 && (size_t)nwritten >= iov->iov_len) {
+            nwritten -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + nwritten;
+            iov->iov_len -= nwritten;
+        }
+    }
+}
+
+
 /**
  * Sends a FMTP packet through the given retransmission connection identified
  * by retxsockfd. It blocks until all sending is finished. Or it can terminate
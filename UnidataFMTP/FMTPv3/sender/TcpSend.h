@@ -37,8 +37,11 @@
 
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <sys/uio.h>
 #include <atomic>
 #include <list>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 
@@ -51,23 +54,29 @@ class TcpSend : public TcpBase
 public:
     /** source port would be initialized to 0 if not being specified. */
     TcpSend(std::string tcpaddr, unsigned short tcpport = 0);
-    ~TcpSend();
+    virtual ~TcpSend();
 
     int acceptConn();
+    /** adds a connection accepted elsewhere to the socket list */
+    void addSockInList(int sockfd);
     void dismantleConn(int sockfd);
     /** return the reference of a socket list */
     const std::list<int> getConnSockList();
     int getMinPathMTU();
     unsigned short getPortNum();
+    /** returns the listening socket */
+    int getSockfd() const {return sockfd;}
     void Init(); /*!< start point that upper layer should call */
     /** only parse the header part of a coming packet */
     int parseHeader(int retxsockfd, FmtpHeader* recvheader);
     /** read any data coming into this given socket */
     int readSock(int retxsockfd, char* pktBuf, int bufSize);
+    /** read exactly the payload following a parsed header */
+    size_t recvPayload(int retxsockfd, void* buf, size_t len);
     void rmSockInList(int sockfd);
     /** gathering send by calling io vector system call */
-    int sendData(int retxsockfd, FmtpHeader* sendheader, char* payload,
-                 size_t paylen);
+    virtual int sendData(int retxsockfd, FmtpHeader* sendheader,
+                         char* payload, size_t paylen);
     static int send(int retxsockfd, FmtpHeader* sendheader, char* payload,
                     size_t paylen);
     void updatePathMTU(int sockfd);
@@ -78,6 +87,8 @@ private:
     unsigned short     tcpPort;
     std::list<int>     connSockList;
     std::mutex         sockListMutex; /*!< to protect shared sockList */
+    /** keeps packets sent to the same receiver apart, by socket */
+    std::map<int, std::shared_ptr<std::mutex>> sendMtxs;
     std::atomic<int>   pmtu; /* min path MTU of the mcast group */
 
     /**
@@ -87,6 +98,8 @@ private:
      * @throws    std::system_error  Keep-alive couldn't be set
      */
     void setKeepAlive(const int sock);
+    /** writes all of a gather vector */
+    static void sendallv(const int sock, struct iovec* iov, int iovcnt);
 };
 
 
@@ -0,0 +1,181 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      UdpRetxSend.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Implement the interfaces of sender side UDP repair channel.
+ *
+ * Encapsulation of the unicast UDP socket used for datagram retransmission.
+ */
+
+
+#include "UdpRetxSend.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <system_error>
+
+
+#ifndef NULL
+    #define NULL 0
+#endif
+
+
+/**
+ * Constructor, sets the local address and port to bind to.
+ *
+ * @param[in] localAddr    IPv4 address of the local interface.
+ * @param[in] localPort    Local port number or 0 for an ephemeral one.
+ */
+UdpRetxSend::UdpRetxSend(const std::string& localAddr,
+                         const unsigned short localPort)
+    : sockfd(-1), localAddr(localAddr), localPort(localPort)
+{
+}
+
+
+/**
+ * Destructs the UdpRetxSend instance and closes the socket.
+ *
+ * @param[in] none
+ */
+UdpRetxSend::~UdpRetxSend()
+{
+    if (sockfd >= 0)
+        (void)close(sockfd);
+}
+
+
+/**
+ * Initializer. Creates the UDP socket and binds it to the local address so
+ * that repair datagrams carry the same source address as the TCP server.
+ *
+ * @throws std::system_error  if the socket cannot be created.
+ * @throws std::system_error  if the local address is invalid.
+ * @throws std::system_error  if the socket cannot be bound.
+ */
+void UdpRetxSend::Init()
+{
+    if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxSend::Init() Couldn't create UDP socket");
+    }
+
+    struct sockaddr_in addr;
+    (void) memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(localAddr.c_str());
+    addr.sin_port        = htons(localPort);
+    if (addr.sin_addr.s_addr == (in_addr_t)(-1)) {
+        throw std::system_error(EINVAL, std::system_category(),
+                "UdpRetxSend::Init() Invalid interface: " + localAddr);
+    }
+
+    if (::bind(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxSend::Init() Couldn't bind " + localAddr + ":" +
+                std::to_string(static_cast<unsigned int>(localPort)));
+    }
+
+    /* best effort, the kernel caps the size at net.core.rmem_max */
+    int bufsize = UDP_RETX_BUFSIZE;
+    (void)setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+}
+
+
+/**
+ * Returns the local port number.
+ *
+ * @return                   The local port number in host byte-order.
+ * @throw std::system_error  The port number cannot be obtained.
+ */
+unsigned short UdpRetxSend::getPortNum()
+{
+    struct sockaddr_in tmpAddr;
+    socklen_t          tmpAddrLen = sizeof(tmpAddr);
+
+    if (getsockname(sockfd, (struct sockaddr*)&tmpAddr, &tmpAddrLen) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxSend::getPortNum() error getting port number");
+    }
+
+    return ntohs(tmpAddr.sin_port);
+}
+
+
+/**
+ * Receives a datagram from any peer. Blocks until one arrives.
+ *
+ * @param[out] buf             Buffer to hold the datagram.
+ * @param[in]  len             Size of the buffer in bytes.
+ * @param[out] from            Address of the sending peer.
+ * @return                     Size of the datagram in bytes.
+ * @throws std::system_error   if recvfrom() fails.
+ */
+ssize_t UdpRetxSend::recvFrom(void* buf, size_t len, struct sockaddr_in* from)
+{
+    socklen_t addrlen = sizeof(*from);
+    ssize_t   nbytes  = recvfrom(sockfd, buf, len, 0, (struct sockaddr*)from,
+                                 &addrlen);
+    if (nbytes < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxSend::recvFrom() error occurred when calling "
+                "recvfrom()");
+    }
+    return nbytes;
+}
+
+
+/**
+ * Gather-sends a FMTP packet to the given peer with a single sendmsg() call.
+ *
+ * @param[in] dest              Destination address.
+ * @param[in] header            Header in network byte-order.
+ * @param[in] payload           Payload or `NULL`.
+ * @param[in] paylen            Size of the payload in bytes.
+ * @return                      Number of bytes sent.
+ * @throws std::system_error    if an error occurs when calling sendmsg().
+ */
+ssize_t UdpRetxSend::sendTo(const struct sockaddr_in& dest, FmtpHeader* header,
+                            const void* payload, size_t paylen)
+{
+    struct msghdr msg;
+    struct iovec  iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len  = sizeof(FmtpHeader);
+    iov[1].iov_base = const_cast<void*>(payload);
+    iov[1].iov_len  = paylen;
+
+    msg.msg_name       = const_cast<struct sockaddr_in*>(&dest);
+    msg.msg_namelen    = sizeof(dest);
+    msg.msg_iov        = iov;
+    msg.msg_iovlen     = (payload && paylen) ? 2 : 1;
+    msg.msg_control    = NULL;
+    msg.msg_controllen = 0;
+    msg.msg_flags      = 0;
+
+    ssize_t nbytes = sendmsg(sockfd, &msg, 0);
+    if (nbytes < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "UdpRetxSend::sendTo() error occurred when calling sendmsg()");
+    }
+    return nbytes;
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      UdpRetxSend.h
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Define the interfaces of sender side UDP repair channel.
+ *
+ * The UdpRetxSend class owns the unicast UDP socket on which the sender
+ * receives datagram retransmission requests and sends repair datagrams back
+ * to the requesting receivers. Unlike the TCP retransmission connection, one
+ * lost repair never delays the repairs behind it.
+ */
+
+
+#ifndef FMTP_SENDER_UDPRETXSEND_H_
+#define FMTP_SENDER_UDPRETXSEND_H_
+
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <string>
+
+#include "fmtpBase.h"
+
+
+class UdpRetxSend {
+public:
+    /**
+     * Constructs.
+     *
+     * @param[in] localAddr  IPv4 address of the local interface to bind to.
+     * @param[in] localPort  Local port number in host byte-order or 0, in
+     *                       which case one is chosen by the operating-system.
+     */
+    UdpRetxSend(const std::string& localAddr,
+                const unsigned short localPort = 0);
+    ~UdpRetxSend();
+
+    void Init();  /*!< start point which caller should call */
+    unsigned short getPortNum();
+    /** returns the UDP socket */
+    int getSockfd() const {return sockfd;}
+    /**
+     * Receives a datagram. Blocks until one arrives.
+     *
+     * @param[out] buf   Buffer to hold the datagram.
+     * @param[in]  len   Size of the buffer in bytes.
+     * @param[out] from  Address of the sending peer.
+     * @return           Size of the datagram in bytes.
+     */
+    ssize_t recvFrom(void* buf, size_t len, struct sockaddr_in* from);
+    /**
+     * Gather-sends a FMTP packet to a given peer.
+     *
+     * @param[in] dest     Destination address.
+     * @param[in] header   Header in network byte-order.
+     * @param[in] payload  Payload or `NULL`.
+     * @param[in] paylen   Size of the payload in bytes.
+     * @return             Number of bytes sent.
+     */
+    ssize_t sendTo(const struct sockaddr_in& dest, FmtpHeader* header,
+                   const void* payload, size_t paylen);
+
+private:
+    int                   sockfd;
+    const std::string     localAddr;
+    const unsigned short  localPort;
+};
+
+
+#endif /* FMTP_SENDER_UDPRETXSEND_H_ */
@@ -35,6 +35,9 @@
 
 
 #include <algorithm>
+#include <chrono>
+#include <climits>
+#include <sys/socket.h>
 #include <unistd.h>
 #include <fstream>
 #include <iostream>
@@ -42,6 +45,10 @@
 #include <stdexcept>
 #include <cstdint>
 #include <system_error>
+#include <thread>
+#ifdef TEST_LOSS
+#include <random>
+#endif
 
 
 
@@ -53,6 +60,42 @@
 #endif
 
 #define DROPSEQ 0*FMTP_DATA_LEN
+/** maximum number of data-blocks streamed by one job of a SenderRuntime */
+#define UCAST_BURST 64
+/**
+ * a unicast stream sends without waiting for the rate while it's less than
+ * this many seconds ahead
+ */
+#define UCAST_PACE_SLACK 0.001
+
+#ifdef TEST_LOSS
+/*
+ * TEST_LOSS emulates a lossy network for the retransmission benchmark: every
+ * multicast data-block and every UDP repair is lost with probability
+ * TEST_LOSS_RATE, and every TCP repair stalls the receiver's connection for
+ * TEST_LOSS_STALL_MS with the same probability, as TCP does while it
+ * recovers a lost segment. Requests aren't affected.
+ */
+#ifndef TEST_LOSS_RATE
+    #define TEST_LOSS_RATE 0.01
+#endif
+#ifndef TEST_LOSS_STALL_MS
+    #define TEST_LOSS_STALL_MS 200
+#endif
+
+/**
+ * Decides whether a packet is lost.
+ *
+ * @return  true with probability TEST_LOSS_RATE.
+ */
+static bool testLost()
+{
+    static std::mutex   mutex;
+    static std::mt19937 rng(1);
+    std::unique_lock<std::mutex> lock(mutex);
+    return std::uniform_real_distribution<double>(0, 1)(rng) < TEST_LOSS_RATE;
+}
+#endif
 
 #ifdef LDM_LOGGING
 static void freeLogging(void* arg)
@@ -223,21 +266,92 @@ fmtpSendv3::fmtpSendv3(const char*                 tcpAddr,
                        const uint32_t              initProdIndex,
                        const float                 tsnd)
 :
+    fmtpSendv3(new TcpSend(tcpAddr, tcpPort), NULL, 0, tcpAddr, mcastAddr,
+               mcastPort, notifier, ttl, ifAddr, initProdIndex, tsnd)
+{
+}
+
+
+/**
+ * Constructs a session of a shared runtime. Takes the same parameters as the
+ * standalone sender, see above. The session sends to its receivers through
+ * the runtime, since a receiver connection may be shared with other sessions.
+ *
+ * @param[in] runtime        The shared runtime.
+ * @param[in] sessionId      Id of the session, unique within the runtime.
+ */
+fmtpSendv3::fmtpSendv3(SenderRuntime&              runtime,
+                       const uint32_t              sessionId,
+                       const char*                 tcpAddr,
+                       const unsigned short        tcpPort,
+                       const char*                 mcastAddr,
+                       const unsigned short        mcastPort,
+                       SendProxy*                  notifier,
+                       const unsigned char         ttl,
+                       const std::string           ifAddr,
+                       const uint32_t              initProdIndex,
+                       const float                 tsnd)
+:
+    fmtpSendv3(new SessionTcpSend(runtime, sessionId, tcpAddr, tcpPort),
+               &runtime, sessionId, tcpAddr, mcastAddr, mcastPort, notifier,
+               ttl, ifAddr, initProdIndex, tsnd)
+{
+}
+
+
+/**
+ * Constructs with a given retransmission transport.
+ *
+ * @param[in] tcpsend        The retransmission transport. Deleted by the
+ *                           instance.
+ * @param[in] runtime        The shared runtime or `NULL` for a standalone
+ *                           sender.
+ * @param[in] sessionId      Id of the session within the runtime.
+ * @param[in] tcpAddr        Unicast address of the sender.
+ * @param[in] mcastAddr      Multicast group address.
+ * @param[in] mcastPort      Multicast group port.
+ * @param[in] notifier       Sending application notifier.
+ * @param[in] ttl            Time to live.
+ * @param[in] ifAddr         IP address of the interface to be used to send
+ *                           multicast packets.
+ * @param[in] initProdIndex  Initial prodIndex set by receiving applications.
+ * @param[in] tsnd           Retransmission timeout duration in minutes.
+ */
+fmtpSendv3::fmtpSendv3(TcpSend*                    tcpsend,
+                       SenderRuntime*              runtime,
+                       const uint32_t              sessionId,
+                       const char*                 tcpAddr,
+                       const char*                 mcastAddr,
+                       const unsigned short        mcastPort,
+                       SendProxy*                  notifier,
+                       const unsigned char         ttl,
+                       const std::string           ifAddr,
+                       const uint32_t              initProdIndex,
+                       const float                 tsnd)
+:
+    prodIndex(initProdIndex),
+    runtime(runtime),
+    sessionId(sessionId),
     udpsend(new UdpSend(mcastAddr, mcastPort, ttl, ifAddr)),
-    tcpsend(new TcpSend(tcpAddr, tcpPort)),
+    tcpsend(tcpsend),
+    udpretx(new UdpRetxSend(tcpAddr)),
+    udpretx_t(),
+    ucastThreads(0),
+    ucastStopped(false),
+    ucastNext(initProdIndex),
+    retxspeed(0),
     sendMeta(new senderMetadata()),
     notifier(notifier),
-    prodIndex(initProdIndex),
+    coor_t(),
+    timer_t(),
     linkspeed(0),
     exitMutex(),
     except(),
-    coor_t(),
-    timer_t(),
-    tsnd(tsnd),
-    txdone(false),
     /* Coverity Scan #1: Fix #1: Initialize notifyprodidx, suppressor to 0 as product index*/
     notifyprodidx(0),
     suppressor(0),
+    tsnd(tsnd),
+    txdone(false),
     udpSerializer{udpsend}
 {
 }
@@ -252,6 +366,7 @@ fmtpSendv3::~fmtpSendv3()
 {
     delete udpsend;
     delete tcpsend;
+    delete udpretx;
     delete sendMeta;
 }
 
@@ -357,6 +472,49 @@ uint32_t fmtpSendv3::sendProduct(void* data, uint32_t dataSize)
  */
 uint32_t fmtpSendv3::sendProduct(void* data, uint32_t dataSize, void* metadata,
                                   uint16_t metaSize)
+{
+    return sendProd(data, dataSize, metadata, metaSize, NULL);
+}
+
+
+/**
+ * Transfers a revision of an earlier product, its base. If the base is still
+ * retained for retransmission, only the blocks of the revision that differ
+ * from it are multicast, and a BOP that lists them. Receivers that hold the
+ * base rebuild the rest from it; other receivers request the rest like lost
+ * blocks. If the base is gone or too much of it differs, the whole revision
+ * is multicast like any product.
+ *
+ * @param[in] data         Memory data to be sent.
+ * @param[in] dataSize     Size of the memory data in bytes.
+ * @param[in] metadata     Application-specific metadata to be sent before the
+ *                         data. May be 0, in which case `metaSize` must be 0.
+ * @param[in] metaSize     Size of the metadata in bytes.
+ * @param[in] baseIndex    Index of the base product.
+ * @return                 Index of the product.
+ * @throws std::runtime_error  if a parameter is invalid, see sendProduct().
+ * @throws std::runtime_error  if a runtime error occurs.
+ */
+uint32_t fmtpSendv3::sendRevision(void* data, uint32_t dataSize,
+                                  void* metadata, uint16_t metaSize,
+                                  uint32_t baseIndex)
+{
+    return sendProd(data, dataSize, metadata, metaSize, &baseIndex);
+}
+
+
+/**
+ * Transfers a product, see sendProduct() and sendRevision().
+ *
+ * @param[in] data         Memory data to be sent.
+ * @param[in] dataSize     Size of the memory data in bytes.
+ * @param[in] metadata     Application-specific metadata or 0.
+ * @param[in] metaSize     Size of the metadata in bytes.
+ * @param[in] baseIndex    Index of the base product of a revision or `NULL`.
+ * @return                 Index of the product.
+ */
+uint32_t fmtpSendv3::sendProd(void* data, uint32_t dataSize, void* metadata,
+                              uint16_t metaSize, const uint32_t* baseIndex)
 {
     throwIfBroken();
 
@@ -384,19 +542,57 @@ uint32_t fmtpSendv3::sendProduct(void* data, uint32_t dataSize, void* metadata,
         RetxMetadata* senderProdMeta = addRetxMetadata(data, dataSize,
                                                        metadata, metaSize,
                                                        &now);
+        std::vector<DeltaRange> ranges;
+        const bool delta = baseIndex &&
+                diffBase(*baseIndex, data, dataSize, metaSize, ranges);
+        ProdChecksum cksum(dataSize);
         // TODO: use latest MTU for file to be sent
         // TcpSend::getMinPathMTU()
-        /* send out BOP message */
-        SendBOPMessage(dataSize, metadata, metaSize, now);
-        /* Send the data */
-        sendData(data, dataSize);
+        if (delta) {
+            /* send out the BOP and only the changed blocks of a revision */
+            SendBOPMessage(dataSize, metadata, metaSize, now, &ranges,
+                           *baseIndex);
+            uint32_t seqnum = 0;
+            for (size_t i = 0; i <= ranges.size(); i++) {
+                /* the unchanged blocks are only added to the checksums */
+                const uint32_t end = i < ranges.size() ? ranges[i].seqnum :
+                                     dataSize;
+                for (; seqnum < end; seqnum += FMTP_DATA_LEN)
+                    cksum.add(seqnum, (char*)data + seqnum,
+                              MIN(dataSize - seqnum, (uint32_t)FMTP_DATA_LEN));
+                if (i < ranges.size()) {
+                    sendData((char*)data + ranges[i].seqnum, ranges[i].length,
+                             cksum, ranges[i].seqnum);
+                    seqnum = ranges[i].seqnum + ranges[i].length;
+                }
+            }
+        }
+        else {
+            /* send out BOP message */
+            SendBOPMessage(dataSize, metadata, metaSize, now);
+            /* Send the data */
+            sendData(data, dataSize, cksum);
+        }
+        std::vector<uint32_t> checksums(cksum.getSums());
+        for (size_t i = 0; i < checksums.size(); i++)
+            checksums[i] = htonl(checksums[i]);
+        sendMeta->setChecksums(prodIndex, checksums);
         /* Send out EOP message */
-        sendEOPMessage();
+        sendEOPMessage(checksums);
+        /* the unicast stream ends with the checksums, so it starts now */
+        queueUcastProd(prodIndex);
 
         /* Set the retransmission timeout parameters */
         setTimerParameters(senderProdMeta);
         /* start a new timer for this product in a separate thread */
-        timerDelayQ.push(prodIndex, senderProdMeta->retxTimeoutPeriod);
+        if (runtime) {
+            const uint32_t prodindex = prodIndex;
+            runtime->schedule(sessionId, senderProdMeta->retxTimeoutPeriod,
+                              [this, prodindex]{expireProd(prodindex);});
+        }
+        else {
+            timerDelayQ.push(prodIndex, senderProdMeta->retxTimeoutPeriod);
+        }
     }
     catch (std::runtime_error& e) {
         taskBroke(std::current_exception());
@@ -428,9 +624,36 @@ uint32_t fmtpSendv3::sendProduct(void* data, uint32_t dataSize, void* metadata,
  */
 void fmtpSendv3::SetSendRate(uint64_t speed)
 {
-    rateshaper.SetRate(speed);
-    std::unique_lock<std::mutex> lock(linkmtx);
-    linkspeed = speed;
+    {
+        std::unique_lock<std::mutex> lock(rateshapermtx);
+        rateshaper.SetRate(speed);
+    }
+    {
+        std::unique_lock<std::mutex> lock(linkmtx);
+        linkspeed = speed;
+    }
+    /* UDP repair follows the multicast rate unless set explicitly */
+    std::unique_lock<std::mutex> lock(retxshapermtx);
+    if (!retxspeed) {
+        retxshaper.SetRate(speed);
+        retxspeed = speed;
+    }
+}
+
+
+/**
+ * Sets the pacing rate of the UDP repair datagrams. Repair traffic shares the
+ * path with the multicast stream, so it's shaped separately to keep a burst
+ * of repairs from causing more loss.
+ *
+ * @param[in] speed         Repair rate in bits per second.
+ * @throw std::runtime_error  if the rate is less than 1Kbps.
+ */
+void fmtpSendv3::SetRetxRate(uint64_t speed)
+{
+    std::unique_lock<std::mutex> lock(retxshapermtx);
+    retxshaper.SetRate(speed);
+    retxspeed = speed;
 }
 
 
@@ -453,10 +676,18 @@ void fmtpSendv3::Start()
     tcpsend->Init();
     /* initialize UDP connection */
     udpsend->Init();
+    /* initialize UDP repair channel */
+    udpretx->Init();
 
     /* initializes a new SilenceSuppressor instance. */
     suppressor = new SilenceSuppressor(PRODNUM * EXPTRUN);
 
+    /* the runtime's threads do the work of this session */
+    if (runtime) {
+        runtime->attach(this, sessionId);
+        return;
+    }
+
     int retval = pthread_create(&timer_t, NULL, &fmtpSendv3::timerWrapper, this);
     if(retval != 0) {
         throw std::system_error(errno, std::system_category(),
@@ -464,9 +695,19 @@ void fmtpSendv3::Start()
                 " retval = " + std::to_string(retval));
     }
 
+    retval = pthread_create(&udpretx_t, NULL, &fmtpSendv3::StartUdpRetxThread,
+                            this);
+    if(retval != 0) {
+        (void)pthread_cancel(timer_t);
+        throw std::system_error(errno, std::system_category(),
+                "fmtpSendv3::Start() pthread_create() StartUdpRetxThread error"
+                " with retval = " + std::to_string(retval));
+    }
+
     retval = pthread_create(&coor_t, NULL, &fmtpSendv3::coordinator, this);
     if(retval != 0) {
         (void)pthread_cancel(timer_t);
+        (void)pthread_cancel(udpretx_t);
         throw std::system_error(errno, std::system_category(),
                 "fmtpSendv3::Start() pthread_create() coordinator error with"
                 " retval = " + std::to_string(retval));
@@ -480,13 +721,22 @@ void fmtpSendv3::Start()
  */
 void fmtpSendv3::Stop()
 {
+    stopUcastRcvrs();
+
+    if (runtime) {
+        runtime->detach(sessionId);
+        return;
+    }
+
     timerDelayQ.disable(); // will cause timer thread to exit
     (void)pthread_cancel(coor_t);
+    (void)pthread_cancel(udpretx_t);
     /* cancels all the threads in list and empties the list */
     retxThreadList.shutdown();
 
     (void)pthread_join(timer_t, NULL);
     (void)pthread_join(coor_t, NULL);
+    (void)pthread_join(udpretx_t, NULL);
 }
 
 
@@ -571,24 +821,9 @@ void* fmtpSendv3::coordinator(void* ptr)
     try {
         while(1) {
             int newtcpsockfd = sendptr->tcpsend->acceptConn();
-            logMsg("fmtpSendv3::coordinator(): Accepted connection on socket " +
-                    std::to_string(newtcpsockfd));
-            /**
-             * Requests the application to verify a new receiver. Shuts down
-             * the connection if failing. Otherwise fork a new thread for the
-             * receiver. This access control process can be skipped if there
-             * is no application support (e.g. testApp).
-             */
-            if (sendptr->notifier) {
-                if (!sendptr->notifier->vetNewRcvr(newtcpsockfd)) {
-                    logMsg("fmtpSendv3::coordinator(): Connection on socket " +
-                            std::to_string(newtcpsockfd) + " isn't authorized");
-                    sendptr->tcpsend->dismantleConn(newtcpsockfd);
-                    continue;
-                }
-            }
-            /* If new receiver accepted, measure its path MTU and update */
-            sendptr->tcpsend->updatePathMTU(newtcpsockfd);
+            /* Otherwise fork a new thread for the receiver. */
+            if (!sendptr->admitRcvr(newtcpsockfd))
+                continue;
 
             int initState;
             pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &initState);
@@ -607,6 +842,34 @@ void* fmtpSendv3::coordinator(void* ptr)
 }
 
 
+/**
+ * Vets a newly accepted receiver. Requests the application to verify the
+ * receiver and shuts down the connection if failing. This access control
+ * process can be skipped if there is no application support (e.g. testApp).
+ *
+ * @param[in] sock  The receiver's socket.
+ * @return          `true` if the receiver is accepted.
+ * @throw std::system_error  if the connection can't be closed.
+ * @throw std::system_error  if the path MTU can't be obtained.
+ */
+bool fmtpSendv3::admitRcvr(const int sock)
+{
+    logMsg("fmtpSendv3::admitRcvr(): Accepted connection on socket " +
+            std::to_string(sock));
+    if (notifier) {
+        if (!notifier->vetNewRcvr(sock)) {
+            logMsg("fmtpSendv3::admitRcvr(): Connection on socket " +
+                    std::to_string(sock) + " isn't authorized");
+            tcpsend->dismantleConn(sock);
+            return false;
+        }
+    }
+    /* If new receiver accepted, measure its path MTU and update */
+    tcpsend->updatePathMTU(sock);
+    return true;
+}
+
+
 /**
  * Handles a retransmission request from a receiver.
  *
@@ -614,13 +877,15 @@ void* fmtpSendv3::coordinator(void* ptr)
  * @param[in] retxMeta    Associated retransmission entry or `0`, in which case
  *                        the request will be rejected.
  * @param[in] sock        The receiver's socket.
+ * @param[in] length      Length of the requested range in bytes.
  */
 void fmtpSendv3::handleRetxReq(FmtpHeader* const   recvheader,
                                RetxMetadata* const retxMeta,
-                               const int           sock)
+                               const int           sock,
+                               const uint32_t      length)
 {
     if (retxMeta) {
-        retransmit(recvheader, retxMeta, sock);
+        retransmit(recvheader, retxMeta, sock, length);
 
         #ifdef DEBUG2
             std::string debugmsg = "Product #" +
@@ -648,6 +913,41 @@ void fmtpSendv3::handleRetxReq(FmtpHeader* const   recvheader,
 }
 
 
+/**
+ * Handles a notice from a receiver that it has given up on a range of
+ * products. Each product of the range that the receiver hasn't acknowledged
+ * yet is handled as if the receiver had completely received it, so that the
+ * product isn't retained for this receiver any longer.
+ *
+ * @param[in] recvheader  The FMTP header of the notice. The seqnum field is
+ *                        the number of products.
+ * @param[in] sock        The receiver's socket.
+ */
+void fmtpSendv3::handleRetxGiveUp(FmtpHeader* const recvheader,
+                                  const int         sock)
+{
+    std::list<uint32_t> prods = sendMeta->getUnfinProds(sock);
+    for (std::list<uint32_t>::iterator it = prods.begin(); it != prods.end();
+         ++it) {
+        if ((uint32_t)(*it - recvheader->prodindex) >= recvheader->seqnum)
+            continue;
+
+        #ifdef DEBUG2
+            std::string debugmsg = "Product #" + std::to_string(*it);
+            debugmsg += ": RETX_GIVEUP received";
+            std::cout << debugmsg << std::endl;
+            WriteToLog(debugmsg);
+        #endif
+
+        FmtpHeader header = *recvheader;
+        header.prodindex  = *it;
+        RetxMetadata* retxMeta = sendMeta->getMetadata(*it);
+        handleRetxEnd(&header, retxMeta, sock);
+        sendMeta->releaseMetadata(*it);
+    }
+}
+
+
 /**
  * Handles a notice from a receiver that a data-product has been completely
  * received.
@@ -780,147 +1080,669 @@ void fmtpSendv3::handleEopReq(FmtpHeader* const  recvheader,
 
 
 /**
- * The actual retransmission handling thread. Each thread listens on a receiver
- * specific socket which is given by retxsockfd. It receives the RETX_REQ or
- * RETX_END message and either issues a RETX_REJ or retransmits the data block.
- * There is only one piece of globally shared senderMetadata structure, which
- * holds a prodindex to RetxMetadata map. Using the given prodindex can find
- * an associated RetxMetadata. Inside that RetxMetadata, there is the unfinished
- * receivers set and timeout value. After the sendProduct() finishing multicast
- * and initializing the RetxMetadata entry, the metadata of that product will
- * be inserted into the senderMetadata map. If the metadata of a requested
- * product can be found, this retx thread will fetch the prodptr and extract
- * the requested data block and pack up to send. Otherwise, retx thread will
- * get a NULL pointer, which indicates that the timer has waken up and removed
- * that metadata out of the map. Thus, retx thread will issue a RETX_REJ to
- * send back to the receiver.
+ * Handles the registration of a receiver's UDP repair port. The repair address
+ * is the peer address of the TCP connection with the announced port, so that a
+ * receiver can only redirect repairs to itself. The sender answers with its
+ * own UDP repair port. A port of 0 unregisters the receiver.
  *
- * @param[in] retxsockfd          retx socket associated with a receiver.
- * @throw  runtime_error          if TcpSend::parseHeader() fails.
+ * @param[in] sock        The receiver's socket.
+ * @param[in] payload     The registration, RCVR_REG_LEN bytes.
+ *
+ * @throw std::system_error   if the peer address can't be obtained.
+ * @throw std::system_error   if the connection is broken.
  */
-void fmtpSendv3::RunRetxThread(int retxsockfd)
+void fmtpSendv3::handleRcvrReg(const int sock, const char* const payload)
 {
-    FmtpHeader recvheader;
+    RcvrRegMsg reg;
+    (void)memcpy(&reg, payload, sizeof(reg));
 
-    logMsg("fmtpSendv3::RunRetxThread(): Entered");
-    while(1) {
-        /* Receive the message from tcp connection and parse the header */
-        int parsestate;
-        try {
-            parsestate = tcpsend->parseHeader(retxsockfd, &recvheader);
-        }
-        catch (const std::runtime_error& e) {
-            /**
-             * TcpSend::parseHeader() TcpBase::recvall() recv() returns -1,
-             * connection is broken.
-             */
-            std::throw_with_nested(std::runtime_error(
-                    "fmtpSendv3::RunRetxThread(): Couldn't parse header"));
+    struct sockaddr_in peer;
+    socklen_t          peerlen = sizeof(peer);
+    if (getpeername(sock, (struct sockaddr*)&peer, &peerlen) < 0) {
+        throw std::system_error(errno, std::system_category(),
+                "fmtpSendv3::handleRcvrReg() Couldn't get peer address");
+    }
+
+    const uint16_t options = ntohs(reg.options);
+    {
+        std::unique_lock<std::mutex> lock(udpPeerMtx);
+        if (reg.udpport) {
+            peer.sin_port = reg.udpport;
+            udpPeers[sock] = peer;
         }
-        if (parsestate == 0) {
-            /* encountered EOF, header incomplete */
-            throw std::runtime_error("fmtpSendv3::RunRetxThread() parseHeader"
-                                     "error: incomplete header");
+        else {
+            udpPeers.erase(sock);
         }
+        if (options & RCVR_OPT_CHECKSUMS)
+            sumRcvrs.insert(sock);
+        else
+            sumRcvrs.erase(sock);
+    }
 
-        /* Acquires the product metadata as in exclusive use */
-        RetxMetadata* retxMeta = sendMeta->getMetadata(recvheader.prodindex);
+    FmtpHeader sendheader;
+    sendheader.prodindex  = 0;
+    sendheader.seqnum     = 0;
+    sendheader.payloadlen = htons(RCVR_REG_LEN);
+    sendheader.flags      = htons(FMTP_RCVR_REG);
+    reg.udpport = reg.udpport ? htons(udpretx->getPortNum()) : 0;
+    const bool unicast = options & RCVR_OPT_UNICAST;
+    reg.options = htons(options & (RCVR_OPT_UNICAST | RCVR_OPT_CHECKSUMS));
+    tcpsend->sendData(sock, &sendheader, (char*)&reg, sizeof(reg));
 
-        try {
-            if (recvheader.flags == FMTP_RETX_REQ) {
-                #ifdef DEBUG2
-                    std::string debugmsg = "Product #" +
-                        std::to_string(recvheader.prodindex);
-                    debugmsg += ": RETX_REQ received";
-                    std::cout << debugmsg << std::endl;
-                    WriteToLog(debugmsg);
-                #endif
-                handleRetxReq(&recvheader, retxMeta, retxsockfd);
-            }
-            else if (recvheader.flags == FMTP_RETX_END) {
-                #ifdef DEBUG2
-                    std::string debugmsg = "Product #" +
-                        std::to_string(recvheader.prodindex);
-                    debugmsg += ": RETX_END received";
-                    std::cout << debugmsg << std::endl;
-                    WriteToLog(debugmsg);
-                #endif
-                handleRetxEnd(&recvheader, retxMeta, retxsockfd);
-            }
-            else if (recvheader.flags == FMTP_BOP_REQ) {
-                #ifdef DEBUG2
-                    std::string debugmsg = "Product #" +
-                        std::to_string(recvheader.prodindex);
-                    debugmsg += ": BOP_REQ received";
-                    std::cout << debugmsg << std::endl;
-                    WriteToLog(debugmsg);
-                #endif
-                handleBopReq(&recvheader, retxMeta, retxsockfd);
-            }
-            else if (recvheader.flags == FMTP_EOP_REQ) {
-                #ifdef DEBUG2
-                    std::string debugmsg = "Product #" +
-                        std::to_string(recvheader.prodindex);
-                    debugmsg += ": EOP_REQ received";
-                    std::cout << debugmsg << std::endl;
-                    WriteToLog(debugmsg);
-                #endif
-                handleEopReq(&recvheader, retxMeta, retxsockfd);
-            }
-        }
-        catch (const std::runtime_error& e) {
-            /* same as parseHeader(), if connection broken, take action */
-            std::throw_with_nested(std::runtime_error(
-                    "fmtpSendv3::RunRetxThread(): Couldn't reply to request"));
-        }
+    if (unicast)
+        addUcastRcvr(sock);
 
-        /* Releases the product metadata in exclusive use */
-        sendMeta->releaseMetadata(recvheader.prodindex);
-    }
+    #ifdef DEBUG2
+        std::string debugmsg = "Receiver on socket " + std::to_string(sock) +
+            " registered UDP repair port " +
+            std::to_string(ntohs(peer.sin_port));
+        std::cout << debugmsg << std::endl;
+        WriteToLog(debugmsg);
+    #endif
 }
 
 
 /**
- * Rejects a retransmission request from a receiver. A sender side timeout or
- * received RETX_END message from all receivers and then receiving retx
- * requests again would cause the rejection.
+ * Starts streaming every product to a receiver that can't receive the
+ * multicast. The products that were multicast after the receiver connected,
+ * and that it hasn't acknowledged, are streamed first. Does nothing if the
+ * receiver is already streamed to or the sender is stopping. Under a
+ * SenderRuntime, the stream is run by jobs of the session.
  *
- * @param[in] prodindex  Product-index of the request.
- * @param[in] sock       The receiver's socket.
+ * @param[in] sock  The receiver's socket.
+ * @throw std::system_error  if the stream thread can't be started.
  */
-void fmtpSendv3::rejRetxReq(const uint32_t prodindex, const int sock)
+void fmtpSendv3::addUcastRcvr(const int sock)
 {
-    FmtpHeader sendheader;
+    std::shared_ptr<UcastRcvr> rcvr(new UcastRcvr(this, sock));
+    {
+        std::unique_lock<std::mutex> lock(ucastMtx);
+        if (ucastStopped || ucastRcvrs.count(sock))
+            return;
 
-    sendheader.prodindex  = htonl(prodindex);
-    sendheader.seqnum     = 0;
-    sendheader.payloadlen = 0;
-    sendheader.flags      = htons(FMTP_RETX_REJ);
-    tcpsend->sendData(sock, &sendheader, NULL, 0);
+        /* the later products are queued by sendProd() */
+        std::list<uint32_t> prods = sendMeta->getUnfinProds(sock);
+        for (auto it = prods.begin(); it != prods.end(); ++it) {
+            if ((int32_t)(*it - ucastNext) < 0)
+                rcvr->prods.push_back(*it);
+        }
+
+        if (!runtime) {
+            std::shared_ptr<UcastRcvr>* arg =
+                    new std::shared_ptr<UcastRcvr>(rcvr);
+            pthread_t t;
+            int status = pthread_create(&t, NULL,
+                                        &fmtpSendv3::StartUcastThread, arg);
+            if (status) {
+                delete arg;
+                throw std::system_error(status, std::system_category(),
+                        "fmtpSendv3::addUcastRcvr() Couldn't start stream "
+                        "thread for socket " + std::to_string(sock));
+            }
+            (void)pthread_detach(t);
+            ++ucastThreads;
+        }
+        rcvr->running = runtime != NULL;
+        ucastRcvrs[sock] = rcvr;
+    }
+
+    /* the runtime isn't called with `ucastMtx` locked, see rmUcastRcvr() */
+    if (runtime)
+        runtime->schedule(sessionId, 0, [this, rcvr]{ucastJob(rcvr);});
+
+    logMsg("fmtpSendv3::addUcastRcvr(): Streaming products to socket " +
+            std::to_string(sock));
 }
 
 
 /**
- * Retransmits data to a receiver. Requested retransmition block size will be
- * checked to make sure the request is valid.
- *
- * @param[in] recvheader  The FMTP header of the retransmission request.
- * @param[in] retxMeta    The associated retransmission entry.
- * @param[in] sock        The receiver's socket.
+ * Queues a new product for all unicast receivers. Called once the product
+ * has been multicast, since its stream ends with the checksums.
  *
- * @throw std::runtime_error if TcpSend::send() fails.
+ * @param[in] prodindex  Product-index of the product.
  */
-void fmtpSendv3::retransmit(
-        const FmtpHeader*   const recvheader,
-        const RetxMetadata* const retxMeta,
-        const int                 sock)
+void fmtpSendv3::queueUcastProd(const uint32_t prodindex)
 {
-    if (recvheader->payloadlen > 0) {
-        uint32_t start = recvheader->seqnum;
-        /* make sure the requested bytes do not exceed file size */
-        uint32_t out   = MIN(retxMeta->prodLength,
-                             start + recvheader->payloadlen);
-
+    std::vector<std::shared_ptr<UcastRcvr>> idle;
+    {
+        std::unique_lock<std::mutex> lock(ucastMtx);
+        ucastNext = prodindex + 1;
+        for (auto it = ucastRcvrs.begin(); it != ucastRcvrs.end(); ++it) {
+            UcastRcvr& rcvr = *it->second;
+            std::unique_lock<std::mutex> lock(rcvr.mtx);
+            rcvr.prods.push_back(prodindex);
+            rcvr.cv.notify_one();
+            if (runtime && !rcvr.running) {
+                rcvr.running = true;
+                idle.push_back(it->second);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < idle.size(); i++) {
+        std::shared_ptr<UcastRcvr> rcvr(idle[i]);
+        runtime->schedule(sessionId, 0, [this, rcvr]{ucastJob(rcvr);});
+    }
+}
+
+
+/**
+ * Stops streaming to a unicast receiver whose connection went away. Doesn't
+ * wait for the stream thread or job, which leaves as soon as it notices.
+ * Called by a SenderRuntime with its lock held.
+ *
+ * @param[in] sock  The receiver's socket.
+ */
+void fmtpSendv3::rmUcastRcvr(const int sock)
+{
+    std::unique_lock<std::mutex> lock(ucastMtx);
+    auto it = ucastRcvrs.find(sock);
+    if (it == ucastRcvrs.end())
+        return;
+
+    {
+        std::unique_lock<std::mutex> rlock(it->second->mtx);
+        it->second->done = true;
+        it->second->cv.notify_one();
+    }
+    /* wakes up a stream thread that's blocked sending */
+    if (!runtime)
+        (void)shutdown(sock, SHUT_RDWR);
+    ucastRcvrs.erase(it);
+}
+
+
+/**
+ * Stops streaming to all unicast receivers and waits for the stream threads
+ * to leave. Their connections are shut down, since a thread may be blocked
+ * sending to a receiver that doesn't read. The connections of a SenderRuntime
+ * are left alone: they may serve other sessions, and the jobs of this one are
+ * waited for when it's detached.
+ */
+void fmtpSendv3::stopUcastRcvrs()
+{
+    std::unique_lock<std::mutex> lock(ucastMtx);
+    ucastStopped = true;
+    for (auto it = ucastRcvrs.begin(); it != ucastRcvrs.end(); ++it) {
+        {
+            std::unique_lock<std::mutex> rlock(it->second->mtx);
+            it->second->done = true;
+            it->second->cv.notify_one();
+        }
+        if (!runtime)
+            (void)shutdown(it->first, SHUT_RDWR);
+    }
+    ucastRcvrs.clear();
+    while (ucastThreads)
+        ucastCv.wait(lock);
+}
+
+
+/**
+ * Reserves the time of a packet from the rate shaper, so that the multicast
+ * and all the unicast streams together stay within the sending rate.
+ *
+ * @param[in] size  Size of the packet in bytes.
+ * @return          Seconds to wait before sending the packet. 0 if no
+ *                  sending rate is set.
+ */
+double fmtpSendv3::reserveRate(const size_t size)
+{
+    {
+        std::unique_lock<std::mutex> lock(linkmtx);
+        if (!linkspeed)
+            return 0;
+    }
+    std::unique_lock<std::mutex> lock(rateshapermtx);
+    return rateshaper.Reserve(size);
+}
+
+
+/**
+ * Streams the queued products to a unicast receiver as BOP, data-blocks and
+ * EOP, in the same packets as the multicast, until it has to wait for the
+ * rate or has sent `maxBlocks` data-blocks. The blocks are written straight
+ * from the product retained for retransmission. The receiver acknowledges
+ * the product with RETX_END like any other. A product that has been removed
+ * before all of it was streamed is rejected with RETX_REJ, so that the
+ * receiver gives up on it.
+ *
+ * @param[in] rcvr       The receiver.
+ * @param[in] maxBlocks  Maximum number of data-blocks to send.
+ * @return               Seconds to wait before the next data-block, 0 if
+ *                       `maxBlocks` data-blocks were sent, or -1 if nothing
+ *                       is left to stream, in which case `rcvr.running` has
+ *                       been cleared.
+ * @throw std::system_error  if the connection is broken.
+ */
+double fmtpSendv3::streamUcast(UcastRcvr& rcvr, const unsigned maxBlocks)
+{
+    RetxMetadata* retxMeta = NULL;
+    double        wait = 0;
+    try {
+        for (unsigned nblocks = 0; nblocks < maxBlocks; ) {
+            if (!rcvr.streaming) {
+                std::unique_lock<std::mutex> lock(rcvr.mtx);
+                if (rcvr.done || rcvr.prods.empty()) {
+                    rcvr.running = false;
+                    wait = -1;
+                    break;
+                }
+                rcvr.prodindex = rcvr.prods.front();
+                rcvr.prods.pop_front();
+                rcvr.streaming = true;
+                rcvr.started   = false;
+                rcvr.paced     = false;
+                rcvr.seqnum    = 0;
+            }
+
+            if (retxMeta == NULL) {
+                retxMeta = sendMeta->getMetadata(rcvr.prodindex);
+                if (retxMeta == NULL) {
+                    logMsg("fmtpSendv3::streamUcast(): Product " +
+                            std::to_string(rcvr.prodindex) + " expired "
+                            "before it was streamed to socket " +
+                            std::to_string(rcvr.sock));
+                    rejRetxReq(rcvr.prodindex, rcvr.sock);
+                    rcvr.streaming = false;
+                    continue;
+                }
+            }
+
+            if (!rcvr.started) {
+                FmtpHeader reqheader;
+                reqheader.prodindex = rcvr.prodindex;
+                retransBOP(&reqheader, retxMeta, rcvr.sock, FMTP_BOP);
+                rcvr.started = true;
+            }
+
+            FmtpHeader header;
+            header.prodindex = htonl(rcvr.prodindex);
+            if (rcvr.seqnum >= retxMeta->prodLength) {
+                std::vector<uint32_t> checksums;
+                sendMeta->getChecksums(rcvr.prodindex, checksums);
+                header.seqnum     = 0;
+                header.payloadlen = htons(checksums.size() *
+                                          sizeof(uint32_t));
+                header.flags      = htons(FMTP_EOP);
+                tcpsend->sendData(rcvr.sock, &header, (char*)checksums.data(),
+                                  checksums.size() * sizeof(uint32_t));
+
+                #ifdef DEBUG2
+                    std::string debugmsg = "Product #" +
+                        std::to_string(rcvr.prodindex);
+                    debugmsg += " has been streamed to socket ";
+                    debugmsg += std::to_string(rcvr.sock);
+                    std::cout << debugmsg << std::endl;
+                    WriteToLog(debugmsg);
+                #endif
+
+                sendMeta->releaseMetadata(rcvr.prodindex);
+                retxMeta       = NULL;
+                rcvr.streaming = false;
+                continue;
+            }
+
+            const uint16_t paylen = MIN(retxMeta->prodLength - rcvr.seqnum,
+                                        (uint32_t)FMTP_DATA_LEN);
+            if (!rcvr.paced) {
+                rcvr.paced = true;
+                wait = reserveRate(sizeof(header) + paylen);
+                if (wait > UCAST_PACE_SLACK)
+                    break;
+                wait = 0;
+            }
+            header.seqnum     = htonl(rcvr.seqnum);
+            header.payloadlen = htons(paylen);
+            header.flags      = htons(FMTP_MEM_DATA);
+            tcpsend->sendData(rcvr.sock, &header,
+                              (char*)retxMeta->dataprod_p + rcvr.seqnum,
+                              paylen);
+            rcvr.seqnum += paylen;
+            rcvr.paced   = false;
+            ++nblocks;
+        }
+    }
+    catch (...) {
+        if (retxMeta)
+            sendMeta->releaseMetadata(rcvr.prodindex);
+        throw;
+    }
+    if (retxMeta)
+        sendMeta->releaseMetadata(rcvr.prodindex);
+
+    return wait;
+}
+
+
+/**
+ * Streams to a unicast receiver as a job of the session's SenderRuntime. The
+ * job sends a burst of data-blocks and then makes way for the other jobs: the
+ * stream goes on after the wait for the rate or, since the runtime doesn't
+ * block on the receiver, once the receiver has read most of what's queued for
+ * it. It ends when nothing is left to stream and starts again when a product
+ * is queued. If streaming fails, the connection is shut down so that the
+ * receiver is dropped like any other broken connection.
+ *
+ * @param[in] rcvr  The receiver.
+ */
+void fmtpSendv3::ucastJob(const std::shared_ptr<UcastRcvr>& rcvr)
+{
+    try {
+        const double wait = streamUcast(*rcvr, UCAST_BURST);
+        if (wait < 0)
+            return;
+
+        std::shared_ptr<UcastRcvr> next(rcvr);
+        std::function<void()> job = [this, next]{ucastJob(next);};
+        if (wait > 0)
+            runtime->schedule(sessionId, wait, job);
+        else
+            runtime->whenWritable(sessionId, rcvr->sock, job);
+    }
+    catch (const std::exception& e) {
+        logMsg(e);
+        std::unique_lock<std::mutex> lock(rcvr->mtx);
+        if (!rcvr->done) {
+            rcvr->done = true;
+            (void)shutdown(rcvr->sock, SHUT_RDWR);
+        }
+    }
+}
+
+
+/**
+ * Streams the queued products to a unicast receiver, oldest first, until the
+ * receiver goes away or the sender stops.
+ *
+ * @param[in] rcvr  The receiver.
+ * @throw std::system_error  if the connection is broken.
+ */
+void fmtpSendv3::ucastThread(UcastRcvr& rcvr)
+{
+    while (1) {
+        {
+            std::unique_lock<std::mutex> lock(rcvr.mtx);
+            while (!rcvr.done && !rcvr.streaming && rcvr.prods.empty())
+                rcvr.cv.wait(lock);
+            if (rcvr.done)
+                return;
+        }
+        const double wait = streamUcast(rcvr, UINT_MAX);
+        if (wait > 0)
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    }
+}
+
+
+/**
+ * Runs the stream thread of a unicast receiver. Called by
+ * `::pthread_create()`. If streaming fails, the connection is shut down so
+ * that the receiver is dropped like any other broken connection.
+ *
+ * @param[in] ptr   Pointer to a heap-allocated `std::shared_ptr<UcastRcvr>`.
+ * @retval    NULL  Always
+ */
+void* fmtpSendv3::StartUcastThread(void* ptr)
+{
+#ifdef LDM_LOGGING
+    pthread_cleanup_push(freeLogging, nullptr);
+#endif
+    std::shared_ptr<UcastRcvr>* arg = static_cast<std::shared_ptr<UcastRcvr>*>(ptr);
+    std::shared_ptr<UcastRcvr>  rcvr(*arg);
+    delete arg;
+
+    fmtpSendv3* sender = rcvr->sender;
+    try {
+        sender->ucastThread(*rcvr);
+    }
+    catch (const std::exception& e) {
+        logMsg(e);
+        /* the socket isn't closed before `done` is set */
+        std::unique_lock<std::mutex> lock(rcvr->mtx);
+        if (!rcvr->done)
+            (void)shutdown(rcvr->sock, SHUT_RDWR);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(sender->ucastMtx);
+        --sender->ucastThreads;
+        sender->ucastCv.notify_all();
+    }
+#ifdef LDM_LOGGING
+    pthread_cleanup_pop(true);
+#endif
+    return NULL;
+}
+
+/**
+ * The actual retransmission handling thread. Each thread listens on a receiver
+ * specific socket which is given by retxsockfd. It receives the RETX_REQ or
+ * RETX_END message and either issues a RETX_REJ or retransmits the data block.
+ * There is only one piece of globally shared senderMetadata structure, which
+ * holds a prodindex to RetxMetadata map. Using the given prodindex can find
+ * an associated RetxMetadata. Inside that RetxMetadata, there is the unfinished
+ * receivers set and timeout value. After the sendProduct() finishing multicast
+ * and initializing the RetxMetadata entry, the metadata of that product will
+ * be inserted into the senderMetadata map. If the metadata of a requested
+ * product can be found, this retx thread will fetch the prodptr and extract
+ * the requested data block and pack up to send. Otherwise, retx thread will
+ * get a NULL pointer, which indicates that the timer has waken up and removed
+ * that metadata out of the map. Thus, retx thread will issue a RETX_REJ to
+ * send back to the receiver.
+ *
+ * @param[in] retxsockfd          retx socket associated with a receiver.
+ * @throw  runtime_error          if TcpSend::parseHeader() fails.
+ */
+void fmtpSendv3::RunRetxThread(int retxsockfd)
+{
+    FmtpHeader recvheader;
+
+    logMsg("fmtpSendv3::RunRetxThread(): Entered");
+    while(1) {
+        /* Receive the message from tcp connection and parse the header */
+        int parsestate;
+        try {
+            parsestate = tcpsend->parseHeader(retxsockfd, &recvheader);
+        }
+        catch (const std::runtime_error& e) {
+            /**
+             * TcpSend::parseHeader() TcpBase::recvall() recv() returns -1,
+             * connection is broken.
+             */
+            std::throw_with_nested(std::runtime_error(
+                    "fmtpSendv3::RunRetxThread(): Couldn't parse header"));
+        }
+        if (parsestate == 0) {
+            /* encountered EOF, header incomplete */
+            throw std::runtime_error("fmtpSendv3::RunRetxThread() parseHeader"
+                                     "error: incomplete header");
+        }
+
+        char           payload[MAX_FMTP_PACKET_LEN];
+        const uint16_t paylen = rcvrPayloadLen(&recvheader);
+        if (tcpsend->recvPayload(retxsockfd, payload, paylen) < paylen) {
+            throw std::runtime_error("fmtpSendv3::RunRetxThread() "
+                                     "incomplete message");
+        }
+        serveRetxMsg(&recvheader, retxsockfd, payload);
+    }
+}
+
+
+/**
+ * Serves one message from a receiver: a registration or a request that refers
+ * to a product. Called by the receiver's retransmission thread or, if the
+ * session is attached to a runtime, by a worker of the runtime.
+ *
+ * @param[in] recvheader          The FMTP header of the message.
+ * @param[in] sock                The receiver's socket.
+ * @param[in] payload             The payload of the message, see
+ *                                rcvrPayloadLen().
+ * @throw  runtime_error          if the connection is broken.
+ */
+void fmtpSendv3::serveRetxMsg(FmtpHeader* const recvheader, const int sock,
+                              const char* const payload)
+{
+    /* registration doesn't refer to a product */
+    if (recvheader->flags == FMTP_RCVR_REG) {
+        try {
+            handleRcvrReg(sock, payload);
+        }
+        catch (const std::runtime_error& e) {
+            std::throw_with_nested(std::runtime_error(
+                    "fmtpSendv3::serveRetxMsg(): Couldn't register "
+                    "receiver"));
+        }
+        return;
+    }
+
+    /* a give-up can refer to any number of products */
+    if (recvheader->flags == FMTP_RETX_GIVEUP) {
+        handleRetxGiveUp(recvheader, sock);
+        return;
+    }
+
+    /* a wide request is followed by the length of its range */
+    uint32_t length = recvheader->payloadlen;
+    if (recvheader->flags == FMTP_RETX_REQ_WIDE) {
+        (void)memcpy(&length, payload, sizeof(length));
+        length = ntohl(length);
+    }
+
+    /* Acquires the product metadata as in exclusive use */
+    RetxMetadata* retxMeta = sendMeta->getMetadata(recvheader->prodindex);
+
+    try {
+        if (recvheader->flags == FMTP_RETX_REQ ||
+                recvheader->flags == FMTP_RETX_REQ_WIDE) {
+            #ifdef DEBUG2
+                std::string debugmsg = "Product #" +
+                    std::to_string(recvheader->prodindex);
+                debugmsg += ": RETX_REQ received";
+                std::cout << debugmsg << std::endl;
+                WriteToLog(debugmsg);
+            #endif
+            handleRetxReq(recvheader, retxMeta, sock, length);
+        }
+        else if (recvheader->flags == FMTP_RETX_END) {
+            #ifdef DEBUG2
+                std::string debugmsg = "Product #" +
+                    std::to_string(recvheader->prodindex);
+                debugmsg += ": RETX_END received";
+                std::cout << debugmsg << std::endl;
+                WriteToLog(debugmsg);
+            #endif
+            handleRetxEnd(recvheader, retxMeta, sock);
+        }
+        else if (recvheader->flags == FMTP_BOP_REQ) {
+            #ifdef DEBUG2
+                std::string debugmsg = "Product #" +
+                    std::to_string(recvheader->prodindex);
+                debugmsg += ": BOP_REQ received";
+                std::cout << debugmsg << std::endl;
+                WriteToLog(debugmsg);
+            #endif
+            handleBopReq(recvheader, retxMeta, sock);
+        }
+        else if (recvheader->flags == FMTP_EOP_REQ) {
+            #ifdef DEBUG2
+                std::string debugmsg = "Product #" +
+                    std::to_string(recvheader->prodindex);
+                debugmsg += ": EOP_REQ received";
+                std::cout << debugmsg << std::endl;
+                WriteToLog(debugmsg);
+            #endif
+            handleEopReq(recvheader, retxMeta, sock);
+        }
+    }
+    catch (const std::runtime_error& e) {
+        /* same as parseHeader(), if connection broken, take action */
+        std::throw_with_nested(std::runtime_error(
+                "fmtpSendv3::serveRetxMsg(): Couldn't reply to request"));
+    }
+
+    /* Releases the product metadata in exclusive use */
+    sendMeta->releaseMetadata(recvheader->prodindex);
+}
+
+
+/**
+ * Rejects a retransmission request from a receiver. A sender side timeout or
+ * received RETX_END message from all receivers and then receiving retx
+ * requests again would cause the rejection.
+ *
+ * @param[in] prodindex  Product-index of the request.
+ * @param[in] sock       The receiver's socket.
+ */
+void fmtpSendv3::rejRetxReq(const uint32_t prodindex, const int sock)
+{
+    FmtpHeader sendheader;
+
+    sendheader.prodindex  = htonl(prodindex);
+    sendheader.seqnum     = 0;
+    sendheader.payloadlen = 0;
+    sendheader.flags      = htons(FMTP_RETX_REJ);
+    tcpsend->sendData(sock, &sendheader, NULL, 0);
+}
+
+
+/**
+ * Returns the size of the payload that follows the header of a message from a
+ * receiver. Only a registration and a wide retransmission request carry one;
+ * the payloadlen field of the other requests is the length of a range.
+ *
+ * @param[in] recvheader  The FMTP header of the message.
+ * @return                Size of the payload in bytes.
+ *
+ * @throw std::runtime_error  if the message is malformed.
+ */
+uint16_t fmtpSendv3::rcvrPayloadLen(const FmtpHeader* const recvheader)
+{
+    if (recvheader->flags == FMTP_RCVR_REG) {
+        if (recvheader->payloadlen != RCVR_REG_LEN) {
+            throw std::runtime_error("fmtpSendv3::rcvrPayloadLen() invalid "
+                    "registration length: " +
+                    std::to_string(recvheader->payloadlen));
+        }
+        return RCVR_REG_LEN;
+    }
+    if (recvheader->flags == FMTP_RETX_REQ_WIDE) {
+        if (recvheader->payloadlen != RETX_WIDE_LEN) {
+            throw std::runtime_error("fmtpSendv3::rcvrPayloadLen() invalid "
+                    "request length: " +
+                    std::to_string(recvheader->payloadlen));
+        }
+        return RETX_WIDE_LEN;
+    }
+    return 0;
+}
+
+
+/**
+ * Retransmits data to a receiver. Requested retransmition block size will be
+ * checked to make sure the request is valid. The range can span any number of
+ * blocks.
+ *
+ * @param[in] recvheader  The FMTP header of the retransmission request.
+ * @param[in] retxMeta    The associated retransmission entry.
+ * @param[in] sock        The receiver's socket.
+ * @param[in] length      Length of the requested range in bytes.
+ *
+ * @throw std::runtime_error if TcpSend::send() fails.
+ */
+void fmtpSendv3::retransmit(
+        const FmtpHeader*   const recvheader,
+        const RetxMetadata* const retxMeta,
+        const int                 sock,
+        const uint32_t            length)
+{
+    if (length > 0 && recvheader->seqnum < retxMeta->prodLength) {
+        uint32_t start = recvheader->seqnum;
+        /* make sure the requested bytes do not exceed file size */
+        uint32_t out   = MIN((uint64_t)retxMeta->prodLength,
+                             (uint64_t)start + length);
+
         FmtpHeader sendheader;
         sendheader.prodindex  = htonl(recvheader->prodindex);
         sendheader.flags      = htons(FMTP_RETX_DATA);
@@ -946,6 +1768,14 @@ void fmtpSendv3::retransmit(
             sendheader.seqnum     = htonl(start);
             sendheader.payloadlen = htons(payLen);
 
+            #ifdef TEST_LOSS
+                /* holds up everything behind it on the connection */
+                if (testLost()) {
+                    std::this_thread::sleep_for(
+                            std::chrono::milliseconds(TEST_LOSS_STALL_MS));
+                }
+            #endif
+
             #if defined(DEBUG1) || defined(DEBUG2)
                 char tmp[1460] = {0};
                 int retval = tcpsend->sendData(sock, &sendheader, tmp, payLen);
@@ -981,6 +1811,90 @@ void fmtpSendv3::retransmit(
 }
 
 
+/**
+ * Retransmits data to a receiver as UDP datagrams, one block per datagram.
+ * The datagrams are paced by the repair rate-shaper, since unlike TCP, UDP
+ * won't back off on its own. A lost datagram is recovered by the receiver
+ * re-requesting the block, so nothing behind it is held up.
+ *
+ * @param[in] recvheader  The FMTP header of the retransmission request.
+ * @param[in] retxMeta    The associated retransmission entry.
+ * @param[in] dest        The receiver's UDP repair address.
+ *
+ * @throw std::system_error  if UdpRetxSend::sendTo() fails.
+ */
+void fmtpSendv3::udpRetransmit(
+        const FmtpHeader*   const recvheader,
+        const RetxMetadata* const retxMeta,
+        const struct sockaddr_in& dest)
+{
+    if (recvheader->payloadlen == 0 ||
+        recvheader->seqnum >= retxMeta->prodLength)
+        return;
+
+    uint32_t start = recvheader->seqnum;
+    /* make sure the requested bytes do not exceed file size */
+    uint32_t out   = MIN(retxMeta->prodLength,
+                         start + recvheader->payloadlen);
+
+    FmtpHeader sendheader;
+    sendheader.prodindex  = htonl(recvheader->prodindex);
+    sendheader.flags      = htons(FMTP_RETX_DATA);
+
+    /* aligns starting seqnum to the multiple-of-MTU boundary. */
+    start = (start/FMTP_DATA_LEN) * FMTP_DATA_LEN;
+    uint16_t payLen;
+
+    for (uint32_t nbytes = out - start; nbytes > 0;
+         nbytes -= payLen, start += payLen) {
+        payLen = MIN(nbytes, FMTP_DATA_LEN);
+
+        sendheader.seqnum     = htonl(start);
+        sendheader.payloadlen = htons(payLen);
+
+        std::unique_lock<std::mutex> lock(retxshapermtx);
+        if (retxspeed) {
+            retxshaper.CalcPeriod(sizeof(sendheader) + payLen);
+        }
+        #ifdef TEST_LOSS
+            if (!testLost())
+        #endif
+        udpretx->sendTo(dest, &sendheader,
+                        (char*)retxMeta->dataprod_p + start, payLen);
+        if (retxspeed) {
+            retxshaper.Sleep();
+        }
+        lock.unlock();
+
+        #ifdef DEBUG2
+            std::string debugmsg = "Product #" +
+                std::to_string(recvheader->prodindex);
+            debugmsg += ": Data block (SeqNum = ";
+            debugmsg += std::to_string(start);
+            debugmsg += "), (PayLen = ";
+            debugmsg += std::to_string(payLen);
+            debugmsg += ") has been retransmitted over UDP";
+            std::cout << debugmsg << std::endl;
+            WriteToLog(debugmsg);
+        #endif
+    }
+}
+
+
+/**
+ * Removes the UDP repair address and the options registered for a receiver's
+ * socket. Called when the receiver's TCP connection goes away.
+ *
+ * @param[in] sock  The receiver's socket.
+ */
+void fmtpSendv3::rmUdpPeer(const int sock)
+{
+    std::unique_lock<std::mutex> lock(udpPeerMtx);
+    udpPeers.erase(sock);
+    sumRcvrs.erase(sock);
+}
+
+
 /**
  * Retransmits BOP to a receiver. All necessary metadata will be retrieved
  * from the RetxMetadata map. This implies the addRetxMetadata() operation
@@ -990,13 +1904,16 @@ void fmtpSendv3::retransmit(
  * @param[in] recvheader  The FMTP header of the retransmission request.
  * @param[in] retxMeta    The associated retransmission entry.
  * @param[in] sock        The receiver's socket.
+ * @param[in] flags       Flags of the BOP packet: FMTP_RETX_BOP, or FMTP_BOP
+ *                        if the product is streamed to a unicast receiver.
  *
  * @throw std::runtime_error if TcpSend::send() fails.
  */
 void fmtpSendv3::retransBOP(
         const FmtpHeader* const  recvheader,
         const RetxMetadata* const retxMeta,
-        const int                 sock)
+        const int                 sock,
+        const uint16_t            flags)
 {
     FmtpHeader   sendheader;
     BOPMsg       bopMsg;
@@ -1006,7 +1923,7 @@ void fmtpSendv3::retransBOP(
     sendheader.seqnum     = 0;
     sendheader.payloadlen = htons(retxMeta->metaSize +
                                   (FMTP_DATA_LEN - AVAIL_BOP_LEN));
-    sendheader.flags      = htons(FMTP_RETX_BOP);
+    sendheader.flags      = htons(flags);
 
     /* Set the FMTP BOP message. */
     bopMsg.startTime[0] =
@@ -1052,7 +1969,8 @@ void fmtpSendv3::retransBOP(
 
 
 /**
- * Retransmits EOP to a receiver.
+ * Retransmits EOP to a receiver, with the product's checksums if its
+ * multicast has finished and the receiver registered with RCVR_OPT_CHECKSUMS.
  *
  * @param[in] recvheader  The FMTP header of the retransmission request.
  * @param[in] sock        The receiver's socket.
@@ -1063,16 +1981,26 @@ void fmtpSendv3::retransEOP(
         const FmtpHeader* const  recvheader,
         const int                 sock)
 {
-    FmtpHeader   sendheader;
+    FmtpHeader            sendheader;
+    std::vector<uint32_t> checksums;
+    bool                  withSums;
+    {
+        std::unique_lock<std::mutex> lock(udpPeerMtx);
+        withSums = sumRcvrs.count(sock);
+    }
+    /* a receiver that didn't ask for the checksums can't skip them */
+    if (withSums)
+        sendMeta->getChecksums(recvheader->prodindex, checksums);
 
     /* Set the FMTP packet header. */
     sendheader.prodindex  = htonl(recvheader->prodindex);
     sendheader.seqnum     = 0;
-    sendheader.payloadlen = 0;
+    sendheader.payloadlen = htons(checksums.size() * sizeof(uint32_t));
     /** notice the flags field should be set to RETX_EOP other than EOP */
     sendheader.flags      = htons(FMTP_RETX_EOP);
 
-    int retval = tcpsend->sendData(sock, &sendheader, NULL, 0);
+    int retval = tcpsend->sendData(sock, &sendheader,
+            (char*)checksums.data(), checksums.size() * sizeof(uint32_t));
     if (retval < 0) {
         throw std::runtime_error(
                 "fmtpSendv3::retransEOP() TcpSend::send() error");
@@ -1109,14 +2037,20 @@ void fmtpSendv3::retransEOP(
  */
 void fmtpSendv3::SendBOPMessage(uint32_t prodSize, void* metadata,
                                  const uint16_t metaSize,
-                                 const struct timespec& startTime)
+                                 const struct timespec& startTime,
+                                 const std::vector<DeltaRange>* ranges,
+                                 const uint32_t baseIndex)
 {
 #if 1
+    uint16_t payloadlen = metaSize +
+            static_cast<uint16_t>(FMTP_DATA_LEN - AVAIL_BOP_LEN);
+    if (ranges)
+        payloadlen += DELTA_HDR_LEN + ranges->size() * sizeof(DeltaRange);
+
     udpSerializer.encode(prodIndex);
     udpSerializer.encode(static_cast<uint32_t>(0));
-    udpSerializer.encode(static_cast<uint16_t>(
-            metaSize + static_cast<uint16_t>(FMTP_DATA_LEN - AVAIL_BOP_LEN)));
-    udpSerializer.encode(static_cast<uint16_t>(FMTP_BOP));
+    udpSerializer.encode(payloadlen);
+    udpSerializer.encode(ranges ? FMTP_BOP_DELTA : FMTP_BOP);
 
     udpSerializer.encode(static_cast<uint64_t>(startTime.tv_sec));
     udpSerializer.encode(static_cast<uint32_t>(startTime.tv_nsec));
@@ -1126,6 +2060,15 @@ void fmtpSendv3::SendBOPMessage(uint32_t prodSize, void* metadata,
     udpSerializer.encode(metaSize);
     udpSerializer.encode(metadata, metaSize);
 
+    if (ranges) {
+        udpSerializer.encode(baseIndex);
+        udpSerializer.encode(static_cast<uint16_t>(ranges->size()));
+        for (size_t i = 0; i < ranges->size(); i++) {
+            udpSerializer.encode((*ranges)[i].seqnum);
+            udpSerializer.encode((*ranges)[i].length);
+        }
+    }
+
     udpSerializer.flush();
 #else
     FmtpHeader    header;
@@ -1207,19 +2150,81 @@ void fmtpSendv3::SendBOPMessage(uint32_t prodSize, void* metadata,
 }
 
 
+/**
+ * Finds the ranges of a revision that differ from its base, block by block.
+ * A block is unchanged only if the base has a block of the same length and
+ * content at the same offset. The base's retransmission entry is held while
+ * it's compared, so its data can't go away.
+ *
+ * @param[in]  baseIndex  Index of the base.
+ * @param[in]  data       The revision.
+ * @param[in]  dataSize   The size of the revision in bytes.
+ * @param[in]  metaSize   Size of the revision's metadata in bytes.
+ * @param[out] ranges     The changed ranges, in order.
+ * @return                `false` if the base is no longer retained, if
+ *                        nothing would be saved or if the ranges don't fit
+ *                        in the BOP; the whole revision is sent then.
+ */
+bool fmtpSendv3::diffBase(const uint32_t baseIndex, const void* data,
+                          const uint32_t dataSize, const uint16_t metaSize,
+                          std::vector<DeltaRange>& ranges)
+{
+    if (AVAIL_BOP_LEN < metaSize + DELTA_HDR_LEN)
+        return false;
+    const size_t maxRanges = (AVAIL_BOP_LEN - metaSize - DELTA_HDR_LEN) /
+                             sizeof(DeltaRange);
+
+    RetxMetadata* base = sendMeta->getMetadata(baseIndex);
+    if (base == NULL)
+        return false;
+
+    uint32_t changed = 0;
+    bool overflow = false;
+    ranges.clear();
+    for (uint32_t seqnum = 0; seqnum < dataSize; seqnum += FMTP_DATA_LEN) {
+        const uint32_t len = MIN(dataSize - seqnum, (uint32_t)FMTP_DATA_LEN);
+        const bool same = base->prodLength > seqnum &&
+                MIN(base->prodLength - seqnum, (uint32_t)FMTP_DATA_LEN) ==
+                len &&
+                memcmp((const char*)data + seqnum,
+                       (const char*)base->dataprod_p + seqnum, len) == 0;
+        if (same)
+            continue;
+
+        changed += len;
+        if (!ranges.empty() &&
+                ranges.back().seqnum + ranges.back().length == seqnum) {
+            ranges.back().length += len;
+        }
+        else if (ranges.size() < maxRanges) {
+            DeltaRange range = {seqnum, len};
+            ranges.push_back(range);
+        }
+        else {
+            overflow = true;
+            break;
+        }
+    }
+    sendMeta->releaseMetadata(baseIndex);
+
+    return !overflow && changed < dataSize;
+}
+
+
 /**
  * Sends the EOP message to the receiver to indicate the end of a product
- * transmission.
+ * transmission. The EOP carries the checksums of the product.
  *
+ * @param[in] checksums        The checksums in network byte-order.
  * @throws std::runtime_error  if UdpSend::SendTo() fails.
  */
-void fmtpSendv3::sendEOPMessage()
+void fmtpSendv3::sendEOPMessage(const std::vector<uint32_t>& checksums)
 {
     FmtpHeader header;
 
     header.prodindex  = htonl(prodIndex);
     header.seqnum     = 0;
-    header.payloadlen = 0;
+    header.payloadlen = htons(checksums.size() * sizeof(uint32_t));
     header.flags      = htons(FMTP_EOP);
 
     #ifdef MODBASE
@@ -1236,7 +2241,8 @@ void fmtpSendv3::sendEOPMessage()
         WriteToLog(debugmsg);
     #endif
 #else
-    udpsend->SendTo(&header, sizeof(header));
+    udpsend->SendData(&header, sizeof(header), (void*)checksums.data(),
+                      checksums.size() * sizeof(uint32_t));
 
     #ifdef MEASURE
         std::string measuremsg = "Product #" + std::to_string(tmpidx);
@@ -1261,17 +2267,20 @@ void fmtpSendv3::sendEOPMessage()
 /**
  * Multicasts the data blocks of a data-product. A legal boundary check is
  * performed to make sure all the data blocks going out are multiples of
- * FMTP_DATA_LEN except the last block.
+ * FMTP_DATA_LEN except the last block. Each block is added to the checksums
+ * right after it's sent, while it's still in the cache.
  *
- * @param[in] data      The data-product.
- * @param[in] dataSize  The size of the data-product in bytes.
+ * @param[in]     data      The data-product.
+ * @param[in]     dataSize  The size of the data-product in bytes.
+ * @param[in,out] cksum     Checksums of the data-product.
+ * @param[in]     seqNum    Offset of the data in the data-product.
  * @throw std::runtime_error  if an I/O error occurs.
  */
-void fmtpSendv3::sendData(void* data, uint32_t dataSize)
+void fmtpSendv3::sendData(void* data, uint32_t dataSize, ProdChecksum& cksum,
+                          uint32_t seqNum)
 {
     FmtpHeader header;
     uint32_t datasize = dataSize;
-    uint32_t seqNum = 0;
     header.prodindex = htonl(prodIndex);
     header.flags     = htons(FMTP_MEM_DATA);
 
@@ -1298,17 +2307,21 @@ void fmtpSendv3::sendData(void* data, uint32_t dataSize)
          * can decide whether to do rate shaping.
          */
         //TODO: use Rateshaper to replace tc?
+        /* the rate is shared with the unicast streams, see reserveRate() */
         if (linkspeed) {
-            rateshaper.CalcPeriod(sizeof(header) + payloadlen);
+            const double wait = reserveRate(sizeof(header) + payloadlen);
+            if (wait > 0)
+                std::this_thread::sleep_for(
+                        std::chrono::duration<double>(wait));
         }
+        #ifdef TEST_LOSS
+            if (!testLost())
+        #endif
         if(udpsend->SendData(&header, sizeof(header), data,
                              (size_t)payloadlen) < 0) {
             throw std::runtime_error(
                     "fmtpSendv3::sendProduct::SendData() error");
         }
-        if (linkspeed) {
-            rateshaper.Sleep();
-        }
 
         #ifdef MODBASE
             uint32_t tmpidx = prodIndex % MODBASE;
@@ -1329,6 +2342,7 @@ void fmtpSendv3::sendData(void* data, uint32_t dataSize)
             }
         #endif
 
+        cksum.add(seqNum, data, payloadlen);
         datasize -= payloadlen;
         data      = (char*)data + payloadlen;
         seqNum   += payloadlen;
@@ -1425,6 +2439,8 @@ void* fmtpSendv3::StartRetxThread(void* ptr)
          * will be called.
          */
         logMsg(e);
+        newptr->retxmitterptr->rmUcastRcvr(newptr->retxsockfd);
+        newptr->retxmitterptr->rmUdpPeer(newptr->retxsockfd);
         newptr->retxmitterptr->tcpsend->rmSockInList(newptr->retxsockfd);
         close(newptr->retxsockfd);
         pthread_t thisThread = ::pthread_self();
@@ -1481,51 +2497,66 @@ void fmtpSendv3::timerThread()
             return;
         }
 
-        #ifdef MODBASE
-            uint32_t tmpidx = prodindex % MODBASE;
-        #else
-            uint32_t tmpidx = prodindex;
-        #endif
+        expireProd(prodindex);
+    }
+}
 
-        #ifdef DEBUG2
-            std::string debugmsg = "Timer: Product #" +
-                std::to_string(tmpidx);
-            debugmsg += " has waken up";
-            std::cout << debugmsg << std::endl;
-            WriteToLog(debugmsg);
-        #endif
 
-        /* Set the FMTP packet header (EOP message). */
-        FmtpHeader          EOPmsg;
-        EOPmsg.prodindex  = htonl(prodindex);
-        EOPmsg.seqnum     = 0;
-        EOPmsg.payloadlen = 0;
-        EOPmsg.flags      = htons(FMTP_RETX_EOP);
-        /* notify all unACKed receivers with an EOP. */
-        sendMeta->notifyUnACKedRcvrs(prodindex, &EOPmsg, tcpsend);
+/**
+ * Removes a product whose retransmission timer went off. Unacknowledged
+ * receivers are sent an EOP first, and the sending application is notified.
+ * Called by the timer thread or, if the session is attached to a runtime, by
+ * a worker of the runtime.
+ *
+ * @param[in] prodindex  Product-index of the product.
+ * @throw std::runtime_error  if sending the EOP fails.
+ */
+void fmtpSendv3::expireProd(const uint32_t prodindex)
+{
+    #ifdef MODBASE
+        uint32_t tmpidx = prodindex % MODBASE;
+    #else
+        uint32_t tmpidx = prodindex;
+    #endif
 
-        const bool isRemoved = sendMeta->rmRetxMetadata(prodindex);
+    #ifdef DEBUG2
+        std::string debugmsg = "Timer: Product #" +
+            std::to_string(tmpidx);
+        debugmsg += " has waken up";
+        std::cout << debugmsg << std::endl;
+        WriteToLog(debugmsg);
+    #endif
+
+    /* Set the FMTP packet header (EOP message). */
+    FmtpHeader          EOPmsg;
+    EOPmsg.prodindex  = htonl(prodindex);
+    EOPmsg.seqnum     = 0;
+    EOPmsg.payloadlen = 0;
+    EOPmsg.flags      = htons(FMTP_RETX_EOP);
+    /* notify all unACKed receivers with an EOP. */
+    sendMeta->notifyUnACKedRcvrs(prodindex, &EOPmsg, tcpsend);
+
+    const bool isRemoved = sendMeta->rmRetxMetadata(prodindex);
+    /**
+     * Only if the product is removed by this remove call, notify the
+     * sending application. Since timer and retx thread access the
+     * RetxMetadata exclusively, notify_of_eop() will be called only once.
+     */
+    if (notifier && isRemoved) {
+        notifier->notifyOfEop(prodindex);
+    }
+    else if (isRemoved) {
+        suppressor->remove(prodindex);
         /**
-         * Only if the product is removed by this remove call, notify the
-         * sending application. Since timer and retx thread access the
-         * RetxMetadata exclusively, notify_of_eop() will be called only once.
+         * Updates the most recently acknowledged product and notifies
+         * a dummy notification handler (getNotify()).
          */
-        if (notifier && isRemoved) {
-            notifier->notifyOfEop(prodindex);
-        }
-        else if (isRemoved) {
-            suppressor->remove(prodindex);
-            /**
-             * Updates the most recently acknowledged product and notifies
-             * a dummy notification handler (getNotify()).
-             */
-            {
-                std::unique_lock<std::mutex> lock(notifyprodmtx);
-                notifyprodidx = prodindex;
-            }
-            notify_cv.notify_one();
-            memrelease_cv.notify_one();
+        {
+            std::unique_lock<std::mutex> lock(notifyprodmtx);
+            notifyprodidx = prodindex;
         }
+        notify_cv.notify_one();
+        memrelease_cv.notify_one();
     }
 }
 
@@ -1557,6 +2588,117 @@ void* fmtpSendv3::timerWrapper(void* ptr)
 }
 
 
+/**
+ * The UDP repair handler. Receives datagram retransmission requests from all
+ * registered receivers on one socket and answers each with paced repair
+ * datagrams, or with a RETX_REJ datagram if the product is no longer
+ * available. Datagrams from unregistered addresses are dropped, so only
+ * receivers with an established TCP connection are served.
+ *
+ * @throw std::system_error  if receiving from the UDP socket fails.
+ */
+void fmtpSendv3::udpRetxThread()
+{
+    logMsg("fmtpSendv3::udpRetxThread(): Entered");
+    while (1)
+        serveUdpRetxReq();
+}
+
+
+/**
+ * Receives one datagram on the UDP repair socket and serves it. Blocks until
+ * a datagram arrives.
+ *
+ * @throw std::system_error  if receiving from the UDP socket fails.
+ */
+void fmtpSendv3::serveUdpRetxReq()
+{
+    char               pktbuf[MAX_FMTP_PACKET_LEN];
+    struct sockaddr_in from;
+    FmtpHeader         recvheader;
+
+    ssize_t nbytes = udpretx->recvFrom(pktbuf, sizeof(pktbuf), &from);
+    if (nbytes < FMTP_HEADER_LEN)
+        return;
+
+    (void)memcpy(&recvheader, pktbuf, FMTP_HEADER_LEN);
+    recvheader.prodindex  = ntohl(recvheader.prodindex);
+    recvheader.seqnum     = ntohl(recvheader.seqnum);
+    recvheader.payloadlen = ntohs(recvheader.payloadlen);
+    recvheader.flags      = ntohs(recvheader.flags);
+    if (recvheader.flags != FMTP_RETX_REQ)
+        return;
+
+    bool registered = false;
+    {
+        std::unique_lock<std::mutex> lock(udpPeerMtx);
+        for (auto it = udpPeers.begin(); it != udpPeers.end(); ++it) {
+            if (it->second.sin_addr.s_addr == from.sin_addr.s_addr &&
+                it->second.sin_port == from.sin_port) {
+                registered = true;
+                break;
+            }
+        }
+    }
+    if (!registered)
+        return;
+
+    /* a request is always served completely, even on Stop() */
+    int initState;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &initState);
+
+    RetxMetadata* retxMeta = sendMeta->getMetadata(recvheader.prodindex);
+    try {
+        if (retxMeta) {
+            udpRetransmit(&recvheader, retxMeta, from);
+        }
+        else {
+            FmtpHeader sendheader;
+            sendheader.prodindex  = htonl(recvheader.prodindex);
+            sendheader.seqnum     = htonl(recvheader.seqnum);
+            sendheader.payloadlen = 0;
+            sendheader.flags      = htons(FMTP_RETX_REJ);
+            udpretx->sendTo(from, &sendheader, NULL, 0);
+        }
+    }
+    catch (const std::system_error& e) {
+        /* one unreachable receiver mustn't stop repairs to the others */
+        logMsg(e);
+    }
+    sendMeta->releaseMetadata(recvheader.prodindex);
+
+    int ignoredState;
+    pthread_setcancelstate(initState, &ignoredState);
+}
+
+
+/**
+ * Executes the UDP repair handler.
+ *
+ * Called by `::pthread_create()`.
+ *
+ * @param[in,out] ptr   Pointer to containing `fmtpSendv3` instance
+ * @retval        NULL  Always
+ */
+void* fmtpSendv3::StartUdpRetxThread(void* ptr)
+{
+#ifdef LDM_LOGGING
+    pthread_cleanup_push(freeLogging, nullptr);
+#endif
+    fmtpSendv3* sendptr = static_cast<fmtpSendv3*>(ptr);
+    try {
+        sendptr->udpRetxThread();
+    }
+    catch (const std::exception& e) {
+        sendptr->taskBroke(std::current_exception());
+    }
+#ifdef LDM_LOGGING
+    pthread_cleanup_pop(true);
+#endif
+    return NULL;
+}
+
+
 /**
  * Write a line of log record into the log file. If the log file doesn't exist,
  * create a new one and then append to it.
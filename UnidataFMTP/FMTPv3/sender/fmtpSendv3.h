@@ -35,20 +35,27 @@
 #include <pthread.h>
 #include <sys/types.h>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <exception>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
+#include <vector>
 
 #include "ProdIndexDelayQueue.h"
 #include "../RateShaper/RateShaper.h"
 #include "RetxThreads.h"
 #include "SendProxy.h"
 #include "senderMetadata.h"
+#include "SenderRuntime.h"
 #include "../SilenceSuppressor/SilenceSuppressor.h"
 #include "TcpSend.h"
+#include "UdpRetxSend.h"
 #include "UdpSend.h"
 #include "fmtpBase.h"
+#include "ProdChecksum.h"
 #include "Serializer.h"
 
 
@@ -70,6 +77,41 @@ struct StartRetxThreadInfo
 };
 
 
+/**
+ * A receiver that can't receive the multicast. Every product is streamed to
+ * it over its TCP connection, by a thread of its own or, under a
+ * SenderRuntime, by jobs of the session.
+ */
+struct UcastRcvr
+{
+    fmtpSendv3*              sender;
+    int                      sock;
+    /** products waiting to be streamed, oldest first */
+    std::deque<uint32_t>     prods;
+    std::mutex               mtx;
+    std::condition_variable  cv;
+    /** the receiver went away or the sender is stopping */
+    bool                     done;
+    /** a job of the runtime streams to the receiver */
+    bool                     running;
+    /* the stream position, used by one thread or job at a time */
+    /** a product is being streamed */
+    bool                     streaming;
+    /** its BOP has been sent */
+    bool                     started;
+    /** the rate has been reserved for its next data-block */
+    bool                     paced;
+    uint32_t                 prodindex;
+    /** offset of its next data-block */
+    uint32_t                 seqnum;
+
+    UcastRcvr(fmtpSendv3* sender, int sock)
+        : sender(sender), sock(sock), done(false), running(false),
+          streaming(false), started(false), paced(false), prodindex(0),
+          seqnum(0) {}
+};
+
+
 /**
  * To contain multiple types of necessary information and transfer to the
  * StartTimerThread() as one single parameter.
@@ -126,6 +168,28 @@ public:
                  const std::string     ifAddr = "0.0.0.0",
                  const uint32_t        initProdIndex = 0,
                  const float           tsnd = 10.0);
+    /**
+     * Constructs a session of a shared runtime. The session runs no threads
+     * of its own: the runtime accepts its receivers, serves their requests
+     * and runs its timers.
+     *
+     * @param[in] runtime    The started runtime.
+     * @param[in] sessionId  Id of the session, unique within the runtime.
+     *                       Receivers use it to share a connection.
+     * All other parameters are the same as for the standalone sender.
+     */
+    explicit fmtpSendv3(
+                 SenderRuntime&        runtime,
+                 const uint32_t        sessionId,
+                 const char*           tcpAddr,
+                 const unsigned short  tcpPort,
+                 const char*           mcastAddr,
+                 const unsigned short  mcastPort,
+                 SendProxy*            notifier = NULL,
+                 const unsigned char   ttl = 1,
+                 const std::string     ifAddr = "0.0.0.0",
+                 const uint32_t        initProdIndex = 0,
+                 const float           tsnd = 10.0);
     ~fmtpSendv3();
 
     /* ----------- testapp-specific APIs begin ----------- */
@@ -148,13 +212,52 @@ public:
     uint32_t       sendProduct(void* data, uint32_t dataSize);
     uint32_t       sendProduct(void* data, uint32_t dataSize, void* metadata,
                                uint16_t metaSize);
+    /**
+     * Transfers a revision of an earlier product. Only the blocks that differ
+     * from the earlier product are multicast if it's still retained for
+     * retransmission; otherwise the whole revision is sent.
+     *
+     * @param[in] baseIndex  Index of the earlier product.
+     * All other parameters are the same as for sendProduct().
+     */
+    uint32_t       sendRevision(void* data, uint32_t dataSize, void* metadata,
+                                uint16_t metaSize, uint32_t baseIndex);
     void           SetSendRate(uint64_t speed);
+    /**
+     * Sets the pacing rate of UDP repair datagrams. Defaults to the send rate.
+     *
+     * @param[in] speed  Rate in bits per second.
+     */
+    void           SetRetxRate(uint64_t speed);
     /** Sender side start point, the first function to be called */
     void           Start();
     /** Sender side stop point */
     void           Stop();
 
 private:
+    friend class SenderRuntime;
+
+    /**
+     * Constructs with a given retransmission transport, see the public
+     * constructors.
+     *
+     * @param[in] tcpsend    The retransmission transport. Deleted by the
+     *                       instance.
+     * @param[in] runtime    The shared runtime or `NULL`.
+     * @param[in] sessionId  Id of the session within the runtime.
+     */
+    fmtpSendv3(TcpSend*              tcpsend,
+               SenderRuntime*        runtime,
+               const uint32_t        sessionId,
+               const char*           tcpAddr,
+               const char*           mcastAddr,
+               const unsigned short  mcastPort,
+               SendProxy*            notifier,
+               const unsigned char   ttl,
+               const std::string     ifAddr,
+               const uint32_t        initProdIndex,
+               const float           tsnd);
+
     /**
      * Adds and entry for a data-product to the retransmission set.
      *
@@ -169,6 +272,14 @@ private:
     RetxMetadata* addRetxMetadata(void* const data, const uint32_t dataSize,
                                   void* const metadata, const uint16_t metaSize,
                                   const struct timespec* startTime);
+    /**
+     * Vets a newly accepted receiver and closes its connection if the sending
+     * application refuses it.
+     *
+     * @param[in] sock  The receiver's socket.
+     * @return          `true` if the receiver is accepted.
+     */
+    bool admitRcvr(const int sock);
     static uint32_t blockIndex(uint32_t start) {return start/FMTP_DATA_LEN;}
     /** new coordinator thread */
     static void* coordinator(void* ptr);
@@ -177,9 +288,20 @@ private:
      *
      * @param[in] recvheader  FMTP header of the retransmission request.
      * @param[in] retxMeta    Associated retransmission entry.
+     * @param[in] sock        The receiver's socket.
+     * @param[in] length      Length of the requested range in bytes.
      */
     void handleRetxReq(FmtpHeader* const  recvheader,
-                       RetxMetadata* const retxMeta, const int sock);
+                       RetxMetadata* const retxMeta, const int sock,
+                       const uint32_t length);
+    /**
+     * Handles a notice from a receiver that it has given up on a range of
+     * products.
+     *
+     * @param[in] recvheader  The FMTP header of the notice.
+     * @param[in] sock        The receiver's socket.
+     */
+    void handleRetxGiveUp(FmtpHeader* const recvheader, const int sock);
     /**
      * Handles a notice from a receiver that a data-product has been completely
      * received.
@@ -208,6 +330,62 @@ private:
      */
     void handleEopReq(FmtpHeader* const  recvheader,
                       RetxMetadata* const retxMeta, const int sock);
+    /**
+     * Handles the registration of a receiver's UDP repair port and options.
+     *
+     * @param[in] sock        The receiver's socket.
+     * @param[in] payload     The registration.
+     */
+    void handleRcvrReg(const int sock, const char* const payload);
+    /**
+     * Starts streaming every product to a receiver over its TCP connection.
+     *
+     * @param[in] sock  The receiver's socket.
+     */
+    void addUcastRcvr(const int sock);
+    /**
+     * Queues a new product for all unicast receivers.
+     *
+     * @param[in] prodindex  Product-index of the product.
+     */
+    void queueUcastProd(const uint32_t prodindex);
+    /**
+     * Stops streaming to a unicast receiver. Does nothing if the receiver
+     * isn't one.
+     *
+     * @param[in] sock  The receiver's socket.
+     */
+    void rmUcastRcvr(const int sock);
+    /** stops streaming to all unicast receivers and waits for it */
+    void stopUcastRcvrs();
+    /**
+     * Reserves the sending rate for a packet.
+     *
+     * @param[in] size  Size of the packet in bytes.
+     * @return          Seconds to wait before sending the packet.
+     */
+    double reserveRate(const size_t size);
+    /**
+     * Streams to a unicast receiver until it has to wait.
+     *
+     * @param[in] rcvr       The receiver.
+     * @param[in] maxBlocks  Maximum number of data-blocks to send.
+     * @return               Seconds to wait for the rate, 0 if `maxBlocks`
+     *                       were sent, or -1 if nothing is left to stream.
+     */
+    double streamUcast(UcastRcvr& rcvr, const unsigned maxBlocks);
+    /** streams to a unicast receiver as a job of the runtime */
+    void ucastJob(const std::shared_ptr<UcastRcvr>& rcvr);
+    /** streams the queued products to a unicast receiver */
+    void ucastThread(UcastRcvr& rcvr);
+    /** a wrapper to call the actual fmtpSendv3::ucastThread() */
+    static void* StartUcastThread(void* ptr);
+    /**
+     * Removes a product whose retransmission timer went off.
+     *
+     * @param[in] prodindex  Product-index of the product.
+     */
+    void expireProd(const uint32_t prodindex);
     /** new timer thread */
     void RunRetxThread(int retxsockfd);
     /**
@@ -217,24 +395,35 @@ private:
      * @param[in] sock       The receiver's socket.
      */
     void rejRetxReq(const uint32_t prodindex, const int sock);
+    /**
+     * Returns the size of the payload that follows a message from a receiver.
+     *
+     * @param[in] recvheader  The FMTP header of the message.
+     * @return                Size of the payload in bytes.
+     */
+    static uint16_t rcvrPayloadLen(const FmtpHeader* const recvheader);
     /**
      * Retransmits data to a receiver.
      *
      * @param[in] recvheader  The FMTP header of the retransmission request.
      * @param[in] retxMeta    The associated retransmission entry.
      * @param[in] sock        The receiver's socket.
+     * @param[in] length      Length of the requested range in bytes.
      */
     void retransmit(const FmtpHeader* const recvheader,
-                    const RetxMetadata* const retxMeta, const int sock);
+                    const RetxMetadata* const retxMeta, const int sock,
+                    const uint32_t length);
     /**
      * Retransmits BOP packet to a receiver.
      *
      * @param[in] recvheader  The FMTP header of the retransmission request.
      * @param[in] retxMeta    The associated retransmission entry.
      * @param[in] sock        The receiver's socket.
+     * @param[in] flags       Flags of the BOP packet.
      */
     void retransBOP(const FmtpHeader* const  recvheader,
-                    const RetxMetadata* const retxMeta, const int sock);
+                    const RetxMetadata* const retxMeta, const int sock,
+                    const uint16_t flags = FMTP_RETX_BOP);
     /**
      * Retransmits EOP packet to a receiver.
      *
@@ -242,18 +431,79 @@ private:
      * @param[in] sock        The receiver's socket.
      */
     void retransEOP(const FmtpHeader* const  recvheader, const int sock);
+    /**
+     * Retransmits data to a receiver as paced UDP datagrams.
+     *
+     * @param[in] recvheader  The FMTP header of the retransmission request.
+     * @param[in] retxMeta    The associated retransmission entry.
+     * @param[in] dest        The receiver's UDP repair address.
+     */
+    void udpRetransmit(const FmtpHeader* const recvheader,
+                       const RetxMetadata* const retxMeta,
+                       const struct sockaddr_in& dest);
+    /**
+     * Removes the UDP repair address registered for a receiver's socket.
+     *
+     * @param[in] sock  The receiver's socket.
+     */
+    void rmUdpPeer(const int sock);
+    /**
+     * Serves one message from a receiver.
+     *
+     * @param[in] recvheader  The FMTP header of the message.
+     * @param[in] sock        The receiver's socket.
+     * @param[in] payload     The payload of the message.
+     */
+    void serveRetxMsg(FmtpHeader* const recvheader, const int sock,
+                      const char* const payload);
+    /** serves one datagram on the UDP repair socket */
+    void serveUdpRetxReq();
+    /**
+     * Multicasts the BOP of a product.
+     *
+     * @param[in] prodSize   The size of the product.
+     * @param[in] metadata   Application-specific metadata.
+     * @param[in] metaSize   Size of the metadata in bytes.
+     * @param[in] startTime  Time product given to FMTP for transmission.
+     * @param[in] ranges     Changed ranges of a revision or `NULL`.
+     * @param[in] baseIndex  Index of the revision's base.
+     */
     void SendBOPMessage(uint32_t prodSize, void* metadata,
                         const uint16_t metaSize,
-                        const struct timespec& startTime);
+                        const struct timespec& startTime,
+                        const std::vector<DeltaRange>* ranges = NULL,
+                        const uint32_t baseIndex = 0);
+    /**
+     * Finds the ranges of a revision that differ from its base.
+     *
+     * @param[in]  baseIndex  Index of the base.
+     * @param[in]  data       The revision.
+     * @param[in]  dataSize   The size of the revision in bytes.
+     * @param[in]  metaSize   Size of the revision's metadata in bytes.
+     * @param[out] ranges     The changed ranges.
+     * @return                `false` if the whole revision has to be sent.
+     */
+    bool diffBase(const uint32_t baseIndex, const void* data,
+                  const uint32_t dataSize, const uint16_t metaSize,
+                  std::vector<DeltaRange>& ranges);
+    /**
+     * Transfers a product or, if `baseIndex != NULL`, a revision.
+     */
+    uint32_t sendProd(void* data, uint32_t dataSize, void* metadata,
+                      uint16_t metaSize, const uint32_t* baseIndex);
+    void sendEOPMessage(const std::vector<uint32_t>& checksums);
     /**
-     * Multicasts the data of a data-product.
+     * Multicasts the data of a data-product and adds it to the product's
+     * checksums.
      *
-     * @param[in] data      The data-product.
-     * @param[in] dataSize  The size of the data-product in bytes.
+     * @param[in]     data      The data to send.
+     * @param[in]     dataSize  The size of the data in bytes.
+     * @param[in,out] cksum     Checksums of the data-product.
+     * @param[in]     seqNum    Offset of the data in the data-product.
      * @throw std::runtime_error  if an I/O error occurs.
      */
-    void sendEOPMessage();
-    void sendData(void* data, uint32_t dataSize);
+    void sendData(void* data, uint32_t dataSize, ProdChecksum& cksum,
+                  uint32_t seqNum = 0);
     /**
      * Sets the retransmission timeout parameters in a retransmission entry.
      *
@@ -281,6 +531,10 @@ private:
     void timerThread();
     /** a wrapper to call the actual fmtpSendv3::timerThread() */
     static void* timerWrapper(void* ptr);
+    /** handles datagram retransmission requests from all receivers */
+    void udpRetxThread();
+    /** a wrapper to call the actual fmtpSendv3::udpRetxThread() */
+    static void* StartUdpRetxThread(void* ptr);
     /* Prevent copying because it's meaningless */
     fmtpSendv3(fmtpSendv3&);
     fmtpSendv3& operator=(const fmtpSendv3&);
@@ -288,10 +542,38 @@ private:
 
 
     uint32_t            prodIndex;
+    /** shared runtime or `NULL` if the session runs its own threads */
+    SenderRuntime*      runtime;
+    uint32_t            sessionId;
     /** underlying udp layer instance */
     UdpSend*            udpsend;
     /** underlying tcp layer instance */
     TcpSend*            tcpsend;
+    /** unicast udp repair channel */
+    UdpRetxSend*        udpretx;
+    pthread_t           udpretx_t;
+    /** UDP repair addresses of registered receivers indexed by socket id */
+    std::map<int, struct sockaddr_in> udpPeers;
+    /** receivers registered with RCVR_OPT_CHECKSUMS indexed by socket id */
+    std::set<int>       sumRcvrs;
+    /** guards udpPeers and sumRcvrs */
+    std::mutex          udpPeerMtx;
+    /** unicast receivers indexed by socket id */
+    std::map<int, std::shared_ptr<UcastRcvr>> ucastRcvrs;
+    /** orders the registration of unicast receivers against new products */
+    std::mutex          ucastMtx;
+    /** number of running unicast stream threads */
+    unsigned            ucastThreads;
+    std::condition_variable ucastCv;
+    /** no more unicast receivers are accepted */
+    bool                ucastStopped;
+    /** index of the next product to be queued for the unicast receivers */
+    uint32_t            ucastNext;
+    /** paces the UDP repair datagrams */
+    RateShaper          retxshaper;
+    std::mutex          retxshapermtx;
+    /** UDP repair rate in bits per second, 0 means not shaped */
+    uint64_t            retxspeed;
     /** maintaining metadata for retx use. */
     senderMetadata*     sendMeta;
     /** sending application callback hook */
@@ -305,7 +587,9 @@ private:
     uint64_t            linkspeed;
     std::mutex          exitMutex;
     std::exception_ptr  except;
+    /** paces the multicast and the unicast streams together */
     RateShaper          rateshaper;
+    std::mutex          rateshapermtx;
     std::mutex          notifyprodmtx;
     std::mutex          notifycvmtx;
     uint32_t            notifyprodidx;
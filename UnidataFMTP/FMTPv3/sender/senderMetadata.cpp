@@ -155,6 +155,27 @@ bool senderMetadata::clearUnfinishedSet(uint32_t prodindex, int retxsockfd,
 }
 
 
+/**
+ * Gets the checksums of a product for its EOP. A product whose multicast
+ * hasn't finished yet has none.
+ *
+ * @param[in]  prodindex        specific product index
+ * @param[out] checksums        The checksums in network byte-order, empty if
+ *                              there are none.
+ */
+void senderMetadata::getChecksums(uint32_t prodindex,
+                                  std::vector<uint32_t>& checksums)
+{
+    std::unique_lock<std::mutex> lock(indexMetaMapLock);
+    std::map<uint32_t, RetxMetadata*>::iterator it =
+            indexMetaMap.find(prodindex);
+    if (it != indexMetaMap.end())
+        checksums = it->second->checksums;
+    else
+        checksums.clear();
+}
+
+
 /**
  * Fetch the requested RetxMetadata entry identified by a given prodindex. If
  * found nothing, return NULL pointer. Otherwise return the pointer to that
@@ -172,14 +193,38 @@ RetxMetadata* senderMetadata::getMetadata(uint32_t prodindex)
         std::unique_lock<std::mutex> lock(indexMetaMapLock);
         if ((it = indexMetaMap.find(prodindex)) != indexMetaMap.end()) {
             temp = it->second;
-            /* sets up exclusive flag to acquire this RetxMetadata */
-            it->second->inuse = true;
+            /*
+             * counts the users instead of setting a flag, since the TCP and
+             * the UDP retransmission tasks may hold the same entry at once.
+             */
+            ++it->second->inuse;
         }
     }
     return temp;
 }
 
 
+/**
+ * Returns the products that a receiver hasn't acknowledged yet, in the order
+ * of their product indexes.
+ *
+ * @param[in] retxsockfd        sock file descriptor of the retransmission tcp
+ *                              connection.
+ * @return    Product indexes of the unfinished products.
+ */
+std::list<uint32_t> senderMetadata::getUnfinProds(int retxsockfd)
+{
+    std::list<uint32_t> prods;
+    std::unique_lock<std::mutex> lock(indexMetaMapLock);
+    for (std::map<uint32_t, RetxMetadata*>::iterator it = indexMetaMap.begin();
+         it != indexMetaMap.end(); ++it) {
+        if (!it->second->remove && it->second->unfinReceivers.count(retxsockfd))
+            prods.push_back(it->first);
+    }
+    return prods;
+}
+
+
 /**
  * Sends all unACKed receivers an EOP. This is to make sure the unACKed
  * receivers did not miss the whole last file.
@@ -219,7 +264,7 @@ void senderMetadata::notifyUnACKedRcvrs(uint32_t prodindex, FmtpHeader* header,
                 /* check if recvrs in RetxMetadata still exist */
                 sklit = std::find(sklist.begin(), sklist.end(), *sockit);
                 if (sklit != sklist.end()) {
-                    int retval = TcpSend::send(*sockit, header, NULL, 0);
+                    int retval = tcpsend->sendData(*sockit, header, NULL, 0);
                     if (retval < 0) {
                         throw std::runtime_error(
                                 "senderMetadata::notifyUnACKedRcvrs() "
@@ -233,8 +278,9 @@ void senderMetadata::notifyUnACKedRcvrs(uint32_t prodindex, FmtpHeader* header,
 
 
 /**
- * Releases the acquired RetxMetadata. If it is marked as in use, reset
- * the in use flag. If it is marked as remove, remove it correspondingly.
+ * Releases the acquired RetxMetadata. If it is marked as in use, decrement
+ * the use count. If it is marked as remove and no longer in use, remove it
+ * correspondingly.
  *
  * @param[in] prodindex         product index of the requested product
  * @return    True if release operation is successful, otherwise false.
@@ -246,9 +292,9 @@ bool senderMetadata::releaseMetadata(uint32_t prodindex)
     std::map<uint32_t, RetxMetadata*>::iterator it;
     if ((it = indexMetaMap.find(prodindex)) != indexMetaMap.end()) {
         if (it->second->inuse) {
-            it->second->inuse = false;
+            --it->second->inuse;
         }
-        if (it->second->remove) {
+        if (it->second->remove && !it->second->inuse) {
             it->second->~RetxMetadata();
             indexMetaMap.erase(it);
         }
@@ -306,3 +352,21 @@ bool senderMetadata::rmRetxMetadata(uint32_t prodindex)
     }
     return rmSuccess;
 }
+
+
+/**
+ * Sets the checksums of a product once it has been multicast. They're set
+ * under the lock because retransmission tasks may be reading them.
+ *
+ * @param[in] prodindex         specific product index
+ * @param[in] checksums         The checksums in network byte-order.
+ */
+void senderMetadata::setChecksums(uint32_t prodindex,
+                                  const std::vector<uint32_t>& checksums)
+{
+    std::unique_lock<std::mutex> lock(indexMetaMapLock);
+    std::map<uint32_t, RetxMetadata*>::iterator it =
+            indexMetaMap.find(prodindex);
+    if (it != indexMetaMap.end())
+        it->second->checksums = checksums;
+}
@@ -38,9 +38,11 @@
 #include <time.h>
 #include <chrono>
 #include <cstring>
+#include <list>
 #include <map>
 #include <mutex>
 #include <set>
+#include <vector>
 
 #include "fmtpBase.h"
 #include "TcpSend.h"
@@ -57,16 +59,18 @@ struct RetxMetadata {
     void*           metadata;          /*!< metadata pointer            */
     double          retxTimeoutPeriod; /*!< timeout time in seconds     */
     void*           dataprod_p;        /*!< pointer to the data product */
+    /* checksums the EOP carries, in network byte-order, see ProdChecksum */
+    std::vector<uint32_t> checksums;
     /* unfinished receiver set indexed by socket id */
     std::set<int>   unfinReceivers;
-    /* indicates the RetxMetadata is in use */
-    bool            inuse;
+    /* number of retransmission tasks currently using the RetxMetadata */
+    unsigned        inuse;
     /* indicates the RetxMetadata should be removed */
     bool            remove;
 
     RetxMetadata(): startTime{0}, prodindex(0), prodLength(0), metaSize(0),
                     metadata(NULL), retxTimeoutPeriod(99999999999.0),
-                    dataprod_p(NULL), inuse(false), remove(false) {}
+                    dataprod_p(NULL), inuse(0), remove(false) {}
     ~RetxMetadata() {
         delete[] (char*)metadata;
         metadata = NULL;
@@ -84,6 +88,7 @@ struct RetxMetadata {
         prodLength(meta.prodLength),
         metaSize(meta.metaSize),
         retxTimeoutPeriod(meta.retxTimeoutPeriod),
+        checksums(meta.checksums),
         unfinReceivers(meta.unfinReceivers),
         inuse(meta.inuse),
         remove(meta.remove)
@@ -107,11 +112,15 @@ public:
     void addRetxMetadata(RetxMetadata* ptrMeta);
     bool clearUnfinishedSet(uint32_t prodindex, int retxsockfd,
                             TcpSend* tcpsend);
+    void getChecksums(uint32_t prodindex, std::vector<uint32_t>& checksums);
     RetxMetadata* getMetadata(uint32_t prodindex);
+    std::list<uint32_t> getUnfinProds(int retxsockfd);
     void notifyUnACKedRcvrs(uint32_t prodindex, FmtpHeader* header,
                             TcpSend* tcpsend);
     bool releaseMetadata(uint32_t prodindex);
     bool rmRetxMetadata(uint32_t prodindex);
+    void setChecksums(uint32_t prodindex,
+                      const std::vector<uint32_t>& checksums);
 
 private:
     /* first: prodindex; second: pointer to metadata of the specified prodindex */
@@ -0,0 +1,187 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      BlockTrackerBench.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Microbenchmark of the receiver's block trackers.
+ *
+ * Compares ProdStateTable with the interval map it replaced (OldProdSegMNG)
+ * and the vector<bool> bitmap before that (OldProdBlockMNG). Every product
+ * goes through the receiver's life cycle: its blocks arrive in order with
+ * some lost, the losses are found for the NACKs, the repairs arrive and the
+ * product is completed. Usage: BlockTrackerBench [nprods] [prodsize]
+ */
+
+
+#include "OldProdBlockMNG.h"
+#include "OldProdSegMNG.h"
+#include "ProdStateTable.h"
+#include "fmtpBase.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+/* the blocks of a product that get lost, by pattern */
+static std::vector<bool> lossPattern(const std::string& pattern,
+                                     const uint32_t nblocks,
+                                     std::mt19937& rng)
+{
+    std::vector<bool> lost(nblocks, false);
+    std::uniform_real_distribution<double> dist(0, 1);
+    for (uint32_t i = 0; i < nblocks; i++) {
+        if (pattern == "random" && dist(rng) < 0.01) {
+            lost[i] = true;
+        }
+        else if (pattern == "burst" && dist(rng) < 0.001) {
+            /* a burst of 50 blocks */
+            for (uint32_t j = i; j < std::min(i + 50, nblocks); j++)
+                lost[j] = true;
+            i += 49;
+        }
+    }
+    return lost;
+}
+
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static uint32_t blockLen(const uint32_t prodsize, const uint32_t block)
+{
+    return std::min(prodsize - block * FMTP_DATA_LEN, (uint32_t)FMTP_DATA_LEN);
+}
+
+
+/* ProdStateTable: NACKs come from a scan of the bitmap */
+static double runTable(const uint32_t nprods, const uint32_t prodsize,
+                       const std::vector<std::vector<bool> >& lost)
+{
+    ProdStateTable            table;
+    std::vector<MissingRange> missing;
+    const uint32_t            nblocks = lost[0].size();
+    const double              start = now();
+    bool                      evicted;
+    uint32_t                  evictedIndex;
+    uint32_t                  numRetrans;
+
+    for (uint32_t p = 0; p < nprods; p++) {
+        table.claim(p, prodsize, evicted, evictedIndex);
+        table.publish(p, NULL, false);
+        for (uint32_t b = 0; b < nblocks; b++)
+            if (!lost[p][b])
+                table.set(p, b * FMTP_DATA_LEN, blockLen(prodsize, b));
+        table.getMissing(p, 0, prodsize, missing);
+        for (size_t i = 0; i < missing.size(); i++)
+            for (uint32_t s = missing[i].seqnum;
+                 s < missing[i].seqnum + missing[i].length; s += FMTP_DATA_LEN)
+                table.set(p, s, blockLen(prodsize, s / FMTP_DATA_LEN));
+        if (!table.finish(p, numRetrans))
+            std::cerr << "ProdStateTable: product " << p << " incomplete\n";
+    }
+    return now() - start;
+}
+
+
+/* OldProdSegMNG: NACKs come from a lookup per block */
+static double runSeg(const uint32_t nprods, const uint32_t prodsize,
+                     const std::vector<std::vector<bool> >& lost)
+{
+    ProdSegMNG            mng;
+    std::vector<uint32_t> missing;
+    const uint32_t        nblocks = lost[0].size();
+    const double          start = now();
+
+    for (uint32_t p = 0; p < nprods; p++) {
+        mng.addProd(p, prodsize);
+        for (uint32_t b = 0; b < nblocks; b++)
+            if (!lost[p][b])
+                mng.set(p, b * FMTP_DATA_LEN, blockLen(prodsize, b));
+        missing.clear();
+        for (uint32_t b = 0; b < nblocks; b++)
+            if (!mng.isReceived(p, b * FMTP_DATA_LEN))
+                missing.push_back(b);
+        for (size_t i = 0; i < missing.size(); i++)
+            mng.set(p, missing[i] * FMTP_DATA_LEN,
+                    blockLen(prodsize, missing[i]));
+        if (!mng.delIfComplete(p))
+            std::cerr << "OldProdSegMNG: product " << p << " incomplete\n";
+    }
+    return now() - start;
+}
+
+
+/* OldProdBlockMNG: has no query, so the NACKs come from the loss pattern */
+static double runBlock(const uint32_t nprods, const uint32_t prodsize,
+                       const std::vector<std::vector<bool> >& lost)
+{
+    ProdBlockMNG   mng;
+    const uint32_t nblocks = lost[0].size();
+    const double   start = now();
+
+    for (uint32_t p = 0; p < nprods; p++) {
+        mng.addProd(p, nblocks);
+        for (uint32_t b = 0; b < nblocks; b++)
+            if (!lost[p][b])
+                mng.set(p, b);
+        for (uint32_t b = 0; b < nblocks; b++)
+            if (lost[p][b])
+                mng.set(p, b);
+        if (!mng.delIfComplete(p))
+            std::cerr << "OldProdBlockMNG: product " << p << " incomplete\n";
+    }
+    return now() - start;
+}
+
+
+int main(int argc, char const* argv[])
+{
+    const uint32_t nprods   = argc > 1 ? atoi(argv[1]) : 200;
+    const uint32_t prodsize = argc > 2 ? atoi(argv[2]) : 4000000;
+    const uint32_t nblocks  = (prodsize + FMTP_DATA_LEN - 1) / FMTP_DATA_LEN;
+    const char*    patterns[] = {"in-order", "random", "burst"};
+
+    std::cout << nprods << " products of " << nblocks << " blocks, "
+              << "ns per block" << std::endl;
+    for (int i = 0; i < 3; i++) {
+        std::mt19937 rng(1);
+        std::vector<std::vector<bool> > lost;
+        for (uint32_t p = 0; p < nprods; p++)
+            lost.push_back(lossPattern(patterns[i], nblocks, rng));
+
+        const double scale = 1e9 / ((double)nprods * nblocks);
+        std::cout << patterns[i]
+                  << ": ProdStateTable "
+                  << runTable(nprods, prodsize, lost) * scale
+                  << ", OldProdSegMNG " << runSeg(nprods, prodsize, lost) * scale
+                  << ", OldProdBlockMNG "
+                  << runBlock(nprods, prodsize, lost) * scale << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      EOPTimerWheelTest.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Test the EOP deadlines of class `EOPTimerWheel`.
+ *
+ * The wheel is turned by calling its private expire() with chosen ticks
+ * instead of waiting for the clock, so the tests don't depend on timing.
+ * The private methods are reached by compiling the wheel's header with
+ * `private` made public.
+ */
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#define private public
+#include "EOPTimerWheel.h"
+#undef private
+
+namespace {
+
+typedef std::chrono::milliseconds ms;
+
+// The fixture for testing class EOPTimerWheel.
+class EOPTimerWheelTest : public ::testing::Test {
+ protected:
+  // Returns the tick of a product's deadline, 0 if it has none.
+  uint64_t tickOf(const uint32_t prodindex) {
+    auto it = wheel.index.find(prodindex);
+    return it == wheel.index.end() ? 0 : it->second->tick;
+  }
+
+  // Turns the wheel up to a tick, one tick at a time, and returns the
+  // products that expired.
+  std::vector<uint32_t> turn(const uint64_t tick) {
+    std::vector<uint32_t> expired;
+    for (uint64_t now = wheel.cursor; now <= tick; now++)
+      wheel.expire(now, expired);
+    return expired;
+  }
+
+  EOPTimerWheel wheel;
+};
+
+TEST_F(EOPTimerWheelTest, AdvanceNeverPostpones) {
+    wheel.add(1, ms(100));
+    const uint64_t tick = tickOf(1);
+    ASSERT_LT(0, tick);
+
+    wheel.advance(1, ms(500));
+    EXPECT_EQ(tick, tickOf(1));
+    wheel.advance(1, ms(100000));
+    EXPECT_EQ(tick, tickOf(1));
+
+    wheel.advance(1, ms(10));
+    const uint64_t earlier = tickOf(1);
+    EXPECT_LT(earlier, tick);
+    wheel.advance(1, ms(50));
+    EXPECT_EQ(earlier, tickOf(1));
+
+    // unlike advance(), add() replaces the deadline
+    wheel.add(1, ms(500));
+    EXPECT_LT(tick, tickOf(1));
+}
+
+TEST_F(EOPTimerWheelTest, AdvanceAddsMissingDeadline) {
+    wheel.advance(2, ms(20));
+    EXPECT_LT(0, tickOf(2));
+    EXPECT_EQ(1, wheel.index.size());
+}
+
+TEST_F(EOPTimerWheelTest, ExpiresAfterMoreThanOneRevolution) {
+    // the slot comes round once before the deadline passes
+    wheel.add(3, ms(EOP_WHEEL_SLOTS * EOP_WHEEL_TICK_US / 1000 * 3 / 2));
+    const uint64_t tick = tickOf(3);
+    ASSERT_LT(EOP_WHEEL_SLOTS, tick);
+
+    EXPECT_EQ(0, turn(tick - 1).size());
+    EXPECT_EQ(tick, tickOf(3));
+
+    std::vector<uint32_t> expired = turn(tick);
+    ASSERT_EQ(1, expired.size());
+    EXPECT_EQ(3, expired[0]);
+    EXPECT_EQ(0, wheel.index.size());
+}
+
+TEST_F(EOPTimerWheelTest, ExpiresAfterSkippedRevolutions) {
+    // the timer thread wakes up late, several revolutions after the cursor
+    wheel.add(4, ms(10));
+    wheel.add(5, ms(EOP_WHEEL_SLOTS * EOP_WHEEL_TICK_US / 1000 * 5 / 2));
+    const uint64_t tick = tickOf(5);
+
+    std::vector<uint32_t> expired;
+    wheel.expire(tick - 1, expired);
+    ASSERT_EQ(1, expired.size());
+    EXPECT_EQ(4, expired[0]);
+
+    expired.clear();
+    wheel.expire(tick, expired);
+    ASSERT_EQ(1, expired.size());
+    EXPECT_EQ(5, expired[0]);
+}
+
+TEST_F(EOPTimerWheelTest, CancelAfterExpire) {
+    wheel.add(6, ms(5));
+    std::vector<uint32_t> expired = turn(tickOf(6));
+    ASSERT_EQ(1, expired.size());
+
+    wheel.cancel(6);
+    EXPECT_EQ(0, wheel.index.size());
+
+    // a new deadline of the same product still expires
+    wheel.add(6, ms(5));
+    expired = turn(tickOf(6));
+    ASSERT_EQ(1, expired.size());
+    EXPECT_EQ(6, expired[0]);
+}
+
+TEST_F(EOPTimerWheelTest, CancelledDeadlineDoesntExpire) {
+    wheel.add(7, ms(5));
+    wheel.add(8, ms(5));
+    const uint64_t tick = tickOf(7);
+    wheel.cancel(7);
+    wheel.cancel(7);
+
+    std::vector<uint32_t> expired = turn(tick);
+    ASSERT_EQ(1, expired.size());
+    EXPECT_EQ(8, expired[0]);
+}
+
+TEST_F(EOPTimerWheelTest, WaitReturnsExpired) {
+    wheel.add(9, ms(2));
+    std::vector<uint32_t> expired;
+    ASSERT_TRUE(wheel.wait(expired));
+    ASSERT_EQ(1, expired.size());
+    EXPECT_EQ(9, expired[0]);
+
+    wheel.stop();
+    EXPECT_FALSE(wheel.wait(expired));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
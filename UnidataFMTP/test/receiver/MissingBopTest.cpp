@@ -0,0 +1,142 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      MissingBopTest.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Test how class `fmtpRecvv3` requests missing BOPs.
+ *
+ * Packets of older products can arrive late on the multicast group; they
+ * must neither move the receiver's most recent product index back nor look
+ * like a gap of almost 2^32 products, which would make the receiver give up
+ * on every product. The private methods are reached by compiling the
+ * receiver's header with `private` made public.
+ */
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#define private public
+#include "fmtpRecvv3.h"
+#undef private
+
+namespace {
+
+// The fixture for testing how class fmtpRecvv3 requests missing BOPs.
+class MissingBopTest : public ::testing::Test {
+ protected:
+  MissingBopTest()
+    : recv("127.0.0.1", 1, "239.0.0.1", 1) {
+  }
+
+  // Returns the queued BOP requests and give-ups.
+  void take(std::vector<INLReqMsg>& reqs, std::vector<NackGiveUp>& giveups) {
+    recv.nacks->stop();
+    (void)recv.nacks->take(reqs, giveups);
+  }
+
+  fmtpRecvv3 recv;
+};
+
+TEST_F(MissingBopTest, GapIsRequested) {
+    recv.prodidx_mcast = 10;
+    recv.requestMissingBopsExclusive(13);
+    ASSERT_EQ(13, recv.prodidx_mcast);
+
+    std::vector<INLReqMsg>  reqs;
+    std::vector<NackGiveUp> giveups;
+    take(reqs, giveups);
+    ASSERT_EQ(0, giveups.size());
+    ASSERT_EQ(2, reqs.size());
+    EXPECT_EQ(11, reqs[0].prodindex);
+    EXPECT_EQ(12, reqs[1].prodindex);
+}
+
+TEST_F(MissingBopTest, OlderProductExclusive) {
+    recv.prodidx_mcast = 100;
+    recv.requestMissingBopsExclusive(97);
+    ASSERT_EQ(100, recv.prodidx_mcast);
+
+    std::vector<INLReqMsg>  reqs;
+    std::vector<NackGiveUp> giveups;
+    take(reqs, giveups);
+    EXPECT_EQ(0, giveups.size());
+    EXPECT_EQ(0, reqs.size());
+}
+
+TEST_F(MissingBopTest, OlderProductInclusive) {
+    recv.prodidx_mcast = 100;
+    recv.requestMissingBopsInclusive(98);
+    ASSERT_EQ(100, recv.prodidx_mcast);
+    recv.requestMissingBopsInclusive(100);
+    ASSERT_EQ(100, recv.prodidx_mcast);
+
+    std::vector<INLReqMsg>  reqs;
+    std::vector<NackGiveUp> giveups;
+    take(reqs, giveups);
+    EXPECT_EQ(0, giveups.size());
+    EXPECT_EQ(0, reqs.size());
+}
+
+TEST_F(MissingBopTest, OlderProductAcrossWrap) {
+    recv.prodidx_mcast = 1;
+    recv.requestMissingBopsExclusive(0xFFFFFFFE);
+    ASSERT_EQ(1, recv.prodidx_mcast);
+    recv.requestMissingBopsExclusive(3);
+    ASSERT_EQ(3, recv.prodidx_mcast);
+
+    std::vector<INLReqMsg>  reqs;
+    std::vector<NackGiveUp> giveups;
+    take(reqs, giveups);
+    EXPECT_EQ(0, giveups.size());
+    ASSERT_EQ(1, reqs.size());
+    EXPECT_EQ(2, reqs[0].prodindex);
+}
+
+TEST_F(MissingBopTest, LongGapIsGivenUp) {
+    recv.nacks->setLimit(16);
+    recv.prodidx_mcast = 10;
+    recv.requestMissingBopsExclusive(100);
+    ASSERT_EQ(100, recv.prodidx_mcast);
+
+    std::vector<INLReqMsg>  reqs;
+    std::vector<NackGiveUp> giveups;
+    take(reqs, giveups);
+    EXPECT_EQ(0, reqs.size());
+    ASSERT_EQ(1, giveups.size());
+    EXPECT_EQ(11, giveups[0].prodindex);
+    EXPECT_EQ(89, giveups[0].count);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,229 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      NackSchedulerTest.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Test the retransmission-request scheduler `NackScheduler`.
+ *
+ * Requests must be handed out BOPs first, then EOPs, then data, each oldest
+ * product first, also across the wrap of the product index. A full
+ * scheduler gives up on the product with the lowest-priority requests, and
+ * a product that has been given up on isn't requested again.
+ */
+
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "NackScheduler.h"
+
+namespace {
+
+// Returns a request.
+INLReqMsg req(const int reqtype, const uint32_t prodindex,
+              const uint32_t seqnum = 0, const uint32_t length = 0) {
+    INLReqMsg req = {reqtype, prodindex, seqnum, length};
+    return req;
+}
+
+// The fixture for testing class NackScheduler.
+class NackSchedulerTest : public ::testing::Test {
+ protected:
+  NackSchedulerTest()
+    : nacks(NACK_LIMIT) {
+  }
+
+  // Returns the waiting requests and give-ups without blocking.
+  void take() {
+    nacks.stop();
+    (void)nacks.take(reqs, giveups);
+  }
+
+  NackScheduler           nacks;
+  std::vector<INLReqMsg>  reqs;
+  std::vector<NackGiveUp> giveups;
+};
+
+TEST_F(NackSchedulerTest, PriorityOrder) {
+    nacks.push(req(MISSING_DATA, 5, 0, 100));
+    nacks.push(req(MISSING_EOP, 6));
+    nacks.push(req(MISSING_BOP, 8));
+    nacks.push(req(MISSING_DATA, 3, 200, 100));
+    nacks.push(req(MISSING_BOP, 7));
+    nacks.push(req(MISSING_EOP, 4));
+    nacks.push(req(MISSING_DATA, 3, 0, 100));
+    take();
+
+    ASSERT_EQ(7, reqs.size());
+    EXPECT_EQ(MISSING_BOP, reqs[0].reqtype);
+    EXPECT_EQ(7, reqs[0].prodindex);
+    EXPECT_EQ(MISSING_BOP, reqs[1].reqtype);
+    EXPECT_EQ(8, reqs[1].prodindex);
+    EXPECT_EQ(MISSING_EOP, reqs[2].reqtype);
+    EXPECT_EQ(4, reqs[2].prodindex);
+    EXPECT_EQ(MISSING_EOP, reqs[3].reqtype);
+    EXPECT_EQ(6, reqs[3].prodindex);
+    // the data requests of a product stay in the order they were made
+    EXPECT_EQ(3, reqs[4].prodindex);
+    EXPECT_EQ(200, reqs[4].seqnum);
+    EXPECT_EQ(3, reqs[5].prodindex);
+    EXPECT_EQ(0, reqs[5].seqnum);
+    EXPECT_EQ(5, reqs[6].prodindex);
+    EXPECT_EQ(0, giveups.size());
+}
+
+TEST_F(NackSchedulerTest, PriorityOrderAcrossWrap) {
+    nacks.push(req(MISSING_BOP, 1));
+    nacks.push(req(MISSING_BOP, 0xFFFFFFFF));
+    nacks.push(req(MISSING_DATA, 0, 0, 100));
+    nacks.push(req(MISSING_DATA, 0xFFFFFFFE, 0, 100));
+    take();
+
+    ASSERT_EQ(4, reqs.size());
+    EXPECT_EQ(0xFFFFFFFF, reqs[0].prodindex);
+    EXPECT_EQ(1, reqs[1].prodindex);
+    EXPECT_EQ(0xFFFFFFFE, reqs[2].prodindex);
+    EXPECT_EQ(0, reqs[3].prodindex);
+}
+
+TEST_F(NackSchedulerTest, BopAndEopRequestsAreMerged) {
+    std::vector<INLReqMsg> batch;
+    batch.push_back(req(MISSING_BOP, 9));
+    batch.push_back(req(MISSING_EOP, 9));
+    batch.push_back(req(MISSING_BOP, 9));
+    nacks.push(batch);
+    nacks.push(req(MISSING_EOP, 9));
+    nacks.push(req(MISSING_DATA, 9, 0, 100));
+    nacks.push(req(MISSING_DATA, 9, 0, 100));
+    take();
+
+    ASSERT_EQ(4, reqs.size());
+    EXPECT_EQ(MISSING_BOP, reqs[0].reqtype);
+    EXPECT_EQ(MISSING_EOP, reqs[1].reqtype);
+    EXPECT_EQ(MISSING_DATA, reqs[2].reqtype);
+    EXPECT_EQ(MISSING_DATA, reqs[3].reqtype);
+}
+
+TEST_F(NackSchedulerTest, MergedRequestsDontCount) {
+    nacks.setLimit(2);
+    nacks.push(req(MISSING_BOP, 1));
+    nacks.push(req(MISSING_BOP, 1));
+    nacks.push(req(MISSING_EOP, 2));
+    take();
+
+    EXPECT_EQ(2, reqs.size());
+    EXPECT_EQ(0, giveups.size());
+}
+
+TEST_F(NackSchedulerTest, LowerPriorityIsEvicted) {
+    nacks.setLimit(3);
+    nacks.push(req(MISSING_DATA, 5, 0, 100));
+    nacks.push(req(MISSING_DATA, 6, 0, 100));
+    nacks.push(req(MISSING_DATA, 6, 100, 100));
+    // every data request of product 6, the newest, goes
+    nacks.push(req(MISSING_BOP, 8));
+    take();
+
+    ASSERT_EQ(2, reqs.size());
+    EXPECT_EQ(MISSING_BOP, reqs[0].reqtype);
+    EXPECT_EQ(8, reqs[0].prodindex);
+    EXPECT_EQ(MISSING_DATA, reqs[1].reqtype);
+    EXPECT_EQ(5, reqs[1].prodindex);
+    ASSERT_EQ(1, giveups.size());
+    EXPECT_EQ(6, giveups[0].prodindex);
+    EXPECT_EQ(1, giveups[0].count);
+}
+
+TEST_F(NackSchedulerTest, OlderProductOfSameRankEvictsNewer) {
+    nacks.setLimit(2);
+    nacks.push(req(MISSING_EOP, 5));
+    nacks.push(req(MISSING_EOP, 7));
+    nacks.push(req(MISSING_EOP, 6));
+    take();
+
+    ASSERT_EQ(2, reqs.size());
+    EXPECT_EQ(5, reqs[0].prodindex);
+    EXPECT_EQ(6, reqs[1].prodindex);
+    ASSERT_EQ(1, giveups.size());
+    EXPECT_EQ(7, giveups[0].prodindex);
+}
+
+TEST_F(NackSchedulerTest, NewestRequestIsGivenUpOn) {
+    nacks.setLimit(2);
+    nacks.push(req(MISSING_EOP, 5));
+    nacks.push(req(MISSING_DATA, 6, 0, 100));
+    // no priority over the waiting ones, so its own product goes
+    nacks.push(req(MISSING_DATA, 7, 0, 100));
+    take();
+
+    ASSERT_EQ(2, reqs.size());
+    EXPECT_EQ(5, reqs[0].prodindex);
+    EXPECT_EQ(6, reqs[1].prodindex);
+    ASSERT_EQ(1, giveups.size());
+    EXPECT_EQ(7, giveups[0].prodindex);
+}
+
+TEST_F(NackSchedulerTest, EvictedProductIsNotRequestedAgain) {
+    nacks.setLimit(1);
+    nacks.push(req(MISSING_DATA, 5, 0, 100));
+    nacks.push(req(MISSING_BOP, 6));
+    nacks.push(req(MISSING_DATA, 5, 100, 100));
+    nacks.push(req(MISSING_EOP, 5));
+    take();
+
+    ASSERT_EQ(1, reqs.size());
+    EXPECT_EQ(MISSING_BOP, reqs[0].reqtype);
+    EXPECT_EQ(6, reqs[0].prodindex);
+    ASSERT_EQ(1, giveups.size());
+    EXPECT_EQ(5, giveups[0].prodindex);
+}
+
+TEST_F(NackSchedulerTest, GiveUpSuppressesRequestsAcrossWrap) {
+    nacks.giveUp(0xFFFFFFFE, 4);
+    nacks.push(req(MISSING_BOP, 0xFFFFFFFE));
+    nacks.push(req(MISSING_BOP, 0xFFFFFFFF));
+    nacks.push(req(MISSING_EOP, 0));
+    nacks.push(req(MISSING_DATA, 1, 0, 100));
+    nacks.push(req(MISSING_BOP, 0xFFFFFFFD));
+    nacks.push(req(MISSING_BOP, 2));
+    take();
+
+    ASSERT_EQ(2, reqs.size());
+    EXPECT_EQ(0xFFFFFFFD, reqs[0].prodindex);
+    EXPECT_EQ(2, reqs[1].prodindex);
+    ASSERT_EQ(1, giveups.size());
+    EXPECT_EQ(0xFFFFFFFE, giveups[0].prodindex);
+    EXPECT_EQ(4, giveups[0].count);
+}
+
+TEST_F(NackSchedulerTest, TakeReturnsFalseOnceStopped) {
+    nacks.push(req(MISSING_BOP, 1));
+    nacks.stop();
+    EXPECT_FALSE(nacks.take(reqs, giveups));
+    EXPECT_EQ(1, reqs.size());
+    EXPECT_FALSE(nacks.take(reqs, giveups));
+    EXPECT_EQ(0, reqs.size());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,205 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      NotifyQueueTest.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Test the notification queue of class `NotifyQueue`.
+ *
+ * Several threads queue events into a tiny ring while one takes them. The
+ * events of each thread must come out in the order they were queued, also
+ * when some of them overflow the ring, so that the application never sees
+ * the progress of a product after its end.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "NotifyQueue.h"
+
+namespace {
+
+const unsigned PRODUCERS = 4;
+const unsigned PRODUCTS  = 2000;
+
+// Returns an event of a product of a producer.
+RecvEvent event(const int type, const unsigned producer, const unsigned prod,
+                const size_t size = 0) {
+    RecvEvent event;
+    (void)memset(&event, 0, sizeof(event));
+    event.type  = type;
+    event.iProd = producer << 24 | prod;
+    event.size  = size;
+    return event;
+}
+
+// Returns the position of an event in its producer's sequence: the two
+// progress events of a product and then its end.
+unsigned position(const RecvEvent& event) {
+    const unsigned prod = event.iProd & 0xFFFFFF;
+    return prod * 3 + (event.type == RECV_END_PROD ? 2 : event.size - 1);
+}
+
+// Queues the events of PRODUCTS products from each of PRODUCERS threads
+// while taking them in small batches. Checks that every product ends, that
+// each producer's events are taken in order and that no progress event of
+// a product is taken after its end.
+void runProducers(NotifyQueue& queue) {
+    std::vector<std::thread> producers;
+    for (unsigned p = 0; p < PRODUCERS; p++) {
+        producers.push_back(std::thread([&queue, p] {
+            for (unsigned i = 0; i < PRODUCTS; i++) {
+                ASSERT_TRUE(queue.push(event(RECV_PROD_PROGRESS, p, i, 1)));
+                ASSERT_TRUE(queue.push(event(RECV_PROD_PROGRESS, p, i, 2)));
+                ASSERT_TRUE(queue.push(event(RECV_END_PROD, p, i)));
+            }
+        }));
+    }
+
+    std::vector<unsigned> ends(PRODUCERS, 0);
+    std::vector<int>      last(PRODUCERS, -1);
+    unsigned              done = 0;
+    RecvEvent             events[3];
+    while (done < PRODUCERS * PRODUCTS) {
+        const size_t n = queue.take(events, 3);
+        ASSERT_LT(0, n);
+        for (size_t i = 0; i < n; i++) {
+            const unsigned producer = events[i].iProd >> 24;
+            ASSERT_LT(producer, PRODUCERS);
+            const int pos = position(events[i]);
+            EXPECT_LT(last[producer], pos);
+            last[producer] = pos;
+            if (events[i].type == RECV_END_PROD) {
+                EXPECT_EQ(ends[producer], events[i].iProd & 0xFFFFFF);
+                ends[producer]++;
+                done++;
+            }
+        }
+    }
+
+    for (unsigned p = 0; p < PRODUCERS; p++) {
+        producers[p].join();
+        EXPECT_EQ(PRODUCTS, ends[p]);
+    }
+}
+
+TEST(NotifyQueueTest, SpilledEventsFollowTheRing) {
+    NotifyQueue queue(2, NOTIFY_GROW);
+    for (unsigned i = 0; i < 10; i++)
+        ASSERT_TRUE(queue.push(event(RECV_END_PROD, 0, i)));
+
+    RecvEvent events[16];
+    ASSERT_EQ(10, queue.take(events, 16));
+    for (unsigned i = 0; i < 10; i++)
+        EXPECT_EQ(i, events[i].iProd);
+
+    NotifyStats stats;
+    queue.getStats(stats);
+    EXPECT_EQ(10, stats.queued);
+    EXPECT_EQ(8, stats.spilled);
+}
+
+TEST(NotifyQueueTest, DepthOfOneKeepsEvents) {
+    NotifyQueue queue(1, NOTIFY_GROW);
+    for (unsigned i = 0; i < 3; i++)
+        ASSERT_TRUE(queue.push(event(RECV_END_PROD, 0, i)));
+
+    RecvEvent events[4];
+    ASSERT_EQ(3, queue.take(events, 4));
+    for (unsigned i = 0; i < 3; i++)
+        EXPECT_EQ(i, events[i].iProd);
+}
+
+TEST(NotifyQueueTest, ProgressIsDroppedWhenFull) {
+    NotifyQueue queue(2, NOTIFY_GROW);
+    ASSERT_TRUE(queue.push(event(RECV_PROD_PROGRESS, 0, 1, 1)));
+    ASSERT_TRUE(queue.push(event(RECV_PROD_PROGRESS, 0, 1, 2)));
+    ASSERT_TRUE(queue.push(event(RECV_PROD_PROGRESS, 0, 1, 3)));
+    ASSERT_TRUE(queue.push(event(RECV_END_PROD, 0, 1)));
+
+    RecvEvent events[4];
+    ASSERT_EQ(3, queue.take(events, 4));
+    EXPECT_EQ(1, events[0].size);
+    EXPECT_EQ(2, events[1].size);
+    EXPECT_EQ(RECV_END_PROD, events[2].type);
+
+    NotifyStats stats;
+    queue.getStats(stats);
+    EXPECT_EQ(1, stats.dropped);
+    EXPECT_EQ(1, stats.spilled);
+}
+
+TEST(NotifyQueueTest, TakeWakesUpOnPush) {
+    NotifyQueue queue(4, NOTIFY_WAIT);
+    std::thread producer([&queue] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        (void)queue.push(event(RECV_MISSED_PROD, 0, 7));
+    });
+
+    RecvEvent events[4];
+    ASSERT_EQ(1, queue.take(events, 4));
+    EXPECT_EQ(RECV_MISSED_PROD, events[0].type);
+    EXPECT_EQ(7, events[0].iProd);
+    producer.join();
+}
+
+TEST(NotifyQueueTest, StopReleasesWaitingPush) {
+    NotifyQueue queue(2, NOTIFY_WAIT);
+    ASSERT_TRUE(queue.push(event(RECV_END_PROD, 0, 1)));
+    ASSERT_TRUE(queue.push(event(RECV_END_PROD, 0, 2)));
+
+    bool        queued = true;
+    std::thread producer([&queue, &queued] {
+        queued = queue.push(event(RECV_END_PROD, 0, 3));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.stop();
+    producer.join();
+    EXPECT_FALSE(queued);
+
+    RecvEvent events[4];
+    ASSERT_EQ(2, queue.take(events, 4));
+    EXPECT_EQ(1, events[0].iProd);
+    EXPECT_EQ(2, events[1].iProd);
+    EXPECT_EQ(0, queue.take(events, 4));
+}
+
+TEST(NotifyQueueTest, ProducersGrow) {
+    NotifyQueue queue(2, NOTIFY_GROW);
+    runProducers(queue);
+}
+
+TEST(NotifyQueueTest, ProducersWait) {
+    NotifyQueue queue(2, NOTIFY_WAIT);
+    runProducers(queue);
+
+    NotifyStats stats;
+    queue.getStats(stats);
+    EXPECT_EQ(0, stats.spilled);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -27,7 +27,7 @@
  */
 
 
-#include "ProdBlockMNG.h"
+#include "OldProdBlockMNG.h"
 
 
 /**
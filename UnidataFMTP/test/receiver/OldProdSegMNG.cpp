@@ -29,7 +29,7 @@
  */
 
 
-#include "ProdSegMNG.h"
+#include "OldProdSegMNG.h"
 
 
 /**
@@ -177,6 +177,41 @@ bool ProdSegMNG::isComplete(const uint32_t prodindex)
 }
 
 
+/**
+ * Checks if the segment starting at the given sequence number has been
+ * received.
+ *
+ * @param[in] prodindex        Product index of the product to query.
+ * @param[in] seqnum           Sequence number of the segment.
+ * @return                     true for received and false for unreceived or
+ *                             product not found.
+ */
+bool ProdSegMNG::isReceived(const uint32_t prodindex, const uint32_t seqnum)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (segmapSet.count(prodindex)) {
+        SegMap* segmap = segmapSet[prodindex];
+        if (segmap->completed) {
+            return true;
+        }
+        else {
+            /* the entry starting at or before seqnum might cover it */
+            SeqLenMap::iterator it = segmap->seqlenMap.upper_bound(seqnum);
+            if (it == segmap->seqlenMap.begin()) {
+                return true;
+            }
+            else {
+                it--;
+                return it->first + it->second <= seqnum;
+            }
+        }
+    }
+    else {
+        return false;
+    }
+}
+
+
 /**
  * Removes a product from map and frees its resources.
  *
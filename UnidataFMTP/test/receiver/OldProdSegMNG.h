@@ -59,6 +59,7 @@ public:
     bool delIfComplete(const uint32_t prodindex);
     bool getLastSegment(const uint32_t prodindex);
     bool isComplete(const uint32_t prodindex);
+    bool isReceived(const uint32_t prodindex, const uint32_t seqnum);
     bool rmProd(const uint32_t prodindex);
     int  set(const uint32_t prodindex, const uint32_t seqnum,
              const uint16_t payloadlen);
@@ -0,0 +1,185 @@
+/**
+ * Copyright (C) 2026 University of Virginia. All rights reserved.
+ *
+ * @file      RetxLatency.cpp
+ *
+ * @section   LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @brief     Product latency benchmark of the TCP and UDP repair channels.
+ *
+ * Runs a sender and a receiver in one process and reports the distribution
+ * of the time from the start of a product's transmission until the receiver
+ * has it completely. Loss is applied from outside, e.g.
+ *
+ *     tc qdisc add dev eth0 root netem loss 1%
+ *
+ * which drops multicast data as well as repairs and requests, or, where that
+ * isn't available, emulated by building with TEST_LOSS (see Makefile_latency
+ * and fmtpSendv3.cpp). The TCP connection must be subject to loss as well for
+ * the two channels to be compared: with lossless TCP, only the UDP repairs
+ * can be lost.
+ */
+
+
+#include "fmtpSendv3.h"
+#include "fmtpRecvv3.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+class LatencyProxy : public RecvProxy
+{
+public:
+    LatencyProxy() : missed(0) {}
+    ~LatencyProxy()
+    {
+        for (auto it = bufs.begin(); it != bufs.end(); ++it)
+            delete[] it->second;
+    }
+
+    void startProd(const struct timespec& start, uint32_t iProd,
+                   size_t prodSize, void* metadata, unsigned metaSize,
+                   void** data)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        char* buf   = new char[prodSize];
+        bufs[iProd] = buf;
+        starts[iProd] = start;
+        *data = buf;
+    }
+
+    void endProd(const struct timespec& stop, uint32_t iProd,
+                 uint32_t numRetrans)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        const struct timespec& start = starts[iProd];
+        latencies.push_back((stop.tv_sec - start.tv_sec) +
+                            (stop.tv_nsec - start.tv_nsec) / 1e9);
+        release(iProd);
+    }
+
+    void missedProd(uint32_t iProd)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ++missed;
+        release(iProd);
+    }
+
+    size_t numDone()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return latencies.size() + missed;
+    }
+
+    void report(const char* mode)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::sort(latencies.begin(), latencies.end());
+        const double pct[] = {50, 90, 99, 99.9, 100};
+        printf("%s: %zu products, %u missed\n", mode, latencies.size(),
+               missed);
+        if (latencies.empty())
+            return;
+        for (unsigned i = 0; i < sizeof(pct)/sizeof(pct[0]); i++) {
+            size_t idx = static_cast<size_t>(pct[i] / 100 *
+                                             (latencies.size() - 1));
+            printf("  p%-5g %10.3f ms\n", pct[i], latencies[idx] * 1e3);
+        }
+    }
+
+private:
+    void release(uint32_t iProd)
+    {
+        auto it = bufs.find(iProd);
+        if (it != bufs.end()) {
+            delete[] it->second;
+            bufs.erase(it);
+        }
+        starts.erase(iProd);
+    }
+
+    std::mutex                        mutex;
+    std::map<uint32_t, char*>         bufs;
+    std::map<uint32_t, struct timespec> starts;
+    std::vector<double>               latencies;
+    unsigned                          missed;
+};
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4) {
+        puts("usage: RetxLatency ifaddr mcastaddr tcp|udp [nprods] "
+             "[prodsize] [rate_mbps]");
+        return 1;
+    }
+
+    const std::string    ifAddr    = argv[1];
+    const std::string    mcastAddr = argv[2];
+    const bool           udp       = !strcmp(argv[3], "udp");
+    const unsigned       nprods    = argc > 4 ? atoi(argv[4]) : 500;
+    const uint32_t       prodsize  = argc > 5 ? atoi(argv[5]) : 1000000;
+    const uint64_t       rate      = (argc > 6 ? atoi(argv[6]) : 100) *
+                                     1000000ULL;
+    const unsigned short mcastPort = 5173;
+
+    char* data = new char[prodsize];
+    (void)memset(data, 0xa, prodsize);
+
+    fmtpSendv3 sender(ifAddr.c_str(), 0, mcastAddr.c_str(), mcastPort, NULL, 1,
+                      ifAddr, 0, 1.0);
+    sender.SetSendRate(rate);
+    sender.Start();
+
+    LatencyProxy proxy;
+    fmtpRecvv3   recv(ifAddr, sender.getTcpPortNum(), mcastAddr, mcastPort,
+                      &proxy, ifAddr);
+    recv.SetUdpRetx(udp);
+    std::thread recvThread([&recv] {
+        try {
+            recv.Start();
+        }
+        catch (const std::exception& e) {
+            fprintf(stderr, "receiver: %s\n", e.what());
+        }
+    });
+    sleep(1);
+
+    for (unsigned i = 0; i < nprods; i++)
+        sender.sendProduct(data, prodsize);
+
+    /* waits for the stragglers, bounded by the sender's timeout */
+    for (int t = 0; t < 600 && proxy.numDone() < nprods; t++)
+        usleep(10000);
+
+    proxy.report(udp ? "udp" : "tcp");
+
+    recv.Stop();
+    recvThread.join();
+    sender.Stop();
+    delete[] data;
+    return 0;
+}